@@ -0,0 +1,249 @@
+// animation.cpp: Animator implementation
+
+#include <algorithm>
+#include <chrono>
+
+#include "foundation.hpp"
+#include "handle.hpp"
+#include "property.hpp"
+#include "widget.hpp"
+#include "animation.hpp"
+
+using namespace DirectWidget;
+
+//
+// Easing
+//
+
+float DirectWidget::ease(Easing easing, float progress)
+{
+    auto t = (std::clamp)(progress, 0.0f, 1.0f);
+
+    switch (easing) {
+    case Easing::EaseIn:
+        return t * t * t;
+
+    case Easing::EaseOut:
+    {
+        auto u = 1.0f - t;
+        return 1.0f - u * u * u;
+    }
+
+    case Easing::EaseInOut:
+    {
+        if (t < 0.5f) return 4.0f * t * t * t;
+        auto u = 2.0f - 2.0f * t;
+        return 1.0f - u * u * u / 2.0f;
+    }
+
+    case Easing::Step:
+        return t < 1.0f ? 0.0f : 1.0f;
+
+    case Easing::Linear:
+    default:
+        return t;
+    }
+}
+
+//
+// Animator
+//
+
+Animator& Animator::instance()
+{
+    static Animator animator;
+    return animator;
+}
+
+animation_id Animator::start(WidgetBase* widget, ANIMATION& animation, WidgetBase* frame)
+{
+    animation.id = m_next_id++;
+    animation.owner = element_handle(widget);
+    animation.frame = element_handle(frame != nullptr ? frame : widget);
+    animation.start = now();
+
+    auto running = find_slot(animation.owner, animation.target);
+    if (running != nullptr) {
+        m_animations[running->index] = animation;
+    }
+    else {
+        m_animation_slots[animation.owner].push_back(ANIMATION_SLOT{ animation.target, m_animations.size() });
+        m_animations.push_back(animation);
+    }
+
+    return animation.id;
+}
+
+void Animator::cancel(animation_id id)
+{
+    for (size_t i = 0; i < m_animations.size(); i++) {
+        if (m_animations[i].id == id) {
+            remove_at(i);
+            return;
+        }
+    }
+}
+
+void Animator::cancel_all(const WidgetBase* widget)
+{
+    auto owner = element_handle(widget);
+    for (size_t i = 0; i < m_animations.size();) {
+        if (m_animations[i].owner == owner) {
+            remove_at(i);
+        }
+        else {
+            i++;
+        }
+    }
+}
+
+void Animator::remove_at(size_t index)
+{
+    auto& removed = m_animations[index];
+    auto slot = find_slot(removed.owner, removed.target);
+    if (slot != nullptr) {
+        auto& slots = *m_animation_slots.find(removed.owner);
+        *slot = slots.back();
+        slots.pop_back();
+        if (slots.empty()) {
+            m_animation_slots.erase(removed.owner);
+        }
+    }
+    else {
+        // Released owners drop the slots of all their animations at once
+        m_animation_slots.erase(removed.owner);
+    }
+
+    // Order of animations does not matter, the last one fills the gap
+    if (index + 1 < m_animations.size()) {
+        m_animations[index] = m_animations.back();
+
+        auto moved = find_slot(m_animations[index].owner, m_animations[index].target);
+        if (moved != nullptr) {
+            moved->index = index;
+        }
+    }
+    m_animations.pop_back();
+}
+
+Animator::ANIMATION_SLOT* Animator::find_slot(ElementHandle owner, const void* target)
+{
+    // Handles of released owners are not looked up, their slots are never used again
+    if (ElementRegistry::instance().is_alive(owner) == false) return nullptr;
+
+    auto slots = m_animation_slots.find(owner);
+    if (slots == nullptr) return nullptr;
+
+    auto slot = std::find_if(slots->begin(), slots->end(), [target](const ANIMATION_SLOT& other) { return other.target == target; });
+    return slot != slots->end() ? &*slot : nullptr;
+}
+
+void Animator::tick(input_clock::time_point time)
+{
+    auto& registry = ElementRegistry::instance();
+
+    for (size_t i = 0; i < m_animations.size();) {
+        // Copied, setting the value notifies listeners which may start other animations
+        auto animation = m_animations[i];
+        if (registry.is_alive(animation.owner) == false) {
+            remove_at(i);
+            continue;
+        }
+
+        // Nothing changes before the delay elapsed
+        if (time < animation.start + animation.timeline.delay) {
+            i++;
+            continue;
+        }
+
+        auto owner = registry.resolve(animation.owner);
+        auto running = apply(animation, owner, time);
+
+        switch (animation.effect) {
+        case AnimationEffect::Paint:
+            if (registry.is_alive(animation.frame)) {
+                static_cast<WidgetBase*>(registry.resolve(animation.frame))->discard_frame();
+            }
+            break;
+
+        case AnimationEffect::Layout:
+            static_cast<WidgetBase*>(owner)->discard_layout();
+            break;
+
+        case AnimationEffect::Measure:
+        {
+            auto widget = static_cast<WidgetBase*>(owner);
+            widget->discard_measure();
+
+            auto top = element_handle(widget->discard_ancestor_measures());
+            if (std::find(m_relayout_roots.begin(), m_relayout_roots.end(), top) == m_relayout_roots.end()) {
+                m_relayout_roots.push_back(top);
+            }
+        }
+        break;
+        }
+
+        // Listeners may have replaced the animation in place by animating the same property again, only the finished one is removed
+        if (running == false && i < m_animations.size() && m_animations[i].id == animation.id) {
+            remove_at(i);
+        }
+        else {
+            i++;
+        }
+    }
+
+    // Layout of a subtree is discarded once for all measure animations in it
+    for (auto& handle : m_relayout_roots) {
+        if (registry.is_alive(handle) == false) continue;
+        static_cast<WidgetBase*>(registry.resolve(handle))->discard_layout();
+    }
+    m_relayout_roots.clear();
+}
+
+bool Animator::apply(const ANIMATION& animation, ElementBase* owner, input_clock::time_point time)
+{
+    auto& timeline = animation.timeline;
+    auto elapsed = (std::max)(std::chrono::duration_cast<std::chrono::microseconds>(time - animation.start) - timeline.delay, std::chrono::microseconds(0));
+
+    // Progress within the current run, runs past the last one end on the value of the last run.
+    // Timelines without duration jump to the target value.
+    auto running = timeline.duration.count() > 0;
+    auto progress = 1.0f;
+    auto run = uint64_t{ 0 };
+    if (running) {
+        run = static_cast<uint64_t>(elapsed.count() / timeline.duration.count());
+        progress = static_cast<float>(elapsed.count() % timeline.duration.count()) / timeline.duration.count();
+    }
+
+    if (timeline.repeat_count > 0 && run >= timeline.repeat_count) {
+        running = false;
+        run = timeline.repeat_count - 1;
+        progress = 1.0f;
+    }
+
+    if (timeline.auto_reverse && run % 2 == 1) {
+        progress = 1.0f - progress;
+    }
+
+    auto value = interpolate(animation.from, animation.to, ease(timeline.easing, progress));
+
+    switch (animation.kind) {
+    case AnimationKind::Float:
+        static_cast<TypedPropertyBase<float>*>(animation.target)->set_value(owner, AnimationTraits<float>::unpack(value));
+        break;
+    case AnimationKind::Size:
+        static_cast<TypedPropertyBase<SIZE_F>*>(animation.target)->set_value(owner, AnimationTraits<SIZE_F>::unpack(value));
+        break;
+    case AnimationKind::Bounds:
+        static_cast<TypedPropertyBase<BOUNDS_F>*>(animation.target)->set_value(owner, AnimationTraits<BOUNDS_F>::unpack(value));
+        break;
+    case AnimationKind::Color:
+        static_cast<TypedPropertyBase<D2D1_COLOR_F>*>(animation.target)->set_value(owner, AnimationTraits<D2D1_COLOR_F>::unpack(value));
+        break;
+    case AnimationKind::Matrix:
+        static_cast<TypedPropertyBase<D2D1_MATRIX_3X2_F>*>(animation.target)->set_value(owner, AnimationTraits<D2D1_MATRIX_3X2_F>::unpack(value));
+        break;
+    }
+
+    return running;
+}
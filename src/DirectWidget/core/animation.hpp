@@ -0,0 +1,229 @@
+// animation.hpp: Animator definition
+// Animator moves property values of widgets along timelines, it is ticked with the frame clock by the windows.
+// Running animations of every type are kept in one array, values are packed into six floats and interpolated alike.
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include <d2d1.h>
+
+#include "foundation.hpp"
+#include "handle.hpp"
+#include "input_queue.hpp"
+#include "property.hpp"
+#include "widget.hpp"
+
+namespace DirectWidget {
+
+    // Easing
+
+    enum class Easing {
+        Linear,
+        // Cubic curves starting slow, ending slow, or both
+        EaseIn,
+        EaseOut,
+        EaseInOut,
+        // Holds the start value until the end of the run
+        Step,
+    };
+
+    // Maps linear progress in [0, 1] to eased progress
+    float ease(Easing easing, float progress);
+
+    // Timeline
+
+    typedef struct {
+        std::chrono::microseconds duration;
+        // Time before the first run starts, the property keeps its value until then
+        std::chrono::microseconds delay;
+        Easing easing;
+        // Number of runs, 0 repeats until cancelled
+        uint32_t repeat_count;
+        // Every other run goes from the target value back to the start value
+        bool auto_reverse;
+    } TIMELINE;
+
+    inline TIMELINE make_timeline(std::chrono::microseconds duration, Easing easing = Easing::EaseInOut) {
+        return { duration, std::chrono::microseconds(0), easing, 1, false };
+    }
+
+    // What a changed value invalidates after every tick
+    enum class AnimationEffect {
+        // Colors, opacity and transforms, only the frame is repainted
+        Paint,
+        // Values read by layout, the subtree is arranged again with the measures it has
+        Layout,
+        // Values read by measure, ancestors are measured again as well
+        Measure,
+    };
+
+    // Interpolation
+    // Animated types are packed into six floats, enough for a 3x2 matrix, which are interpolated component by component.
+
+    using ANIMATION_VALUE = std::array<float, 6>;
+
+    enum class AnimationKind {
+        Float,
+        Size,
+        Bounds,
+        Color,
+        Matrix,
+    };
+
+    template <typename T>
+    struct AnimationTraits;
+
+    template <>
+    struct AnimationTraits<float> {
+        static constexpr AnimationKind Kind = AnimationKind::Float;
+        static ANIMATION_VALUE pack(float value) { return { value, 0, 0, 0 }; }
+        static float unpack(const ANIMATION_VALUE& value) { return value[0]; }
+    };
+
+    template <>
+    struct AnimationTraits<SIZE_F> {
+        static constexpr AnimationKind Kind = AnimationKind::Size;
+        static ANIMATION_VALUE pack(const SIZE_F& value) { return { value.width, value.height, 0, 0 }; }
+        static SIZE_F unpack(const ANIMATION_VALUE& value) { return { value[0], value[1] }; }
+    };
+
+    template <>
+    struct AnimationTraits<BOUNDS_F> {
+        static constexpr AnimationKind Kind = AnimationKind::Bounds;
+        static ANIMATION_VALUE pack(const BOUNDS_F& value) { return { value.left, value.top, value.right, value.bottom }; }
+        static BOUNDS_F unpack(const ANIMATION_VALUE& value) { return { value[0], value[1], value[2], value[3] }; }
+    };
+
+    template <>
+    struct AnimationTraits<D2D1_COLOR_F> {
+        static constexpr AnimationKind Kind = AnimationKind::Color;
+        static ANIMATION_VALUE pack(const D2D1_COLOR_F& value) { return { value.r, value.g, value.b, value.a }; }
+        static D2D1_COLOR_F unpack(const ANIMATION_VALUE& value) { return { value[0], value[1], value[2], value[3] }; }
+    };
+
+    // Components are interpolated, so rotations pass through skew, scales and translations interpolate exactly
+    template <>
+    struct AnimationTraits<D2D1_MATRIX_3X2_F> {
+        static constexpr AnimationKind Kind = AnimationKind::Matrix;
+        static ANIMATION_VALUE pack(const D2D1_MATRIX_3X2_F& value) { return { value._11, value._12, value._21, value._22, value._31, value._32 }; }
+        static D2D1_MATRIX_3X2_F unpack(const ANIMATION_VALUE& value) { return { value[0], value[1], value[2], value[3], value[4], value[5] }; }
+    };
+
+    inline ANIMATION_VALUE interpolate(const ANIMATION_VALUE& from, const ANIMATION_VALUE& to, float progress) {
+        ANIMATION_VALUE value;
+        for (size_t i = 0; i < value.size(); i++) {
+            value[i] = from[i] + (to[i] - from[i]) * progress;
+        }
+        return value;
+    }
+
+    template <typename T>
+    T interpolate(const T& from, const T& to, float progress) {
+        using traits = AnimationTraits<T>;
+        return traits::unpack(interpolate(traits::pack(from), traits::pack(to), progress));
+    }
+
+    // Animator
+
+    using animation_id = uint64_t;
+    constexpr animation_id NoAnimation = 0;
+
+    class Animator {
+    public:
+        using clock_function = input_clock::time_point (*)();
+
+        static Animator& instance();
+
+        // Tests pass a virtual clock and tick with its time
+        Animator(clock_function clock = input_clock::now) : m_clock(clock) {}
+
+        Animator(Animator&) = delete;
+        Animator(Animator&&) = delete;
+
+        void set_clock(clock_function clock) { m_clock = clock; }
+
+        input_clock::time_point now() const { return m_clock(); }
+
+        // Animates property of widget from its current value to value
+        // A running animation of the same property is replaced, so transitions continue from where they are.
+        // frame is the widget repainted after every tick, widgets overlapping siblings pass their parent. It is widget when nullptr.
+        template <typename T>
+        animation_id animate(WidgetBase* widget, const property_ptr<T>& property, const T& value, const TIMELINE& timeline,
+            AnimationEffect effect = AnimationEffect::Paint, WidgetBase* frame = nullptr) {
+            return animate(widget, property, property->get_value(widget), value, timeline, effect, frame);
+        }
+
+        template <typename T>
+        animation_id animate(WidgetBase* widget, const property_ptr<T>& property, const T& from, const T& value, const TIMELINE& timeline,
+            AnimationEffect effect = AnimationEffect::Paint, WidgetBase* frame = nullptr) {
+            using traits = AnimationTraits<T>;
+
+            ANIMATION animation{};
+            animation.kind = traits::Kind;
+            animation.target = property.get();
+            animation.from = traits::pack(from);
+            animation.to = traits::pack(value);
+            animation.timeline = timeline;
+            animation.effect = effect;
+            return start(widget, animation, frame);
+        }
+
+        // Stops animations leaving their properties at the current value
+        void cancel(animation_id id);
+        void cancel_all(const WidgetBase* widget);
+
+        bool is_running() const { return m_animations.empty() == false; }
+        size_t count() const { return m_animations.size(); }
+
+        // Moves every animation to the frame time and removes the finished ones
+        void tick() { tick(now()); }
+        void tick(input_clock::time_point time);
+
+    private:
+        typedef struct {
+            animation_id id;
+            ElementHandle owner;
+            ElementHandle frame;
+            AnimationKind kind;
+            AnimationEffect effect;
+            // Property of the type given by kind
+            void* target;
+            ANIMATION_VALUE from;
+            ANIMATION_VALUE to;
+            TIMELINE timeline;
+            input_clock::time_point start;
+        } ANIMATION;
+
+        // Position of the running animation of a property in the array
+        typedef struct {
+            void* target;
+            size_t index;
+        } ANIMATION_SLOT;
+
+        animation_id start(WidgetBase* widget, ANIMATION& animation, WidgetBase* frame);
+
+        // Returns false once the animation ran its last run, after applying its final value
+        bool apply(const ANIMATION& animation, ElementBase* owner, input_clock::time_point time);
+
+        void remove_at(size_t index);
+
+        // Slot of the animation of target run by a live owner, nullptr when there is none
+        ANIMATION_SLOT* find_slot(ElementHandle owner, const void* target);
+
+        clock_function m_clock;
+        animation_id m_next_id = 1;
+
+        std::vector<ANIMATION> m_animations;
+
+        // Running animations of every owner, so replacing one does not scan the array.
+        // Entries of released owners are dropped when their first animation is removed, the others are not looked up again.
+        ElementStorage<std::vector<ANIMATION_SLOT>> m_animation_slots;
+
+        // Topmost widgets whose layout is discarded once per tick after measure animations
+        std::vector<ElementHandle> m_relayout_roots;
+    };
+}
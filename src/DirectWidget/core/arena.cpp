@@ -0,0 +1,38 @@
+// arena.cpp: ElementArena implementation
+
+#include <cassert>
+#include <memory_resource>
+
+#include "foundation.hpp"
+#include "arena.hpp"
+
+using namespace DirectWidget;
+
+const LogContext ElementArena::Logger{ NAMEOF(ElementArena) };
+
+thread_local ElementArena* ElementArena::CurrentArena = nullptr;
+
+ElementArena::~ElementArena()
+{
+#ifdef _DEBUG
+    assert(m_region->live_allocations == 0 && "elements outlived their arena");
+#endif
+
+    if (m_region->live_allocations > 0) {
+        Logger.at(NAMEOF(~ElementArena)).log_error(L"elements outlived their arena, its region is leaked");
+
+        // Surviving elements still live in the region and free themselves through it
+        m_region.release();
+    }
+}
+
+bool ElementArena::release()
+{
+    if (m_region->live_allocations > 0) {
+        Logger.at(NAMEOF(release)).log_error(L"arena still has live elements");
+        return false;
+    }
+
+    m_region->buffer.release();
+    return true;
+}
@@ -0,0 +1,100 @@
+// arena.hpp: ElementArena definition
+// ElementArena serves the elements of one tree (e.g. a screen) from a single region that is released in bulk
+// Elements outliving their arena keep the region alive, it is leaked rather than freed under them
+
+#pragma once
+
+#include <memory>
+#include <memory_resource>
+#include <utility>
+
+#include "foundation.hpp"
+#include "handle.hpp"
+
+namespace DirectWidget {
+
+    class ElementArena {
+    public:
+        static constexpr size_t DefaultInitialSize = 64 * 1024;
+
+        ElementArena() : ElementArena(DefaultInitialSize) {}
+        ElementArena(size_t initial_size) : m_region(std::make_unique<Region>(initial_size)) {}
+        ~ElementArena();
+
+        ElementArena(ElementArena&) = delete;
+        ElementArena(ElementArena&&) = delete;
+
+        size_t live_allocations() const { return m_region->live_allocations; }
+
+        // Memory resource of the elements, allocators keep pointing at it after the arena is gone
+        std::pmr::memory_resource* resource() const { return m_region.get(); }
+
+        // Returns the arena make_element allocates from on this thread, or nullptr
+        static ElementArena* current() { return CurrentArena; }
+
+        // Makes the arena current for make_element calls while in scope
+        class Scope {
+        public:
+            Scope(ElementArena& arena) : m_previous(CurrentArena) { CurrentArena = &arena; }
+            ~Scope() { CurrentArena = m_previous; }
+
+            Scope(Scope&) = delete;
+            Scope(Scope&&) = delete;
+
+        private:
+            ElementArena* m_previous;
+        };
+
+        // Frees the whole region, fails if any element allocated from it is still alive
+        bool release();
+
+        // Drops the tree root in one teardown batch, then frees the region
+        template <typename T>
+        bool release(std::shared_ptr<T>& root) {
+            {
+                ElementRegistry::TeardownBatch batch;
+                root.reset();
+            }
+            return release();
+        }
+
+    private:
+        class Region : public std::pmr::memory_resource {
+        public:
+            Region(size_t initial_size) : buffer(initial_size) {}
+
+            std::pmr::monotonic_buffer_resource buffer;
+            size_t live_allocations = 0;
+
+        protected:
+            void* do_allocate(size_t bytes, size_t alignment) override {
+                live_allocations++;
+                return buffer.allocate(bytes, alignment);
+            }
+
+            // Memory is only reclaimed by release()
+            void do_deallocate(void* pointer, size_t bytes, size_t alignment) override {
+                live_allocations--;
+            }
+
+            bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+                return this == &other;
+            }
+        };
+
+        static const LogContext Logger;
+        static thread_local ElementArena* CurrentArena;
+
+        std::unique_ptr<Region> m_region;
+    };
+
+    // Creates an element in the current arena, or on the heap when no arena is active
+    template <typename T, typename... Args>
+    std::shared_ptr<T> make_element(Args&&... args) {
+        auto arena = ElementArena::current();
+        if (arena == nullptr) {
+            return std::make_shared<T>(std::forward<Args>(args)...);
+        }
+        return std::allocate_shared<T>(std::pmr::polymorphic_allocator<T>(arena->resource()), std::forward<Args>(args)...);
+    }
+}
@@ -5,6 +5,8 @@
 #include <vector>
 #include <memory>
 
+#include "handle.hpp"
+
 namespace DirectWidget {
 
     class ElementBase;
@@ -40,8 +42,33 @@ namespace DirectWidget {
 
     using listener_ptr = std::shared_ptr<DependencyListenerBase>;
 
+    // Kind tag assigned on construction, used instead of RTTI when classifying dependencies of an element
+
+    enum class DependencyKind {
+        Property,
+        Resource,
+        InheritedProperty,
+        InheritedResource,
+        RoutedEvent,
+    };
+
+    // Interface of dependencies that resolve their value through the parent element
+
+    class InheritedDependencyBase {
+    public:
+        virtual ~InheritedDependencyBase() = default;
+
+        virtual void register_parent(const ElementBase* owner, ElementBase* parent) = 0;
+        virtual void remove_parent(const ElementBase* owner) = 0;
+    };
+
     class DependencyBase {
     public:
+        DependencyKind kind() const { return m_kind; }
+
+        // Returns nullptr unless the dependency is inherited
+        InheritedDependencyBase* inherited() const { return m_inherited; }
+
         void add_listener(const listener_ptr& listener) {
             m_listeners.push_back(listener);
         }
@@ -51,9 +78,22 @@ namespace DirectWidget {
         }
 
         virtual void register_owner(const ElementBase* owner) {}
-        virtual void remove_owner(const ElementBase* owner) {}
+        virtual void remove_owner(ElementHandle owner) {}
+
+        virtual void remove_owners(const std::vector<ElementHandle>& owners) {
+            for (auto& owner : owners) {
+                remove_owner(owner);
+            }
+        }
 
     protected:
+        void set_kind(DependencyKind kind) { m_kind = kind; }
+
+        void set_inherited(DependencyKind kind, InheritedDependencyBase* inherited) {
+            m_kind = kind;
+            m_inherited = inherited;
+        }
+
         void notify_updated(const ElementBase* owner, const NotificationArgument& arg) {
             for (auto& listener : m_listeners) {
                 listener->on_dependency_updated(owner, arg);
@@ -61,7 +101,13 @@ namespace DirectWidget {
         }
 
     private:
+        friend class ElementRegistry;
+
+        DependencyKind m_kind = DependencyKind::Property;
+        InheritedDependencyBase* m_inherited = nullptr;
+
         std::vector<listener_ptr> m_listeners;
+        std::vector<ElementHandle> m_retired_owners;
     };
 
     using dependency_ptr = std::shared_ptr<DependencyBase>;
@@ -1,10 +1,12 @@
 #pragma once
 
+#include <cstdint>
 #include <memory>
 #include <vector>
 
 #include "foundation.hpp"
 #include "dependency.hpp"
+#include "handle.hpp"
 #include "property.hpp"
 #include "resource.hpp"
 
@@ -15,48 +17,80 @@ namespace DirectWidget {
 
     class ElementBase {
     public:
+        ElementBase() : m_handle(ElementRegistry::instance().allocate(this)) {}
+
+        ElementBase(ElementBase&) = delete;
+        ElementBase(ElementBase&&) = delete;
+
         virtual ~ElementBase() {
-            for (auto& dependency : m_dependencies) {
-                dependency->remove_owner(this);
+            // Children dying with this element are torn down in the same batch
+            auto& registry = ElementRegistry::instance();
+            registry.begin_teardown();
+
+            // Observers drop the whole subtree of a detaching child, so they hear of every child of the outermost
+            // element torn down. Elements below it still have a parent, that one notified for them already.
+            if (m_parent == nullptr) {
+                for (auto& child : m_children) {
+                    registry.notify_child_detaching(this, child.get());
+                }
             }
+
+            // Children held elsewhere live on without a parent
+            for (auto& child : m_children) {
+                if (child.use_count() > 1) {
+                    child->m_parent = nullptr;
+                    for (auto inherited : child->m_inherited_dependencies) {
+                        inherited->remove_parent(child.get());
+                    }
+                }
+            }
+            m_children.clear();
+            registry.retire(m_handle, m_dependencies);
+            registry.end_teardown();
         }
 
+        ElementHandle handle() const { return m_handle; }
+        ElementBase* parent() const { return m_parent; }
+
+        // Orders this element among the children of its parent, children listed later have larger keys
+        uint64_t sibling_order() const { return m_sibling_order; }
+
     protected:
         void register_dependency(const dependency_ptr& dependency) {
             dependency->register_owner(this);
             m_dependencies.push_back(dependency);
+
+            auto inherited = dependency->inherited();
+            if (inherited != nullptr) {
+                m_inherited_dependencies.push_back(inherited);
+            }
         }
 
+        // Children are ordered as they were attached
         void register_child(const element_ptr& child) {
+            register_child(child, m_children.empty() ? 0 : m_children.back()->m_sibling_order + 1);
+        }
+
+        // Elements listing their children in another order than they were attached in pass the key of that order
+        void register_child(const element_ptr& child, uint64_t sibling_order) {
             child->m_parent = this;
-            for (auto& dependency : child->m_dependencies) {
-                auto inherited_property = dynamic_pointer_cast<InheritedPropertyBase>(dependency);
-                if (inherited_property == nullptr) {
-                    auto inherited_resource = dynamic_pointer_cast<InheritedResourceBase>(dependency);
-                    if (inherited_resource == nullptr) continue;
-                    inherited_resource->register_parent(child.get(), this);
-                }
-                else {
-                    inherited_property->register_parent(child.get(), this);
-                }
+            child->m_sibling_order = sibling_order;
+            for (auto inherited : child->m_inherited_dependencies) {
+                inherited->register_parent(child.get(), this);
             }
             m_children.push_back(child);
+            ElementRegistry::instance().notify_child_attached(this, child.get());
         }
 
         void detach_child(const element_ptr& child) {
+            ElementRegistry::instance().notify_child_detaching(this, child.get());
+
             child->m_parent = nullptr;
-            for (auto& dependency : child->m_dependencies) {
-                auto inherited_property = dynamic_pointer_cast<InheritedPropertyBase>(dependency);
-                if (inherited_property == nullptr) {
-                    auto inherited_resource = dynamic_pointer_cast<InheritedResourceBase>(dependency);
-                    if (inherited_resource == nullptr) continue;
-                    inherited_resource->remove_parent(child.get());
-                }
-                else {
-                    inherited_property->remove_parent(child.get());
-                }
+            for (auto inherited : child->m_inherited_dependencies) {
+                inherited->remove_parent(child.get());
             }
             m_children.erase(std::remove(m_children.begin(), m_children.end(), child), m_children.end());
+            ElementRegistry::instance().notify_tree_changed();
         }
 
         template <typename T>
@@ -80,8 +114,11 @@ namespace DirectWidget {
         }
 
     private:
+        ElementHandle m_handle;
         ElementBase* m_parent = nullptr;
+        uint64_t m_sibling_order = 0;
         std::vector<dependency_ptr> m_dependencies;
+        std::vector<InheritedDependencyBase*> m_inherited_dependencies;
         std::vector<element_ptr> m_children;
     };
 }
\ No newline at end of file
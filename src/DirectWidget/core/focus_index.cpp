@@ -0,0 +1,218 @@
+// focus_index.cpp: FocusIndex implementation
+
+#include <algorithm>
+#include <vector>
+
+#include "foundation.hpp"
+#include "handle.hpp"
+#include "element_base.hpp"
+#include "widget.hpp"
+#include "focus_index.hpp"
+
+using namespace DirectWidget;
+
+static int element_depth(const ElementBase* element)
+{
+    int depth = 0;
+    while (element->parent() != nullptr) {
+        element = element->parent();
+        depth++;
+    }
+    return depth;
+}
+
+bool FocusIndex::precedes(const ElementBase* a, const ElementBase* b)
+{
+    if (a == nullptr || b == nullptr || a == b) return false;
+
+    auto depth_a = element_depth(a), depth_b = element_depth(b);
+
+    // Ancestors come first in preorder
+    while (depth_a > depth_b) {
+        a = a->parent();
+        depth_a--;
+    }
+    if (a == b) return false;
+
+    while (depth_b > depth_a) {
+        b = b->parent();
+        depth_b--;
+    }
+    if (a == b) return true;
+
+    while (a->parent() != b->parent()) {
+        a = a->parent();
+        b = b->parent();
+    }
+
+    // Siblings under the lowest common ancestor are ordered by their keys among its children
+    if (a->parent() == nullptr) return false;
+    return a->sibling_order() < b->sibling_order();
+}
+
+WidgetBase* FocusIndex::resolve(ElementHandle handle)
+{
+    auto& registry = ElementRegistry::instance();
+    if (registry.is_alive(handle) == false) return nullptr;
+    return static_cast<WidgetBase*>(registry.resolve(handle));
+}
+
+FocusIndex::SCOPE::const_iterator FocusIndex::lower_bound(const SCOPE& scope, const WidgetBase* widget)
+{
+    return std::lower_bound(scope.begin(), scope.end(), widget, [](ElementHandle entry, const WidgetBase* widget) {
+        return precedes(resolve(entry), widget);
+        });
+}
+
+void FocusIndex::rebuild(const WidgetBase* root)
+{
+    clear();
+    if (root == nullptr) return;
+
+    m_root = root->handle();
+    insert_subtree(root);
+}
+
+void FocusIndex::clear()
+{
+    m_root = NullElementHandle;
+    m_scopes = {};
+}
+
+const WidgetBase* FocusIndex::scope_of(const WidgetBase* widget) const
+{
+    if (m_root.is_null()) return nullptr;
+    if (widget->handle() == m_root) return widget;
+
+    for (auto element = widget->parent(); element != nullptr; element = element->parent()) {
+        auto ancestor = static_cast<const WidgetBase*>(element);
+        if (ancestor->handle() == m_root || ancestor->is_focus_scope()) {
+            return ancestor;
+        }
+    }
+
+    // Not under root
+    return nullptr;
+}
+
+const FocusIndex::SCOPE* FocusIndex::find_scope(const WidgetBase* widget) const
+{
+    auto scope = scope_of(widget);
+    if (scope == nullptr) return nullptr;
+    return m_scopes.find(scope->handle());
+}
+
+void FocusIndex::insert(const WidgetBase* widget)
+{
+    auto scope_widget = scope_of(widget);
+    if (scope_widget == nullptr) return;
+
+    auto& scope = m_scopes[scope_widget->handle()];
+    auto position = lower_bound(scope, widget);
+    if (position != scope.end() && *position == widget->handle()) return;
+
+    scope.insert(position, widget->handle());
+}
+
+void FocusIndex::remove(const WidgetBase* widget)
+{
+    auto scope = m_scopes.find(element_handle(scope_of(widget)));
+    if (scope == nullptr) return;
+
+    std::erase(*scope, widget->handle());
+}
+
+void FocusIndex::insert_subtree(const WidgetBase* widget)
+{
+    if (widget->is_focusable()) {
+        insert(widget);
+    }
+
+    for (auto& child : widget->children()) {
+        insert_subtree(child.get());
+    }
+}
+
+void FocusIndex::remove_subtree(const WidgetBase* widget)
+{
+    if (widget->handle() == m_root) {
+        clear();
+        return;
+    }
+
+    // The subtree may already be gone from the children of its parent, so entries are matched by handle
+    // rather than located by tree order. Scopes nested in the subtree go away with it.
+    std::vector<ElementHandle> removed;
+
+    auto collect = [&](auto& self, const WidgetBase* widget) -> void {
+        if (widget->is_focusable()) {
+            removed.push_back(widget->handle());
+        }
+        if (widget->is_focus_scope()) {
+            m_scopes.erase(widget->handle());
+        }
+        for (auto& child : widget->children()) {
+            self(self, child.get());
+        }
+    };
+    collect(collect, widget);
+
+    if (removed.empty()) return;
+
+    auto scope = m_scopes.find(element_handle(scope_of(widget)));
+    if (scope == nullptr) return;
+
+    auto by_index = [](ElementHandle a, ElementHandle b) { return a.index < b.index; };
+    std::sort(removed.begin(), removed.end(), by_index);
+
+    std::erase_if(*scope, [&](ElementHandle entry) {
+        return std::binary_search(removed.begin(), removed.end(), entry, by_index);
+        });
+}
+
+void FocusIndex::update(const WidgetBase* widget)
+{
+    remove(widget);
+    if (widget->is_focusable()) {
+        insert(widget);
+    }
+}
+
+WidgetBase* FocusIndex::next(const WidgetBase* widget, bool wrap) const
+{
+    auto scope = find_scope(widget);
+    if (scope == nullptr || scope->empty()) return nullptr;
+
+    auto position = lower_bound(*scope, widget);
+    if (position != scope->end() && *position == widget->handle()) {
+        position++;
+    }
+
+    if (position == scope->end()) {
+        if (wrap == false) return nullptr;
+        position = scope->begin();
+    }
+
+    return resolve(*position);
+}
+
+WidgetBase* FocusIndex::previous(const WidgetBase* widget, bool wrap) const
+{
+    auto scope = find_scope(widget);
+    if (scope == nullptr || scope->empty()) return nullptr;
+
+    auto position = lower_bound(*scope, widget);
+    if (position == scope->begin()) {
+        if (wrap == false) return nullptr;
+        position = scope->end();
+    }
+
+    return resolve(*(position - 1));
+}
+
+WidgetBase* FocusIndex::first() const
+{
+    auto scope = m_scopes.find(m_root);
+    if (scope == nullptr || scope->empty()) return nullptr;
+    return resolve(scope->front());
+}
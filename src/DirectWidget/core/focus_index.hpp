@@ -0,0 +1,60 @@
+// focus_index.hpp: FocusIndex definition
+// FocusIndex keeps the focusable widgets of every focus scope sorted in tree order,
+// so focus navigation is a lookup instead of a tree walk
+
+#pragma once
+
+#include <vector>
+
+#include "foundation.hpp"
+#include "handle.hpp"
+
+namespace DirectWidget {
+
+    class ElementBase;
+    class WidgetBase;
+
+    class FocusIndex {
+    public:
+        // Indexes the tree under root, root is the outermost focus scope
+        void rebuild(const WidgetBase* root);
+        void clear();
+
+        // Incremental maintenance, called after a subtree was attached and before it is detached
+        void insert_subtree(const WidgetBase* widget);
+        void remove_subtree(const WidgetBase* widget);
+
+        // Re-indexes widget after its focusable flag changed
+        void update(const WidgetBase* widget);
+
+        // Nearest focus scope enclosing widget, a scope widget itself belongs to its enclosing scope
+        const WidgetBase* scope_of(const WidgetBase* widget) const;
+
+        // Focusable widgets following or preceding widget in its scope, widget does not need to be focusable
+        // Returns nullptr at the ends of the scope unless wrap is set
+        WidgetBase* next(const WidgetBase* widget, bool wrap) const;
+        WidgetBase* previous(const WidgetBase* widget, bool wrap) const;
+
+        // First focusable widget of the outermost scope
+        WidgetBase* first() const;
+
+    private:
+        typedef std::vector<ElementHandle> SCOPE;
+
+        void insert(const WidgetBase* widget);
+        void remove(const WidgetBase* widget);
+
+        const SCOPE* find_scope(const WidgetBase* widget) const;
+
+        // Position of the first entry not preceding widget
+        static SCOPE::const_iterator lower_bound(const SCOPE& scope, const WidgetBase* widget);
+
+        // True when a comes before b in a preorder walk of the tree
+        static bool precedes(const ElementBase* a, const ElementBase* b);
+
+        static WidgetBase* resolve(ElementHandle handle);
+
+        ElementHandle m_root = NullElementHandle;
+        ElementStorage<SCOPE> m_scopes;
+    };
+}
@@ -0,0 +1,408 @@
+// glyph_atlas.cpp: GlyphAtlas implementation
+
+#include <algorithm>
+#include <cmath>
+#include <format>
+#include <functional>
+#include <vector>
+
+#include <Windows.h>
+#include <d2d1.h>
+#include <d2d1helper.h>
+#include <dwrite.h>
+#include <dwrite_2.h>
+
+#include "foundation.hpp"
+#include "app.hpp"
+#include "interop.hpp"
+#include "widget.hpp"
+#include "glyph_atlas.hpp"
+
+using namespace DirectWidget;
+using namespace DirectWidget::Interop;
+
+const LogContext GlyphAtlas::Logger{ NAMEOF(GlyphAtlas) };
+
+// Pixels left empty around every glyph, so blits never pick up a neighbour
+static constexpr UINT GlyphPadding = 1;
+
+size_t GlyphAtlas::KeyHash::operator()(const GLYPH_KEY& key) const
+{
+    auto hash = std::hash<const void*>{}(key.font_face);
+    hash ^= std::hash<float>{}(key.font_size) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+    hash ^= std::hash<uint32_t>{}((static_cast<uint32_t>(key.glyph) << 8) | key.subpixel) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+    return hash;
+}
+
+//
+// Shaping
+//
+
+// Records the glyph runs of a text layout instead of drawing them
+class GlyphRunRecorder : public IDWriteTextRenderer {
+public:
+    GlyphRunRecorder(SHAPED_TEXT& text) : m_text(text) {}
+
+    // Lives on the stack of GlyphAtlas::shape, references are not counted
+    IFACEMETHOD(QueryInterface)(REFIID riid, void** object) override {
+        if (riid == __uuidof(IDWriteTextRenderer) || riid == __uuidof(IDWritePixelSnapping) || riid == __uuidof(IUnknown)) {
+            *object = static_cast<IDWriteTextRenderer*>(this);
+            return S_OK;
+        }
+        *object = nullptr;
+        return E_NOINTERFACE;
+    }
+
+    IFACEMETHOD_(ULONG, AddRef)() override { return 1; }
+    IFACEMETHOD_(ULONG, Release)() override { return 1; }
+
+    // Positions are snapped to device pixels when drawn
+    IFACEMETHOD(IsPixelSnappingDisabled)(void*, BOOL* disabled) override {
+        *disabled = TRUE;
+        return S_OK;
+    }
+
+    IFACEMETHOD(GetCurrentTransform)(void*, DWRITE_MATRIX* transform) override {
+        *transform = DWRITE_MATRIX{ 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f };
+        return S_OK;
+    }
+
+    IFACEMETHOD(GetPixelsPerDip)(void*, FLOAT* pixels_per_dip) override {
+        *pixels_per_dip = 1.0f;
+        return S_OK;
+    }
+
+    IFACEMETHOD(DrawGlyphRun)(void*, FLOAT baseline_x, FLOAT baseline_y, DWRITE_MEASURING_MODE,
+        const DWRITE_GLYPH_RUN* glyph_run, const DWRITE_GLYPH_RUN_DESCRIPTION*, IUnknown*) override {
+        if (glyph_run->isSideways || is_color_font(glyph_run->fontFace)) {
+            m_text.cacheable = false;
+            return S_OK;
+        }
+
+        SHAPED_GLYPH_RUN run;
+        run.font_face = glyph_run->fontFace;
+        run.font_size = glyph_run->fontEmSize;
+        run.baseline_origin = D2D1::Point2F(baseline_x, baseline_y);
+
+        auto count = glyph_run->glyphCount;
+        run.glyphs.assign(glyph_run->glyphIndices, glyph_run->glyphIndices + count);
+
+        // Right to left runs start at their right edge, advances and offsets point to the left
+        auto right_to_left = glyph_run->bidiLevel % 2 == 1;
+        auto pen = 0.0f;
+        run.positions.reserve(count);
+        for (UINT32 i = 0; i < count; i++) {
+            auto offset = glyph_run->glyphOffsets != nullptr ? glyph_run->glyphOffsets[i] : DWRITE_GLYPH_OFFSET{ 0.0f, 0.0f };
+            if (right_to_left) {
+                pen -= glyph_run->glyphAdvances[i];
+                run.positions.push_back(D2D1::Point2F(pen - offset.advanceOffset, -offset.ascenderOffset));
+            }
+            else {
+                run.positions.push_back(D2D1::Point2F(pen + offset.advanceOffset, -offset.ascenderOffset));
+                pen += glyph_run->glyphAdvances[i];
+            }
+        }
+
+        m_text.runs.push_back(std::move(run));
+        return S_OK;
+    }
+
+    IFACEMETHOD(DrawUnderline)(void*, FLOAT, FLOAT, const DWRITE_UNDERLINE*, IUnknown*) override {
+        m_text.cacheable = false;
+        return S_OK;
+    }
+
+    IFACEMETHOD(DrawStrikethrough)(void*, FLOAT, FLOAT, const DWRITE_STRIKETHROUGH*, IUnknown*) override {
+        m_text.cacheable = false;
+        return S_OK;
+    }
+
+    IFACEMETHOD(DrawInlineObject)(void*, FLOAT, FLOAT, IDWriteInlineObject*, BOOL, BOOL, IUnknown*) override {
+        m_text.cacheable = false;
+        return S_OK;
+    }
+
+private:
+    // Color glyphs have layers of their own, an alpha atlas cannot hold them
+    static bool is_color_font(IDWriteFontFace* font_face) {
+        com_ptr<IDWriteFontFace2> font_face2;
+        if (FAILED(font_face->QueryInterface(IID_PPV_ARGS(&font_face2)))) return false;
+        return font_face2->IsColorFont() != FALSE;
+    }
+
+    SHAPED_TEXT& m_text;
+};
+
+HRESULT GlyphAtlas::shape(IDWriteTextLayout* layout, SHAPED_TEXT& text)
+{
+    text.runs.clear();
+    text.cacheable = true;
+
+    GlyphRunRecorder recorder(text);
+    auto hr = layout->Draw(nullptr, &recorder, 0.0f, 0.0f);
+    Logger.at(NAMEOF(shape)).at(NAMEOF(IDWriteTextLayout::Draw)).log_error(hr);
+    if (FAILED(hr)) {
+        text.runs.clear();
+        text.cacheable = false;
+        return hr;
+    }
+
+    m_shaped++;
+    return S_OK;
+}
+
+//
+// Drawing
+//
+
+HRESULT GlyphAtlas::prepare(const com_ptr<ID2D1RenderTarget>& device_target)
+{
+    if (m_target == device_target && m_bitmap != nullptr) return S_OK;
+
+    // Bitmaps belong to the device of their render target, a recreated target needs the glyphs rasterized again
+    clear();
+    m_target = device_target;
+
+    auto properties = D2D1::BitmapProperties(D2D1::PixelFormat(DXGI_FORMAT_A8_UNORM, D2D1_ALPHA_MODE_PREMULTIPLIED));
+    auto hr = device_target->CreateBitmap(D2D1::SizeU(m_size, m_size), properties, &m_bitmap);
+    Logger.at(NAMEOF(prepare)).at(NAMEOF(ID2D1RenderTarget::CreateBitmap)).log_error(hr);
+    return hr;
+}
+
+HRESULT GlyphAtlas::draw(const RenderContext& context, const com_ptr<ID2D1RenderTarget>& device_target,
+    const SHAPED_TEXT& text, D2D1_POINT_2F origin, ID2D1Brush* brush)
+{
+    auto hr = prepare(device_target);
+    if (FAILED(hr)) return hr;
+
+    auto& target = context.render_target();
+    auto& transform = context.transform();
+    auto scale = context.scale();
+
+    // Glyph pixels are copied one to one, the mask is only drawn in aliased mode
+    auto antialias_mode = target->GetAntialiasMode();
+    target->SetAntialiasMode(D2D1_ANTIALIAS_MODE_ALIASED);
+
+    for (auto& run : text.runs) {
+        for (size_t i = 0; i < run.glyphs.size(); i++) {
+            auto& position = run.positions[i];
+            auto x = (origin.x + run.baseline_origin.x + position.x + transform._31) * scale;
+            auto y = (origin.y + run.baseline_origin.y + position.y + transform._32) * scale;
+
+            // The baseline sits on a pixel row, the glyph origin on one of the subpixel steps
+            auto pixel_x = std::floor(x);
+            auto step = static_cast<int>(std::round((x - pixel_x) * SubpixelSteps));
+            if (step == SubpixelSteps) {
+                pixel_x += 1.0f;
+                step = 0;
+            }
+            auto pixel_y = std::round(y);
+
+            GLYPH_KEY key{ run.font_face, run.font_size * scale, run.glyphs[i], static_cast<uint8_t>(step) };
+            auto glyph = find_or_rasterize(key, target);
+            if (glyph == nullptr) continue;
+
+            if (glyph->oversized) {
+                auto advance = 0.0f;
+                DWRITE_GLYPH_RUN single{ run.font_face, run.font_size, 1, &run.glyphs[i], &advance, nullptr, FALSE, 0 };
+                target->SetAntialiasMode(antialias_mode);
+                target->DrawGlyphRun(
+                    D2D1::Point2F(origin.x + run.baseline_origin.x + position.x, origin.y + run.baseline_origin.y + position.y),
+                    &single, brush);
+                target->SetAntialiasMode(D2D1_ANTIALIAS_MODE_ALIASED);
+                continue;
+            }
+
+            auto& rect = glyph->rect;
+            if (rect.right == rect.left) continue;
+
+            auto left = (pixel_x + glyph->left) / scale - transform._31;
+            auto top = (pixel_y + glyph->top) / scale - transform._32;
+            auto destination = D2D1::RectF(left, top,
+                left + (rect.right - rect.left) / scale,
+                top + (rect.bottom - rect.top) / scale);
+            auto source = D2D1::RectF(
+                static_cast<FLOAT>(rect.left), static_cast<FLOAT>(rect.top),
+                static_cast<FLOAT>(rect.right), static_cast<FLOAT>(rect.bottom));
+
+            target->FillOpacityMask(m_bitmap, brush, D2D1_OPACITY_MASK_CONTENT_TEXT_GRAYSCALE, &destination, &source);
+        }
+    }
+
+    target->SetAntialiasMode(antialias_mode);
+    return S_OK;
+}
+
+const GlyphAtlas::ATLAS_GLYPH* GlyphAtlas::find_or_rasterize(const GLYPH_KEY& key, ID2D1RenderTarget* target)
+{
+    auto entry = m_glyphs.find(key);
+    if (entry != m_glyphs.end()) {
+        m_hits++;
+        return &entry->second;
+    }
+
+    m_misses++;
+
+    std::vector<BYTE> alpha;
+    RECT bounds;
+    auto hr = rasterize(key, alpha, bounds);
+    if (FAILED(hr)) return nullptr;
+
+    ATLAS_GLYPH glyph{ D2D1::RectU(0, 0, 0, 0), bounds.left, bounds.top, false };
+
+    auto width = static_cast<UINT>(bounds.right - bounds.left);
+    auto height = static_cast<UINT>(bounds.bottom - bounds.top);
+    if (width > 0 && height > 0) {
+        D2D1_POINT_2U position;
+        if (width + 2 * GlyphPadding > m_size || height + 2 * GlyphPadding > m_size) {
+            glyph.oversized = true;
+            m_oversized++;
+        }
+        else if (allocate(width + 2 * GlyphPadding, height + 2 * GlyphPadding, position) == false) {
+            // Glyphs drawn so far are read from the atlas before it is written again
+            hr = target->Flush();
+            Logger.at(NAMEOF(find_or_rasterize)).at(NAMEOF(ID2D1RenderTarget::Flush)).log_error(hr);
+
+            evict_all();
+            allocate(width + 2 * GlyphPadding, height + 2 * GlyphPadding, position);
+        }
+
+        if (glyph.oversized == false) {
+            // Uploaded with the padding, so the pixels around the glyph are cleared too
+            auto pitch = width + 2 * GlyphPadding;
+            std::vector<BYTE> pixels(static_cast<size_t>(pitch) * (height + 2 * GlyphPadding), 0);
+            for (UINT row = 0; row < height; row++) {
+                std::copy_n(&alpha[static_cast<size_t>(row) * width], width, &pixels[static_cast<size_t>(row + GlyphPadding) * pitch + GlyphPadding]);
+            }
+
+            auto upload = D2D1::RectU(position.x, position.y, position.x + pitch, position.y + height + 2 * GlyphPadding);
+            hr = m_bitmap->CopyFromMemory(&upload, pixels.data(), pitch);
+            Logger.at(NAMEOF(find_or_rasterize)).at(NAMEOF(ID2D1Bitmap::CopyFromMemory)).log_error(hr);
+            if (FAILED(hr)) return nullptr;
+
+            glyph.rect = D2D1::RectU(position.x + GlyphPadding, position.y + GlyphPadding,
+                position.x + GlyphPadding + width, position.y + GlyphPadding + height);
+            m_glyph_area += static_cast<uint64_t>(width) * height;
+        }
+    }
+
+    m_font_faces.try_emplace(key.font_face, key.font_face);
+    auto inserted = m_glyphs.insert_or_assign(key, glyph);
+    return &inserted.first->second;
+}
+
+HRESULT GlyphAtlas::rasterize(const GLYPH_KEY& key, std::vector<BYTE>& alpha, RECT& bounds) const
+{
+    auto& dwrite = Application::instance()->dwrite();
+
+    auto index = key.glyph;
+    auto advance = 0.0f;
+    DWRITE_GLYPH_RUN run{ key.font_face, key.font_size, 1, &index, &advance, nullptr, FALSE, 0 };
+
+    // The em size is in device pixels already, the subpixel step moves the origin within the first pixel
+    com_ptr<IDWriteGlyphRunAnalysis> analysis;
+    auto hr = dwrite->CreateGlyphRunAnalysis(&run, 1.0f, nullptr,
+        DWRITE_RENDERING_MODE_NATURAL_SYMMETRIC, DWRITE_MEASURING_MODE_NATURAL,
+        static_cast<FLOAT>(key.subpixel) / SubpixelSteps, 0.0f, &analysis);
+    Logger.at(NAMEOF(rasterize)).at(NAMEOF(IDWriteFactory::CreateGlyphRunAnalysis)).log_error(hr);
+    if (FAILED(hr)) return hr;
+
+    hr = analysis->GetAlphaTextureBounds(DWRITE_TEXTURE_CLEARTYPE_3x1, &bounds);
+    Logger.at(NAMEOF(rasterize)).at(NAMEOF(IDWriteGlyphRunAnalysis::GetAlphaTextureBounds)).log_error(hr);
+    if (FAILED(hr)) return hr;
+
+    auto width = static_cast<size_t>(bounds.right - bounds.left);
+    auto height = static_cast<size_t>(bounds.bottom - bounds.top);
+    alpha.clear();
+    if (width == 0 || height == 0) return S_OK;
+
+    std::vector<BYTE> coverage(width * height * 3);
+    hr = analysis->CreateAlphaTexture(DWRITE_TEXTURE_CLEARTYPE_3x1, &bounds, coverage.data(), static_cast<UINT32>(coverage.size()));
+    Logger.at(NAMEOF(rasterize)).at(NAMEOF(IDWriteGlyphRunAnalysis::CreateAlphaTexture)).log_error(hr);
+    if (FAILED(hr)) return hr;
+
+    // Grayscale coverage is the average of the three subpixel samples
+    alpha.resize(width * height);
+    for (size_t i = 0; i < alpha.size(); i++) {
+        alpha[i] = static_cast<BYTE>((coverage[i * 3] + coverage[i * 3 + 1] + coverage[i * 3 + 2]) / 3);
+    }
+    return S_OK;
+}
+
+// Glyphs are packed in shelves, rows as tall as their tallest glyph filled from left to right
+bool GlyphAtlas::allocate(UINT width, UINT height, D2D1_POINT_2U& position)
+{
+    // Shelves much taller than the glyph are left to taller glyphs
+    for (auto& shelf : m_shelves) {
+        if (height <= shelf.height && height * 2 >= shelf.height && shelf.right + width <= m_size) {
+            position = D2D1::Point2U(shelf.right, shelf.top);
+            shelf.right += width;
+            return true;
+        }
+    }
+
+    if (m_shelf_bottom + height > m_size) return false;
+
+    m_shelves.push_back({ m_shelf_bottom, height, width });
+    position = D2D1::Point2U(0, m_shelf_bottom);
+    m_shelf_bottom += height;
+    return true;
+}
+
+void GlyphAtlas::evict_all()
+{
+    m_evictions += m_glyphs.size();
+    m_resets++;
+
+    m_glyphs.clear();
+    m_font_faces.clear();
+    m_shelves.clear();
+    m_shelf_bottom = 0;
+    m_glyph_area = 0;
+}
+
+void GlyphAtlas::clear()
+{
+    m_glyphs.clear();
+    m_font_faces.clear();
+    m_shelves.clear();
+    m_shelf_bottom = 0;
+    m_glyph_area = 0;
+
+    m_bitmap = nullptr;
+    m_target = nullptr;
+}
+
+//
+// Statistics
+//
+
+double GlyphAtlas::occupancy() const
+{
+    return static_cast<double>(m_glyph_area) / (static_cast<double>(m_size) * m_size);
+}
+
+double GlyphAtlas::shelf_occupancy() const
+{
+    return static_cast<double>(m_shelf_bottom) / m_size;
+}
+
+void GlyphAtlas::reset_statistics()
+{
+    m_hits = 0;
+    m_misses = 0;
+    m_evictions = 0;
+    m_resets = 0;
+    m_oversized = 0;
+    m_shaped = 0;
+}
+
+void GlyphAtlas::log_report(const LogContext& logger) const
+{
+    auto draws = m_hits + m_misses;
+    auto hit_rate = draws > 0 ? 100.0 * m_hits / draws : 0.0;
+    auto line = std::format(L"Glyphs: count={} atlas={}x{} occupancy={:.1f}% shelves={:.1f}% hits={} misses={} hit_rate={:.1f}% evictions={} resets={} oversized={} shaped={}",
+        m_glyphs.size(), m_size, m_size, 100.0 * occupancy(), 100.0 * shelf_occupancy(),
+        m_hits, m_misses, hit_rate, m_evictions, m_resets, m_oversized, m_shaped);
+    logger.log(line.c_str());
+}
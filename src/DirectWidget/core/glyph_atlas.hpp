@@ -0,0 +1,156 @@
+// glyph_atlas.hpp: GlyphAtlas definition
+// GlyphAtlas keeps glyphs rasterized by DirectWrite on the CPU in a single alpha bitmap, so labels are drawn as blits of their glyphs.
+// Text layouts are shaped once into glyph runs, which are drawn from the atlas until the layout changes.
+// Every window and snapshot owns the atlas of its render target, and attaches it to its widget tree with the render target.
+
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include <Windows.h>
+#include <d2d1.h>
+#include <dwrite.h>
+
+#include "foundation.hpp"
+#include "interop.hpp"
+#include "widget.hpp"
+
+namespace DirectWidget {
+
+    typedef struct {
+        IDWriteFontFace* font_face;
+        // Em size in device pixels
+        float font_size;
+        UINT16 glyph;
+        // Horizontal offset of the glyph origin from the pixel grid, in steps of 1 / SubpixelSteps pixel
+        uint8_t subpixel;
+    } GLYPH_KEY;
+
+    typedef struct {
+        Interop::com_ptr<IDWriteFontFace> font_face;
+        // Em size in device independent pixels
+        float font_size;
+        // Relative to the origin the layout was shaped at
+        D2D1_POINT_2F baseline_origin;
+        std::vector<UINT16> glyphs;
+        // Origin of each glyph relative to the baseline origin, reading direction and offsets applied
+        std::vector<D2D1_POINT_2F> positions;
+    } SHAPED_GLYPH_RUN;
+
+    typedef struct {
+        std::vector<SHAPED_GLYPH_RUN> runs;
+        // Color glyphs, sideways runs, decorations and inline objects are left to DrawTextLayout
+        bool cacheable;
+    } SHAPED_TEXT;
+
+    class GlyphAtlas {
+    public:
+        // Edge length of the atlas bitmap in pixels
+        static constexpr UINT DefaultSize = 1024;
+        static constexpr int SubpixelSteps = 4;
+
+        GlyphAtlas(UINT size = DefaultSize) : m_size(size) {}
+
+        GlyphAtlas(GlyphAtlas&) = delete;
+        GlyphAtlas(GlyphAtlas&&) = delete;
+
+        UINT size() const { return m_size; }
+        size_t glyph_count() const { return m_glyphs.size(); }
+
+        // Collects the glyph runs layout draws at origin (0, 0)
+        HRESULT shape(IDWriteTextLayout* layout, SHAPED_TEXT& text);
+
+        // Draws text at origin in context, rasterizing the glyphs missing from the atlas.
+        // device_target is the render target of the widget, context may draw into a surface or tile compatible with it.
+        // Text is snapped to device pixels, the transform of context must be a translation.
+        HRESULT draw(const RenderContext& context, const Interop::com_ptr<ID2D1RenderTarget>& device_target,
+            const SHAPED_TEXT& text, D2D1_POINT_2F origin, ID2D1Brush* brush);
+
+        // Drops every glyph and the bitmap, called by the owner when its render target goes away
+        void clear();
+
+        // statistics
+
+        // Glyphs drawn from the atlas and glyphs rasterized into it
+        uint64_t hit_count() const { return m_hits; }
+        uint64_t miss_count() const { return m_misses; }
+
+        // Glyphs dropped to make room, the atlas is emptied whenever it is full
+        uint64_t eviction_count() const { return m_evictions; }
+        uint64_t reset_count() const { return m_resets; }
+
+        // Glyphs too large for the atlas, drawn with DrawGlyphRun instead
+        uint64_t oversized_count() const { return m_oversized; }
+
+        // Text layouts shaped into glyph runs
+        uint64_t shaped_count() const { return m_shaped; }
+
+        // Share of the atlas covered by glyphs, and by the shelves they are packed in
+        double occupancy() const;
+        double shelf_occupancy() const;
+
+        void reset_statistics();
+
+        // Writes hit rate, occupancy and evictions
+        void log_report(const LogContext& logger) const;
+
+    private:
+        static const LogContext Logger;
+
+        typedef struct {
+            // Pixels of the glyph in the atlas, empty for glyphs without pixels like spaces
+            D2D1_RECT_U rect;
+            // Top left pixel relative to the glyph origin on the baseline
+            LONG left;
+            LONG top;
+            bool oversized;
+        } ATLAS_GLYPH;
+
+        typedef struct {
+            UINT top;
+            UINT height;
+            UINT right;
+        } SHELF;
+
+        struct KeyHash {
+            size_t operator()(const GLYPH_KEY& key) const;
+        };
+
+        struct KeyEqual {
+            bool operator()(const GLYPH_KEY& a, const GLYPH_KEY& b) const {
+                return a.font_face == b.font_face && a.font_size == b.font_size && a.glyph == b.glyph && a.subpixel == b.subpixel;
+            }
+        };
+
+        HRESULT prepare(const Interop::com_ptr<ID2D1RenderTarget>& device_target);
+
+        // Returns nullptr when the glyph could not be rasterized
+        const ATLAS_GLYPH* find_or_rasterize(const GLYPH_KEY& key, ID2D1RenderTarget* target);
+        HRESULT rasterize(const GLYPH_KEY& key, std::vector<BYTE>& alpha, RECT& bounds) const;
+        bool allocate(UINT width, UINT height, D2D1_POINT_2U& position);
+        // Empties the atlas to make room, the bitmap is kept
+        void evict_all();
+
+        UINT m_size;
+
+        Interop::com_ptr<ID2D1RenderTarget> m_target;
+        Interop::com_ptr<ID2D1Bitmap> m_bitmap;
+
+        std::unordered_map<GLYPH_KEY, ATLAS_GLYPH, KeyHash, KeyEqual> m_glyphs;
+        // Font faces of the cached glyphs are kept alive, so their keys are not reused by other faces
+        std::unordered_map<IDWriteFontFace*, Interop::com_ptr<IDWriteFontFace>> m_font_faces;
+
+        std::vector<SHELF> m_shelves;
+        UINT m_shelf_bottom = 0;
+        uint64_t m_glyph_area = 0;
+
+        uint64_t m_hits = 0;
+        uint64_t m_misses = 0;
+        uint64_t m_evictions = 0;
+        uint64_t m_resets = 0;
+        uint64_t m_oversized = 0;
+        uint64_t m_shaped = 0;
+    };
+}
@@ -0,0 +1,108 @@
+// handle.cpp: ElementRegistry implementation
+
+#include <memory>
+#include <vector>
+
+#include "handle.hpp"
+#include "dependency.hpp"
+#include "element_base.hpp"
+
+using namespace DirectWidget;
+
+ElementHandle DirectWidget::element_handle(const ElementBase* element)
+{
+    if (element == nullptr) return NullElementHandle;
+    return element->handle();
+}
+
+ElementRegistry& ElementRegistry::instance()
+{
+    static ElementRegistry registry;
+    return registry;
+}
+
+ElementHandle ElementRegistry::allocate(ElementBase* element)
+{
+    if (m_free_slots.empty()) {
+        auto index = static_cast<uint32_t>(m_slots.size());
+        m_slots.push_back({ element, 1 });
+        return { index, 1 };
+    }
+
+    auto index = m_free_slots.back();
+    m_free_slots.pop_back();
+
+    auto& slot = m_slots[index];
+    slot.element = element;
+    return { index, slot.generation };
+}
+
+void ElementRegistry::release(ElementHandle handle)
+{
+    auto& slot = m_slots[handle.index];
+    slot.element = nullptr;
+
+    // generation 0 is reserved for null handles
+    if (++slot.generation == 0) {
+        slot.generation = 1;
+    }
+
+    m_free_slots.push_back(handle.index);
+}
+
+void ElementRegistry::notify_child_attached(const ElementBase* parent, const ElementBase* child)
+{
+    m_tree_version++;
+    for (auto observer : m_tree_observers) {
+        observer->on_child_attached(parent, child);
+    }
+}
+
+void ElementRegistry::notify_child_detaching(const ElementBase* parent, const ElementBase* child)
+{
+    m_tree_version++;
+    for (auto observer : m_tree_observers) {
+        observer->on_child_detaching(parent, child);
+    }
+}
+
+void ElementRegistry::retire(ElementHandle handle, const std::vector<dependency_ptr>& dependencies)
+{
+    m_retired.push_back(handle);
+    m_tree_version++;
+
+    for (auto& dependency : dependencies) {
+        if (dependency->m_retired_owners.empty()) {
+            m_pending_dependencies.push_back(dependency);
+        }
+        dependency->m_retired_owners.push_back(handle);
+    }
+
+    if (m_teardown_depth == 0) {
+        flush();
+    }
+}
+
+void ElementRegistry::flush()
+{
+    // Elements released by remove_owners (e.g. children held in a collection) join the current batch
+    m_teardown_depth++;
+
+    while (m_pending_dependencies.empty() == false) {
+        auto dependencies = std::move(m_pending_dependencies);
+        m_pending_dependencies.clear();
+
+        for (auto& dependency : dependencies) {
+            auto owners = std::move(dependency->m_retired_owners);
+            dependency->m_retired_owners.clear();
+            dependency->remove_owners(owners);
+        }
+    }
+
+    m_teardown_depth--;
+
+    for (auto& handle : m_retired) {
+        release(handle);
+    }
+    m_retired.clear();
+}
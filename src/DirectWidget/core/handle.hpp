@@ -0,0 +1,222 @@
+// handle.hpp: Generational element handles
+// Every element owns a slot in the ElementRegistry, per-element storage of dependencies is indexed by that slot
+
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace DirectWidget {
+
+    class ElementBase;
+    class DependencyBase;
+
+    struct ElementHandle {
+        uint32_t index;
+        uint32_t generation;
+
+        bool is_null() const { return generation == 0; }
+
+        bool operator==(const ElementHandle& other) const { return index == other.index && generation == other.generation; }
+        bool operator!=(const ElementHandle& other) const { return !(*this == other); }
+    };
+
+    constexpr ElementHandle NullElementHandle{ 0, 0 };
+
+    // Returns handle of the element, or NullElementHandle for nullptr
+    ElementHandle element_handle(const ElementBase* element);
+
+    // Observes children being attached to and detached from parents anywhere in the element tree
+
+    class TreeObserverBase {
+    public:
+        virtual ~TreeObserverBase() = default;
+
+        // Called after child is linked to parent
+        virtual void on_child_attached(const ElementBase* parent, const ElementBase* child) = 0;
+
+        // Called while child is still linked to parent
+        virtual void on_child_detaching(const ElementBase* parent, const ElementBase* child) = 0;
+    };
+
+    class ElementRegistry {
+    public:
+        static ElementRegistry& instance();
+
+        ElementRegistry(ElementRegistry&) = delete;
+        ElementRegistry(ElementRegistry&&) = delete;
+
+        ElementHandle allocate(ElementBase* element);
+
+        bool is_alive(ElementHandle handle) const {
+            return handle.is_null() == false &&
+                handle.index < m_slots.size() &&
+                m_slots[handle.index].generation == handle.generation;
+        }
+
+        // Stale handles resolve to nullptr, like the parent recorded for a child that outlived it
+        ElementBase* resolve(ElementHandle handle) const {
+            if (is_alive(handle) == false) return nullptr;
+            return m_slots[handle.index].element;
+        }
+
+        // Incremented whenever an element is attached to or detached from a parent,
+        // caches derived from the element tree compare against it
+        uint64_t tree_version() const { return m_tree_version; }
+        void notify_tree_changed() { m_tree_version++; }
+
+        void add_tree_observer(TreeObserverBase* observer) { m_tree_observers.push_back(observer); }
+        void remove_tree_observer(TreeObserverBase* observer) { std::erase(m_tree_observers, observer); }
+
+        void notify_child_attached(const ElementBase* parent, const ElementBase* child);
+        void notify_child_detaching(const ElementBase* parent, const ElementBase* child);
+
+        // Teardown batching
+        // Elements destroyed while a teardown is in progress are removed from their dependencies
+        // in one pass per dependency when the outermost teardown ends.
+
+        void retire(ElementHandle handle, const std::vector<std::shared_ptr<DependencyBase>>& dependencies);
+
+        void begin_teardown() { m_teardown_depth++; }
+        void end_teardown() {
+            if (--m_teardown_depth == 0) flush();
+        }
+
+        class TeardownBatch {
+        public:
+            TeardownBatch() { ElementRegistry::instance().begin_teardown(); }
+            ~TeardownBatch() { ElementRegistry::instance().end_teardown(); }
+
+            TeardownBatch(TeardownBatch&) = delete;
+            TeardownBatch(TeardownBatch&&) = delete;
+        };
+
+    private:
+        ElementRegistry() = default;
+
+        void release(ElementHandle handle);
+        void flush();
+
+        typedef struct {
+            ElementBase* element;
+            uint32_t generation;
+        } SLOT;
+
+        std::vector<SLOT> m_slots;
+        std::vector<uint32_t> m_free_slots;
+
+        std::vector<ElementHandle> m_retired;
+        std::vector<std::shared_ptr<DependencyBase>> m_pending_dependencies;
+        int m_teardown_depth = 0;
+
+        uint64_t m_tree_version = 0;
+        std::vector<TreeObserverBase*> m_tree_observers;
+    };
+
+    // Per-element storage indexed by handle slot
+    // Slots are grouped in pages allocated on first write and freed once empty, so a dependency only used by a few elements
+    // costs a page per group of PageSize slots it is used in, plus a pointer per page up to the highest index in use.
+    // A lookup with a handle of a released element finds nothing, debug builds assert on it.
+    // Pages never move, so references stay valid when elements are created inside callbacks.
+
+    template <typename T>
+    class ElementStorage {
+    public:
+        static constexpr uint32_t PageSize = 64;
+
+        const T* find(ElementHandle handle) const {
+            if (handle.is_null()) return nullptr;
+            auto page = page_of(handle);
+            if (page == nullptr) return nullptr;
+            check_handle(handle);
+            auto& slot = page->slots[handle.index % PageSize];
+            if (slot.generation != handle.generation) return nullptr;
+            return &slot.value;
+        }
+
+        T* find(ElementHandle handle) {
+            return const_cast<T*>(static_cast<const ElementStorage*>(this)->find(handle));
+        }
+
+        bool contains(ElementHandle handle) const { return find(handle) != nullptr; }
+
+        // Returns the value for handle, inserting a default value if missing
+        T& operator[](ElementHandle handle) {
+            auto value = find(handle);
+            if (value != nullptr) return *value;
+            return insert_or_assign(handle, T{});
+        }
+
+        T& insert_or_assign(ElementHandle handle, const T& value) {
+            assert(handle.is_null() == false);
+            check_handle(handle);
+
+            auto page_index = handle.index / PageSize;
+            if (page_index >= m_pages.size()) {
+                m_pages.resize(page_index + 1);
+            }
+            auto& page = m_pages[page_index];
+            if (page == nullptr) {
+                page = std::make_unique<PAGE>();
+                m_page_count++;
+            }
+
+            auto& slot = page->slots[handle.index % PageSize];
+            if (slot.generation == 0) {
+                page->used++;
+            }
+            slot.generation = handle.generation;
+            slot.value = value;
+            return slot.value;
+        }
+
+        void erase(ElementHandle handle) {
+            if (handle.is_null()) return;
+            auto page_index = handle.index / PageSize;
+            if (page_index >= m_pages.size() || m_pages[page_index] == nullptr) return;
+
+            auto& page = m_pages[page_index];
+            auto& slot = page->slots[handle.index % PageSize];
+            if (slot.generation != handle.generation) return;
+            slot.generation = 0;
+            slot.value = T{};
+
+            if (--page->used == 0) {
+                page = nullptr;
+                m_page_count--;
+            }
+        }
+
+        // Pages currently allocated, each holds PageSize values
+        size_t page_count() const { return m_page_count; }
+
+    private:
+        static void check_handle(ElementHandle handle) {
+#ifdef _DEBUG
+            assert(ElementRegistry::instance().is_alive(handle) && "stale element handle");
+#endif
+        }
+
+        struct SLOT {
+            uint32_t generation = 0;
+            T value{};
+        };
+
+        struct PAGE {
+            SLOT slots[PageSize];
+            // Slots holding a value
+            uint32_t used = 0;
+        };
+
+        const PAGE* page_of(ElementHandle handle) const {
+            auto page_index = handle.index / PageSize;
+            if (page_index >= m_pages.size()) return nullptr;
+            return m_pages[page_index].get();
+        }
+
+        std::vector<std::unique_ptr<PAGE>> m_pages;
+        size_t m_page_count = 0;
+    };
+}
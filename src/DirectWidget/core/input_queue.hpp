@@ -0,0 +1,147 @@
+// input_queue.hpp: Platform neutral input records and the queue feeding them to the framework
+// Input is recorded by the window procedure (or an injector) and processed once per frame
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#include "foundation.hpp"
+
+namespace DirectWidget {
+
+    // Bounded single producer, single consumer ring buffer
+    // Each side caches the other side's index and only reloads it when the queue looks full or empty,
+    // so an uncontended push or pop touches no shared cache line besides its own index.
+
+    template <typename T, size_t Capacity>
+    class SpscQueue {
+        static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "capacity must be a power of two");
+
+    public:
+        // Producer side, returns false when the queue is full
+        bool push(const T& value) {
+            auto tail = m_tail.load(std::memory_order_relaxed);
+            if (tail - m_cached_head == Capacity) {
+                m_cached_head = m_head.load(std::memory_order_acquire);
+                if (tail - m_cached_head == Capacity) return false;
+            }
+
+            m_buffer[tail & (Capacity - 1)] = value;
+            m_tail.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Consumer side, returns false when the queue is empty
+        bool pop(T& value) {
+            auto head = m_head.load(std::memory_order_relaxed);
+            if (head == m_cached_tail) {
+                m_cached_tail = m_tail.load(std::memory_order_acquire);
+                if (head == m_cached_tail) return false;
+            }
+
+            value = m_buffer[head & (Capacity - 1)];
+            m_head.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+    private:
+        static constexpr size_t CacheLineSize = 64;
+
+        // consumer
+        alignas(CacheLineSize) std::atomic<size_t> m_head = 0;
+        size_t m_cached_tail = 0;
+
+        // producer
+        alignas(CacheLineSize) std::atomic<size_t> m_tail = 0;
+        size_t m_cached_head = 0;
+
+        alignas(CacheLineSize) std::array<T, Capacity> m_buffer{};
+    };
+
+    enum class InputType {
+        PointerMove,
+        PointerLeave,
+        PointerPress,
+        PointerRelease,
+        PointerWheel,
+        KeyDown,
+        Character,
+    };
+
+    // Modifier key flags of keyboard records
+    constexpr uint32_t ModifierShift = 0x1;
+    constexpr uint32_t ModifierControl = 0x2;
+    constexpr uint32_t ModifierAlt = 0x4;
+
+    using input_clock = std::chrono::steady_clock;
+
+    // Pointer coordinates are in physical pixels of the client area, wheel records carry the wheel rotation in delta
+    // Keyboard records carry a virtual key code (KeyDown) or a UTF-16 code unit (Character) in key
+    typedef struct {
+        InputType type;
+        int x;
+        int y;
+        int delta;
+        uint32_t key;
+        uint32_t modifiers;
+        input_clock::time_point timestamp;
+    } INPUT_EVENT;
+
+    inline INPUT_EVENT make_input_event(InputType type, int x, int y) {
+        return { type, x, y, 0, 0, 0, input_clock::now() };
+    }
+
+    inline INPUT_EVENT make_wheel_input_event(int x, int y, int delta) {
+        return { InputType::PointerWheel, x, y, delta, 0, 0, input_clock::now() };
+    }
+
+    inline INPUT_EVENT make_key_input_event(InputType type, uint32_t key, uint32_t modifiers) {
+        return { type, 0, 0, 0, key, modifiers, input_clock::now() };
+    }
+
+    class InputQueue {
+    public:
+        static constexpr size_t Capacity = 1024;
+
+        // Producer side, a full queue drops the record
+        bool push(const INPUT_EVENT& event) { return m_queue.push(event); }
+
+        // Consumer side, hands every queued record to callback in order
+        // Runs of pointer moves collapse into one record carrying the latest position and the oldest timestamp,
+        // so latency measured from it covers the longest waiting input. Other records are never coalesced.
+        template <typename Callback>
+        void drain(Callback&& callback) {
+            INPUT_EVENT event;
+            INPUT_EVENT pending_move;
+            bool move_pending = false;
+
+            while (m_queue.pop(event)) {
+                if (event.type == InputType::PointerMove) {
+                    if (move_pending) {
+                        event.timestamp = pending_move.timestamp;
+                    }
+                    pending_move = event;
+                    move_pending = true;
+                    continue;
+                }
+
+                if (move_pending) {
+                    callback(static_cast<const INPUT_EVENT&>(pending_move));
+                    move_pending = false;
+                }
+                callback(static_cast<const INPUT_EVENT&>(event));
+            }
+
+            if (move_pending) {
+                callback(static_cast<const INPUT_EVENT&>(pending_move));
+            }
+        }
+
+    private:
+        SpscQueue<INPUT_EVENT, Capacity> m_queue;
+    };
+}
@@ -1,5 +1,7 @@
 #include "interop.hpp"
 
+#include <memory>
+
 #include <comdef.h>
 #include <d2d1.h>
 
@@ -9,6 +11,30 @@
 using namespace DirectWidget;
 using namespace Interop;
 
+class SolidColorBrushResource::ColorListener : public DependencyListenerBase {
+public:
+    ColorListener(SolidColorBrushResource* resource) : m_resource(resource) {}
+
+    void on_dependency_updated(const ElementBase* owner, const NotificationArgument& arg) override {
+        if (arg.notification_type() != NotificationType::ValueChanged) return;
+
+        // Owners of the property without a brush of this resource find nothing
+        auto& brush = m_resource->get_resource(owner);
+        if (brush == nullptr) return;
+
+        brush->SetColor(static_cast<const ValueChangeNotificationArgument<D2D1_COLOR_F>&>(arg).new_value());
+    }
+
+private:
+    // Resources are static and outlive their listeners
+    SolidColorBrushResource* m_resource;
+};
+
+SolidColorBrushResource::SolidColorBrushResource(const property_ptr<D2D1_COLOR_F>& color_property) : m_color_property(color_property)
+{
+    m_color_property->add_listener(std::make_shared<ColorListener>(this));
+}
+
 HRESULT SolidColorBrushResource::initialize(const ElementBase* owner, com_ptr<ID2D1SolidColorBrush>& resource) {
     auto& render_target = static_cast<const WidgetBase*>(owner)->render_target();
     return render_target->CreateSolidColorBrush(m_color_property->get_value(owner), &resource);
@@ -1,7 +1,6 @@
 #pragma once
 
 #include <memory>
-#include <unordered_map>
 
 #include <Windows.h>
 #include <comdef.h>
@@ -9,6 +8,7 @@
 #include <d2d1helper.h>
 
 #include "foundation.hpp"
+#include "handle.hpp"
 #include "property.hpp"
 #include "resource.hpp"
 
@@ -22,20 +22,20 @@ namespace DirectWidget {
         public:
             void register_owner(const ElementBase* owner) override {
                 ResourceBase::register_owner(owner);
-                m_resources[owner] = nullptr;
+                m_resources.insert_or_assign(element_handle(owner), com_ptr<T>());
             }
 
-            void remove_owner(const ElementBase* owner) override {
+            void remove_owner(ElementHandle owner) override {
                 ResourceBase::remove_owner(owner);
                 m_resources.erase(owner);
             }
 
             const com_ptr<T>& get_resource(const ElementBase* owner) const {
-                auto it = m_resources.find(owner);
-                if (it == m_resources.end()) {
-                    return nullptr;
+                auto resource = m_resources.find(element_handle(owner));
+                if (resource == nullptr) {
+                    return m_empty_resource;
                 }
-                return it->second;
+                return *resource;
             }
 
         protected:
@@ -43,20 +43,21 @@ namespace DirectWidget {
             virtual void discard(const ElementBase* owner, com_ptr<T>& resource) {}
 
             bool initialize(const ElementBase* owner) override {
-                auto& resource = m_resources[owner];
+                auto& resource = m_resources[element_handle(owner)];
                 auto hr = initialize(owner, resource);
                 ResourceBase::Logger.at(NAMEOF(ComResource<T>::initialize)).log_error(hr);
                 return SUCCEEDED(hr);
             }
 
             void discard(const ElementBase* owner) override {
-                auto& resource = m_resources[owner];
+                auto& resource = m_resources[element_handle(owner)];
                 discard(owner, resource);
                 resource = nullptr;
             }
 
         private:
-            std::unordered_map<const ElementBase*, com_ptr<T>> m_resources;
+            ElementStorage<com_ptr<T>> m_resources;
+            const com_ptr<T> m_empty_resource;
         };
 
         template<typename T>
@@ -65,14 +66,17 @@ namespace DirectWidget {
         template<typename T>
         using inherited_com_resource_ptr = std::shared_ptr<InheritedResource<com_ptr<T>>>;
 
+        // Brushes follow their color property in place, so color changes and animations repaint without recreating them
         class SolidColorBrushResource : public ComResource<ID2D1SolidColorBrush> {
         public:
-            SolidColorBrushResource(const property_ptr<D2D1_COLOR_F>& color_property) : m_color_property(color_property) {}
+            SolidColorBrushResource(const property_ptr<D2D1_COLOR_F>& color_property);
 
         protected:
             HRESULT initialize(const ElementBase* owner, com_ptr<ID2D1SolidColorBrush>& resource) override;
 
         private:
+            class ColorListener;
+
             property_ptr<D2D1_COLOR_F> m_color_property;
         };
 
@@ -0,0 +1,160 @@
+// latency.cpp: LatencyHistogram and LatencyTracker implementation
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <format>
+#include <string>
+
+#include "foundation.hpp"
+#include "input_queue.hpp"
+#include "latency.hpp"
+
+using namespace DirectWidget;
+
+//
+// LatencyHistogram
+//
+
+size_t LatencyHistogram::bucket_index(uint64_t value)
+{
+    if (value < SubBucketCount) return static_cast<size_t>(value);
+
+    // Sub buckets of larger values would wrap around, they all land in the last bucket
+    auto exponent = static_cast<int>(std::bit_width(value)) - 1;
+    if (exponent > 39) return BucketCount - 1;
+
+    auto sub_bucket = (value >> (exponent - SubBucketBits)) & (SubBucketCount - 1);
+    return static_cast<size_t>((exponent - SubBucketBits + 1) * SubBucketCount + sub_bucket);
+}
+
+uint64_t LatencyHistogram::bucket_upper_bound(size_t index)
+{
+    if (index < SubBucketCount) return index;
+
+    auto exponent = static_cast<int>(index / SubBucketCount) + SubBucketBits - 1;
+    auto sub_bucket = index % SubBucketCount;
+    auto width = uint64_t{ 1 } << (exponent - SubBucketBits);
+    return ((SubBucketCount + sub_bucket) << (exponent - SubBucketBits)) + width - 1;
+}
+
+void LatencyHistogram::record(std::chrono::microseconds latency)
+{
+    auto value = latency.count() > 0 ? static_cast<uint64_t>(latency.count()) : uint64_t{ 0 };
+    m_buckets[bucket_index(value)]++;
+    m_count++;
+    m_max = (std::max)(m_max, value);
+}
+
+void LatencyHistogram::reset()
+{
+    m_buckets.fill(0);
+    m_count = 0;
+    m_max = 0;
+}
+
+std::chrono::microseconds LatencyHistogram::percentile(double percentile) const
+{
+    if (m_count == 0) return std::chrono::microseconds(0);
+
+    auto target = static_cast<uint64_t>(std::ceil(std::clamp(percentile, 0.0, 100.0) / 100.0 * m_count));
+    target = (std::max)(target, uint64_t{ 1 });
+
+    uint64_t cumulative = 0;
+    for (size_t index = 0; index < BucketCount; index++) {
+        cumulative += m_buckets[index];
+        if (cumulative >= target) {
+            return std::chrono::microseconds((std::min)(bucket_upper_bound(index), m_max));
+        }
+    }
+
+    return std::chrono::microseconds(m_max);
+}
+
+//
+// LatencyTracker
+//
+
+void LatencyTracker::record(const INPUT_EVENT& event, LatencyStage stage, input_clock::time_point time)
+{
+    auto latency = std::chrono::duration_cast<std::chrono::microseconds>(time - event.timestamp);
+    m_histograms[histogram_index(event.type, stage)].record(latency);
+}
+
+void LatencyTracker::begin_dispatch(const INPUT_EVENT& event)
+{
+    m_dispatching = true;
+    m_invalidated = false;
+    m_current = event;
+}
+
+void LatencyTracker::end_dispatch()
+{
+    if (m_dispatching == false) return;
+
+    record(m_current, LatencyStage::Dispatch, now());
+    if (m_invalidated) {
+        m_awaiting_present.push_back(m_current);
+    }
+
+    m_dispatching = false;
+}
+
+void LatencyTracker::note_invalidation()
+{
+    if (m_dispatching) {
+        m_invalidated = true;
+    }
+}
+
+void LatencyTracker::frame_presented()
+{
+    if (m_awaiting_present.empty()) return;
+
+    auto time = now();
+    for (auto& event : m_awaiting_present) {
+        record(event, LatencyStage::Present, time);
+    }
+    m_awaiting_present.clear();
+}
+
+void LatencyTracker::reset()
+{
+    for (auto& histogram : m_histograms) {
+        histogram.reset();
+    }
+    m_awaiting_present.clear();
+    m_dispatching = false;
+}
+
+void LatencyTracker::log_report(const LogContext& logger) const
+{
+    static const PCWSTR type_names[InputTypeCount] = {
+        NAMEOF(PointerMove),
+        NAMEOF(PointerLeave),
+        NAMEOF(PointerPress),
+        NAMEOF(PointerRelease),
+        NAMEOF(PointerWheel),
+        NAMEOF(KeyDown),
+        NAMEOF(Character),
+    };
+
+    static const PCWSTR stage_names[StageCount] = {
+        NAMEOF(Dispatch),
+        NAMEOF(Present),
+    };
+
+    for (size_t type = 0; type < InputTypeCount; type++) {
+        for (size_t stage = 0; stage < StageCount; stage++) {
+            auto& histogram = m_histograms[type * StageCount + stage];
+            if (histogram.count() == 0) continue;
+
+            auto line = std::format(L"{} {}: count={} p50={}us p95={}us p99={}us max={}us",
+                type_names[type], stage_names[stage], histogram.count(),
+                histogram.percentile(50).count(), histogram.percentile(95).count(),
+                histogram.percentile(99).count(), histogram.maximum().count());
+            logger.log(line.c_str());
+        }
+    }
+}
@@ -0,0 +1,100 @@
+// latency.hpp: Input latency instrumentation
+// LatencyTracker follows every input record from OS receipt through dispatch to the frame presenting its result
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "foundation.hpp"
+#include "input_queue.hpp"
+
+namespace DirectWidget {
+
+    // Log-linear histogram of microsecond samples
+    // Each power of two range is split into SubBucketCount buckets, bounding the relative error of a percentile to 1/SubBucketCount.
+
+    class LatencyHistogram {
+    public:
+        static constexpr int SubBucketBits = 4;
+        static constexpr int SubBucketCount = 1 << SubBucketBits;
+
+        void record(std::chrono::microseconds latency);
+        void reset();
+
+        uint64_t count() const { return m_count; }
+        std::chrono::microseconds maximum() const { return std::chrono::microseconds(m_max); }
+
+        // Upper bound of the bucket holding the given percentile, in [0, 100]
+        std::chrono::microseconds percentile(double percentile) const;
+
+    private:
+        static size_t bucket_index(uint64_t value);
+        static uint64_t bucket_upper_bound(size_t index);
+
+        // Values up to 2^40 microseconds, larger samples land in the last bucket
+        static constexpr size_t BucketCount = (40 - SubBucketBits + 1) * SubBucketCount;
+
+        std::array<uint64_t, BucketCount> m_buckets{};
+        uint64_t m_count = 0;
+        uint64_t m_max = 0;
+    };
+
+    enum class LatencyStage {
+        // OS receipt until the handlers of the event returned
+        Dispatch,
+        // OS receipt until the frame containing the invalidation caused by the event was presented
+        Present,
+    };
+
+    class LatencyTracker {
+    public:
+        using clock_function = input_clock::time_point (*)();
+
+        // Tests pass a virtual clock, timestamps of injected records must come from the same clock
+        LatencyTracker(clock_function clock = input_clock::now) : m_clock(clock) {}
+
+        void set_clock(clock_function clock) { m_clock = clock; }
+
+        input_clock::time_point now() const { return m_clock(); }
+
+        // Brackets the handlers run for event, invalidations noted in between are attributed to it
+        void begin_dispatch(const INPUT_EVENT& event);
+        void end_dispatch();
+
+        void note_invalidation();
+
+        void frame_presented();
+
+        const LatencyHistogram& histogram(InputType type, LatencyStage stage) const {
+            return m_histograms[histogram_index(type, stage)];
+        }
+
+        void reset();
+
+        // Writes count and p50/p95/p99 of every histogram holding samples
+        void log_report(const LogContext& logger) const;
+
+    private:
+        static constexpr size_t InputTypeCount = static_cast<size_t>(InputType::Character) + 1;
+        static constexpr size_t StageCount = static_cast<size_t>(LatencyStage::Present) + 1;
+
+        static size_t histogram_index(InputType type, LatencyStage stage) {
+            return static_cast<size_t>(type) * StageCount + static_cast<size_t>(stage);
+        }
+
+        void record(const INPUT_EVENT& event, LatencyStage stage, input_clock::time_point time);
+
+        clock_function m_clock;
+
+        bool m_dispatching = false;
+        bool m_invalidated = false;
+        INPUT_EVENT m_current{};
+
+        std::vector<INPUT_EVENT> m_awaiting_present;
+        std::array<LatencyHistogram, InputTypeCount * StageCount> m_histograms;
+    };
+}
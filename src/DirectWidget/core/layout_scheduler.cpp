@@ -0,0 +1,172 @@
+// layout_scheduler.cpp: LayoutScheduler implementation
+
+#include <algorithm>
+#include <chrono>
+#include <format>
+
+#include "foundation.hpp"
+#include "handle.hpp"
+#include "layout_scheduler.hpp"
+#include "widget.hpp"
+
+using namespace DirectWidget;
+
+thread_local LayoutScheduler* LayoutScheduler::s_current = nullptr;
+
+static constexpr uint32_t work_flag(LayoutWork work) { return 1u << static_cast<uint32_t>(work); }
+
+//
+// Slices
+//
+
+LayoutScheduler::Slice::Slice(LayoutScheduler& scheduler, std::chrono::microseconds budget)
+    : m_scheduler(scheduler), m_previous(s_current)
+{
+    s_current = &scheduler;
+    scheduler.begin_slice(budget);
+}
+
+LayoutScheduler::Slice::~Slice()
+{
+    m_scheduler.end_slice();
+    s_current = m_previous;
+}
+
+void LayoutScheduler::begin_slice(std::chrono::microseconds budget)
+{
+    m_budget = budget;
+    m_slice_start = now();
+    m_deadline = m_slice_start + budget;
+}
+
+void LayoutScheduler::end_slice()
+{
+    auto time = now();
+    auto duration = std::chrono::duration_cast<std::chrono::microseconds>(time - m_slice_start);
+    m_slice_histogram.record(duration);
+    if (m_budget.count() > 0 && duration > m_budget) {
+        m_overruns++;
+    }
+
+    if (m_incomplete && m_queue.empty()) {
+        m_completion_histogram.record(std::chrono::duration_cast<std::chrono::microseconds>(time - m_incomplete_since));
+        m_incomplete = false;
+    }
+
+    m_budget = std::chrono::microseconds(0);
+}
+
+//
+// Work queue
+//
+
+void LayoutScheduler::defer_measure(const WidgetBase* widget, const SIZE_F& measure)
+{
+    enqueue({ element_handle(widget), LayoutWork::Measure, measure });
+}
+
+void LayoutScheduler::defer_layout(const WidgetBase* widget)
+{
+    enqueue({ element_handle(widget), LayoutWork::Layout, SIZE_F{ 0, 0 } });
+}
+
+void LayoutScheduler::enqueue(const LAYOUT_ITEM& item)
+{
+    auto& queued = m_queued[item.widget];
+    if (queued & work_flag(item.work)) return;
+    queued |= work_flag(item.work);
+
+    if (m_incomplete == false) {
+        m_incomplete = true;
+        m_incomplete_since = now();
+    }
+
+    m_queue.push_back(item);
+    m_deferred++;
+}
+
+void LayoutScheduler::resume()
+{
+    auto& registry = ElementRegistry::instance();
+
+    while (m_queue.empty() == false && should_yield() == false) {
+        auto item = m_queue.front();
+        m_queue.pop_front();
+
+        // Widgets destroyed while their work was queued are skipped, their storage slot is reset on reuse
+        if (registry.is_alive(item.widget) == false) continue;
+        m_queued[item.widget] &= ~work_flag(item.work);
+
+        auto widget = static_cast<WidgetBase*>(registry.resolve(item.widget));
+        switch (item.work) {
+        case LayoutWork::Measure:
+            complete_measure(widget, item.measure);
+            break;
+
+        case LayoutWork::Layout:
+            // Widgets laid out since they were deferred, by their parent or for hit testing, are done
+            if (WidgetBase::LayoutResource->is_valid(widget) == false) {
+                WidgetBase::LayoutResource->initialize_for(widget);
+            }
+            break;
+        }
+    }
+
+    // Layouts are discarded after the queue ran, so a subtree is laid out once for all measures resumed in it
+    for (auto& handle : m_relayout_roots) {
+        if (registry.is_alive(handle) == false) continue;
+        static_cast<WidgetBase*>(registry.resolve(handle))->discard_layout();
+    }
+    m_relayout_roots.clear();
+}
+
+void LayoutScheduler::complete_measure(WidgetBase* widget, const SIZE_F& deferred_measure)
+{
+    auto& measure_resource = WidgetBase::MeasureResource;
+    if (measure_resource->is_valid(widget) == false) {
+        measure_resource->initialize_for(widget);
+
+        // Deferred again, the widget is back in the queue
+        if (measure_resource->is_valid(widget) == false) return;
+    }
+
+    auto& measure = measure_resource->get_resource(widget);
+    if (measure.width == deferred_measure.width && measure.height == deferred_measure.height) return;
+
+    // Ancestors measured with the deferred size, their measures are redone from the cached measures of their other children
+    auto handle = element_handle(widget->discard_ancestor_measures());
+    if (std::find(m_relayout_roots.begin(), m_relayout_roots.end(), handle) == m_relayout_roots.end()) {
+        m_relayout_roots.push_back(handle);
+    }
+}
+
+//
+// Statistics
+//
+
+void LayoutScheduler::reset_statistics()
+{
+    m_slice_histogram.reset();
+    m_completion_histogram.reset();
+    m_overruns = 0;
+    m_deferred = 0;
+}
+
+void LayoutScheduler::log_report(const LogContext& logger) const
+{
+    if (m_slice_histogram.count() > 0) {
+        auto line = std::format(L"Slice: count={} overruns={} p50={}us p95={}us p99={}us max={}us",
+            m_slice_histogram.count(), m_overruns,
+            m_slice_histogram.percentile(50).count(), m_slice_histogram.percentile(95).count(),
+            m_slice_histogram.percentile(99).count(), m_slice_histogram.maximum().count());
+        logger.log(line.c_str());
+    }
+
+    if (m_completion_histogram.count() > 0) {
+        auto line = std::format(L"Completion: count={} deferred={} p50={}us p95={}us p99={}us max={}us",
+            m_completion_histogram.count(), m_deferred,
+            m_completion_histogram.percentile(50).count(), m_completion_histogram.percentile(95).count(),
+            m_completion_histogram.percentile(99).count(), m_completion_histogram.maximum().count());
+        logger.log(line.c_str());
+    }
+}
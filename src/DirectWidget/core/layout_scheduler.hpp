@@ -0,0 +1,122 @@
+// layout_scheduler.hpp: LayoutScheduler definition
+// LayoutScheduler bounds the measure and layout work of a frame by a time budget.
+// Work left when the budget runs out is queued and resumed by the next frame, widgets keep their previous layout until then.
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "foundation.hpp"
+#include "handle.hpp"
+#include "input_queue.hpp"
+#include "latency.hpp"
+
+namespace DirectWidget {
+
+    class WidgetBase;
+
+    enum class LayoutWork {
+        Measure,
+        Layout,
+    };
+
+    class LayoutScheduler {
+    public:
+        using clock_function = input_clock::time_point (*)();
+
+        // Scheduler of the slice running on this thread, nullptr outside of slices where layout never yields
+        static LayoutScheduler* current() { return s_current; }
+
+        // Makes scheduler current for the lifetime of the slice
+        // A zero budget never yields, layout then runs to completion as it does outside of slices.
+        class Slice {
+        public:
+            Slice(LayoutScheduler& scheduler, std::chrono::microseconds budget);
+            ~Slice();
+
+            Slice(const Slice&) = delete;
+            Slice& operator=(const Slice&) = delete;
+
+        private:
+            LayoutScheduler& m_scheduler;
+            LayoutScheduler* m_previous;
+        };
+
+        // Benchmarks pass a virtual clock
+        LayoutScheduler(clock_function clock = input_clock::now) : m_clock(clock) {}
+
+        void set_clock(clock_function clock) { m_clock = clock; }
+
+        input_clock::time_point now() const { return m_clock(); }
+
+        // True once the budget of the running slice is spent, measure and layout then defer instead of running
+        bool should_yield() const {
+            return m_budget.count() > 0 && now() >= m_deadline;
+        }
+
+        // Queues work of a widget, measure keeps the size the widget had when it was deferred
+        void defer_measure(const WidgetBase* widget, const SIZE_F& measure);
+        void defer_layout(const WidgetBase* widget);
+
+        bool has_pending() const { return m_queue.empty() == false; }
+        size_t pending_count() const { return m_queue.size(); }
+
+        // Runs queued work in order until the queue is empty or the slice yields
+        void resume();
+
+        // statistics
+
+        // Duration of slices, and of the time from the first deferral until the queue was empty again
+        const LatencyHistogram& slice_histogram() const { return m_slice_histogram; }
+        const LatencyHistogram& completion_histogram() const { return m_completion_histogram; }
+
+        // Slices running longer than their budget, and work items deferred
+        uint64_t overrun_count() const { return m_overruns; }
+        uint64_t deferred_count() const { return m_deferred; }
+
+        void reset_statistics();
+
+        // Writes budget adherence and completion latency
+        void log_report(const LogContext& logger) const;
+
+    private:
+        static thread_local LayoutScheduler* s_current;
+
+        typedef struct {
+            ElementHandle widget;
+            LayoutWork work;
+            // Size the parent measured with while the measure was deferred
+            SIZE_F measure;
+        } LAYOUT_ITEM;
+
+        void begin_slice(std::chrono::microseconds budget);
+        void end_slice();
+
+        void enqueue(const LAYOUT_ITEM& item);
+        void complete_measure(WidgetBase* widget, const SIZE_F& deferred_measure);
+
+        clock_function m_clock;
+
+        std::chrono::microseconds m_budget{ 0 };
+        input_clock::time_point m_slice_start{};
+        input_clock::time_point m_deadline{};
+
+        std::deque<LAYOUT_ITEM> m_queue;
+        // Work deferred more than once in a slice is queued once
+        ElementStorage<uint32_t> m_queued;
+
+        // Topmost widgets whose layout is discarded once resumed measures changed the sizes they were laid out with
+        std::vector<ElementHandle> m_relayout_roots;
+
+        bool m_incomplete = false;
+        input_clock::time_point m_incomplete_since{};
+
+        LatencyHistogram m_slice_histogram;
+        LatencyHistogram m_completion_histogram;
+        uint64_t m_overruns = 0;
+        uint64_t m_deferred = 0;
+    };
+}
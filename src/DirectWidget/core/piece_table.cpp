@@ -0,0 +1,345 @@
+// piece_table.cpp: PieceTable implementation
+
+#include <algorithm>
+#include <cassert>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "piece_table.hpp"
+
+using namespace DirectWidget;
+
+PieceTable::PieceTable(std::wstring_view text)
+{
+    // Node 0 is the empty sentinel, its aggregates stay zero
+    m_nodes.push_back({ Nil, Nil, 0, BufferKind::Original, 0, 0, 0, 0, 0 });
+
+    if (text.empty() == false) {
+        append_to_buffer(BufferKind::Original, text);
+        m_root = allocate(BufferKind::Original, 0, text.size(), next_priority());
+    }
+}
+
+uint32_t PieceTable::next_priority()
+{
+    // xorshift32
+    m_seed ^= m_seed << 13;
+    m_seed ^= m_seed >> 17;
+    m_seed ^= m_seed << 5;
+    return m_seed;
+}
+
+void PieceTable::append_to_buffer(BufferKind kind, std::wstring_view text)
+{
+    auto& target = buffer(kind);
+    auto offset = target.text.size();
+    target.text.append(text);
+
+    for (size_t i = 0; i < text.size(); i++) {
+        if (text[i] == L'\n') {
+            target.line_feeds.push_back(offset + i);
+        }
+    }
+}
+
+size_t PieceTable::count_line_feeds(BufferKind kind, size_t start, size_t length) const
+{
+    auto& line_feeds = buffer(kind).line_feeds;
+    auto first = std::lower_bound(line_feeds.begin(), line_feeds.end(), start);
+    auto last = std::lower_bound(first, line_feeds.end(), start + length);
+    return static_cast<size_t>(last - first);
+}
+
+uint32_t PieceTable::allocate(BufferKind kind, size_t start, size_t length, uint32_t priority)
+{
+    NODE node{ Nil, Nil, priority, kind, start, length, count_line_feeds(kind, start, length), 0, 0 };
+
+    uint32_t index;
+    if (m_free_nodes.empty()) {
+        index = static_cast<uint32_t>(m_nodes.size());
+        m_nodes.push_back(node);
+    }
+    else {
+        index = m_free_nodes.back();
+        m_free_nodes.pop_back();
+        m_nodes[index] = node;
+    }
+
+    update(index);
+    return index;
+}
+
+void PieceTable::release(uint32_t node)
+{
+    // Iterative, the released subtree may be a large part of the tree
+    std::vector<uint32_t> pending{ node };
+    while (pending.empty() == false) {
+        auto current = pending.back();
+        pending.pop_back();
+        if (current == Nil) continue;
+
+        pending.push_back(m_nodes[current].left);
+        pending.push_back(m_nodes[current].right);
+        m_free_nodes.push_back(current);
+    }
+}
+
+void PieceTable::update(uint32_t node)
+{
+    auto& current = m_nodes[node];
+    auto& left = m_nodes[current.left];
+    auto& right = m_nodes[current.right];
+
+    current.subtree_length = left.subtree_length + current.length + right.subtree_length;
+    current.subtree_line_feeds = left.subtree_line_feeds + current.line_feeds + right.subtree_line_feeds;
+}
+
+std::pair<uint32_t, uint32_t> PieceTable::split(uint32_t node, size_t position)
+{
+    if (node == Nil) return { Nil, Nil };
+
+    auto left_length = m_nodes[m_nodes[node].left].subtree_length;
+    auto piece_length = m_nodes[node].length;
+
+    if (position <= left_length) {
+        auto [first, second] = split(m_nodes[node].left, position);
+        m_nodes[node].left = second;
+        update(node);
+        return { first, node };
+    }
+
+    if (position >= left_length + piece_length) {
+        auto [first, second] = split(m_nodes[node].right, position - left_length - piece_length);
+        m_nodes[node].right = first;
+        update(node);
+        return { node, second };
+    }
+
+    // Cut the piece, the tail inherits the priority so heap order below it is kept
+    auto offset = position - left_length;
+    auto tail = allocate(m_nodes[node].buffer, m_nodes[node].start + offset, piece_length - offset, m_nodes[node].priority);
+
+    auto& head = m_nodes[node];
+    head.length = offset;
+    head.line_feeds = count_line_feeds(head.buffer, head.start, head.length);
+
+    m_nodes[tail].right = head.right;
+    head.right = Nil;
+
+    update(node);
+    update(tail);
+    return { node, tail };
+}
+
+uint32_t PieceTable::merge(uint32_t left, uint32_t right)
+{
+    if (left == Nil) return right;
+    if (right == Nil) return left;
+
+    if (m_nodes[left].priority > m_nodes[right].priority) {
+        auto merged = merge(m_nodes[left].right, right);
+        m_nodes[left].right = merged;
+        update(left);
+        return left;
+    }
+
+    auto merged = merge(left, m_nodes[right].left);
+    m_nodes[right].left = merged;
+    update(right);
+    return right;
+}
+
+bool PieceTable::try_extend_last(uint32_t node, size_t added_start, size_t added_length)
+{
+    if (node == Nil) return false;
+
+    std::vector<uint32_t> path;
+    for (auto current = node; current != Nil; current = m_nodes[current].right) {
+        path.push_back(current);
+    }
+
+    auto& last = m_nodes[path.back()];
+    if (last.buffer != BufferKind::Added || last.start + last.length != added_start) return false;
+
+    last.length += added_length;
+    last.line_feeds += count_line_feeds(BufferKind::Added, added_start, added_length);
+
+    for (auto it = path.rbegin(); it != path.rend(); it++) {
+        update(*it);
+    }
+    return true;
+}
+
+void PieceTable::insert(size_t position, std::wstring_view text)
+{
+    if (text.empty()) return;
+    position = (std::min)(position, length());
+
+    auto added_start = buffer(BufferKind::Added).text.size();
+    append_to_buffer(BufferKind::Added, text);
+
+    auto [first, second] = split(m_root, position);
+
+    // Typing appends to the add buffer right after the previous insertion, which extends its piece
+    if (try_extend_last(first, added_start, text.size()) == false) {
+        auto piece = allocate(BufferKind::Added, added_start, text.size(), next_priority());
+        first = merge(first, piece);
+    }
+
+    m_root = merge(first, second);
+}
+
+void PieceTable::erase(size_t position, size_t count)
+{
+    if (position >= length() || count == 0) return;
+    count = (std::min)(count, length() - position);
+
+    auto [first, rest] = split(m_root, position);
+    auto [erased, second] = split(rest, count);
+
+    release(erased);
+    m_root = merge(first, second);
+}
+
+wchar_t PieceTable::at(size_t position) const
+{
+    assert(position < length());
+
+    auto node = m_root;
+    while (node != Nil) {
+        auto& current = m_nodes[node];
+        auto left_length = m_nodes[current.left].subtree_length;
+
+        if (position < left_length) {
+            node = current.left;
+        }
+        else if (position < left_length + current.length) {
+            return buffer(current.buffer).text[current.start + position - left_length];
+        }
+        else {
+            position -= left_length + current.length;
+            node = current.right;
+        }
+    }
+    return L'\0';
+}
+
+void PieceTable::copy_node(uint32_t node, size_t position, size_t count, std::wstring& text) const
+{
+    if (node == Nil || count == 0) return;
+
+    auto& current = m_nodes[node];
+    auto left_length = m_nodes[current.left].subtree_length;
+
+    if (position < left_length) {
+        auto left_count = (std::min)(count, left_length - position);
+        copy_node(current.left, position, left_count, text);
+        position += left_count;
+        count -= left_count;
+    }
+    if (count == 0) return;
+
+    auto piece_position = position - left_length;
+    if (piece_position < current.length) {
+        auto piece_count = (std::min)(count, current.length - piece_position);
+        text.append(buffer(current.buffer).text, current.start + piece_position, piece_count);
+        position += piece_count;
+        count -= piece_count;
+    }
+    if (count == 0) return;
+
+    copy_node(current.right, position - left_length - current.length, count, text);
+}
+
+void PieceTable::copy(size_t position, size_t count, std::wstring& text) const
+{
+    if (position >= length()) return;
+    count = (std::min)(count, length() - position);
+
+    text.reserve(text.size() + count);
+    copy_node(m_root, position, count, text);
+}
+
+std::wstring PieceTable::text() const
+{
+    std::wstring text;
+    copy(0, length(), text);
+    return text;
+}
+
+size_t PieceTable::line_start(size_t line) const
+{
+    if (line == 0) return 0;
+    if (line >= line_count()) return length();
+
+    // Find the line-th line feed
+    auto remaining = line;
+    size_t base = 0;
+
+    auto node = m_root;
+    while (node != Nil) {
+        auto& current = m_nodes[node];
+        auto& left = m_nodes[current.left];
+
+        if (remaining <= left.subtree_line_feeds) {
+            node = current.left;
+            continue;
+        }
+
+        remaining -= left.subtree_line_feeds;
+        base += left.subtree_length;
+
+        if (remaining <= current.line_feeds) {
+            auto& line_feeds = buffer(current.buffer).line_feeds;
+            auto first = std::lower_bound(line_feeds.begin(), line_feeds.end(), current.start);
+            auto offset = *(first + (remaining - 1)) - current.start;
+            return base + offset + 1;
+        }
+
+        remaining -= current.line_feeds;
+        base += current.length;
+        node = current.right;
+    }
+
+    return length();
+}
+
+size_t PieceTable::line_end(size_t line) const
+{
+    if (line + 1 >= line_count()) return length();
+    return line_start(line + 1) - 1;
+}
+
+size_t PieceTable::line_of(size_t position) const
+{
+    position = (std::min)(position, length());
+
+    // Count line feeds before position
+    size_t line = 0;
+
+    auto node = m_root;
+    while (node != Nil) {
+        auto& current = m_nodes[node];
+        auto& left = m_nodes[current.left];
+
+        if (position <= left.subtree_length) {
+            node = current.left;
+            continue;
+        }
+
+        line += left.subtree_line_feeds;
+        position -= left.subtree_length;
+
+        if (position <= current.length) {
+            return line + count_line_feeds(current.buffer, current.start, position);
+        }
+
+        line += current.line_feeds;
+        position -= current.length;
+        node = current.right;
+    }
+
+    return line;
+}
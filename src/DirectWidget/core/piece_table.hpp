@@ -0,0 +1,102 @@
+// piece_table.hpp: PieceTable definition
+// PieceTable stores editable text as pieces of an immutable original buffer and an append-only add buffer.
+// Pieces are kept in a treap ordered by text position, every node caches the length and line feed count of its subtree,
+// so edits and position/line lookups are O(log n) in the number of pieces.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace DirectWidget {
+
+    class PieceTable {
+    public:
+        PieceTable() : PieceTable(std::wstring_view()) {}
+        explicit PieceTable(std::wstring_view text);
+
+        PieceTable(PieceTable&) = delete;
+        PieceTable(PieceTable&&) = default;
+        PieceTable& operator=(PieceTable&&) = default;
+
+        size_t length() const { return m_nodes[m_root].subtree_length; }
+
+        // Lines are separated by L'\n', an empty text has one line
+        size_t line_count() const { return m_nodes[m_root].subtree_line_feeds + 1; }
+
+        void insert(size_t position, std::wstring_view text);
+        void erase(size_t position, size_t count);
+
+        wchar_t at(size_t position) const;
+
+        // Appends count characters starting at position to text
+        void copy(size_t position, size_t count, std::wstring& text) const;
+        std::wstring text() const;
+
+        // Position of the first character of line
+        size_t line_start(size_t line) const;
+
+        // Position of the line feed ending line, or length() for the last line
+        size_t line_end(size_t line) const;
+
+        // Line holding position
+        size_t line_of(size_t position) const;
+
+    private:
+        static constexpr uint32_t Nil = 0;
+
+        enum class BufferKind : uint8_t {
+            Original,
+            Added,
+        };
+
+        typedef struct {
+            std::wstring text;
+            // Offsets of L'\n' in text, ascending
+            std::vector<size_t> line_feeds;
+        } BUFFER;
+
+        typedef struct {
+            uint32_t left;
+            uint32_t right;
+            uint32_t priority;
+            BufferKind buffer;
+            size_t start;
+            size_t length;
+            size_t line_feeds;
+            size_t subtree_length;
+            size_t subtree_line_feeds;
+        } NODE;
+
+        uint32_t allocate(BufferKind buffer, size_t start, size_t length, uint32_t priority);
+        void release(uint32_t node);
+        void update(uint32_t node);
+
+        // Splits the tree so the first part holds the first position characters, cutting a piece if necessary
+        std::pair<uint32_t, uint32_t> split(uint32_t node, size_t position);
+        uint32_t merge(uint32_t left, uint32_t right);
+
+        // Extends the last piece of the tree if it ends where text was appended to the add buffer
+        bool try_extend_last(uint32_t node, size_t added_start, size_t added_length);
+
+        void copy_node(uint32_t node, size_t position, size_t count, std::wstring& text) const;
+
+        size_t count_line_feeds(BufferKind buffer, size_t start, size_t length) const;
+        void append_to_buffer(BufferKind buffer, std::wstring_view text);
+
+        const BUFFER& buffer(BufferKind kind) const { return m_buffers[static_cast<size_t>(kind)]; }
+        BUFFER& buffer(BufferKind kind) { return m_buffers[static_cast<size_t>(kind)]; }
+
+        uint32_t next_priority();
+
+        BUFFER m_buffers[2];
+        std::vector<NODE> m_nodes;
+        std::vector<uint32_t> m_free_nodes;
+        uint32_t m_root = Nil;
+        uint32_t m_seed = 0x9E3779B9u;
+    };
+}
@@ -5,10 +5,10 @@
 
 #include <memory>
 #include <vector>
-#include <unordered_map>
 
 #include "foundation.hpp"
 #include "dependency.hpp"
+#include "handle.hpp"
 
 namespace DirectWidget {
 
@@ -70,37 +70,41 @@ namespace DirectWidget {
     template <typename T>
     using property_ptr = std::shared_ptr<TypedPropertyBase<T>>;
 
-    class InheritedPropertyBase : virtual public PropertyBase {
+    class InheritedPropertyBase : virtual public PropertyBase, public InheritedDependencyBase {
     public:
+        InheritedPropertyBase() {
+            set_inherited(DependencyKind::InheritedProperty, this);
+        }
+
         virtual ~InheritedPropertyBase() = default;
 
         void register_owner(const ElementBase* owner) override {
-            m_parent[owner] = nullptr;
+            m_parent.insert_or_assign(element_handle(owner), NullElementHandle);
         }
 
-        void remove_owner(const ElementBase* owner) override {
+        void remove_owner(ElementHandle owner) override {
             m_parent.erase(owner);
         }
 
-        void register_parent(const ElementBase* owner, ElementBase* parent) {
-            m_parent[owner] = parent;
+        void register_parent(const ElementBase* owner, ElementBase* parent) override {
+            m_parent[element_handle(owner)] = element_handle(parent);
         }
 
-        void remove_parent(const ElementBase* owner) {
-            m_parent[owner] = nullptr;
+        void remove_parent(const ElementBase* owner) override {
+            m_parent[element_handle(owner)] = NullElementHandle;
         }
 
     protected:
         ElementBase* get_parent(const ElementBase* owner) const {
-            auto it = m_parent.find(owner);
-            if (it == m_parent.end()) {
+            auto parent = m_parent.find(element_handle(owner));
+            if (parent == nullptr) {
                 return nullptr;
             }
-            return it->second;
+            return ElementRegistry::instance().resolve(*parent);
         }
 
     private:
-        std::unordered_map<const ElementBase*, ElementBase*> m_parent;
+        ElementStorage<ElementHandle> m_parent;
     };
 
     template <typename T>
@@ -130,34 +134,35 @@ namespace DirectWidget {
         }
 
         void register_owner(const ElementBase* owner) override {
-            m_values.insert({ owner, m_default_value });
+            m_values.insert_or_assign(element_handle(owner), m_default_value);
         }
 
-        void remove_owner(const ElementBase* owner) override {
+        void remove_owner(ElementHandle owner) override {
             m_values.erase(owner);
         }
 
         const T& get_value(const ElementBase* owner) const override {
-            auto iter = m_values.find(owner);
-            if (iter != m_values.end()) {
-                return iter->second;
+            auto value = m_values.find(element_handle(owner));
+            if (value != nullptr) {
+                return *value;
             }
             return m_default_value;
         }
 
         void set_value(const ElementBase* owner, const T& value) override {
-            auto old_value = m_values[owner];
+            auto& stored_value = m_values[element_handle(owner)];
+            auto old_value = stored_value;
 
             // FIXME:
             //if (old_value == value) return;
 
-            m_values[owner] = value;
+            stored_value = value;
             TypedPropertyBase<T>::notify_change(owner, old_value, value);
         }
 
     private:
         const T m_default_value;
-        std::unordered_map<const ElementBase*, T> m_values;
+        ElementStorage<T> m_values;
     };
 
     // Observable collection
@@ -166,28 +171,28 @@ namespace DirectWidget {
     class ObservableCollectionProperty : public PropertyBase {
     public:
         void register_owner(const ElementBase* owner) override {
-            m_values.insert({ owner, std::vector<T>() });
+            m_values.insert_or_assign(element_handle(owner), std::vector<T>());
         }
 
-        void remove_owner(const ElementBase* owner) override {
+        void remove_owner(ElementHandle owner) override {
             m_values.erase(owner);
         }
 
         const std::vector<T>& get_values(const ElementBase* owner) const {
-            auto iter = m_values.find(owner);
-            if (iter == m_values.end()) {
-                return std::vector<T>{};
+            auto values = m_values.find(element_handle(owner));
+            if (values == nullptr) {
+                return m_empty_values;
             }
-            return iter->second;
+            return *values;
         }
 
         void add_element(ElementBase* owner, const T& element) {
-            m_values[owner].push_back(element);
+            m_values[element_handle(owner)].push_back(element);
             notify_change(owner, element, true);
         }
 
         void remove_element(ElementBase* owner, const T& element) {
-            auto& collection = m_values[owner];
+            auto& collection = m_values[element_handle(owner)];
             collection.erase(std::remove(collection.begin(), collection.end(), element));
             notify_change(owner, element, false);
         }
@@ -198,7 +203,8 @@ namespace DirectWidget {
         }
 
     private:
-        std::unordered_map<const ElementBase*, std::vector<T>> m_values;
+        ElementStorage<std::vector<T>> m_values;
+        const std::vector<T> m_empty_values;
     };
 
     template <typename T>
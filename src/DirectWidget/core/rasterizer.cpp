@@ -0,0 +1,397 @@
+// rasterizer.cpp: Rasterizer implementation
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include <intrin.h>
+#include <immintrin.h>
+
+#include <Windows.h>
+#include <d2d1.h>
+
+#include "foundation.hpp"
+#include "rasterizer.hpp"
+
+using namespace DirectWidget;
+
+//
+// Scalar kernels
+// Channels are blended as source + target * (255 - source alpha) / 255, the division rounded like the vector kernels round it.
+//
+
+static inline uint32_t div255(uint32_t value)
+{
+    value += 128;
+    return (value + (value >> 8)) >> 8;
+}
+
+static inline uint32_t over(uint32_t target, uint32_t source)
+{
+    auto inverse = 255 - (source >> 24);
+    uint32_t result = 0;
+    for (uint32_t shift = 0; shift < 32; shift += 8) {
+        auto channel = ((source >> shift) & 0xFF) + div255(((target >> shift) & 0xFF) * inverse);
+        result |= (std::min)(channel, 255u) << shift;
+    }
+    return result;
+}
+
+static void scalar_fill(uint32_t* target, size_t count, uint32_t color)
+{
+    for (size_t i = 0; i < count; i++) {
+        target[i] = color;
+    }
+}
+
+static void scalar_fill_over(uint32_t* target, size_t count, uint32_t color)
+{
+    for (size_t i = 0; i < count; i++) {
+        target[i] = over(target[i], color);
+    }
+}
+
+static void scalar_copy(uint32_t* target, const uint32_t* source, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        target[i] = source[i];
+    }
+}
+
+static void scalar_blend(uint32_t* target, const uint32_t* source, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        target[i] = (source[i] >> 24) == 255 ? source[i] : over(target[i], source[i]);
+    }
+}
+
+//
+// SSE2 kernels
+// Pixels are widened to 16 bit channels, scaled by the inverse alpha and narrowed again before the source is added.
+//
+
+static inline __m128i div255_epu16(__m128i value)
+{
+    value = _mm_add_epi16(value, _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(value, _mm_srli_epi16(value, 8)), 8);
+}
+
+// Alpha of each pixel in all four of its 16 bit channels
+static inline __m128i broadcast_alpha_epu16(__m128i pixels)
+{
+    return _mm_shufflehi_epi16(_mm_shufflelo_epi16(pixels, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+}
+
+static void sse2_fill(uint32_t* target, size_t count, uint32_t color)
+{
+    auto pixels = _mm_set1_epi32(static_cast<int>(color));
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(target + i), pixels);
+    }
+    scalar_fill(target + i, count - i, color);
+}
+
+static void sse2_fill_over(uint32_t* target, size_t count, uint32_t color)
+{
+    auto zero = _mm_setzero_si128();
+    auto source = _mm_set1_epi32(static_cast<int>(color));
+    auto inverse = _mm_set1_epi16(static_cast<short>(255 - (color >> 24)));
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        auto pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(target + i));
+        auto low = div255_epu16(_mm_mullo_epi16(_mm_unpacklo_epi8(pixels, zero), inverse));
+        auto high = div255_epu16(_mm_mullo_epi16(_mm_unpackhi_epi8(pixels, zero), inverse));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(target + i), _mm_adds_epu8(_mm_packus_epi16(low, high), source));
+    }
+    scalar_fill_over(target + i, count - i, color);
+}
+
+static void sse2_copy(uint32_t* target, const uint32_t* source, size_t count)
+{
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(target + i), _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i)));
+    }
+    scalar_copy(target + i, source + i, count - i);
+}
+
+static void sse2_blend(uint32_t* target, const uint32_t* source, size_t count)
+{
+    auto zero = _mm_setzero_si128();
+    auto opaque = _mm_set1_epi16(255);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        auto pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(target + i));
+        auto sources = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+        auto inverse_low = _mm_sub_epi16(opaque, broadcast_alpha_epu16(_mm_unpacklo_epi8(sources, zero)));
+        auto inverse_high = _mm_sub_epi16(opaque, broadcast_alpha_epu16(_mm_unpackhi_epi8(sources, zero)));
+        auto low = div255_epu16(_mm_mullo_epi16(_mm_unpacklo_epi8(pixels, zero), inverse_low));
+        auto high = div255_epu16(_mm_mullo_epi16(_mm_unpackhi_epi8(pixels, zero), inverse_high));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(target + i), _mm_adds_epu8(_mm_packus_epi16(low, high), sources));
+    }
+    scalar_blend(target + i, source + i, count - i);
+}
+
+//
+// AVX2 kernels
+// Eight pixels at a time, unpacking and packing within 128 bit lanes keeps them in order. Remainders go to the SSE2 kernels.
+//
+
+static inline __m256i div255_epu16(__m256i value)
+{
+    value = _mm256_add_epi16(value, _mm256_set1_epi16(128));
+    return _mm256_srli_epi16(_mm256_add_epi16(value, _mm256_srli_epi16(value, 8)), 8);
+}
+
+static inline __m256i broadcast_alpha_epu16(__m256i pixels)
+{
+    return _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(pixels, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+}
+
+static void avx2_fill(uint32_t* target, size_t count, uint32_t color)
+{
+    auto pixels = _mm256_set1_epi32(static_cast<int>(color));
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(target + i), pixels);
+    }
+    _mm256_zeroupper();
+    sse2_fill(target + i, count - i, color);
+}
+
+static void avx2_fill_over(uint32_t* target, size_t count, uint32_t color)
+{
+    auto zero = _mm256_setzero_si256();
+    auto source = _mm256_set1_epi32(static_cast<int>(color));
+    auto inverse = _mm256_set1_epi16(static_cast<short>(255 - (color >> 24)));
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        auto pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(target + i));
+        auto low = div255_epu16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(pixels, zero), inverse));
+        auto high = div255_epu16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(pixels, zero), inverse));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(target + i), _mm256_adds_epu8(_mm256_packus_epi16(low, high), source));
+    }
+    _mm256_zeroupper();
+    sse2_fill_over(target + i, count - i, color);
+}
+
+static void avx2_copy(uint32_t* target, const uint32_t* source, size_t count)
+{
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(target + i), _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i)));
+    }
+    _mm256_zeroupper();
+    sse2_copy(target + i, source + i, count - i);
+}
+
+static void avx2_blend(uint32_t* target, const uint32_t* source, size_t count)
+{
+    auto zero = _mm256_setzero_si256();
+    auto opaque = _mm256_set1_epi16(255);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        auto pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(target + i));
+        auto sources = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i));
+        auto inverse_low = _mm256_sub_epi16(opaque, broadcast_alpha_epu16(_mm256_unpacklo_epi8(sources, zero)));
+        auto inverse_high = _mm256_sub_epi16(opaque, broadcast_alpha_epu16(_mm256_unpackhi_epi8(sources, zero)));
+        auto low = div255_epu16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(pixels, zero), inverse_low));
+        auto high = div255_epu16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(pixels, zero), inverse_high));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(target + i), _mm256_adds_epu8(_mm256_packus_epi16(low, high), sources));
+    }
+    _mm256_zeroupper();
+    sse2_blend(target + i, source + i, count - i);
+}
+
+//
+// Dispatch
+//
+
+static RasterInstructionSet detect_instruction_set()
+{
+    int info[4];
+    __cpuid(info, 0);
+    auto highest_leaf = info[0];
+
+    __cpuid(info, 1);
+    auto sse2 = (info[3] & (1 << 26)) != 0;
+    auto avx = (info[2] & (1 << 28)) != 0;
+    auto osxsave = (info[2] & (1 << 27)) != 0;
+    if (sse2 == false) return RasterInstructionSet::Scalar;
+
+    // The system has to save the upper halves of the ymm registers as well
+    if (highest_leaf < 7 || avx == false || osxsave == false || (_xgetbv(0) & 0x6) != 0x6) return RasterInstructionSet::Sse2;
+
+    __cpuidex(info, 7, 0);
+    auto avx2 = (info[1] & (1 << 5)) != 0;
+    return avx2 ? RasterInstructionSet::Avx2 : RasterInstructionSet::Sse2;
+}
+
+RasterInstructionSet Rasterizer::supported_instruction_set()
+{
+    static const auto supported = detect_instruction_set();
+    return supported;
+}
+
+Rasterizer::Rasterizer(RasterInstructionSet instruction_set)
+{
+    static const KERNELS scalar{ scalar_fill, scalar_fill_over, scalar_copy, scalar_blend };
+    static const KERNELS sse2{ sse2_fill, sse2_fill_over, sse2_copy, sse2_blend };
+    static const KERNELS avx2{ avx2_fill, avx2_fill_over, avx2_copy, avx2_blend };
+
+    m_instruction_set = (std::min)(instruction_set, supported_instruction_set());
+    switch (m_instruction_set) {
+    case RasterInstructionSet::Avx2:
+        m_kernels = &avx2;
+        break;
+    case RasterInstructionSet::Sse2:
+        m_kernels = &sse2;
+        break;
+    case RasterInstructionSet::Scalar:
+    default:
+        m_kernels = &scalar;
+        break;
+    }
+}
+
+uint32_t Rasterizer::premultiply(const D2D1_COLOR_F& color)
+{
+    auto alpha = (std::clamp)(color.a, 0.0f, 1.0f);
+    auto channel = [alpha](float value) {
+        return static_cast<uint32_t>(std::lround((std::clamp)(value, 0.0f, 1.0f) * alpha * 255.0f));
+    };
+    return static_cast<uint32_t>(std::lround(alpha * 255.0f)) << 24 | channel(color.r) << 16 | channel(color.g) << 8 | channel(color.b);
+}
+
+//
+// Rects
+//
+
+typedef struct {
+    // Pixels touched along one axis, last included
+    LONG first;
+    LONG last;
+    // Share of the first and last pixel covered, out of 255
+    uint32_t first_coverage;
+    uint32_t last_coverage;
+} EDGE_SPAN;
+
+static uint32_t to_coverage(float share)
+{
+    return static_cast<uint32_t>(std::lround((std::clamp)(share, 0.0f, 1.0f) * 255.0f));
+}
+
+// Pixels the interval from, to touches within 0, limit, returns false when it touches none
+static bool edge_span(float from, float to, UINT limit, EDGE_SPAN& span)
+{
+    from = (std::max)(from, 0.0f);
+    to = (std::min)(to, static_cast<float>(limit));
+    if ((to > from) == false) return false;
+
+    span.first = static_cast<LONG>(std::floor(from));
+    span.last = static_cast<LONG>(std::ceil(to)) - 1;
+    if (span.first == span.last) {
+        span.first_coverage = span.last_coverage = to_coverage(to - from);
+    }
+    else {
+        span.first_coverage = to_coverage(static_cast<float>(span.first + 1) - from);
+        span.last_coverage = to_coverage(to - static_cast<float>(span.last));
+    }
+    return true;
+}
+
+void Rasterizer::fill_span(uint32_t* target, size_t count, uint32_t color, uint32_t coverage) const
+{
+    if (count == 0 || coverage == 0) return;
+
+    if (coverage < 255) {
+        uint32_t scaled = 0;
+        for (uint32_t shift = 0; shift < 32; shift += 8) {
+            scaled |= div255(((color >> shift) & 0xFF) * coverage) << shift;
+        }
+        color = scaled;
+    }
+
+    // Transparent colors leave the target as it is
+    if (color == 0) return;
+
+    if ((color >> 24) == 255) {
+        m_kernels->fill(target, count, color);
+    }
+    else {
+        m_kernels->fill_over(target, count, color);
+    }
+}
+
+void Rasterizer::fill_rect(const RASTER_SURFACE& target, const BOUNDS_F& rect, const D2D1_COLOR_F& color) const
+{
+    EDGE_SPAN columns, rows;
+    if (edge_span(rect.left, rect.right, target.width, columns) == false) return;
+    if (edge_span(rect.top, rect.bottom, target.height, rows) == false) return;
+
+    auto pixel = premultiply(color);
+    if (pixel == 0) return;
+
+    for (auto y = rows.first; y <= rows.last; y++) {
+        auto row_coverage = y == rows.first ? rows.first_coverage : y == rows.last ? rows.last_coverage : 255u;
+        auto row = target.pixels + static_cast<size_t>(y) * target.stride;
+
+        fill_span(row + columns.first, 1, pixel, div255(columns.first_coverage * row_coverage));
+        if (columns.first == columns.last) continue;
+
+        fill_span(row + columns.first + 1, static_cast<size_t>(columns.last - columns.first - 1), pixel, row_coverage);
+        fill_span(row + columns.last, 1, pixel, div255(columns.last_coverage * row_coverage));
+    }
+}
+
+void Rasterizer::stroke_rect(const RASTER_SURFACE& target, const BOUNDS_F& rect, float width, const D2D1_COLOR_F& color) const
+{
+    if (width <= 0.0f) return;
+
+    auto half = width / 2.0f;
+    BOUNDS_F outer{ rect.left - half, rect.top - half, rect.right + half, rect.bottom + half };
+    BOUNDS_F inner{ rect.left + half, rect.top + half, rect.right - half, rect.bottom - half };
+
+    // Strokes wider than the rect fill it
+    if (inner.right <= inner.left || inner.bottom <= inner.top) {
+        fill_rect(target, outer, color);
+        return;
+    }
+
+    // Edges are filled as four rects, the top and bottom ones span the corners
+    fill_rect(target, BOUNDS_F{ outer.left, outer.top, outer.right, inner.top }, color);
+    fill_rect(target, BOUNDS_F{ outer.left, inner.bottom, outer.right, outer.bottom }, color);
+    fill_rect(target, BOUNDS_F{ outer.left, inner.top, inner.left, inner.bottom }, color);
+    fill_rect(target, BOUNDS_F{ inner.right, inner.top, outer.right, inner.bottom }, color);
+}
+
+//
+// Blits
+//
+
+void Rasterizer::blit(const RASTER_SURFACE& target, const RASTER_SURFACE& source, POINT origin, const RECT& clip) const
+{
+    compose(target, source, origin, clip, m_kernels->copy);
+}
+
+void Rasterizer::blend(const RASTER_SURFACE& target, const RASTER_SURFACE& source, POINT origin, const RECT& clip) const
+{
+    compose(target, source, origin, clip, m_kernels->blend);
+}
+
+void Rasterizer::compose(const RASTER_SURFACE& target, const RASTER_SURFACE& source, POINT origin, const RECT& clip,
+    void (*kernel)(uint32_t*, const uint32_t*, size_t)) const
+{
+    auto left = (std::max)({ clip.left, origin.x, LONG{ 0 } });
+    auto top = (std::max)({ clip.top, origin.y, LONG{ 0 } });
+    auto right = (std::min)({ clip.right, origin.x + static_cast<LONG>(source.width), static_cast<LONG>(target.width) });
+    auto bottom = (std::min)({ clip.bottom, origin.y + static_cast<LONG>(source.height), static_cast<LONG>(target.height) });
+    if (right <= left || bottom <= top) return;
+
+    for (auto y = top; y < bottom; y++) {
+        auto target_row = target.pixels + static_cast<size_t>(y) * target.stride + left;
+        auto source_row = source.pixels + static_cast<size_t>(y - origin.y) * source.stride + (left - origin.x);
+        kernel(target_row, source_row, static_cast<size_t>(right - left));
+    }
+}
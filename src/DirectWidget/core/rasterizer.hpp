@@ -0,0 +1,80 @@
+// rasterizer.hpp: Rasterizer definition
+// Rasterizer draws the primitives of widgets into premultiplied BGRA pixels on the CPU: rect fills and strokes, blits and blends.
+// Spans are drawn by scalar, SSE2 or AVX2 kernels, the widest ones the processor runs are selected at runtime.
+// Snapshot copies its frames out through them.
+// Every kernel set rounds alike, so pixels do not depend on the processor.
+
+#pragma once
+
+#include <cstdint>
+
+#include <Windows.h>
+#include <d2d1.h>
+
+#include "foundation.hpp"
+
+namespace DirectWidget {
+
+    enum class RasterInstructionSet {
+        Scalar,
+        Sse2,
+        Avx2,
+    };
+
+    typedef struct {
+        // Premultiplied BGRA, one uint32_t per pixel
+        uint32_t* pixels;
+        UINT width;
+        UINT height;
+        // Distance between rows in pixels
+        UINT stride;
+    } RASTER_SURFACE;
+
+    class Rasterizer {
+    public:
+        // Widest instruction set of the processor, detected once
+        static RasterInstructionSet supported_instruction_set();
+
+        Rasterizer() : Rasterizer(supported_instruction_set()) {}
+
+        // Benchmarks select narrower kernels, wider ones than the processor runs fall back to the supported set
+        Rasterizer(RasterInstructionSet instruction_set);
+
+        RasterInstructionSet instruction_set() const { return m_instruction_set; }
+
+        // Premultiplies a straight alpha color into a pixel
+        static uint32_t premultiply(const D2D1_COLOR_F& color);
+
+        // Fills rect source over, pixels on fractional edges are blended by the share of them rect covers
+        void fill_rect(const RASTER_SURFACE& target, const BOUNDS_F& rect, const D2D1_COLOR_F& color) const;
+
+        // Strokes rect with a stroke of width centered on its edges, as ID2D1RenderTarget::DrawRectangle does
+        void stroke_rect(const RASTER_SURFACE& target, const BOUNDS_F& rect, float width, const D2D1_COLOR_F& color) const;
+
+        // Copies source to origin in target, within clip and target
+        void blit(const RASTER_SURFACE& target, const RASTER_SURFACE& source, POINT origin, const RECT& clip) const;
+
+        // Draws source over target at origin, within clip and target
+        void blend(const RASTER_SURFACE& target, const RASTER_SURFACE& source, POINT origin, const RECT& clip) const;
+
+    private:
+        typedef struct {
+            // Stores color over count pixels
+            void (*fill)(uint32_t* target, size_t count, uint32_t color);
+            // Draws a translucent color over count pixels
+            void (*fill_over)(uint32_t* target, size_t count, uint32_t color);
+            void (*copy)(uint32_t* target, const uint32_t* source, size_t count);
+            // Draws count source pixels over target pixels
+            void (*blend)(uint32_t* target, const uint32_t* source, size_t count);
+        } KERNELS;
+
+        // Fills count pixels with color scaled by coverage out of 255
+        void fill_span(uint32_t* target, size_t count, uint32_t color, uint32_t coverage) const;
+
+        void compose(const RASTER_SURFACE& target, const RASTER_SURFACE& source, POINT origin, const RECT& clip,
+            void (*kernel)(uint32_t*, const uint32_t*, size_t)) const;
+
+        RasterInstructionSet m_instruction_set;
+        const KERNELS* m_kernels;
+    };
+}
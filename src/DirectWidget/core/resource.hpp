@@ -5,10 +5,10 @@
 
 #include <memory>
 #include <vector>
-#include <unordered_map>
 
 #include "foundation.hpp"
 #include "dependency.hpp"
+#include "handle.hpp"
 
 namespace DirectWidget {
 
@@ -25,21 +25,30 @@ namespace DirectWidget {
 
     class ResourceBase : public DependencyBase {
     public:
+        ResourceBase() {
+            set_kind(DependencyKind::Resource);
+        }
+
         virtual ~ResourceBase() = default;
 
         virtual void register_owner(const ElementBase* owner) override {
-            m_state[owner] = ResourceState{};
+            m_state.insert_or_assign(element_handle(owner), ResourceState{});
         }
 
-        virtual void remove_owner(const ElementBase* owner) override {
-            invalidate_for(owner);
+        // Owner is already destroyed at this point, so no discard callbacks are made.
+        // Owners holding resources with external side effects invalidate them in their destructor.
+        virtual void remove_owner(ElementHandle owner) override {
             m_state.erase(owner);
         }
 
+        bool is_owner(const ElementBase* owner) const {
+            return m_state.find(element_handle(owner)) != nullptr;
+        }
+
         bool is_valid(const ElementBase* owner) const {
-            auto it = m_state.find(owner);
-            if (it != m_state.end()) {
-                return it->second.is_valid();
+            auto state = m_state.find(element_handle(owner));
+            if (state != nullptr) {
+                return state->is_valid();
             }
             return false;
         }
@@ -62,12 +71,12 @@ namespace DirectWidget {
         virtual void discard(const ElementBase* owner) = 0;
 
         void mark_valid(const ElementBase* owner) {
-            m_state[owner].set_valid(true);
+            m_state[element_handle(owner)].set_valid(true);
             notify_initialization(owner);
         }
 
         virtual void mark_invalid(const ElementBase* owner) {
-            m_state[owner].set_valid(false);
+            m_state[element_handle(owner)].set_valid(false);
             notify_invalidation(owner);
         }
 
@@ -84,7 +93,7 @@ namespace DirectWidget {
         }
 
     private:
-        std::unordered_map<const ElementBase*, ResourceState> m_state;
+        ElementStorage<ResourceState> m_state;
     };
 
     using resource_base_ptr = std::shared_ptr<ResourceBase>;
@@ -105,43 +114,48 @@ namespace DirectWidget {
     template <typename T>
     using resource_ptr = std::shared_ptr<Resource<T>>;
 
-    class InheritedResourceBase : virtual public ResourceBase {
+    class InheritedResourceBase : virtual public ResourceBase, public InheritedDependencyBase {
     public:
+        InheritedResourceBase() {
+            set_inherited(DependencyKind::InheritedResource, this);
+        }
+
         virtual void register_owner(const ElementBase* owner) override {
             ResourceBase::register_owner(owner);
-            m_parent[owner] = nullptr;
+            m_parent.insert_or_assign(element_handle(owner), NullElementHandle);
         }
 
-        virtual void remove_owner(const ElementBase* owner) override {
+        virtual void remove_owner(ElementHandle owner) override {
             ResourceBase::remove_owner(owner);
             m_parent.erase(owner);
         }
 
-        void register_parent(const ElementBase* owner, ElementBase* parent) {
-            auto grandparent = m_parent[parent];
-            if (grandparent == nullptr) {
-                m_parent[owner] = parent;
+        void register_parent(const ElementBase* owner, ElementBase* parent) override {
+            auto parent_handle = element_handle(parent);
+            auto grandparent = m_parent.find(parent_handle);
+            if (grandparent == nullptr || grandparent->is_null()) {
+                m_parent[element_handle(owner)] = parent_handle;
             }
             else {
-                m_parent[owner] = grandparent;
+                m_parent[element_handle(owner)] = *grandparent;
             }
         }
 
-        void remove_parent(const ElementBase* owner) {
-            m_parent[owner] = nullptr;
+        void remove_parent(const ElementBase* owner) override {
+            m_parent[element_handle(owner)] = NullElementHandle;
         }
 
     protected:
         ElementBase* get_parent_for(const ElementBase* owner) const {
-            auto it = m_parent.find(owner);
-            if (it == m_parent.end()) {
+            auto parent = m_parent.find(element_handle(owner));
+            if (parent == nullptr) {
                 return nullptr;
             }
-            return it->second;
+            return ElementRegistry::instance().resolve(*parent);
         }
 
     private:
-        std::unordered_map<const ElementBase*, ElementBase*> m_parent;
+        ElementStorage<ElementHandle> m_parent;
     };
 
     template <typename T>
@@ -153,8 +167,8 @@ namespace DirectWidget {
             InheritedResourceBase::register_owner(owner);
         }
 
-        void remove_owner(const ElementBase* owner) override {
-            InheritedResourceBase::register_owner(owner);
+        void remove_owner(ElementHandle owner) override {
+            InheritedResourceBase::remove_owner(owner);
         }
 
         const T& get_resource(const ElementBase* owner) const override {
@@ -184,26 +198,26 @@ namespace DirectWidget {
     public:
         void register_owner(const ElementBase* owner) override {
             ResourceBase::register_owner(owner);
-            m_resources[owner] = T();
+            m_resources.insert_or_assign(element_handle(owner), T());
         }
 
-        void remove_owner(const ElementBase* owner) override {
+        void remove_owner(ElementHandle owner) override {
             ResourceBase::remove_owner(owner);
             m_resources.erase(owner);
         }
 
         const T& get_resource(const ElementBase* owner) const override {
-            auto it = m_resources.find(owner);
-            if (it == m_resources.end()) {
-                return T();
+            auto resource = m_resources.find(element_handle(owner));
+            if (resource == nullptr) {
+                return m_empty_resource;
             }
-            return it->second;
+            return *resource;
         }
 
         void update_resource(const ElementBase* owner, const T& value) {
-            auto& resource = m_resources[owner];
+            auto& resource = m_resources[element_handle(owner)];
             if (resource == value) return;
-            m_resources[owner] = value;
+            resource = value;
             ResourceBase::notify_updated(owner);
         }
 
@@ -212,18 +226,19 @@ namespace DirectWidget {
         virtual void discard(const ElementBase* owner, T& resource) {}
 
         bool initialize(const ElementBase* owner) override {
-            auto& resource = m_resources[owner];
+            auto& resource = m_resources[element_handle(owner)];
             return initialize(owner, resource);
         }
 
         void discard(const ElementBase* owner) override {
-            auto& resource = m_resources[owner];
+            auto& resource = m_resources[element_handle(owner)];
             discard(owner, resource);
             resource = T();
         }
 
     private:
-        std::unordered_map<const ElementBase*, T> m_resources;
+        ElementStorage<T> m_resources;
+        const T m_empty_resource{};
     };
 
     template <typename T>
@@ -231,16 +246,20 @@ namespace DirectWidget {
     public:
         void register_owner(const ElementBase* owner) override {
             ResourceBase::register_owner(owner);
-            m_resources[owner] = nullptr;
+            m_resources.insert_or_assign(element_handle(owner), nullptr);
         }
 
-        void remove_owner(const ElementBase* owner) override {
+        void remove_owner(ElementHandle owner) override {
             ResourceBase::remove_owner(owner);
             m_resources.erase(owner);
         }
 
         const std::shared_ptr<T>& get_resource(const ElementBase* owner) const {
-            return m_resources[owner];
+            auto resource = m_resources.find(element_handle(owner));
+            if (resource == nullptr) {
+                return m_empty_resource;
+            }
+            return *resource;
         }
 
     protected:
@@ -248,17 +267,18 @@ namespace DirectWidget {
         virtual void discard(const ElementBase* owner, std::shared_ptr<T>& resource) {}
 
         bool initialize(const ElementBase* owner) override {
-            auto& resource = m_resources[owner];
+            auto& resource = m_resources[element_handle(owner)];
             return initialize(owner, resource);
         }
 
         void discard(const ElementBase* owner) override {
-            auto& resource = m_resources[owner];
+            auto& resource = m_resources[element_handle(owner)];
             discard(owner, resource);
             resource = nullptr;
         }
 
     private:
-        std::unordered_map<const ElementBase*, std::shared_ptr<T>> m_resources;
+        ElementStorage<std::shared_ptr<T>> m_resources;
+        const std::shared_ptr<T> m_empty_resource;
     };
 }
\ No newline at end of file
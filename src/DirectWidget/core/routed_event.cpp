@@ -0,0 +1,36 @@
+// routed_event.cpp: EventRoute implementation
+
+#include <vector>
+
+#include "handle.hpp"
+#include "element_base.hpp"
+#include "routed_event.hpp"
+
+using namespace DirectWidget;
+
+void EventRoute::update(const ElementBase* source, const ElementBase* root)
+{
+    auto& registry = ElementRegistry::instance();
+
+    auto source_handle = element_handle(source);
+    auto root_handle = element_handle(root);
+    if (source_handle == this->source() && root_handle == m_root && m_tree_version == registry.tree_version()) {
+        return;
+    }
+
+    m_elements.clear();
+    m_root = root_handle;
+    m_tree_version = registry.tree_version();
+
+    for (auto element = source; element != nullptr; element = element->parent()) {
+        m_elements.push_back(element->handle());
+        if (element == root) break;
+    }
+}
+
+void EventRoute::clear()
+{
+    m_elements.clear();
+    m_root = NullElementHandle;
+    m_tree_version = ~0ull;
+}
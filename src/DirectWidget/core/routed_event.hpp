@@ -0,0 +1,218 @@
+// routed_event.hpp: Routed event definitions
+// Routed events travel along the ancestor chain of their source, first tunnelling from the root down to the source,
+// then bubbling back up, until a handler marks them handled
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "foundation.hpp"
+#include "dependency.hpp"
+#include "handle.hpp"
+
+namespace DirectWidget {
+
+    class ElementBase;
+
+    enum class RoutePhase {
+        Tunnel,
+        Bubble,
+    };
+
+    class RoutedEventArgs {
+    public:
+        ElementHandle source() const { return m_source; }
+        RoutePhase phase() const { return m_phase; }
+
+        bool handled() const { return m_handled; }
+        void set_handled() { m_handled = true; }
+
+    private:
+        template <typename TArgs>
+        friend class RoutedEvent;
+
+        ElementHandle m_source = NullElementHandle;
+        RoutePhase m_phase = RoutePhase::Tunnel;
+        bool m_handled = false;
+    };
+
+    // Ancestor chain of an event source, source first
+    // The chain is rebuilt only when the source or the element tree changed, so repeated dispatches
+    // to the same element walk no parent pointers.
+
+    class EventRoute {
+    public:
+        // Routes to the ancestors of source up to and including root
+        void update(const ElementBase* source, const ElementBase* root);
+        void clear();
+
+        ElementHandle source() const { return m_elements.empty() ? NullElementHandle : m_elements.front(); }
+        const std::vector<ElementHandle>& elements() const { return m_elements; }
+
+    private:
+        ElementHandle m_root = NullElementHandle;
+        uint64_t m_tree_version = ~0ull;
+        std::vector<ElementHandle> m_elements;
+    };
+
+    class RoutedEventBase : public DependencyBase {
+    public:
+        RoutedEventBase() { set_kind(DependencyKind::RoutedEvent); }
+
+    protected:
+        static uint32_t next_handler_id() {
+            static uint32_t id = 0;
+            return ++id;
+        }
+    };
+
+    template <typename TArgs>
+    class RoutedEvent : public RoutedEventBase {
+    public:
+        using handler_t = std::function<void(ElementBase*, TArgs&)>;
+
+        // Class handlers run before the instance handlers of every element on the route
+        using class_handler_t = void (*)(ElementBase*, TArgs&);
+
+        void set_class_handler(RoutePhase phase, class_handler_t handler) {
+            m_class_handlers[static_cast<size_t>(phase)] = handler;
+        }
+
+        // Returns an id for remove_handler
+        uint32_t add_handler(const ElementBase* owner, RoutePhase phase, handler_t handler) {
+            auto id = next_handler_id();
+            m_handlers[element_handle(owner)].push_back({ id, phase, std::move(handler) });
+            return id;
+        }
+
+        void remove_handler(const ElementBase* owner, uint32_t id) {
+            auto handlers = m_handlers.find(element_handle(owner));
+            if (handlers == nullptr) return;
+
+            for (auto& handler : *handlers) {
+                if (handler.id == id) handler.removed = true;
+            }
+
+            // Handlers run in place, the one removing itself is still running
+            if (m_raise_depth > 0) {
+                m_pending_removals.push_back(element_handle(owner));
+                return;
+            }
+            std::erase_if(*handlers, [](const HANDLER& handler) { return handler.removed; });
+        }
+
+        void remove_owner(ElementHandle owner) override {
+            // A handler may tear down its own element, its handlers are kept until the event was raised
+            if (m_raise_depth > 0) {
+                auto handlers = m_handlers.find(owner);
+                if (handlers != nullptr) {
+                    m_retired_handlers.push_back(std::move(*handlers));
+                }
+            }
+            m_handlers.erase(owner);
+        }
+
+        // Returns true if the event was handled
+        bool raise(const EventRoute& route, TArgs& args) {
+            m_raise_depth++;
+            auto handled = dispatch(route, args);
+            if (--m_raise_depth == 0) {
+                flush_removals();
+            }
+            return handled;
+        }
+
+    private:
+        struct HANDLER {
+            uint32_t id;
+            RoutePhase phase;
+            handler_t handler;
+            // Removed while the event was raised, erased once it is done
+            bool removed = false;
+        };
+
+        // Handlers added while one runs go to the back, a deque keeps the running one in place
+        typedef std::deque<HANDLER> HANDLERS;
+
+        bool dispatch(const EventRoute& route, TArgs& args) const {
+            auto& elements = route.elements();
+            args.m_source = route.source();
+
+            args.m_phase = RoutePhase::Tunnel;
+            for (auto it = elements.rbegin(); it != elements.rend(); it++) {
+                if (invoke(*it, args)) return true;
+            }
+
+            args.m_phase = RoutePhase::Bubble;
+            for (auto it = elements.begin(); it != elements.end(); it++) {
+                if (invoke(*it, args)) return true;
+            }
+
+            return false;
+        }
+
+        bool invoke(ElementHandle handle, TArgs& args) const {
+            // Handlers may destroy elements further along the route
+            auto& registry = ElementRegistry::instance();
+            if (registry.is_alive(handle) == false) return false;
+            auto element = registry.resolve(handle);
+
+            auto class_handler = m_class_handlers[static_cast<size_t>(args.m_phase)];
+            if (class_handler != nullptr) {
+                class_handler(element, args);
+                if (args.handled()) return true;
+                if (registry.is_alive(handle) == false) return false;
+            }
+
+            auto handlers = m_handlers.find(handle);
+            if (handlers == nullptr) return false;
+
+            // Indexed loop, handlers may be added or removed while the event is being raised
+            for (size_t i = 0; i < handlers->size(); i++) {
+                auto& handler = (*handlers)[i];
+                if (handler.phase != args.m_phase || handler.removed) continue;
+
+                handler.handler(element, args);
+                if (args.handled()) return true;
+
+                // The handler may have destroyed its element, its handlers are no longer listed then
+                if (registry.is_alive(handle) == false) return false;
+                handlers = m_handlers.find(handle);
+                if (handlers == nullptr) return false;
+            }
+
+            return false;
+        }
+
+        void flush_removals() {
+            auto& registry = ElementRegistry::instance();
+            for (auto owner : m_pending_removals) {
+                if (registry.is_alive(owner) == false) continue;
+                auto handlers = m_handlers.find(owner);
+                if (handlers == nullptr) continue;
+                std::erase_if(*handlers, [](const HANDLER& handler) { return handler.removed; });
+            }
+            m_pending_removals.clear();
+            m_retired_handlers.clear();
+        }
+
+        class_handler_t m_class_handlers[2] = { nullptr, nullptr };
+        ElementStorage<HANDLERS> m_handlers;
+
+        int m_raise_depth = 0;
+        std::vector<ElementHandle> m_pending_removals;
+        std::vector<HANDLERS> m_retired_handlers;
+    };
+
+    template <typename TArgs>
+    using routed_event_ptr = std::shared_ptr<RoutedEvent<TArgs>>;
+
+    template <typename TArgs>
+    routed_event_ptr<TArgs> make_routed_event() {
+        return std::make_shared<RoutedEvent<TArgs>>();
+    }
+}
@@ -0,0 +1,166 @@
+// snapshot.cpp: Snapshot implementation
+
+#include <chrono>
+#include <cmath>
+#include <format>
+#include <vector>
+
+#include <Windows.h>
+#include <d2d1.h>
+#include <d2d1helper.h>
+#include <wincodec.h>
+
+#include "foundation.hpp"
+#include "app.hpp"
+#include "interop.hpp"
+#include "rasterizer.hpp"
+#include "widget.hpp"
+#include "snapshot.hpp"
+
+using namespace DirectWidget;
+using namespace DirectWidget::Interop;
+
+const LogContext Snapshot::Logger{ NAMEOF(Snapshot) };
+
+UINT Snapshot::pixel_width() const
+{
+    return static_cast<UINT>(std::ceil(m_size.width * m_dpi / USER_DEFAULT_SCREEN_DPI));
+}
+
+UINT Snapshot::pixel_height() const
+{
+    return static_cast<UINT>(std::ceil(m_size.height * m_dpi / USER_DEFAULT_SCREEN_DPI));
+}
+
+HRESULT Snapshot::create_render_target()
+{
+    if (m_render_target != nullptr) return S_OK;
+
+    auto hr = CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&m_wic));
+    Logger.at(NAMEOF(create_render_target)).at(NAMEOF(CoCreateInstance)).log_error(hr);
+    if (FAILED(hr)) return hr;
+
+    hr = m_wic->CreateBitmap(pixel_width(), pixel_height(), GUID_WICPixelFormat32bppPBGRA, WICBitmapCacheOnLoad, &m_bitmap);
+    Logger.at(NAMEOF(create_render_target)).at(NAMEOF(IWICImagingFactory::CreateBitmap)).log_error(hr);
+    if (FAILED(hr)) return hr;
+
+    auto properties = D2D1::RenderTargetProperties(
+        m_software ? D2D1_RENDER_TARGET_TYPE_SOFTWARE : D2D1_RENDER_TARGET_TYPE_DEFAULT,
+        D2D1::PixelFormat(DXGI_FORMAT_B8G8R8A8_UNORM, D2D1_ALPHA_MODE_PREMULTIPLIED),
+        m_dpi, m_dpi);
+
+    auto& d2d = Application::instance()->d2d();
+    hr = d2d->CreateWicBitmapRenderTarget(m_bitmap, properties, &m_render_target);
+    Logger.at(NAMEOF(create_render_target)).at(NAMEOF(ID2D1Factory::CreateWicBitmapRenderTarget)).log_error(hr);
+    return hr;
+}
+
+HRESULT Snapshot::render(const widget_ptr& root)
+{
+    auto hr = create_render_target();
+    if (FAILED(hr)) return hr;
+
+    auto start = m_clock();
+
+    if (root != m_root) {
+        detach();
+        root->attach_render_target(m_render_target, &m_glyph_atlas);
+        root->create_resources();
+        m_root = root;
+
+        // The tree may have been laid out for another size, it is measured for the snapshot
+        root->set_maximum_size(m_size);
+        root->set_constraints(BOUNDS_F{ 0, 0, m_size.width, m_size.height });
+        root->discard_measure();
+    }
+
+    m_render_target->BeginDraw();
+    m_render_target->Clear(D2D1::ColorF(0, 0, 0, 0));
+    hr = m_render_target->EndDraw();
+    Logger.at(NAMEOF(render)).at(NAMEOF(ID2D1RenderTarget::EndDraw)).log_error(hr);
+
+    if (SUCCEEDED(hr)) {
+        root->issue_frame();
+    }
+
+    // The next render starts from a cleared bitmap again, tiled and composited children keep their pixels
+    root->discard_frame();
+
+    auto duration = std::chrono::duration_cast<std::chrono::microseconds>(m_clock() - start);
+    m_render_histogram.record(duration);
+    m_render_time += duration;
+    m_pixels += static_cast<uint64_t>(pixel_width()) * pixel_height();
+
+    return hr;
+}
+
+void Snapshot::detach()
+{
+    if (m_root == nullptr) return;
+
+    // Device resources of the tree belong to this render target, they are created again wherever the tree is shown next
+    m_root->discard_resources();
+    m_root->detach_render_target();
+    m_root->discard_frame();
+    m_root = nullptr;
+}
+
+HRESULT Snapshot::copy_pixels(std::vector<uint8_t>& pixels) const
+{
+    if (m_bitmap == nullptr) return E_NOT_VALID_STATE;
+
+    auto width = pixel_width(), height = pixel_height();
+    pixels.resize(static_cast<size_t>(width) * height * 4);
+
+    WICRect area{ 0, 0, static_cast<INT>(width), static_cast<INT>(height) };
+    com_ptr<IWICBitmapLock> lock;
+    auto hr = m_bitmap->Lock(&area, WICBitmapLockRead, &lock);
+    Logger.at(NAMEOF(copy_pixels)).at(NAMEOF(IWICBitmap::Lock)).log_error(hr);
+    if (FAILED(hr)) return hr;
+
+    UINT stride = 0;
+    hr = lock->GetStride(&stride);
+    Logger.at(NAMEOF(copy_pixels)).at(NAMEOF(IWICBitmapLock::GetStride)).log_error(hr);
+    if (FAILED(hr)) return hr;
+
+    UINT size = 0;
+    BYTE* data = nullptr;
+    hr = lock->GetDataPointer(&size, &data);
+    Logger.at(NAMEOF(copy_pixels)).at(NAMEOF(IWICBitmapLock::GetDataPointer)).log_error(hr);
+    if (FAILED(hr)) return hr;
+
+    // Rows are copied by the widest raster kernels of the processor, dropping the padding of the bitmap
+    RASTER_SURFACE source{ reinterpret_cast<uint32_t*>(data), width, height, stride / 4 };
+    RASTER_SURFACE target{ reinterpret_cast<uint32_t*>(pixels.data()), width, height, width };
+    m_rasterizer.blit(target, source, POINT{ 0, 0 }, RECT{ 0, 0, static_cast<LONG>(width), static_cast<LONG>(height) });
+    return S_OK;
+}
+
+//
+// Statistics
+//
+
+double Snapshot::megapixels_per_second() const
+{
+    if (m_render_time.count() == 0) return 0.0;
+    return static_cast<double>(m_pixels) / m_render_time.count();
+}
+
+void Snapshot::reset_statistics()
+{
+    m_render_histogram.reset();
+    m_pixels = 0;
+    m_render_time = std::chrono::microseconds(0);
+}
+
+void Snapshot::log_report(const LogContext& logger) const
+{
+    if (m_render_histogram.count() == 0) return;
+
+    auto line = std::format(L"Snapshot: {}x{} {} renders={} throughput={:.1f}MP/s p50={}us p95={}us max={}us",
+        pixel_width(), pixel_height(), m_software ? L"software" : L"hardware",
+        m_render_histogram.count(), megapixels_per_second(),
+        m_render_histogram.percentile(50).count(), m_render_histogram.percentile(95).count(),
+        m_render_histogram.maximum().count());
+    logger.log(line.c_str());
+}
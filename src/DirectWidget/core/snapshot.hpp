@@ -0,0 +1,92 @@
+// snapshot.hpp: Snapshot definition
+// Snapshot renders a widget tree into a bitmap without a window, for generating images on servers and checking frames in CI.
+// By default frames are drawn by the software rasterizer of Direct2D, which needs neither a display nor a GPU.
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include <Windows.h>
+#include <d2d1.h>
+#include <wincodec.h>
+
+#include "foundation.hpp"
+#include "glyph_atlas.hpp"
+#include "input_queue.hpp"
+#include "interop.hpp"
+#include "latency.hpp"
+#include "rasterizer.hpp"
+#include "widget.hpp"
+
+namespace DirectWidget {
+
+    class Snapshot {
+    public:
+        using clock_function = input_clock::time_point (*)();
+
+        // size is in device independent pixels, the bitmap has size scaled by dpi in pixels
+        Snapshot(const SIZE_F& size, float dpi = USER_DEFAULT_SCREEN_DPI, bool software = true, clock_function clock = input_clock::now)
+            : m_size(size), m_dpi(dpi), m_software(software), m_clock(clock) {}
+
+        ~Snapshot() { detach(); }
+
+        Snapshot(Snapshot&) = delete;
+        Snapshot(Snapshot&&) = delete;
+
+        // Lays out root at the snapshot size and renders it over a transparent bitmap
+        // Root stays attached until another root is rendered or detach is called, so the tiles and surfaces of the tree
+        // carry over to its next render. Root must not be shown in a window meanwhile.
+        HRESULT render(const widget_ptr& root);
+
+        // Releases the device resources of the last rendered root, it can be shown in a window afterwards
+        void detach();
+
+        // Premultiplied BGRA bitmap of the last render, nullptr before the first one
+        const Interop::com_ptr<IWICBitmap>& bitmap() const { return m_bitmap; }
+
+        UINT pixel_width() const;
+        UINT pixel_height() const;
+
+        // Copies the rows of the bitmap without padding, 4 bytes per pixel, through the raster kernels
+        HRESULT copy_pixels(std::vector<uint8_t>& pixels) const;
+
+        // Glyphs of the text drawn into snapshots, kept between renders
+        GlyphAtlas& glyph_atlas() { return m_glyph_atlas; }
+        const GlyphAtlas& glyph_atlas() const { return m_glyph_atlas; }
+
+        // statistics
+
+        // Duration of renders, layout included
+        const LatencyHistogram& render_histogram() const { return m_render_histogram; }
+
+        // Pixels rendered per second over every render since the last reset
+        double megapixels_per_second() const;
+
+        void reset_statistics();
+
+        void log_report(const LogContext& logger) const;
+
+    private:
+        static const LogContext Logger;
+
+        HRESULT create_render_target();
+
+        SIZE_F m_size;
+        float m_dpi;
+        bool m_software;
+        clock_function m_clock;
+
+        Interop::com_ptr<IWICImagingFactory> m_wic;
+        Interop::com_ptr<IWICBitmap> m_bitmap;
+        Interop::com_ptr<ID2D1RenderTarget> m_render_target;
+        widget_ptr m_root;
+        GlyphAtlas m_glyph_atlas;
+        Rasterizer m_rasterizer;
+
+        LatencyHistogram m_render_histogram;
+        uint64_t m_pixels = 0;
+        std::chrono::microseconds m_render_time{ 0 };
+    };
+}
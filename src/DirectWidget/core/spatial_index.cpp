@@ -0,0 +1,187 @@
+// spatial_index.cpp: SpatialIndex implementation
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <d2d1.h>
+
+#include "foundation.hpp"
+#include "handle.hpp"
+#include "widget.hpp"
+#include "spatial_index.hpp"
+
+using namespace DirectWidget;
+
+void SpatialIndex::rebuild(const WidgetBase* root)
+{
+    clear();
+    m_tree_version = ElementRegistry::instance().tree_version();
+
+    if (root == nullptr) return;
+
+    uint32_t order = 0;
+    assign_order(root, order);
+}
+
+void SpatialIndex::assign_order(const WidgetBase* widget, uint32_t& order)
+{
+    auto handle = widget->handle();
+    auto& entry = m_entries[handle];
+    entry.order = order++;
+
+    if (WidgetBase::RenderBoundsResource->is_valid(widget)) {
+        entry.bounds = widget->hit_bounds();
+        insert(handle, entry);
+    }
+
+    for (auto& child : widget->children()) {
+        assign_order(child.get(), order);
+    }
+}
+
+void SpatialIndex::update(const WidgetBase* widget, const BOUNDS_F& bounds)
+{
+    auto handle = widget->handle();
+    auto entry = m_entries.find(handle);
+
+    // Widgets unknown to the index get their paint order on the next rebuild
+    if (entry == nullptr) return;
+
+    if (entry->indexed) {
+        auto cells = cell_range(bounds);
+        if (entry->large == false &&
+            cells.left == entry->cells.left && cells.top == entry->cells.top &&
+            cells.right == entry->cells.right && cells.bottom == entry->cells.bottom) {
+            entry->bounds = bounds;
+            return;
+        }
+        erase(handle, *entry);
+    }
+
+    entry->bounds = bounds;
+    insert(handle, *entry);
+}
+
+void SpatialIndex::remove(const WidgetBase* widget)
+{
+    auto handle = widget->handle();
+    auto entry = m_entries.find(handle);
+    if (entry == nullptr || entry->indexed == false) return;
+
+    erase(handle, *entry);
+}
+
+void SpatialIndex::clear()
+{
+    m_entries = ElementStorage<ENTRY>();
+    m_cells.clear();
+    m_large_entries.clear();
+    m_tree_version = ~0ull;
+}
+
+WidgetBase* SpatialIndex::hit_test(D2D1_POINT_2F point) const
+{
+    auto& registry = ElementRegistry::instance();
+
+    WidgetBase* result = nullptr;
+    uint32_t result_order = 0;
+
+    auto test = [&](ElementHandle handle) {
+        if (registry.is_alive(handle) == false) return;
+
+        auto entry = m_entries.find(handle);
+        if (entry == nullptr) return;
+        if (result != nullptr && entry->order < result_order) return;
+
+        auto& bounds = entry->bounds;
+        if (point.x < bounds.left || point.x >= bounds.right ||
+            point.y < bounds.top || point.y >= bounds.bottom) return;
+
+        // Indexed bounds contain transformed widgets, the widget tests its exact shape
+        auto widget = static_cast<WidgetBase*>(registry.resolve(handle));
+        if (widget->hit_test(point) == false) return;
+
+        result = widget;
+        result_order = entry->order;
+    };
+
+    auto x = static_cast<int>(std::floor(point.x / m_cell_size));
+    auto y = static_cast<int>(std::floor(point.y / m_cell_size));
+
+    auto cell = m_cells.find(cell_key(x, y));
+    if (cell != m_cells.end()) {
+        for (auto& handle : cell->second) {
+            test(handle);
+        }
+    }
+
+    for (auto& handle : m_large_entries) {
+        test(handle);
+    }
+
+    return result;
+}
+
+void SpatialIndex::insert(ElementHandle widget, ENTRY& entry)
+{
+    auto& bounds = entry.bounds;
+    if (bounds.right <= bounds.left || bounds.bottom <= bounds.top) return;
+
+    entry.indexed = true;
+    entry.cells = cell_range(bounds);
+
+    auto cell_count = (entry.cells.right - entry.cells.left + 1) * (entry.cells.bottom - entry.cells.top + 1);
+    entry.large = cell_count > MaxCellsPerEntry;
+
+    if (entry.large) {
+        m_large_entries.push_back(widget);
+        return;
+    }
+
+    for (auto y = entry.cells.top; y <= entry.cells.bottom; y++) {
+        for (auto x = entry.cells.left; x <= entry.cells.right; x++) {
+            m_cells[cell_key(x, y)].push_back(widget);
+        }
+    }
+}
+
+void SpatialIndex::erase(ElementHandle widget, ENTRY& entry)
+{
+    auto remove_from = [widget](std::vector<ElementHandle>& handles) {
+        auto it = std::find(handles.begin(), handles.end(), widget);
+        if (it == handles.end()) return;
+        *it = handles.back();
+        handles.pop_back();
+    };
+
+    if (entry.large) {
+        remove_from(m_large_entries);
+    }
+    else {
+        for (auto y = entry.cells.top; y <= entry.cells.bottom; y++) {
+            for (auto x = entry.cells.left; x <= entry.cells.right; x++) {
+                auto cell = m_cells.find(cell_key(x, y));
+                if (cell == m_cells.end()) continue;
+
+                remove_from(cell->second);
+                if (cell->second.empty()) {
+                    m_cells.erase(cell);
+                }
+            }
+        }
+    }
+
+    entry.indexed = false;
+    entry.large = false;
+}
+
+SpatialIndex::CELL_RANGE SpatialIndex::cell_range(const BOUNDS_F& bounds) const
+{
+    return {
+        static_cast<int>(std::floor(bounds.left / m_cell_size)),
+        static_cast<int>(std::floor(bounds.top / m_cell_size)),
+        static_cast<int>(std::floor(bounds.right / m_cell_size)),
+        static_cast<int>(std::floor(bounds.bottom / m_cell_size)),
+    };
+}
@@ -0,0 +1,74 @@
+// spatial_index.hpp: SpatialIndex definition
+// SpatialIndex buckets widget render bounds in a uniform grid to answer "topmost widget at point" queries
+
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include <d2d1.h>
+
+#include "foundation.hpp"
+#include "handle.hpp"
+
+namespace DirectWidget {
+
+    class WidgetBase;
+
+    class SpatialIndex {
+    public:
+        static constexpr float DefaultCellSize = 64.0f;
+
+        // Entries covering more cells than this are kept in a separate list scanned by every query
+        static constexpr int MaxCellsPerEntry = 64;
+
+        SpatialIndex() : SpatialIndex(DefaultCellSize) {}
+        SpatialIndex(float cell_size) : m_cell_size(cell_size) {}
+
+        // True when the element tree changed since the last rebuild
+        bool is_stale() const { return m_tree_version != ElementRegistry::instance().tree_version(); }
+
+        // Assigns paint order to the tree under root and indexes every widget that has valid render bounds
+        void rebuild(const WidgetBase* root);
+
+        // Moves widget to its new bounds, keeping its paint order
+        void update(const WidgetBase* widget, const BOUNDS_F& bounds);
+        void remove(const WidgetBase* widget);
+        void clear();
+
+        // Returns the last painted widget whose shape contains the point
+        WidgetBase* hit_test(D2D1_POINT_2F point) const;
+
+    private:
+        typedef struct {
+            int left, top, right, bottom;
+        } CELL_RANGE;
+
+        struct ENTRY {
+            BOUNDS_F bounds{};
+            CELL_RANGE cells{};
+            uint32_t order = 0;
+            bool indexed = false;
+            bool large = false;
+        };
+
+        void assign_order(const WidgetBase* widget, uint32_t& order);
+
+        void insert(ElementHandle widget, ENTRY& entry);
+        void erase(ElementHandle widget, ENTRY& entry);
+
+        CELL_RANGE cell_range(const BOUNDS_F& bounds) const;
+
+        static uint64_t cell_key(int x, int y) {
+            return (static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32) | static_cast<uint32_t>(y);
+        }
+
+        float m_cell_size;
+        uint64_t m_tree_version = ~0ull;
+
+        ElementStorage<ENTRY> m_entries;
+        std::unordered_map<uint64_t, std::vector<ElementHandle>> m_cells;
+        std::vector<ElementHandle> m_large_entries;
+    };
+}
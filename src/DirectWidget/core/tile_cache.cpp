@@ -0,0 +1,179 @@
+// tile_cache.cpp: TileCache implementation
+
+#include <cmath>
+#include <format>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "foundation.hpp"
+#include "handle.hpp"
+#include "interop.hpp"
+#include "tile_cache.hpp"
+
+using namespace DirectWidget;
+using namespace DirectWidget::Interop;
+
+TileCache& TileCache::instance()
+{
+    static TileCache cache;
+    return cache;
+}
+
+size_t TileCache::KeyHash::operator()(const TILE_KEY& key) const
+{
+    auto hash = std::hash<uint64_t>{}((static_cast<uint64_t>(key.widget.index) << 32) | key.widget.generation);
+    hash ^= std::hash<uint64_t>{}((static_cast<uint64_t>(static_cast<uint32_t>(key.x)) << 32) | static_cast<uint32_t>(key.y)) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+    hash ^= std::hash<float>{}(key.scale) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+    return hash;
+}
+
+void TileCache::set_budget(size_t budget)
+{
+    m_budget = budget;
+    evict_to(budget);
+}
+
+com_ptr<ID2D1BitmapRenderTarget> TileCache::find(const TILE_KEY& key)
+{
+    auto entry = m_index.find(key);
+    if (entry == m_index.end()) {
+        m_misses++;
+        return nullptr;
+    }
+
+    auto tile = entry->second;
+    m_hits++;
+    if (tile->prefetched) {
+        tile->prefetched = false;
+        m_prefetch_hits++;
+    }
+
+    m_tiles.splice(m_tiles.begin(), m_tiles, tile);
+    return tile->tile;
+}
+
+void TileCache::insert(const TILE_KEY& key, const com_ptr<ID2D1BitmapRenderTarget>& tile, bool prefetched)
+{
+    auto existing = m_index.find(key);
+    if (existing != m_index.end()) {
+        erase(existing->second);
+    }
+
+    auto pixel_size = tile->GetPixelSize();
+    auto size = static_cast<size_t>(pixel_size.width) * pixel_size.height * 4;
+
+    // Tiles drawn this frame are the most recent ones, a budget smaller than the view evicts them last
+    evict_to(m_budget > size ? m_budget - size : 0);
+
+    auto& widget_tiles = m_widget_tiles[widget_key(key.widget)];
+    m_tiles.push_front({ key, tile, size, prefetched, widget_tiles.size() });
+    m_index.insert_or_assign(key, m_tiles.begin());
+    widget_tiles.push_back(m_tiles.begin());
+    m_size += size;
+
+    if (prefetched) {
+        m_prefetched++;
+    }
+}
+
+void TileCache::invalidate(ElementHandle widget, const BOUNDS_F& bounds)
+{
+    auto entry = m_widget_tiles.find(widget_key(widget));
+    if (entry == m_widget_tiles.end()) return;
+
+    auto left = static_cast<int32_t>(std::floor(bounds.left / TileSize));
+    auto top = static_cast<int32_t>(std::floor(bounds.top / TileSize));
+    auto right = static_cast<int32_t>(std::ceil(bounds.right / TileSize));
+    auto bottom = static_cast<int32_t>(std::ceil(bounds.bottom / TileSize));
+
+    // Erasing a tile moves the last tile of the widget into its place, the last one erased takes the entry with it
+    auto& tiles = entry->second;
+    for (size_t i = 0; i < tiles.size();) {
+        auto& key = tiles[i]->key;
+        if (key.x >= left && key.x < right && key.y >= top && key.y < bottom) {
+            if (tiles.size() == 1) {
+                erase(tiles.front());
+                return;
+            }
+            erase(tiles[i]);
+        }
+        else {
+            i++;
+        }
+    }
+}
+
+void TileCache::invalidate_all(ElementHandle widget)
+{
+    auto entry = m_widget_tiles.find(widget_key(widget));
+    if (entry == m_widget_tiles.end()) return;
+
+    auto tiles = std::move(entry->second);
+    m_widget_tiles.erase(entry);
+    for (auto tile : tiles) {
+        unlink(tile);
+    }
+}
+
+void TileCache::clear()
+{
+    m_tiles.clear();
+    m_index.clear();
+    m_widget_tiles.clear();
+    m_size = 0;
+}
+
+void TileCache::evict_to(size_t budget)
+{
+    while (m_size > budget && m_tiles.empty() == false) {
+        erase(std::prev(m_tiles.end()));
+        m_evictions++;
+    }
+}
+
+void TileCache::erase(tile_list::iterator tile)
+{
+    auto entry = m_widget_tiles.find(widget_key(tile->key.widget));
+    auto& tiles = entry->second;
+    if (tiles.size() == 1) {
+        m_widget_tiles.erase(entry);
+    }
+    else {
+        auto position = tile->widget_position;
+        tiles[position] = tiles.back();
+        tiles[position]->widget_position = position;
+        tiles.pop_back();
+    }
+
+    unlink(tile);
+}
+
+void TileCache::unlink(tile_list::iterator tile)
+{
+    m_size -= tile->size;
+    m_index.erase(tile->key);
+    m_tiles.erase(tile);
+}
+
+//
+// Statistics
+//
+
+void TileCache::reset_statistics()
+{
+    m_hits = 0;
+    m_misses = 0;
+    m_prefetched = 0;
+    m_prefetch_hits = 0;
+    m_evictions = 0;
+}
+
+void TileCache::log_report(const LogContext& logger) const
+{
+    auto draws = m_hits + m_misses;
+    auto hit_rate = draws > 0 ? 100.0 * m_hits / draws : 0.0;
+    auto line = std::format(L"Tiles: count={} size={}KB budget={}KB hits={} misses={} hit_rate={:.1f}% prefetched={} prefetch_hits={} evictions={}",
+        m_tiles.size(), m_size / 1024, m_budget / 1024, m_hits, m_misses, hit_rate, m_prefetched, m_prefetch_hits, m_evictions);
+    logger.log(line.c_str());
+}
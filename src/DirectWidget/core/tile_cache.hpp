@@ -0,0 +1,138 @@
+// tile_cache.hpp: TileCache definition
+// TileCache keeps the rasterized tiles of tiled widgets across frames, so scrolling them only rasterizes tiles coming into view.
+// Tiles are bounded by a memory budget, the least recently drawn ones are evicted first.
+
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+#include <d2d1.h>
+
+#include "foundation.hpp"
+#include "handle.hpp"
+#include "interop.hpp"
+
+namespace DirectWidget {
+
+    typedef struct {
+        ElementHandle widget;
+        // Tile coordinates from the top left corner of the render bounds of the widget
+        int32_t x;
+        int32_t y;
+        // Device pixels per device independent pixel the tile was rasterized at
+        float scale;
+    } TILE_KEY;
+
+    class TileCache {
+    public:
+        // Edge length of a tile in device independent pixels
+        static constexpr float TileSize = 256.0f;
+        static constexpr size_t DefaultBudget = 64 * 1024 * 1024;
+
+        // Tiles around the visible ones rasterized ahead of scrolling, per frame that rasterized no visible tile
+        static constexpr int PrefetchDistance = 1;
+        static constexpr size_t PrefetchPerFrame = 2;
+
+        static TileCache& instance();
+
+        TileCache(size_t budget = DefaultBudget) : m_budget(budget) {}
+
+        TileCache(TileCache&) = delete;
+        TileCache(TileCache&&) = delete;
+
+        // Budget in bytes of tile pixels, lowering it evicts right away
+        size_t budget() const { return m_budget; }
+        void set_budget(size_t budget);
+
+        size_t size() const { return m_size; }
+        size_t tile_count() const { return m_tiles.size(); }
+
+        // Returns the tile and makes it the most recently drawn one, nullptr when it is not cached
+        Interop::com_ptr<ID2D1BitmapRenderTarget> find(const TILE_KEY& key);
+        bool contains(const TILE_KEY& key) const { return m_index.contains(key); }
+
+        void insert(const TILE_KEY& key, const Interop::com_ptr<ID2D1BitmapRenderTarget>& tile, bool prefetched);
+
+        // Drops tiles of widget overlapping bounds, given relative to the top left corner of its render bounds
+        void invalidate(ElementHandle widget, const BOUNDS_F& bounds);
+        void invalidate_all(ElementHandle widget);
+        void clear();
+
+        bool has_tiles(ElementHandle widget) const { return m_widget_tiles.contains(widget_key(widget)); }
+
+        // prefetch
+
+        // Called by the window before painting, tiled widgets request another frame while tiles around their view are missing
+        void begin_frame() { m_prefetch_pending = false; }
+        void request_prefetch() { m_prefetch_pending = true; }
+        bool has_pending_prefetch() const { return m_prefetch_pending; }
+
+        // statistics
+
+        // Draws served from the cache and draws which rasterized their tile
+        uint64_t hit_count() const { return m_hits; }
+        uint64_t miss_count() const { return m_misses; }
+
+        // Tiles rasterized ahead of time, and those drawn at least once before being evicted
+        uint64_t prefetch_count() const { return m_prefetched; }
+        uint64_t prefetch_hit_count() const { return m_prefetch_hits; }
+
+        uint64_t eviction_count() const { return m_evictions; }
+
+        void reset_statistics();
+
+        // Writes hit rate, prefetch use, evictions and memory use
+        void log_report(const LogContext& logger) const;
+
+    private:
+        typedef struct {
+            TILE_KEY key;
+            Interop::com_ptr<ID2D1BitmapRenderTarget> tile;
+            size_t size;
+            // Rasterized ahead of time and not drawn yet
+            bool prefetched;
+            // Position in the tiles of the widget
+            size_t widget_position;
+        } TILE;
+
+        struct KeyHash {
+            size_t operator()(const TILE_KEY& key) const;
+        };
+
+        struct KeyEqual {
+            bool operator()(const TILE_KEY& a, const TILE_KEY& b) const {
+                return a.widget == b.widget && a.x == b.x && a.y == b.y && a.scale == b.scale;
+            }
+        };
+
+        using tile_list = std::list<TILE>;
+
+        // Tiles of released widgets stay until they are evicted, so tiles are grouped by handle rather than in ElementStorage
+        static uint64_t widget_key(ElementHandle widget) {
+            return (static_cast<uint64_t>(widget.index) << 32) | widget.generation;
+        }
+
+        void evict_to(size_t budget);
+        void erase(tile_list::iterator tile);
+        void unlink(tile_list::iterator tile);
+
+        size_t m_budget;
+        size_t m_size = 0;
+
+        // Most recently drawn first
+        tile_list m_tiles;
+        std::unordered_map<TILE_KEY, tile_list::iterator, KeyHash, KeyEqual> m_index;
+        std::unordered_map<uint64_t, std::vector<tile_list::iterator>> m_widget_tiles;
+
+        bool m_prefetch_pending = false;
+
+        uint64_t m_hits = 0;
+        uint64_t m_misses = 0;
+        uint64_t m_prefetched = 0;
+        uint64_t m_prefetch_hits = 0;
+        uint64_t m_evictions = 0;
+    };
+}
@@ -1,7 +1,9 @@
 // base_widget.cpp: BaseWidget implementation
 
+#include <algorithm>
+#include <cmath>
 #include <memory>
-#include <unordered_map>
+#include <vector>
 
 #include <Windows.h>
 #include <d2d1.h>
@@ -14,9 +16,12 @@
 #include "window.hpp"
 #include "widget.hpp"
 #include "dependency.hpp"
+#include "handle.hpp"
 #include "property.hpp"
 #include "resource.hpp"
 #include "interop.hpp"
+#include "layout_scheduler.hpp"
+#include "tile_cache.hpp"
 
 using namespace DirectWidget;
 using namespace DirectWidget::Interop;
@@ -24,9 +29,43 @@ using namespace DirectWidget::Interop;
 const LogContext WidgetBase::Logger{ NAMEOF(WidgetBase) };
 const LogContext RenderContext::Logger{ NAMEOF(RenderContext) };
 
+// Bounding box of bounds mapped by transform
+static BOUNDS_F transform_bounds(const D2D1::Matrix3x2F& transform, const BOUNDS_F& bounds)
+{
+    if (transform.IsIdentity()) return bounds;
+
+    D2D1_POINT_2F corners[] = {
+        transform.TransformPoint(D2D1::Point2F(bounds.left, bounds.top)),
+        transform.TransformPoint(D2D1::Point2F(bounds.right, bounds.top)),
+        transform.TransformPoint(D2D1::Point2F(bounds.left, bounds.bottom)),
+        transform.TransformPoint(D2D1::Point2F(bounds.right, bounds.bottom)),
+    };
+
+    BOUNDS_F result{ corners[0].x, corners[0].y, corners[0].x, corners[0].y };
+    for (auto& corner : corners) {
+        result.left = (std::min)(result.left, corner.x);
+        result.top = (std::min)(result.top, corner.y);
+        result.right = (std::max)(result.right, corner.x);
+        result.bottom = (std::max)(result.bottom, corner.y);
+    }
+    return result;
+}
+
+static bool intersects(const BOUNDS_F& a, const BOUNDS_F& b)
+{
+    return a.left < b.right && b.left < a.right && a.top < b.bottom && b.top < a.bottom;
+}
+
 class WidgetBase::WidgetMeasureResource : public BasicTypeResource<SIZE_F> {
 protected:
     bool initialize(const ElementBase* owner, SIZE_F& resource) override {
+        // Out of budget the widget stays invalid, its parent measures with the previous size until the scheduler resumes it
+        auto scheduler = LayoutScheduler::current();
+        if (scheduler != nullptr && scheduler->should_yield()) {
+            scheduler->defer_measure(static_cast<const WidgetBase*>(owner), resource);
+            return false;
+        }
+
         SIZE_F available_size{ WidgetBase::MaxSizeProperty->get_value(owner) };
 
         auto& size = WidgetBase::SizeProperty->get_value(owner);
@@ -51,6 +90,9 @@ protected:
         resource.height = content_size.height + margin_height;
         return true;
     }
+
+    // The previous size is kept until the widget is measured again, so deferred measures have a size to stand in
+    void discard(const ElementBase* owner) override {}
 };
 
 class WidgetBase::WidgetRenderBoundsResource : public BasicTypeResource<BOUNDS_F> {
@@ -62,6 +104,134 @@ protected:
     }
 };
 
+class WidgetBase::WidgetWorldTransformResource : public BasicTypeResource<D2D1_MATRIX_3X2_F> {
+protected:
+    bool initialize(const ElementBase* owner, D2D1_MATRIX_3X2_F& resource) override {
+        auto widget = static_cast<const WidgetBase*>(owner);
+        auto parent = widget->parent_widget();
+        auto world = parent != nullptr
+            ? *D2D1::Matrix3x2F::ReinterpretBaseType(&WorldTransformResource->get_or_initialize_resource(parent))
+            : D2D1::Matrix3x2F::Identity();
+
+        // Most widgets are not transformed and share the matrix of their parent
+        auto& transform = *D2D1::Matrix3x2F::ReinterpretBaseType(&RenderTransformProperty->get_value(owner));
+        if (transform.IsIdentity()) {
+            resource = world;
+            return true;
+        }
+
+        auto& render_bounds = RenderBoundsResource->get_or_initialize_resource(owner);
+        auto& origin = RenderTransformOriginProperty->get_value(owner);
+        auto origin_x = render_bounds.left + (render_bounds.right - render_bounds.left) * origin.x;
+        auto origin_y = render_bounds.top + (render_bounds.bottom - render_bounds.top) * origin.y;
+
+        resource = D2D1::Matrix3x2F::Translation(-origin_x, -origin_y) * transform * D2D1::Matrix3x2F::Translation(origin_x, origin_y) * world;
+        return true;
+    }
+};
+
+class WidgetBase::WidgetOpacityLayerResource : public Interop::ComResource<ID2D1Layer> {
+protected:
+    HRESULT initialize(const ElementBase* owner, com_ptr<ID2D1Layer>& resource) override {
+        // Layers grow to the largest content pushed into them, one is kept per widget for the frames it fades
+        auto& render_target = static_cast<const WidgetBase*>(owner)->render_target();
+        auto hr = render_target->CreateLayer(&resource);
+        Logger.at(NAMEOF(OpacityLayerResource)).at(NAMEOF(ID2D1RenderTarget::CreateLayer)).log_error(hr);
+        return hr;
+    }
+};
+
+class WidgetBase::WidgetSurfaceResource : public Interop::ComResource<ID2D1BitmapRenderTarget> {
+protected:
+    HRESULT initialize(const ElementBase* owner, com_ptr<ID2D1BitmapRenderTarget>& resource) override {
+        // Surfaces share the resource domain of the window target, brushes of the widgets are drawn into them as they are
+        auto& render_bounds = RenderBoundsResource->get_or_initialize_resource(owner);
+        auto size = D2D1::SizeF(render_bounds.right - render_bounds.left, render_bounds.bottom - render_bounds.top);
+        auto& render_target = static_cast<const WidgetBase*>(owner)->render_target();
+        auto hr = render_target->CreateCompatibleRenderTarget(size, &resource);
+        Logger.at(NAMEOF(SurfaceResource)).at(NAMEOF(ID2D1RenderTarget::CreateCompatibleRenderTarget)).log_error(hr);
+        if (FAILED(hr)) return hr;
+
+        resource->BeginDraw();
+        resource->Clear(D2D1::ColorF(0, 0, 0, 0));
+        return resource->EndDraw();
+    }
+};
+
+static void discard_frames(const WidgetBase* widget)
+{
+    WidgetBase::RenderContentResource->invalidate_for(widget);
+    for (auto& child : widget->children()) {
+        discard_frames(child.get());
+    }
+}
+
+class WidgetBase::WidgetTransformListener : public DependencyListenerBase {
+public:
+    void on_dependency_updated(const ElementBase* owner, const NotificationArgument& arg) override {
+        auto widget = static_cast<const WidgetBase*>(owner);
+        if (arg.dependency() != CompositedProperty.get() && arg.dependency() != TiledProperty.get()) {
+            widget->discard_transform();
+            return;
+        }
+
+        // The subtree moves to or from a surface or tiles, it is painted again where it is drawn now
+        SurfaceResource->invalidate_for(widget);
+        TileCache::instance().invalidate_all(element_handle(widget));
+        discard_frames(widget);
+
+        auto parent = widget->parent_widget();
+        if (parent != nullptr) {
+            parent->discard_frame();
+        }
+    }
+};
+
+// Drops the tiles a frame invalidated in a tiled subtree was painted into
+class WidgetBase::WidgetTileListener : public DependencyListenerBase {
+public:
+    void on_dependency_updated(const ElementBase* owner, const NotificationArgument& arg) override {
+        if (arg.notification_type() != NotificationType::Invalidated) return;
+
+        auto& cache = TileCache::instance();
+        if (cache.tile_count() == 0) return;
+
+        auto widget = static_cast<const WidgetBase*>(owner);
+        auto tiled = widget;
+        while (tiled != nullptr && tiled->is_tiled() == false) {
+            tiled = tiled->parent_widget();
+        }
+        if (tiled == nullptr) return;
+
+        // Frames invalidated with their layout have no bounds left to tell the tiles apart
+        auto handle = element_handle(tiled);
+        if (tiled == widget || is_placed(widget) == false || is_placed(tiled) == false) {
+            cache.invalidate_all(handle);
+            return;
+        }
+
+        auto tiled_world = *D2D1::Matrix3x2F::ReinterpretBaseType(&WorldTransformResource->get_resource(tiled));
+        if (tiled_world.Invert() == false) {
+            cache.invalidate_all(handle);
+            return;
+        }
+
+        auto& world = *D2D1::Matrix3x2F::ReinterpretBaseType(&WorldTransformResource->get_resource(widget));
+        auto& tiled_bounds = RenderBoundsResource->get_resource(tiled);
+        auto bounds = transform_bounds(tiled_world, transform_bounds(world, RenderBoundsResource->get_resource(widget)));
+        cache.invalidate(handle, BOUNDS_F{
+            bounds.left - tiled_bounds.left,
+            bounds.top - tiled_bounds.top,
+            bounds.right - tiled_bounds.left,
+            bounds.bottom - tiled_bounds.top });
+    }
+
+private:
+    static bool is_placed(const WidgetBase* widget) {
+        return RenderBoundsResource->is_valid(widget) && WorldTransformResource->is_valid(widget);
+    }
+};
+
 class WidgetBase::WidgetRenderGeometryResource : public Interop::ComResource<ID2D1Geometry> {
 protected:
     HRESULT initialize(const ElementBase* owner, com_ptr<ID2D1Geometry>& resource) {
@@ -79,58 +249,114 @@ class WidgetBase::WidgetLayoutResource : public Resource<LayoutContext> {
 public:
     void register_owner(const ElementBase* owner) override {
         ResourceBase::register_owner(owner);
-        m_resources[owner] = LayoutContext({ 0,0 }, { 0,0,0,0 }, { 0,0,0,0 });
+        m_resources.insert_or_assign(element_handle(owner), LayoutContext({ 0,0 }, { 0,0,0,0 }, { 0,0,0,0 }));
     }
 
-    void remove_owner(const ElementBase* owner) override {
+    void remove_owner(ElementHandle owner) override {
         ResourceBase::remove_owner(owner);
         m_resources.erase(owner);
+        m_deferred.erase(owner);
     }
 
     const LayoutContext& get_resource(const ElementBase* owner) const {
-        auto it = m_resources.find(owner);
-        if (it != m_resources.end()) {
-            return it->second;
+        auto resource = m_resources.find(element_handle(owner));
+        if (resource != nullptr) {
+            return *resource;
         }
-        return LayoutContext({ 0,0 }, { 0,0,0,0 }, { 0,0,0,0 });
+        return m_empty_resource;
     }
 
     bool initialize(const ElementBase* owner) override {
         if (is_valid(owner) == true) return true;
+        if (defer(owner, nullptr)) return false;
+
+        // Background and pixel scale were given by the parent, a subtree laid out on its own keeps them
+        auto& resource = m_resources[element_handle(owner)];
+        auto deferred = m_deferred.find(element_handle(owner));
+        auto& given = deferred != nullptr ? *deferred : resource;
+        auto background = given.background();
+        auto pixel_scale = given.pixel_scale();
 
-        auto& resource = m_resources[owner];
+        auto& measure = WidgetBase::MeasureResource->get_or_initialize_resource(owner);
         resource = LayoutContext(
-            WidgetBase::MeasureResource->get_or_initialize_resource(owner),
+            measure,
             WidgetBase::ConstraintsProperty->get_value(owner),
             WidgetBase::MarginProperty->get_value(owner),
-            resource.background_widget());
-        static_cast<const WidgetBase*>(owner)->layout(resource);
+            background,
+            pixel_scale);
+        layout(owner, resource);
         return true;
     }
 
     void initialize_with_context(const ElementBase* owner, const LayoutContext& context)
     {
         if (is_valid(owner) == true) return;
+        if (defer(owner, &context)) return;
 
-        auto& resource = m_resources[owner];
+        auto& resource = m_resources[element_handle(owner)];
         resource = context;
-        static_cast<const WidgetBase*>(owner)->layout(resource);
+        layout(owner, resource);
+    }
+
+    void set_pixel_scale(const ElementBase* owner, float scale)
+    {
+        m_resources[element_handle(owner)].set_pixel_scale(scale);
     }
 
     void discard(const ElementBase* owner) override {}
 
 private:
-    std::unordered_map<const ElementBase*, LayoutContext> m_resources;
+    // Out of budget the previous arrangement stays in place, the context given by the parent is kept for the scheduler to resume with
+    bool defer(const ElementBase* owner, const LayoutContext* context)
+    {
+        auto scheduler = LayoutScheduler::current();
+        if (scheduler == nullptr || scheduler->should_yield() == false) return false;
+
+        auto handle = element_handle(owner);
+        if (context != nullptr) {
+            m_deferred.insert_or_assign(handle, *context);
+        }
+        else if (m_deferred.contains(handle) == false) {
+            m_deferred.insert_or_assign(handle, m_resources[handle]);
+        }
+
+        scheduler->defer_layout(static_cast<const WidgetBase*>(owner));
+        return true;
+    }
+
+    void layout(const ElementBase* owner, LayoutContext& resource)
+    {
+        // Frames painted while the layout was deferred used the previous render bounds
+        auto handle = element_handle(owner);
+        if (m_deferred.contains(handle)) {
+            m_deferred.erase(handle);
+            WidgetBase::RenderBoundsResource->invalidate_for(owner);
+            WidgetBase::WorldTransformResource->invalidate_for(owner);
+            WidgetBase::RenderGeometryResource->invalidate_for(owner);
+            WidgetBase::RenderContentResource->invalidate_for(owner);
+        }
+
+        static_cast<const WidgetBase*>(owner)->layout(resource);
+    }
+
+    ElementStorage<LayoutContext> m_resources;
+    ElementStorage<LayoutContext> m_deferred;
+    const LayoutContext m_empty_resource;
 };
 
 class WidgetBase::WidgetRenderContentResource : public ResourceBase {
 public:
     bool initialize(const ElementBase* owner) override {
+        auto widget = static_cast<const WidgetBase*>(owner);
+        auto opacity = widget->opacity();
         RenderContext context{
-            static_cast<const WidgetBase*>(owner)->render_target(),
-            WidgetBase::RenderBoundsResource->get_or_initialize_resource(owner)
+            widget->render_target(),
+            WidgetBase::RenderBoundsResource->get_or_initialize_resource(owner),
+            WidgetBase::WorldTransformResource->get_or_initialize_resource(owner),
+            opacity,
+            opacity_layer(widget, opacity)
         };
-        initialize_with_context(owner, context);
+        initialize_with_context(owner, context, false);
 
         // TODO:
         // if (hr == D2DERR_RECREATE_TARGET)
@@ -138,7 +364,8 @@ public:
         return true;
     }
 
-    void initialize_with_context(const ElementBase* owner, const RenderContext& render_context) {
+    // covered is set inside surfaces when an ancestor painted over the frame the widget left in the surface
+    void initialize_with_context(const ElementBase* owner, const RenderContext& render_context, bool covered) {
         auto& render_bounds = render_context.render_bounds();
         if (render_bounds.right - render_bounds.left <= 0 ||
             render_bounds.bottom - render_bounds.top <= 0)
@@ -146,39 +373,342 @@ public:
 
         auto widget = static_cast<const WidgetBase*>(owner);
 
-        if (is_valid(owner) == false) {
-            auto& background_widget = m_background_widgets[owner];
+        auto painted = covered || is_valid(owner) == false;
+        if (painted) {
+            auto background_widget = find_background_widget(owner);
             if (background_widget != nullptr) {
-                auto background_context = render_context.create_subcontext(WidgetBase::RenderBoundsResource->get_or_initialize_resource(background_widget.get()));
-                initialize_with_context(background_widget.get(), background_context);
+                auto background_context = render_context.create_subcontext(
+                    WidgetBase::RenderBoundsResource->get_or_initialize_resource(background_widget),
+                    target_transform(background_widget),
+                    render_context.opacity(),
+                    nullptr);
+                initialize_with_context(background_widget, background_context, false);
             }
 
+            // Pixels of the last frame survive only in surfaces, and only when nothing was painted over them
+            render_context.set_retains_frame(m_retain && covered == false && background_widget == nullptr);
             widget->render(render_context);
+            render_context.set_retains_frame(false);
+
             auto hr = render_context.render_target()->Flush();
             Logger.at(NAMEOF(WidgetBase::RenderContentResource::initialize_with_context)).at(NAMEOF(ID2D1RenderTarget::Flush)).log_error(hr);
 
-            m_background_widgets[owner] = WidgetBase::LayoutResource->get_resource(owner).background_widget();
+            m_background_widgets[element_handle(owner)] = WidgetBase::LayoutResource->get_resource(owner).background();
 
             if (Application::instance()->is_debug()) {
                 static_cast<const WidgetBase*>(owner)->render_debug_layout(render_context.render_target());
             }
+
+            // The window is painted in full every frame, frames in surfaces are kept until they are invalidated.
+            // Tiles are painted in full as well, widgets spanning several tiles are painted into each of them.
+            if (m_retain) {
+                mark_valid(owner);
+            }
+            m_painted++;
         }
 
-        widget->for_each_child([this, &render_context](WidgetBase* child) {
-            auto child_render_context = render_context.create_subcontext(WidgetBase::RenderBoundsResource->get_or_initialize_resource(child));
-            initialize_with_context(child, child_render_context);
+        auto covers_children = painted && m_surface_transform != nullptr;
+        widget->for_each_child([this, &render_context, covers_children](WidgetBase* child) {
+            // Invisible subtrees are skipped, their frames are painted once they fade in
+            auto opacity = render_context.opacity() * child->opacity();
+            if (opacity <= 0) return;
+
+            // Tiles are kept for the window only, tiled widgets in a surface and composited widgets in a tile are painted in place
+            if (child->is_tiled() && m_surface_transform == nullptr) {
+                render_tiles(child, render_context, opacity);
+                return;
+            }
+
+            if (child->is_composited() && m_cull_bounds == nullptr) {
+                composite(child, render_context, opacity, covers_children);
+                return;
+            }
+
+            if (m_cull_bounds != nullptr && intersects(child->hit_bounds(), *m_cull_bounds) == false) return;
+
+            auto child_render_context = render_context.create_subcontext(
+                WidgetBase::RenderBoundsResource->get_or_initialize_resource(child),
+                target_transform(child),
+                opacity,
+                opacity_layer(child, opacity));
+            initialize_with_context(child, child_render_context, covers_children);
             });
     }
 
+    void remove_owner(ElementHandle owner) override {
+        ResourceBase::remove_owner(owner);
+        m_background_widgets.erase(owner);
+        m_surface_sizes.erase(owner);
+    }
+
     void discard(const ElementBase* owner) override {
-        auto& background_widget = m_background_widgets[owner];
+        auto background_widget = find_background_widget(owner);
         if (background_widget != nullptr) {
             background_widget->discard_frame();
         }
     }
 
 private:
-    std::unordered_map<const ElementBase*, widget_ptr> m_background_widgets;
+    // Composited widgets paint their subtree into their surface, which is then drawn like a bitmap
+    // with the transform and opacity of the widget. Only frames invalidated since the last paint are painted into the surface.
+    void composite(const WidgetBase* widget, const RenderContext& render_context, float opacity, bool covered) {
+        auto render_bounds = WidgetBase::RenderBoundsResource->get_or_initialize_resource(widget);
+        auto size = SIZE_F{ render_bounds.right - render_bounds.left, render_bounds.bottom - render_bounds.top };
+        if (size.width <= 0 || size.height <= 0) return;
+
+        auto surface = surface_for(widget, size);
+        if (surface == nullptr) return;
+
+        // Surfaces hold the subtree as laid out, before the world transform of the widget
+        auto world = *D2D1::Matrix3x2F::ReinterpretBaseType(&WidgetBase::WorldTransformResource->get_or_initialize_resource(widget));
+        auto surface_transform = world;
+        if (surface_transform.Invert() == false) return;
+        surface_transform = surface_transform * D2D1::Matrix3x2F::Translation(-render_bounds.left, -render_bounds.top);
+
+        auto target = target_transform(widget);
+        auto painted = m_painted;
+        auto previous_surface_transform = m_surface_transform;
+        auto previous_retain = m_retain;
+        m_surface_transform = &surface_transform;
+        m_retain = true;
+        {
+            RenderContext surface_context{
+                com_ptr<ID2D1RenderTarget>(surface),
+                render_bounds,
+                D2D1::Matrix3x2F::Translation(-render_bounds.left, -render_bounds.top),
+                1.0f,
+                nullptr
+            };
+            initialize_with_context(widget, surface_context, false);
+        }
+        m_surface_transform = previous_surface_transform;
+        m_retain = previous_retain;
+
+        // Surfaces nested in a surface are drawn again only when either of them changed
+        if (m_surface_transform != nullptr && covered == false && m_painted == painted) return;
+        m_painted++;
+
+        com_ptr<ID2D1Bitmap> bitmap;
+        auto hr = surface->GetBitmap(&bitmap);
+        Logger.at(NAMEOF(WidgetBase::RenderContentResource::composite)).at(NAMEOF(ID2D1BitmapRenderTarget::GetBitmap)).log_error(hr);
+        if (FAILED(hr)) return;
+
+        auto& render_target = render_context.render_target();
+        render_target->SetTransform(target);
+        render_target->DrawBitmap(bitmap, Interop::to_d2d(render_bounds), opacity, D2D1_BITMAP_INTERPOLATION_MODE_LINEAR);
+        render_target->SetTransform(render_context.transform());
+    }
+
+    const com_ptr<ID2D1BitmapRenderTarget>& surface_for(const WidgetBase* widget, const SIZE_F& size) {
+        auto& surface_resource = WidgetBase::SurfaceResource;
+        auto handle = element_handle(widget);
+
+        auto surface_size = m_surface_sizes.find(handle);
+        if (surface_resource->is_valid(widget) &&
+            (surface_size == nullptr || surface_size->width != size.width || surface_size->height != size.height)) {
+            surface_resource->invalidate_for(widget);
+        }
+
+        if (surface_resource->is_valid(widget) == false) {
+            // New surfaces are blank, the subtree is painted into it in full
+            surface_resource->initialize_for(widget);
+            m_surface_sizes.insert_or_assign(handle, size);
+            discard_frames(widget);
+        }
+        return surface_resource->get_resource(widget);
+    }
+
+    // Tiled widgets draw the cached tiles inside the clip of their parent and rasterize the missing ones.
+    // Frames without a missing tile rasterize a few tiles around the view, so scrolling finds them ready.
+    void render_tiles(const WidgetBase* widget, const RenderContext& render_context, float opacity) {
+        auto render_bounds = WidgetBase::RenderBoundsResource->get_or_initialize_resource(widget);
+        if (render_bounds.right - render_bounds.left <= 0 || render_bounds.bottom - render_bounds.top <= 0) return;
+
+        auto world = *D2D1::Matrix3x2F::ReinterpretBaseType(&WidgetBase::WorldTransformResource->get_or_initialize_resource(widget));
+        auto inverse = world;
+        if (inverse.Invert() == false) return;
+
+        // Visible part of the render bounds, the clip of the parent mapped back through the world transform
+        auto clip = transform_bounds(*D2D1::Matrix3x2F::ReinterpretBaseType(&render_context.transform()), render_context.render_bounds());
+        auto visible = transform_bounds(inverse, clip);
+        visible.left = (std::max)(visible.left, render_bounds.left);
+        visible.top = (std::max)(visible.top, render_bounds.top);
+        visible.right = (std::min)(visible.right, render_bounds.right);
+        visible.bottom = (std::min)(visible.bottom, render_bounds.bottom);
+        if (visible.right <= visible.left || visible.bottom <= visible.top) return;
+
+        FLOAT dpi_x, dpi_y;
+        render_context.render_target()->GetDpi(&dpi_x, &dpi_y);
+        auto scale = dpi_x / USER_DEFAULT_SCREEN_DPI;
+
+        auto tile_size = TileCache::TileSize;
+        auto first_x = static_cast<int32_t>(std::floor((visible.left - render_bounds.left) / tile_size));
+        auto first_y = static_cast<int32_t>(std::floor((visible.top - render_bounds.top) / tile_size));
+        auto last_x = static_cast<int32_t>(std::ceil((visible.right - render_bounds.left) / tile_size)) - 1;
+        auto last_y = static_cast<int32_t>(std::ceil((visible.bottom - render_bounds.top) / tile_size)) - 1;
+
+        auto& cache = TileCache::instance();
+        auto handle = element_handle(widget);
+        auto& render_target = render_context.render_target();
+        auto rasterized = false;
+
+        render_target->SetTransform(world);
+        for (auto y = first_y; y <= last_y; y++) {
+            for (auto x = first_x; x <= last_x; x++) {
+                TILE_KEY key{ handle, x, y, scale };
+                auto tile = cache.find(key);
+                if (tile == nullptr) {
+                    tile = rasterize_tile(widget, key, world, inverse, render_bounds);
+                    if (tile == nullptr) continue;
+                    cache.insert(key, tile, false);
+                    rasterized = true;
+                }
+
+                com_ptr<ID2D1Bitmap> bitmap;
+                auto hr = tile->GetBitmap(&bitmap);
+                Logger.at(NAMEOF(WidgetBase::RenderContentResource::render_tiles)).at(NAMEOF(ID2D1BitmapRenderTarget::GetBitmap)).log_error(hr);
+                if (FAILED(hr)) continue;
+
+                render_target->DrawBitmap(bitmap, Interop::to_d2d(tile_bounds(render_bounds, x, y)), opacity, D2D1_BITMAP_INTERPOLATION_MODE_LINEAR);
+            }
+        }
+        render_target->SetTransform(render_context.transform());
+
+        auto column_count = static_cast<int32_t>(std::ceil((render_bounds.right - render_bounds.left) / tile_size));
+        auto row_count = static_cast<int32_t>(std::ceil((render_bounds.bottom - render_bounds.top) / tile_size));
+        auto prefetch_first_x = (std::max)(first_x - TileCache::PrefetchDistance, 0);
+        auto prefetch_first_y = (std::max)(first_y - TileCache::PrefetchDistance, 0);
+        auto prefetch_last_x = (std::min)(last_x + TileCache::PrefetchDistance, column_count - 1);
+        auto prefetch_last_y = (std::min)(last_y + TileCache::PrefetchDistance, row_count - 1);
+
+        size_t prefetched = 0;
+        for (auto y = prefetch_first_y; y <= prefetch_last_y; y++) {
+            for (auto x = prefetch_first_x; x <= prefetch_last_x; x++) {
+                TILE_KEY key{ handle, x, y, scale };
+                if (cache.contains(key)) continue;
+
+                // Frames busy with visible tiles leave the rest for the next one
+                if (rasterized || prefetched == TileCache::PrefetchPerFrame) {
+                    cache.request_prefetch();
+                    return;
+                }
+
+                auto tile = rasterize_tile(widget, key, world, inverse, render_bounds);
+                if (tile == nullptr) continue;
+                cache.insert(key, tile, true);
+                prefetched++;
+            }
+        }
+    }
+
+    com_ptr<ID2D1BitmapRenderTarget> rasterize_tile(const WidgetBase* widget, const TILE_KEY& key,
+        const D2D1::Matrix3x2F& world, const D2D1::Matrix3x2F& inverse, const BOUNDS_F& render_bounds) {
+        auto tile_size = TileCache::TileSize;
+
+        com_ptr<ID2D1BitmapRenderTarget> tile;
+        auto hr = widget->render_target()->CreateCompatibleRenderTarget(D2D1::SizeF(tile_size, tile_size), &tile);
+        Logger.at(NAMEOF(WidgetBase::RenderContentResource::rasterize_tile)).at(NAMEOF(ID2D1RenderTarget::CreateCompatibleRenderTarget)).log_error(hr);
+        if (FAILED(hr)) return nullptr;
+
+        tile->BeginDraw();
+        tile->Clear(D2D1::ColorF(0, 0, 0, 0));
+        hr = tile->EndDraw();
+        if (FAILED(hr)) return nullptr;
+
+        // Tiles hold the subtree before the world transform of the widget, widgets outside of the tile are skipped
+        auto bounds = tile_bounds(render_bounds, key.x, key.y);
+        auto tile_transform = inverse * D2D1::Matrix3x2F::Translation(-bounds.left, -bounds.top);
+        auto cull_bounds = transform_bounds(world, bounds);
+
+        auto previous_surface_transform = m_surface_transform;
+        auto previous_cull_bounds = m_cull_bounds;
+        auto previous_retain = m_retain;
+        m_surface_transform = &tile_transform;
+        m_cull_bounds = &cull_bounds;
+        m_retain = false;
+        {
+            RenderContext tile_context{
+                com_ptr<ID2D1RenderTarget>(tile),
+                render_bounds,
+                D2D1::Matrix3x2F::Translation(-bounds.left, -bounds.top),
+                1.0f,
+                nullptr
+            };
+            initialize_with_context(widget, tile_context, true);
+        }
+        m_surface_transform = previous_surface_transform;
+        m_cull_bounds = previous_cull_bounds;
+        m_retain = previous_retain;
+
+        return tile;
+    }
+
+    static BOUNDS_F tile_bounds(const BOUNDS_F& render_bounds, int32_t x, int32_t y) {
+        auto tile_size = TileCache::TileSize;
+        auto left = render_bounds.left + x * tile_size;
+        auto top = render_bounds.top + y * tile_size;
+        return BOUNDS_F{ left, top, left + tile_size, top + tile_size };
+    }
+
+    // World transform of widget followed by the mapping into the surface being painted, if any
+    D2D1_MATRIX_3X2_F target_transform(const WidgetBase* widget) const {
+        auto& world = *D2D1::Matrix3x2F::ReinterpretBaseType(&WidgetBase::WorldTransformResource->get_or_initialize_resource(widget));
+        if (m_surface_transform == nullptr) return world;
+        return world * *m_surface_transform;
+    }
+
+    // Translucent widgets draw into a layer only when parts of their subtree overlap,
+    // otherwise every part fades through the opacity of its brushes.
+    ID2D1Layer* opacity_layer(const WidgetBase* widget, float opacity) {
+        if (opacity >= 1 || overlaps(widget) == false) return nullptr;
+        return WidgetBase::OpacityLayerResource->get_or_initialize_resource(widget);
+    }
+
+    bool overlaps(const WidgetBase* widget) {
+        auto& bounds = m_child_bounds;
+        bounds.clear();
+        widget->for_each_child([&bounds](WidgetBase* child) {
+            auto child_bounds = child->hit_bounds();
+            if (child_bounds.right <= child_bounds.left || child_bounds.bottom <= child_bounds.top) return;
+            bounds.push_back(child_bounds);
+            });
+
+        if (bounds.empty()) return false;
+        if (widget->paints_under_children()) return true;
+
+        // Sweep along x, only children starting before the current one ends can overlap it
+        std::sort(bounds.begin(), bounds.end(), [](const BOUNDS_F& a, const BOUNDS_F& b) { return a.left < b.left; });
+        for (size_t i = 0; i < bounds.size(); i++) {
+            for (size_t j = i + 1; j < bounds.size() && bounds[j].left < bounds[i].right; j++) {
+                if (bounds[j].top < bounds[i].bottom && bounds[i].top < bounds[j].bottom) return true;
+            }
+        }
+        return false;
+    }
+
+    WidgetBase* find_background_widget(const ElementBase* owner) const {
+        auto background = m_background_widgets.find(element_handle(owner));
+        if (background == nullptr) return nullptr;
+
+        auto& registry = ElementRegistry::instance();
+        if (registry.is_alive(*background) == false) return nullptr;
+        return static_cast<WidgetBase*>(registry.resolve(*background));
+    }
+
+    ElementStorage<ElementHandle> m_background_widgets;
+    // Reused by the overlap test of every translucent widget
+    std::vector<BOUNDS_F> m_child_bounds;
+
+    // Maps world coordinates into the surface or tile being painted, nullptr while painting the window
+    const D2D1::Matrix3x2F* m_surface_transform = nullptr;
+    // Set while painting a surface, whose frames are kept until invalidated
+    bool m_retain = false;
+    // World bounds of the tile being painted, nullptr outside of tiles
+    const BOUNDS_F* m_cull_bounds = nullptr;
+    // Frames painted so far, tells surfaces whose content changed
+    uint64_t m_painted = 0;
+    // Render bounds size each surface was created for
+    ElementStorage<SIZE_F> m_surface_sizes;
 };
 
 class WidgetBase::WidgetRenderTargetProperty : public PropertyBase {
@@ -200,8 +730,79 @@ property_ptr<WidgetAlignment> WidgetBase::HorizontalAlignmentProperty = make_pro
 property_ptr<SIZE_F> WidgetBase::MaxSizeProperty = make_property<SIZE_F>({ 0,0 });
 property_ptr<BOUNDS_F> WidgetBase::ConstraintsProperty = make_property<BOUNDS_F>({ 0,0,0,0 });
 
+property_ptr<bool> WidgetBase::HoveredProperty = make_property(false);
+
+property_ptr<D2D1_MATRIX_3X2_F> WidgetBase::RenderTransformProperty = make_property<D2D1_MATRIX_3X2_F>(D2D1::Matrix3x2F::Identity());
+property_ptr<D2D1_POINT_2F> WidgetBase::RenderTransformOriginProperty = make_property(D2D1::Point2F(0.5f, 0.5f));
+property_ptr<float> WidgetBase::OpacityProperty = make_property(1.0f);
+property_ptr<bool> WidgetBase::CompositedProperty = make_property(false);
+property_ptr<bool> WidgetBase::TiledProperty = make_property(false);
+
+property_ptr<bool> WidgetBase::FocusableProperty = make_property(false);
+property_ptr<bool> WidgetBase::FocusScopeProperty = make_property(false);
+property_ptr<bool> WidgetBase::FocusedProperty = make_property(false);
+
 property_base_ptr WidgetBase::RenderTargetProperty = std::make_shared<PropertyBase>();
 
+std::shared_ptr<WidgetBase::WidgetTransformListener> WidgetBase::TransformListener = []() {
+    auto listener = std::make_shared<WidgetTransformListener>();
+    RenderTransformProperty->add_listener(listener);
+    RenderTransformOriginProperty->add_listener(listener);
+    OpacityProperty->add_listener(listener);
+    CompositedProperty->add_listener(listener);
+    TiledProperty->add_listener(listener);
+    return listener;
+    }();
+
+//
+// Routed events
+//
+
+template <bool (WidgetBase::*Handler)(D2D1_POINT_2F)>
+static routed_event_ptr<PointerEventArgs> make_pointer_event() {
+    auto event = make_routed_event<PointerEventArgs>();
+    event->set_class_handler(RoutePhase::Bubble, [](ElementBase* element, PointerEventArgs& args) {
+        if ((static_cast<WidgetBase*>(element)->*Handler)(args.point())) {
+            args.set_handled();
+        }
+    });
+    return event;
+}
+
+routed_event_ptr<PointerEventArgs> WidgetBase::PointerHoverEvent = make_pointer_event<&WidgetBase::handle_pointer_hover>();
+routed_event_ptr<PointerEventArgs> WidgetBase::PointerPressEvent = make_pointer_event<&WidgetBase::handle_pointer_press>();
+routed_event_ptr<PointerEventArgs> WidgetBase::PointerReleaseEvent = make_pointer_event<&WidgetBase::handle_pointer_release>();
+
+routed_event_ptr<WheelEventArgs> WidgetBase::PointerWheelEvent = []() {
+    auto event = make_routed_event<WheelEventArgs>();
+    event->set_class_handler(RoutePhase::Bubble, [](ElementBase* element, WheelEventArgs& args) {
+        if (static_cast<WidgetBase*>(element)->handle_pointer_wheel(args.point(), args.delta())) {
+            args.set_handled();
+        }
+    });
+    return event;
+    }();
+
+routed_event_ptr<KeyEventArgs> WidgetBase::KeyDownEvent = []() {
+    auto event = make_routed_event<KeyEventArgs>();
+    event->set_class_handler(RoutePhase::Bubble, [](ElementBase* element, KeyEventArgs& args) {
+        if (static_cast<WidgetBase*>(element)->handle_key_down(args.key(), args.modifiers())) {
+            args.set_handled();
+        }
+    });
+    return event;
+    }();
+
+routed_event_ptr<CharacterEventArgs> WidgetBase::CharacterEvent = []() {
+    auto event = make_routed_event<CharacterEventArgs>();
+    event->set_class_handler(RoutePhase::Bubble, [](ElementBase* element, CharacterEventArgs& args) {
+        if (static_cast<WidgetBase*>(element)->handle_character(args.character())) {
+            args.set_handled();
+        }
+    });
+    return event;
+    }();
+
 //
 // Resources
 //
@@ -209,10 +810,19 @@ property_base_ptr WidgetBase::RenderTargetProperty = std::make_shared<PropertyBa
 resource_ptr<SIZE_F> WidgetBase::MeasureResource = std::make_shared<WidgetMeasureResource>();
 resource_ptr<LayoutContext> WidgetBase::LayoutResource = std::make_shared<WidgetLayoutResource>();
 resource_ptr<BOUNDS_F> WidgetBase::RenderBoundsResource = std::make_shared<WidgetRenderBoundsResource>();
+resource_ptr<D2D1_MATRIX_3X2_F> WidgetBase::WorldTransformResource = std::make_shared<WidgetWorldTransformResource>();
 Interop::com_resource_ptr<ID2D1Geometry> WidgetBase::RenderGeometryResource = std::make_shared<WidgetRenderGeometryResource>();
 
 resource_base_ptr WidgetBase::RenderContentResource = std::make_shared<WidgetRenderContentResource>();
 
+std::shared_ptr<WidgetBase::WidgetTileListener> WidgetBase::TileListener = []() {
+    auto listener = std::make_shared<WidgetTileListener>();
+    RenderContentResource->add_listener(listener);
+    return listener;
+    }();
+Interop::com_resource_ptr<ID2D1Layer> WidgetBase::OpacityLayerResource = std::make_shared<WidgetOpacityLayerResource>();
+Interop::com_resource_ptr<ID2D1BitmapRenderTarget> WidgetBase::SurfaceResource = std::make_shared<WidgetSurfaceResource>();
+
 resource_ptr<float> WidgetBase::ScaleResource = std::make_shared<InheritedResource<float>>(Window::ScaleResource);
 
 WidgetBase::WidgetBase() {
@@ -224,13 +834,35 @@ WidgetBase::WidgetBase() {
     register_dependency(MaxSizeProperty);
     register_dependency(ConstraintsProperty);
 
+    register_dependency(HoveredProperty);
+
+    register_dependency(RenderTransformProperty);
+    register_dependency(RenderTransformOriginProperty);
+    register_dependency(OpacityProperty);
+    register_dependency(CompositedProperty);
+    register_dependency(TiledProperty);
+
+    register_dependency(FocusableProperty);
+    register_dependency(FocusScopeProperty);
+    register_dependency(FocusedProperty);
+
+    register_dependency(PointerHoverEvent);
+    register_dependency(PointerPressEvent);
+    register_dependency(PointerReleaseEvent);
+    register_dependency(PointerWheelEvent);
+    register_dependency(KeyDownEvent);
+    register_dependency(CharacterEvent);
+
     register_dependency(RenderTargetProperty);
 
     register_dependency(MeasureResource);
     register_dependency(LayoutResource);
     register_dependency(RenderBoundsResource);
+    register_dependency(WorldTransformResource);
     register_dependency(RenderGeometryResource);
     register_dependency(RenderContentResource);
+    register_dependency(OpacityLayerResource);
+    register_dependency(SurfaceResource);
     register_dependency(ScaleResource);
 }
 
@@ -312,7 +944,7 @@ void WidgetBase::render_debug_layout(const com_ptr<ID2D1RenderTarget>& render_ta
     render_target->DrawRectangle(render_rect, bounds_brush);
     render_target->DrawRectangle(layout_rect, layout_brush);
 
-    for_each_child([render_target](WidgetBase* widget) {
+    for_each_child([&render_target](WidgetBase* widget) {
         widget->render_debug_layout(render_target);
         });
 
@@ -320,11 +952,81 @@ void WidgetBase::render_debug_layout(const com_ptr<ID2D1RenderTarget>& render_ta
     Logger.at(NAMEOF(render_debug_layout)).at(NAMEOF(render_target->Flush)).log_error(hr);
 }
 
-void WidgetBase::attach_render_target(const com_ptr<ID2D1RenderTarget>& render_target)
+void WidgetBase::discard_layout()
+{
+    LayoutResource->invalidate_for(this);
+    RenderBoundsResource->invalidate_for(this);
+    WorldTransformResource->invalidate_for(this);
+    RenderGeometryResource->invalidate_for(this);
+    RenderContentResource->invalidate_for(this);
+
+    for_each_child([](WidgetBase* child) {
+        child->discard_layout();
+        });
+}
+
+static void discard_world_transforms(const WidgetBase* widget, bool repaint)
+{
+    WidgetBase::WorldTransformResource->invalidate_for(widget);
+
+    // Surfaces and tiles hold their subtree untransformed, moving a composited or tiled widget keeps its pixels
+    if (widget->is_composited() || widget->is_tiled()) {
+        repaint = false;
+    }
+    if (repaint) {
+        WidgetBase::RenderContentResource->invalidate_for(widget);
+    }
+
+    for (auto& child : widget->children()) {
+        discard_world_transforms(child.get(), repaint);
+    }
+}
+
+void WidgetBase::discard_transform() const
+{
+    discard_world_transforms(this, true);
+
+    // The area the subtree covered before is painted by its parent and siblings
+    auto parent = parent_widget();
+    if (parent != nullptr) {
+        parent->discard_frame();
+    }
+}
+
+void WidgetBase::discard_measure()
+{
+    MeasureResource->invalidate_for(this);
+    for_each_child([](WidgetBase* child) {
+        child->discard_measure();
+        });
+
+    discard_layout();
+}
+
+WidgetBase* WidgetBase::discard_ancestor_measures()
+{
+    // The window is an ancestor without a measure, it is skipped like ancestors already waiting for one
+    auto top = this;
+    for (auto element = parent(); element != nullptr; element = element->parent()) {
+        if (MeasureResource->is_valid(element) == false) continue;
+        MeasureResource->invalidate_for(element);
+        top = static_cast<WidgetBase*>(element);
+    }
+    return top;
+}
+
+void WidgetBase::set_layout_rounding(float scale)
+{
+    static_pointer_cast<WidgetLayoutResource>(LayoutResource)->set_pixel_scale(this, scale);
+    discard_layout();
+}
+
+void WidgetBase::attach_render_target(const com_ptr<ID2D1RenderTarget>& render_target, GlyphAtlas* glyph_atlas)
 {
     m_render_target = render_target;
-    for_each_child([render_target](WidgetBase* widget) {
-        widget->attach_render_target(render_target);
+    m_glyph_atlas = glyph_atlas;
+    for_each_child([&render_target, glyph_atlas](WidgetBase* widget) {
+        widget->attach_render_target(render_target, glyph_atlas);
         });
 
     static_pointer_cast<WidgetRenderTargetProperty>(RenderTargetProperty)->notify_change(this);
@@ -333,7 +1035,13 @@ void WidgetBase::attach_render_target(const com_ptr<ID2D1RenderTarget>& render_t
 void WidgetBase::detach_render_target()
 {
     discard_resources();
+    OpacityLayerResource->invalidate_for(this);
+    SurfaceResource->invalidate_for(this);
+    if (is_tiled()) {
+        TileCache::instance().invalidate_all(handle());
+    }
     m_render_target = nullptr;
+    m_glyph_atlas = nullptr;
     for_each_child([](WidgetBase* widget) {
         widget->detach_render_target();
         });
@@ -341,14 +1049,44 @@ void WidgetBase::detach_render_target()
     static_pointer_cast<WidgetRenderTargetProperty>(RenderTargetProperty)->notify_change(this);
 }
 
+WidgetBase* WidgetBase::parent_widget() const
+{
+    // The window is the parent of the root widget, it takes no part in layout
+    auto element = parent();
+    if (element == nullptr || LayoutResource->is_owner(element) == false) return nullptr;
+    return static_cast<WidgetBase*>(element);
+}
+
 bool WidgetBase::hit_test(D2D1_POINT_2F point) {
-    BOOL result = false;
-    auto hr = WidgetBase::RenderGeometryResource->get_or_initialize_resource(this)->FillContainsPoint(point, D2D1::Matrix3x2F::Identity(), &result);
-    Logger.at(NAMEOF(hit_test)).at(NAMEOF(ID2D1Geometry::FillContainsPoint)).log_error(hr);
-    return result;
+    auto transform = *D2D1::Matrix3x2F::ReinterpretBaseType(&WorldTransformResource->get_or_initialize_resource(this));
+    if (transform.IsIdentity() == false) {
+        // Subtrees scaled to nothing cannot be hit
+        if (transform.Invert() == false) return false;
+        point = transform.TransformPoint(point);
+    }
+
+    auto& bounds = RenderBoundsResource->get_or_initialize_resource(this);
+    if (point.x < bounds.left || point.x >= bounds.right ||
+        point.y < bounds.top || point.y >= bounds.bottom) {
+        return false;
+    }
+    return contains_point(point);
+}
+
+BOUNDS_F WidgetBase::hit_bounds() const
+{
+    auto& bounds = RenderBoundsResource->get_or_initialize_resource(this);
+    auto& transform = *D2D1::Matrix3x2F::ReinterpretBaseType(&WorldTransformResource->get_or_initialize_resource(this));
+    return transform_bounds(transform, bounds);
+}
+
+WidgetBase* LayoutContext::background_widget() const {
+    auto& registry = ElementRegistry::instance();
+    if (registry.is_alive(m_background) == false) return nullptr;
+    return static_cast<WidgetBase*>(registry.resolve(m_background));
 }
 
-void LayoutContext::layout_child(const widget_ptr& child, const BOUNDS_F& constraints, const widget_ptr& background) const {
+void LayoutContext::layout_child(const widget_ptr& child, const BOUNDS_F& constraints, ElementHandle background) const {
     child->set_constraints(constraints);
     auto child_context = create_subcontext(WidgetBase::MeasureResource->get_or_initialize_resource(child.get()), child->constraints(), child->margin(), background);
     static_pointer_cast<WidgetBase::WidgetLayoutResource>(WidgetBase::LayoutResource)->initialize_with_context(child.get(), child_context);
@@ -5,8 +5,11 @@
 
 // Standard headers
 
-#include <functional>
+#include <cmath>
+#include <cstdint>
 #include <memory>
+#include <span>
+#include <type_traits>
 
 // Windows headers
 
@@ -19,55 +22,100 @@
 #include "foundation.hpp"
 #include "interop.hpp"
 #include "element_base.hpp"
+#include "handle.hpp"
 #include "property.hpp"
 #include "resource.hpp"
+#include "routed_event.hpp"
 
 namespace DirectWidget {
 
     class WidgetBase;
+    class GlyphAtlas;
     using widget_ptr = std::shared_ptr<WidgetBase>;
 
+    // Pixel snapping
+    // Coordinates are device independent pixels, scale is the number of device pixels per device independent pixel.
+
+    inline float snap_to_pixel(float value, float scale) {
+        return std::round(value * scale) / scale;
+    }
+
+    inline bool is_pixel_aligned(float value, float scale) {
+        auto pixels = value * scale;
+        return std::abs(pixels - std::round(pixels)) < 1e-3f;
+    }
+
+    inline bool is_pixel_aligned(const BOUNDS_F& bounds, float scale) {
+        return is_pixel_aligned(bounds.left, scale) && is_pixel_aligned(bounds.top, scale) &&
+            is_pixel_aligned(bounds.right, scale) && is_pixel_aligned(bounds.bottom, scale);
+    }
+
+    // Layout state of a widget
+    // Siblings are referenced through element handles, so contexts are trivially copyable and never own widgets.
+    // A context with a pixel scale snaps render bounds to device pixels, subcontexts inherit the scale.
+
     class LayoutContext {
     public:
         LayoutContext() : LayoutContext({ 0,0 }, { 0,0,0,0 }, { 0,0,0,0 }) {}
 
-        LayoutContext(const SIZE_F& measure, const BOUNDS_F& constraints, const BOUNDS_F& margin, const widget_ptr& background_widget) :
-            m_measure(measure), m_constraints(constraints), m_margin(margin), m_background_widget(background_widget) {
+        LayoutContext(const SIZE_F& measure, const BOUNDS_F& constraints, const BOUNDS_F& margin, ElementHandle background, float pixel_scale) :
+            m_measure(measure), m_constraints(constraints), m_margin(margin), m_background(background), m_pixel_scale(pixel_scale) {
             m_layout_bounds = constraints;
         }
 
+        LayoutContext(const SIZE_F& measure, const BOUNDS_F& constraints, const BOUNDS_F& margin, ElementHandle background) :
+            LayoutContext(measure, constraints, margin, background, 0.0f) {
+        }
+
         LayoutContext(const SIZE_F& measure, const BOUNDS_F& constraints, const BOUNDS_F& margin) :
-            LayoutContext(measure, constraints, margin, nullptr) {
+            LayoutContext(measure, constraints, margin, NullElementHandle) {
         }
 
         void layout_child(const widget_ptr& child, const BOUNDS_F& constraints) const {
-            layout_child(child, constraints, m_background_widget);
+            layout_child(child, constraints, m_background);
         }
-        void layout_child(const widget_ptr& child, const BOUNDS_F& constraints, const widget_ptr& background) const;
+        void layout_child(const widget_ptr& child, const BOUNDS_F& constraints, ElementHandle background) const;
 
         LayoutContext create_subcontext(const SIZE_F& measure, const BOUNDS_F& constraints, const BOUNDS_F& margin) const {
-            return LayoutContext(measure, constraints, margin, m_background_widget);
+            return LayoutContext(measure, constraints, margin, m_background, m_pixel_scale);
         }
 
-        LayoutContext create_subcontext(const SIZE_F& measure, const BOUNDS_F& constraints, const BOUNDS_F& margin, const widget_ptr& background_widget) const {
-            return LayoutContext(measure, constraints, margin, background_widget);
+        LayoutContext create_subcontext(const SIZE_F& measure, const BOUNDS_F& constraints, const BOUNDS_F& margin, ElementHandle background) const {
+            return LayoutContext(measure, constraints, margin, background, m_pixel_scale);
         }
 
         const SIZE_F& measure() const { return m_measure; }
         const BOUNDS_F& constraints() const { return m_constraints; }
-        const widget_ptr& background_widget() const { return m_background_widget; }
+
+        ElementHandle background() const { return m_background; }
+
+        // Device pixels per device independent pixel render bounds are snapped to, 0 when not snapping
+        float pixel_scale() const { return m_pixel_scale; }
+        void set_pixel_scale(float scale) { m_pixel_scale = scale; }
+
+        // Returns nullptr when there is no background widget or it is no longer alive
+        WidgetBase* background_widget() const;
 
         BOUNDS_F& layout_bounds() { return m_layout_bounds; }
 
         const BOUNDS_F& layout_bounds() const { return m_layout_bounds; }
 
         BOUNDS_F render_bounds() const {
-            return {
+            BOUNDS_F bounds{
                 m_layout_bounds.left + m_margin.left,
                 m_layout_bounds.top + m_margin.top,
                 m_layout_bounds.right - m_margin.right,
                 m_layout_bounds.bottom - m_margin.bottom
             };
+
+            // Edges are snapped rather than sizes, so edges shared by neighbours stay shared
+            if (m_pixel_scale > 0.0f) {
+                bounds.left = snap_to_pixel(bounds.left, m_pixel_scale);
+                bounds.top = snap_to_pixel(bounds.top, m_pixel_scale);
+                bounds.right = snap_to_pixel(bounds.right, m_pixel_scale);
+                bounds.bottom = snap_to_pixel(bounds.bottom, m_pixel_scale);
+            }
+            return bounds;
         }
 
     private:
@@ -75,18 +123,36 @@ namespace DirectWidget {
         BOUNDS_F m_constraints;
         BOUNDS_F m_layout_bounds;
         BOUNDS_F m_margin;
-        widget_ptr m_background_widget;
+        ElementHandle m_background;
+        float m_pixel_scale;
     };
 
+    static_assert(std::is_trivially_copyable_v<LayoutContext>);
+
+    // Drawing state of a widget
+    // Contexts carry the world transform of the widget and the opacity its brushes are drawn with.
+    // Subtrees fading as a group are drawn into a layer, the layer applies the opacity and brushes inside draw opaque.
+
     class RenderContext {
     public:
         RenderContext(const Interop::com_ptr<ID2D1RenderTarget>& render_target, const BOUNDS_F& render_bounds)
-            : RenderContext(true, render_target, render_bounds) {
+            : RenderContext(render_target, render_bounds, D2D1::Matrix3x2F::Identity(), 1.0f, nullptr) {
+
+        }
+
+        RenderContext(const Interop::com_ptr<ID2D1RenderTarget>& render_target, const BOUNDS_F& render_bounds,
+            const D2D1_MATRIX_3X2_F& transform, float opacity, ID2D1Layer* layer)
+            : RenderContext(true, render_target, render_bounds, target_scale(render_target), transform, opacity, layer) {
 
         }
 
         ~RenderContext() {
+            if (m_layer != nullptr) {
+                m_render_target->PopLayer();
+            }
             m_render_target->PopAxisAlignedClip();
+            m_render_target->SetTransform(m_previous_transform);
+
             if (m_is_root)
             {
                 auto hr = m_render_target->EndDraw();
@@ -102,27 +168,124 @@ namespace DirectWidget {
         RenderContext(RenderContext&&) = delete;
 
         RenderContext create_subcontext(const BOUNDS_F& render_bounds) const {
-            return RenderContext(false, m_render_target, render_bounds);
+            return RenderContext(false, m_render_target, render_bounds, m_target_scale, m_transform, m_opacity, nullptr);
+        }
+
+        // Context of a child with its own world transform, opacity includes the opacity of this context
+        RenderContext create_subcontext(const BOUNDS_F& render_bounds, const D2D1_MATRIX_3X2_F& transform, float opacity, ID2D1Layer* layer) const {
+            return RenderContext(false, m_render_target, render_bounds, m_target_scale, transform, opacity, layer);
         }
 
         const BOUNDS_F& render_bounds() const { return m_render_bounds; }
         const Interop::com_ptr<ID2D1RenderTarget>& render_target() const { return m_render_target; }
 
+        const D2D1_MATRIX_3X2_F& transform() const { return m_transform; }
+        float opacity() const { return m_opacity; }
+
+        // Device pixels per device independent pixel of the render target
+        float scale() const { return m_target_scale; }
+
+        // Set by the render pass when the target still holds the last frame of the widget, so it may repaint only what changed.
+        // The window is painted in full every frame, only frames in surfaces are kept.
+        bool retains_frame() const { return m_retains_frame; }
+        void set_retains_frame(bool retains_frame) const { m_retains_frame = retains_frame; }
+
+        // Brushes are shared by every frame of their widget, drawing sets the opacity of the context on them
+        ID2D1Brush* brush(ID2D1Brush* brush) const {
+            brush->SetOpacity(m_opacity);
+            return brush;
+        }
+
     private:
         static const LogContext Logger;
 
-        RenderContext(bool is_root, const Interop::com_ptr<ID2D1RenderTarget>& render_target, const BOUNDS_F& render_bounds)
-            : m_is_root(is_root), m_render_target(render_target), m_render_bounds(render_bounds) {
+        RenderContext(bool is_root, const Interop::com_ptr<ID2D1RenderTarget>& render_target, const BOUNDS_F& render_bounds, float target_scale,
+            const D2D1_MATRIX_3X2_F& transform, float opacity, ID2D1Layer* layer)
+            : m_is_root(is_root), m_render_target(render_target), m_render_bounds(render_bounds), m_target_scale(target_scale),
+            m_transform(transform), m_opacity(layer != nullptr ? 1.0f : opacity), m_layer(layer) {
             if (is_root) {
                 m_render_target->BeginDraw();
             }
+
+            m_render_target->GetTransform(&m_previous_transform);
+            m_render_target->SetTransform(transform);
+
+            // Clips on pixel edges cover whole pixels, the aliased clip skips coverage computation
+            auto identity = D2D1::Matrix3x2F::ReinterpretBaseType(&m_transform)->IsIdentity();
+            auto antialias_mode = identity && is_pixel_aligned(render_bounds, target_scale)
+                ? D2D1_ANTIALIAS_MODE_ALIASED
+                : D2D1_ANTIALIAS_MODE_PER_PRIMITIVE;
+
             auto bounds_rect = D2D1::RectF(render_bounds.left, render_bounds.top, render_bounds.right, render_bounds.bottom);
-            render_target->PushAxisAlignedClip(bounds_rect, D2D1_ANTIALIAS_MODE_PER_PRIMITIVE);
+            render_target->PushAxisAlignedClip(bounds_rect, antialias_mode);
+
+            if (layer != nullptr) {
+                auto parameters = D2D1::LayerParameters(bounds_rect, nullptr, antialias_mode, D2D1::Matrix3x2F::Identity(), opacity);
+                render_target->PushLayer(parameters, layer);
+            }
+        }
+
+        static float target_scale(const Interop::com_ptr<ID2D1RenderTarget>& render_target) {
+            FLOAT dpi_x, dpi_y;
+            render_target->GetDpi(&dpi_x, &dpi_y);
+            return dpi_x / USER_DEFAULT_SCREEN_DPI;
         }
 
         bool m_is_root;
         Interop::com_ptr<ID2D1RenderTarget> m_render_target;
         BOUNDS_F m_render_bounds;
+        // Device pixels per device independent pixel of the render target
+        float m_target_scale;
+
+        D2D1_MATRIX_3X2_F m_transform;
+        D2D1_MATRIX_3X2_F m_previous_transform;
+        float m_opacity;
+        ID2D1Layer* m_layer;
+        mutable bool m_retains_frame = false;
+    };
+
+    class PointerEventArgs : public RoutedEventArgs {
+    public:
+        PointerEventArgs(D2D1_POINT_2F point) : m_point(point) {}
+
+        D2D1_POINT_2F point() const { return m_point; }
+
+    private:
+        D2D1_POINT_2F m_point;
+    };
+
+    class WheelEventArgs : public PointerEventArgs {
+    public:
+        WheelEventArgs(D2D1_POINT_2F point, int delta) : PointerEventArgs(point), m_delta(delta) {}
+
+        // Wheel rotation in multiples of WHEEL_DELTA, positive when rotated away from the user
+        int delta() const { return m_delta; }
+
+    private:
+        int m_delta;
+    };
+
+    class KeyEventArgs : public RoutedEventArgs {
+    public:
+        KeyEventArgs(uint32_t key, uint32_t modifiers) : m_key(key), m_modifiers(modifiers) {}
+
+        // Virtual key code
+        uint32_t key() const { return m_key; }
+        uint32_t modifiers() const { return m_modifiers; }
+
+    private:
+        uint32_t m_key;
+        uint32_t m_modifiers;
+    };
+
+    class CharacterEventArgs : public RoutedEventArgs {
+    public:
+        CharacterEventArgs(wchar_t character) : m_character(character) {}
+
+        wchar_t character() const { return m_character; }
+
+    private:
+        wchar_t m_character;
     };
 
     enum class WidgetAlignment {
@@ -145,6 +308,26 @@ namespace DirectWidget {
         static property_ptr<SIZE_F> MaxSizeProperty;
         static property_ptr<BOUNDS_F> ConstraintsProperty;
 
+        static property_ptr<bool> HoveredProperty;
+
+        // Transform of the rendered widget and its subtree around the origin, relative to its render bounds.
+        // Transforms and opacity only repaint, measure and layout are unaffected.
+        static property_ptr<D2D1_MATRIX_3X2_F> RenderTransformProperty;
+        static property_ptr<D2D1_POINT_2F> RenderTransformOriginProperty;
+        static property_ptr<float> OpacityProperty;
+
+        // Composited widgets retain the frame of their subtree in a surface of their own.
+        // Moving or fading them only draws the surface again, their subtree is painted when it changes.
+        static property_ptr<bool> CompositedProperty;
+
+        // Tiled widgets rasterize their subtree into tiles kept by the TileCache, only the tiles in view are drawn.
+        // Meant for large content moved by its render transform, moving it rasterizes only the tiles coming into view.
+        static property_ptr<bool> TiledProperty;
+
+        static property_ptr<bool> FocusableProperty;
+        static property_ptr<bool> FocusScopeProperty;
+        static property_ptr<bool> FocusedProperty;
+
         SIZE_F size() const { return get_property<SIZE_F>(SizeProperty); }
         void set_size(const SIZE_F& size) { set_property<SIZE_F>(SizeProperty, size); }
 
@@ -163,6 +346,49 @@ namespace DirectWidget {
         const BOUNDS_F& constraints() const { return get_property<BOUNDS_F>(ConstraintsProperty); }
         void set_constraints(const BOUNDS_F& constraints) { set_property<BOUNDS_F>(ConstraintsProperty, constraints); }
 
+        const D2D1_MATRIX_3X2_F& render_transform() const { return get_property(RenderTransformProperty); }
+        void set_render_transform(const D2D1_MATRIX_3X2_F& transform) { set_property(RenderTransformProperty, transform); }
+
+        const D2D1_POINT_2F& render_transform_origin() const { return get_property(RenderTransformOriginProperty); }
+        void set_render_transform_origin(const D2D1_POINT_2F& origin) { set_property(RenderTransformOriginProperty, origin); }
+
+        float opacity() const { return get_property(OpacityProperty); }
+        void set_opacity(float opacity) { set_property(OpacityProperty, opacity); }
+
+        bool is_composited() const { return get_property(CompositedProperty); }
+        void set_composited(bool composited) { set_property(CompositedProperty, composited); }
+
+        bool is_tiled() const { return get_property(TiledProperty); }
+        void set_tiled(bool tiled) { set_property(TiledProperty, tiled); }
+
+        // Maintained by the window while the pointer is over the widget or one of its descendants
+        bool is_hovered() const { return get_property<bool>(HoveredProperty); }
+        void set_hovered(bool hovered) { set_property<bool>(HoveredProperty, hovered); }
+
+        bool is_focusable() const { return get_property<bool>(FocusableProperty); }
+        void set_focusable(bool focusable) { set_property<bool>(FocusableProperty, focusable); }
+
+        // Tab and arrow navigation inside a focus scope wraps around within the scope and never leaves it
+        bool is_focus_scope() const { return get_property<bool>(FocusScopeProperty); }
+        void set_focus_scope(bool focus_scope) { set_property<bool>(FocusScopeProperty, focus_scope); }
+
+        // Maintained by the window holding keyboard focus
+        bool is_focused() const { return get_property<bool>(FocusedProperty); }
+        void set_focused(bool focused) { set_property<bool>(FocusedProperty, focused); }
+
+        // routed events
+        // The bubble class handlers forward to the handle_pointer_* methods below
+
+        static routed_event_ptr<PointerEventArgs> PointerHoverEvent;
+        static routed_event_ptr<PointerEventArgs> PointerPressEvent;
+        static routed_event_ptr<PointerEventArgs> PointerReleaseEvent;
+        static routed_event_ptr<WheelEventArgs> PointerWheelEvent;
+
+        // Keyboard events are routed to the focused widget, the bubble class handlers forward to handle_key_down and handle_character
+
+        static routed_event_ptr<KeyEventArgs> KeyDownEvent;
+        static routed_event_ptr<CharacterEventArgs> CharacterEvent;
+
         // notification properties
 
         static property_base_ptr RenderTargetProperty;
@@ -172,9 +398,15 @@ namespace DirectWidget {
         static resource_ptr<SIZE_F> MeasureResource;
         static resource_ptr<LayoutContext> LayoutResource;
         static resource_ptr<BOUNDS_F> RenderBoundsResource;
+        // Render transforms of the widget and its ancestors composed, maps render bounds to the render target
+        static resource_ptr<D2D1_MATRIX_3X2_F> WorldTransformResource;
         static Interop::com_resource_ptr<ID2D1Geometry> RenderGeometryResource;
 
         static resource_base_ptr RenderContentResource;
+        // Created for widgets whose children fade as a group
+        static Interop::com_resource_ptr<ID2D1Layer> OpacityLayerResource;
+        // Created for composited widgets, sized to their render bounds
+        static Interop::com_resource_ptr<ID2D1BitmapRenderTarget> SurfaceResource;
 
         static resource_ptr<float> ScaleResource;
 
@@ -184,22 +416,44 @@ namespace DirectWidget {
 
         // rendering
 
-        void attach_render_target(const Interop::com_ptr<ID2D1RenderTarget>& render_target);
+        // The glyph atlas belongs to the window or snapshot owning render_target
+        void attach_render_target(const Interop::com_ptr<ID2D1RenderTarget>& render_target, GlyphAtlas* glyph_atlas);
         void detach_render_target();
 
         virtual void create_resources() { for_each_child([](WidgetBase* widget) { widget->create_resources(); }); }
         virtual void discard_resources() { for_each_child([](WidgetBase* widget) { widget->discard_resources(); }); }
 
         const Interop::com_ptr<ID2D1RenderTarget>& render_target() const { return m_render_target; }
+        GlyphAtlas* glyph_atlas() const { return m_glyph_atlas; }
 
         void issue_frame() { RenderContentResource->initialize_for(this); }
         void discard_frame() { 
             RenderContentResource->invalidate_for(this);
             for_each_child([](WidgetBase* child) {
+                // Composited and tiled children keep their pixels, they are drawn over this frame again
+                if (child->is_composited() || child->is_tiled()) return;
                 RenderContentResource->invalidate_for(child);
                 });
         }
 
+        // Drops the arrangement and frame of the subtree, the next frame lays it out again within the constraints set by the parent
+        // Widgets caching resources derived from their render bounds override it and drop them as well
+        virtual void discard_layout();
+
+        // Drops measures as well, for subtrees whose content changed
+        void discard_measure();
+
+        // Drops measures of the ancestors, which were measured with the previous size of this widget.
+        // Returns the topmost of them, or this widget, whose layout has to be discarded for the new measures to be laid out.
+        WidgetBase* discard_ancestor_measures();
+
+        // Drops world transforms of the subtree and repaints the area it covered, measure and layout are kept
+        void discard_transform() const;
+
+        // Snaps render bounds of this widget and the subtree laid out from it to device pixels at scale, 0 stops snapping.
+        // The window sets it on its root widget. Measures are kept, only the layout is discarded.
+        void set_layout_rounding(float scale);
+
         // interaction
 
         D2D1_POINT_2F pixel_to_point(int x, int y) {
@@ -212,32 +466,58 @@ namespace DirectWidget {
             return D2D1::Point2U(static_cast<UINT>(point.x * scale), static_cast<UINT>(point.y * scale));
         }
 
+        // Maps point through the inverse world transform, tests render bounds analytically, then the widget shape
         bool hit_test(D2D1_POINT_2F point);
 
+        // Render bounds as covered on the render target, the bounding box of the transformed bounds
+        BOUNDS_F hit_bounds() const;
+
+        // Shape test for points inside render bounds,
+        // widgets with non-rectangular shapes override it and test RenderGeometryResource
+        virtual bool contains_point(D2D1_POINT_2F point) const { return true; }
+
+        // Pointer events are routed to the topmost widget, returning true marks the event handled
+
         virtual bool handle_pointer_hover(D2D1_POINT_2F point) { return false; }
         virtual bool handle_pointer_press(D2D1_POINT_2F point) { return false; }
         virtual bool handle_pointer_release(D2D1_POINT_2F point) { return false; }
+        virtual bool handle_pointer_wheel(D2D1_POINT_2F point, int delta) { return false; }
 
-        bool handle_pointer_move(int x, int y) {
-            return false; // TODO
-        }
+        // Called only on hover state changes, widgets invalidate their frame here if they render hover
+        virtual void handle_pointer_enter() {}
+        virtual void handle_pointer_leave() {}
 
-        bool handle_pointer_press(int x, int y) {
-            return handle_pointer_press(pixel_to_point(x, y));
-        }
+        virtual bool handle_key_down(uint32_t key, uint32_t modifiers) { return false; }
+        virtual bool handle_character(wchar_t character) { return false; }
 
-        bool handle_pointer_release(int x, int y) {
-            return handle_pointer_release(pixel_to_point(x, y));
-        }
+        // Called on focus changes
+        virtual void handle_focus_gained() {}
+        virtual void handle_focus_lost() {}
+
+        // children
+
+        virtual std::span<const widget_ptr> children() const { return {}; }
+
+        // Parent widget, nullptr for the root widget of a window
+        WidgetBase* parent_widget() const;
 
     protected:
 
         WidgetBase();
 
-        virtual void for_each_child(std::function<void(WidgetBase*)> callback) const {}
+        // Visits children without type erasure, so tree walks inline and never allocate
+        template <typename Callback>
+        void for_each_child(Callback&& callback) const {
+            for (auto& child : children()) {
+                callback(child.get());
+            }
+        }
 
         virtual void render(const RenderContext& context) const {}
 
+        // Widgets painting under their children return true, fading them then takes a layer
+        virtual bool paints_under_children() const { return false; }
+
         virtual SIZE_F measure(const SIZE_F& maximum_size) const { return { 0,0 }; }
 
         virtual void layout(LayoutContext& context) const;
@@ -246,14 +526,23 @@ namespace DirectWidget {
         static const LogContext Logger;
 
         Interop::com_ptr<ID2D1RenderTarget> m_render_target = nullptr;
+        GlyphAtlas* m_glyph_atlas = nullptr;
 
         class WidgetMeasureResource;
         class WidgetLayoutResource;
         class WidgetRenderBoundsResource;
+        class WidgetWorldTransformResource;
+        class WidgetOpacityLayerResource;
+        class WidgetSurfaceResource;
+        class WidgetTransformListener;
+        class WidgetTileListener;
         class WidgetRenderGeometryResource;
         class WidgetRenderContentResource;
         class WidgetRenderTargetProperty;
 
+        static std::shared_ptr<WidgetTransformListener> TransformListener;
+        static std::shared_ptr<WidgetTileListener> TileListener;
+
         friend LayoutContext;
     };
 }
\ No newline at end of file
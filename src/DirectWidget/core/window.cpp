@@ -1,6 +1,9 @@
 // window.cpp: Window implementation
 
+#include <algorithm>
+#include <chrono>
 #include <memory>
+#include <vector>
 
 #include <Windows.h>
 #include <windowsx.h>
@@ -10,12 +13,16 @@
 
 #include "foundation.hpp"
 #include "element_base.hpp"
+#include "handle.hpp"
 #include "property.hpp"
 #include "resource.hpp"
 #include "interop.hpp"
 #include "window.hpp"
 #include "app.hpp"
 #include "widget.hpp"
+#include "animation.hpp"
+#include "tile_cache.hpp"
+#include "glyph_atlas.hpp"
 
 using namespace DirectWidget;
 
@@ -84,7 +91,12 @@ class Win32ScaleResource : public BasicTypeResource<float> {
 protected:
     bool initialize(const ElementBase* owner, float& resource) override {
         if (is_valid(owner) == true) return true;
-        if (Window::WindowResource->is_valid(owner) == false) return false;
+
+        // Windows driven without a handle, e.g. by benches, map pixels at the default scale until they are shown
+        if (Window::WindowResource->is_valid(owner) == false) {
+            resource = 1.0f;
+            return false;
+        }
 
         auto& hwnd = Window::WindowResource->get_resource(owner);
         resource = static_cast<float>(GetDpiForWindow(hwnd)) / USER_DEFAULT_SCREEN_DPI;
@@ -104,9 +116,12 @@ public:
             rc.right - rc.left,
             rc.bottom - rc.top);
 
+        // The target uses the scale of the monitor the window is on rather than the system scale
+        auto dpi = static_cast<FLOAT>(GetDpiForWindow(hwnd));
+
         auto& factory = Application::instance()->d2d();
         return factory->CreateHwndRenderTarget(
-            D2D1::RenderTargetProperties(),
+            D2D1::RenderTargetProperties(D2D1_RENDER_TARGET_TYPE_DEFAULT, D2D1::PixelFormat(), dpi, dpi),
             D2D1::HwndRenderTargetProperties(hwnd, size),
             &resource);
     }
@@ -118,30 +133,147 @@ public:
 class Window::WidgetRenderContentListener : public DependencyListenerBase {
 public:
     void register_window(const ElementBase* owner, Window* window) {
-        m_window[owner] = window;
+        m_window.insert_or_assign(element_handle(owner), window);
     }
 
     void remove_window_for(const ElementBase* owner) {
-        m_window.erase(owner);
+        m_window.erase(element_handle(owner));
     }
 
     void on_dependency_updated(const ElementBase* owner, const NotificationArgument& arg) override {
-        auto window = m_window.find(owner);
-        if (window == m_window.end()) {
+        auto window = m_window.find(element_handle(owner));
+        if (window == nullptr) {
             return;
         }
-        auto& hwnd = Window::WindowResource->get_resource(window->second);
+        auto& hwnd = Window::WindowResource->get_resource(*window);
 
         if (arg.notification_type() == NotificationType::Initialized) {
             ValidateRect(hwnd, NULL);
         }
         else {
             InvalidateRect(hwnd, NULL, FALSE);
+            (*window)->m_latency_tracker.note_invalidation();
+        }
+    }
+
+private:
+    ElementStorage<Window*> m_window;
+};
+
+// Keeps the spatial index of the window in sync with render bounds and world transforms of its widgets
+class Window::WidgetRenderBoundsListener : public DependencyListenerBase {
+public:
+    void register_window(Window* window) {
+        m_window.insert_or_assign(window->handle(), window);
+    }
+
+    void remove_window(Window* window) {
+        m_window.erase(window->handle());
+    }
+
+    void on_dependency_updated(const ElementBase* owner, const NotificationArgument& arg) override {
+        if (arg.notification_type() != NotificationType::Initialized &&
+            arg.notification_type() != NotificationType::Invalidated) {
+            return;
+        }
+
+        // Entries keep the previous transform until the new one is composed, the widget tests its exact shape meanwhile
+        auto transform_changed = arg.dependency() == WidgetBase::WorldTransformResource.get();
+        if (transform_changed && arg.notification_type() != NotificationType::Initialized) {
+            return;
+        }
+
+        // The window is the topmost ancestor of its widgets
+        auto root = owner;
+        while (root->parent() != nullptr) {
+            root = root->parent();
+        }
+
+        auto window = m_window.find(root->handle());
+        if (window == nullptr) {
+            return;
+        }
+
+        auto& spatial_index = (*window)->m_spatial_index;
+        auto widget = static_cast<const WidgetBase*>(owner);
+        if (arg.notification_type() == NotificationType::Initialized) {
+            if (transform_changed && WidgetBase::RenderBoundsResource->is_valid(widget) == false) return;
+            spatial_index.update(widget, widget->hit_bounds());
+        }
+        else {
+            spatial_index.remove(widget);
+        }
+    }
+
+private:
+    ElementStorage<Window*> m_window;
+};
+
+// Keeps the focus index of the window in sync with the widget tree and focusable flags
+class Window::WidgetFocusListener : public DependencyListenerBase, public TreeObserverBase {
+public:
+    void register_window(Window* window) {
+        m_window.insert_or_assign(window->handle(), window);
+    }
+
+    void remove_window(Window* window) {
+        m_window.erase(window->handle());
+    }
+
+    void on_child_attached(const ElementBase* parent, const ElementBase* child) override {
+        auto window = find_window(parent);
+        if (window == nullptr) return;
+
+        if (parent == window) {
+            window->m_focus_index.rebuild(static_cast<const WidgetBase*>(child));
+        }
+        else {
+            window->m_focus_index.insert_subtree(static_cast<const WidgetBase*>(child));
+        }
+    }
+
+    void on_child_detaching(const ElementBase* parent, const ElementBase* child) override {
+        auto window = find_window(parent);
+        if (window == nullptr) return;
+
+        // Focus does not stay inside a detached subtree
+        for (auto element = static_cast<ElementBase*>(window->focused_widget()); element != nullptr; element = element->parent()) {
+            if (element == child) {
+                window->focus(nullptr);
+                break;
+            }
+        }
+
+        window->m_focus_index.remove_subtree(static_cast<const WidgetBase*>(child));
+    }
+
+    void on_dependency_updated(const ElementBase* owner, const NotificationArgument& arg) override {
+        if (arg.notification_type() != NotificationType::ValueChanged) return;
+
+        auto window = find_window(owner);
+        if (window == nullptr || window == owner) return;
+
+        // Scope changes move whole subtrees between scopes, they are rare enough to re-index everything
+        if (arg.dependency() == WidgetBase::FocusScopeProperty.get()) {
+            window->m_focus_index.rebuild(window->root_widget().get());
+        }
+        else {
+            window->m_focus_index.update(static_cast<const WidgetBase*>(owner));
         }
     }
 
 private:
-    std::unordered_map<const ElementBase*, Window*> m_window;
+    // The window is the topmost ancestor of its widgets
+    Window* find_window(const ElementBase* element) const {
+        while (element->parent() != nullptr) {
+            element = element->parent();
+        }
+
+        auto window = m_window.find(element->handle());
+        return window != nullptr ? *window : nullptr;
+    }
+
+    ElementStorage<Window*> m_window;
 };
 
 const LogContext Window::Logger{ NAMEOF(Window) };
@@ -150,6 +282,8 @@ property_ptr<PCWSTR> Window::ClassNameProperty = make_property<PCWSTR>(NAMEOF(Di
 property_ptr<PCWSTR> Window::TitleProperty = make_property<PCWSTR>(NAMEOF(DirectWidget::Window));
 property_ptr<UINT> Window::StyleProperty = make_property<UINT>(WS_OVERLAPPEDWINDOW);
 property_ptr<widget_ptr> Window::RootWidgetProperty = make_property<widget_ptr>(nullptr);
+property_ptr<bool> Window::LayoutRoundingProperty = make_property(false);
+property_ptr<std::chrono::microseconds> Window::LayoutBudgetProperty = make_property(std::chrono::microseconds(0));
 
 resource_ptr<ATOM> Window::ClassResource = std::make_shared<Win32WindowClassResource>();
 resource_ptr<HWND> Window::WindowResource = std::make_shared<Win32WindowResource>();
@@ -163,6 +297,38 @@ std::shared_ptr<Window::WidgetRenderContentListener> Window::RenderContentListen
     return listener;
     }();
 
+std::shared_ptr<Window::WidgetRenderBoundsListener> Window::RenderBoundsListener = []() {
+    auto listener = std::make_shared<WidgetRenderBoundsListener>();
+    WidgetBase::RenderBoundsResource->add_listener(listener);
+    WidgetBase::WorldTransformResource->add_listener(listener);
+    return listener;
+    }();
+
+// Timestamps a record with the time the OS received the message being handled
+static INPUT_EVENT with_message_time(INPUT_EVENT event)
+{
+    auto age = static_cast<DWORD>(GetTickCount()) - static_cast<DWORD>(GetMessageTime());
+    event.timestamp -= std::chrono::milliseconds(age);
+    return event;
+}
+
+static uint32_t key_modifiers()
+{
+    uint32_t modifiers = 0;
+    if (GetKeyState(VK_SHIFT) & 0x8000) modifiers |= ModifierShift;
+    if (GetKeyState(VK_CONTROL) & 0x8000) modifiers |= ModifierControl;
+    if (GetKeyState(VK_MENU) & 0x8000) modifiers |= ModifierAlt;
+    return modifiers;
+}
+
+std::shared_ptr<Window::WidgetFocusListener> Window::FocusListener = []() {
+    auto listener = std::make_shared<WidgetFocusListener>();
+    WidgetBase::FocusableProperty->add_listener(listener);
+    WidgetBase::FocusScopeProperty->add_listener(listener);
+    ElementRegistry::instance().add_tree_observer(listener.get());
+    return listener;
+    }();
+
 LRESULT Window::WindowProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam) {
     Window* window;
     if (uMsg == WM_NCCREATE) {
@@ -183,17 +349,33 @@ LRESULT Window::WindowProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam) {
     }
 }
 
+Window::~Window()
+{
+    RenderBoundsListener->remove_window(this);
+    FocusListener->remove_window(this);
+    discard_device_resources();
+
+    // Resources are not discarded on owner removal, release the win32 objects while the window is alive
+    WindowResource->invalidate_for(this);
+    ClassResource->invalidate_for(this);
+}
+
 Window::Window() {
     register_dependency(ClassNameProperty);
     register_dependency(TitleProperty);
     register_dependency(StyleProperty);
     register_dependency(RootWidgetProperty);
+    register_dependency(LayoutRoundingProperty);
+    register_dependency(LayoutBudgetProperty);
 
     register_dependency(ClassResource);
     register_dependency(WindowResource);
     register_dependency(ClientRectResource);
     register_dependency(ScaleResource);
     register_dependency(RenderTargetResource);
+
+    RenderBoundsListener->register_window(this);
+    FocusListener->register_window(this);
 }
 
 LRESULT Window::handle_message(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam) {
@@ -209,7 +391,31 @@ LRESULT Window::handle_message(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lPara
     {
         if (root_widget() == nullptr) return FALSE;
         if (create_device_resources() == false) return FALSE;
-        root_widget()->issue_frame();
+        process_input();
+
+        // Animations started by input show their first step in this frame
+        auto& animator = Animator::instance();
+        animator.tick();
+
+        auto& tile_cache = TileCache::instance();
+        tile_cache.begin_frame();
+        {
+            // Layout left over by the previous frame goes first, layout the frame itself needs shares the rest of the budget
+            LayoutScheduler::Slice slice(m_layout_scheduler, layout_budget());
+            m_layout_scheduler.resume();
+            root_widget()->issue_frame();
+        }
+        m_latency_tracker.frame_presented();
+
+        // A paint requested only for input may leave the frame untouched
+        ValidateRect(hWnd, NULL);
+
+        // WM_PAINT is generated once the message queue is empty, so input queued meanwhile is dispatched before layout resumes.
+        // Running animations request the next frame the same way, presenting paces them to the display refresh.
+        // Tiles left to prefetch are rasterized a few per frame while nothing else is drawn.
+        if (m_layout_scheduler.has_pending() || animator.is_running() || tile_cache.has_pending_prefetch()) {
+            InvalidateRect(hWnd, NULL, FALSE);
+        }
 
         return TRUE;
     }
@@ -226,40 +432,78 @@ LRESULT Window::handle_message(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lPara
     case WM_DPICHANGED:
     {
         ScaleResource->invalidate_for(this);
+
+        // The suggested rect keeps the logical size of the window at the new scale
+        auto suggested = reinterpret_cast<const RECT*>(lParam);
+        SetWindowPos(hWnd, NULL,
+            suggested->left, suggested->top,
+            suggested->right - suggested->left, suggested->bottom - suggested->top,
+            SWP_NOZORDER | SWP_NOACTIVATE);
+
+        handle_scale_change(LOWORD(wParam));
         return TRUE;
     }
     break;
 
     case WM_MOUSEMOVE:
     {
-        if (root_widget() == nullptr) return FALSE;
-
-        auto x = GET_X_LPARAM(lParam), y = GET_Y_LPARAM(lParam);
-        if (root_widget()->handle_pointer_move(x, y)) {
-            return TRUE;
+        if (m_pointer_leave_tracked == false) {
+            TRACKMOUSEEVENT track_event{
+                .cbSize = sizeof(TRACKMOUSEEVENT),
+                .dwFlags = TME_LEAVE,
+                .hwndTrack = hWnd,
+            };
+            m_pointer_leave_tracked = TrackMouseEvent(&track_event) != FALSE;
         }
+
+        inject_input(with_message_time(make_input_event(InputType::PointerMove, GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam))));
+        return TRUE;
     }
     break;
 
-    case WM_LBUTTONDOWN:
+    case WM_MOUSELEAVE:
     {
-        if (root_widget() == nullptr) return FALSE;
+        m_pointer_leave_tracked = false;
+        inject_input(with_message_time(make_input_event(InputType::PointerLeave, 0, 0)));
+        return TRUE;
+    }
+    break;
 
-        auto x = GET_X_LPARAM(lParam), y = GET_Y_LPARAM(lParam);
-        if (root_widget()->handle_pointer_press(x, y)) {
-            return TRUE;
-        }
+    case WM_LBUTTONDOWN:
+    {
+        inject_input(with_message_time(make_input_event(InputType::PointerPress, GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam))));
+        return TRUE;
     }
     break;
 
     case WM_LBUTTONUP:
     {
-        if (root_widget() == nullptr) return FALSE;
+        inject_input(with_message_time(make_input_event(InputType::PointerRelease, GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam))));
+        return TRUE;
+    }
+    break;
 
-        auto x = GET_X_LPARAM(lParam), y = GET_Y_LPARAM(lParam);
-        if (root_widget()->handle_pointer_release(x, y)) {
-            return TRUE;
-        }
+    case WM_MOUSEWHEEL:
+    {
+        // Wheel messages carry screen coordinates
+        POINT point{ GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam) };
+        ScreenToClient(hWnd, &point);
+        inject_input(with_message_time(make_wheel_input_event(point.x, point.y, GET_WHEEL_DELTA_WPARAM(wParam))));
+        return TRUE;
+    }
+    break;
+
+    case WM_KEYDOWN:
+    {
+        inject_input(with_message_time(make_key_input_event(InputType::KeyDown, static_cast<uint32_t>(wParam), key_modifiers())));
+        return TRUE;
+    }
+    break;
+
+    case WM_CHAR:
+    {
+        inject_input(with_message_time(make_key_input_event(InputType::Character, static_cast<uint32_t>(wParam), key_modifiers())));
+        return TRUE;
     }
     break;
 
@@ -278,7 +522,7 @@ bool Window::create_device_resources()
     RenderContentListener->register_window(root_widget().get(), this);
 
     auto& render_target = RenderTargetResource->get_or_initialize_resource(this);
-    root_widget()->attach_render_target(render_target);
+    root_widget()->attach_render_target(render_target, &m_glyph_atlas);
     root_widget()->create_resources();
 
     auto render_target_size = render_target->GetSize();
@@ -286,15 +530,325 @@ bool Window::create_device_resources()
     root_widget()->set_constraints(BOUNDS_F{ 0,0,render_target_size.width, render_target_size.height });
 
     m_resource_created = true;
+    update_layout_rounding();
     return true;
 }
 
+void Window::update_layout_rounding()
+{
+    auto& root = root_widget();
+    if (root == nullptr || m_resource_created == false) return;
+
+    root->set_layout_rounding(layout_rounding() ? ScaleResource->get_or_initialize_resource(this) : 0.0f);
+}
+
+void Window::handle_scale_change(UINT dpi)
+{
+    // Without a render target the new scale is picked up when it is created
+    if (m_resource_created == false) return;
+
+    auto& render_target = RenderTargetResource->get_resource(this);
+    auto& rc = ClientRectResource->get_or_initialize_resource(this);
+
+    auto hr = render_target->Resize(D2D1::SizeU(rc.right - rc.left, rc.bottom - rc.top));
+    Logger.at(NAMEOF(handle_scale_change)).at(NAMEOF(ID2D1HwndRenderTarget::Resize)).log_error(hr);
+    render_target->SetDpi(static_cast<FLOAT>(dpi), static_cast<FLOAT>(dpi));
+
+    // Measures are in device independent pixels, they are only redone when the logical size of the window changed.
+    // Either way the layout is redone for the new rounding, which drops text layouts sized to the old bounds.
+    auto& root = root_widget();
+    auto size = render_target->GetSize();
+    auto& maximum_size = root->maximum_size();
+    if (maximum_size.width != size.width || maximum_size.height != size.height) {
+        root->set_maximum_size(SIZE_F{ size.width, size.height });
+        root->set_constraints(BOUNDS_F{ 0, 0, size.width, size.height });
+        root->discard_measure();
+    }
+
+    if (layout_rounding()) {
+        update_layout_rounding();
+    }
+    else {
+        root->discard_layout();
+    }
+
+    InvalidateRect(window_handle(), NULL, FALSE);
+}
+
 void Window::discard_device_resources()
 {
+    // Nothing was attached to a window without a root or before its first frame
+    if (root_widget() == nullptr || m_resource_created == false) return;
+
     RenderContentListener->remove_window_for(root_widget().get());
 
+    // The glyph atlas is a bitmap of the render target going away
+    m_glyph_atlas.clear();
+
     root_widget()->discard_resources();
     root_widget()->detach_render_target();
     root_widget()->discard_frame();
     m_resource_created = false;
 }
+
+WidgetBase* Window::hit_test(D2D1_POINT_2F point)
+{
+    auto& root = root_widget();
+    if (root == nullptr) return nullptr;
+
+    if (m_spatial_index.is_stale()) {
+        m_spatial_index.rebuild(root.get());
+    }
+
+    return m_spatial_index.hit_test(point);
+}
+
+void Window::inject_input(const INPUT_EVENT& event)
+{
+    if (m_input_queue.push(event) == false) {
+        Logger.at(NAMEOF(inject_input)).log_error(L"input queue is full, input record dropped");
+        return;
+    }
+
+    // Without a handle there is no frame to request, the host drains the queue through process_input
+    auto& hwnd = window_handle();
+    if (hwnd == NULL) return;
+
+    // WM_PAINT is only generated when the message queue is empty, so input recorded until then is processed in one batch
+    if (m_input_frame_requested.exchange(true, std::memory_order_acq_rel) == false) {
+        InvalidateRect(hwnd, NULL, FALSE);
+    }
+}
+
+void Window::process_input()
+{
+    m_input_frame_requested.store(false, std::memory_order_release);
+
+    m_input_queue.drain([this](const INPUT_EVENT& event) {
+        switch (event.type) {
+        case InputType::PointerMove:
+            m_pointer_position = { event.x, event.y };
+            m_pointer_inside = true;
+            m_pointer_move_pending = true;
+            m_pointer_move_event = event;
+            break;
+
+        case InputType::PointerLeave:
+            m_pointer_inside = false;
+            m_pointer_move_pending = true;
+            m_pointer_move_event = event;
+            break;
+
+        case InputType::PointerPress:
+            flush_pointer_move();
+            m_latency_tracker.begin_dispatch(event);
+            dispatch_pointer_event(event.x, event.y, WidgetBase::PointerPressEvent);
+            focus_pointer_target();
+            m_latency_tracker.end_dispatch();
+            break;
+
+        case InputType::PointerRelease:
+            flush_pointer_move();
+            m_latency_tracker.begin_dispatch(event);
+            dispatch_pointer_event(event.x, event.y, WidgetBase::PointerReleaseEvent);
+            m_latency_tracker.end_dispatch();
+            break;
+
+        case InputType::PointerWheel:
+            flush_pointer_move();
+            m_latency_tracker.begin_dispatch(event);
+            dispatch_pointer_wheel(event.x, event.y, event.delta);
+            m_latency_tracker.end_dispatch();
+            break;
+
+        case InputType::KeyDown:
+            m_latency_tracker.begin_dispatch(event);
+            dispatch_key_down(event.key, event.modifiers);
+            m_latency_tracker.end_dispatch();
+            break;
+
+        case InputType::Character:
+            m_latency_tracker.begin_dispatch(event);
+            dispatch_character(static_cast<wchar_t>(event.key));
+            m_latency_tracker.end_dispatch();
+            break;
+        }
+    });
+
+    flush_pointer_move();
+}
+
+bool Window::dispatch_pointer_event(int x, int y, const routed_event_ptr<PointerEventArgs>& event)
+{
+    auto& root = root_widget();
+    if (root == nullptr) return false;
+
+    auto point = root->pixel_to_point(x, y);
+
+    m_pointer_route.update(hit_test(point), root.get());
+
+    PointerEventArgs args(point);
+    return event->raise(m_pointer_route, args);
+}
+
+bool Window::dispatch_pointer_wheel(int x, int y, int delta)
+{
+    auto& root = root_widget();
+    if (root == nullptr) return false;
+
+    auto point = root->pixel_to_point(x, y);
+
+    m_pointer_route.update(hit_test(point), root.get());
+
+    WheelEventArgs args(point, delta);
+    return WidgetBase::PointerWheelEvent->raise(m_pointer_route, args);
+}
+
+void Window::flush_pointer_move()
+{
+    if (m_pointer_move_pending == false) return;
+    m_pointer_move_pending = false;
+
+    auto& root = root_widget();
+    if (root == nullptr) return;
+
+    auto& registry = ElementRegistry::instance();
+    m_latency_tracker.begin_dispatch(m_pointer_move_event);
+
+    D2D1_POINT_2F point{ 0, 0 };
+    if (m_pointer_inside) {
+        point = root->pixel_to_point(m_pointer_position.x, m_pointer_position.y);
+        m_pointer_route.update(hit_test(point), root.get());
+        m_next_hover_path = m_pointer_route.elements();
+    }
+    else {
+        m_pointer_route.clear();
+        m_next_hover_path.clear();
+    }
+
+    auto contains = [](const std::vector<ElementHandle>& path, ElementHandle handle) {
+        return std::find(path.begin(), path.end(), handle) != path.end();
+    };
+
+    // Leave innermost widgets first
+    for (auto& handle : m_hover_path) {
+        if (contains(m_next_hover_path, handle) || registry.is_alive(handle) == false) continue;
+
+        auto widget = static_cast<WidgetBase*>(registry.resolve(handle));
+        widget->set_hovered(false);
+        widget->handle_pointer_leave();
+    }
+
+    // Enter outermost widgets first
+    for (auto it = m_next_hover_path.rbegin(); it != m_next_hover_path.rend(); it++) {
+        if (contains(m_hover_path, *it) || registry.is_alive(*it) == false) continue;
+
+        auto widget = static_cast<WidgetBase*>(registry.resolve(*it));
+        widget->set_hovered(true);
+        widget->handle_pointer_enter();
+    }
+
+    std::swap(m_hover_path, m_next_hover_path);
+
+    if (m_pointer_inside) {
+        PointerEventArgs args(point);
+        WidgetBase::PointerHoverEvent->raise(m_pointer_route, args);
+    }
+
+    m_latency_tracker.end_dispatch();
+}
+
+WidgetBase* Window::focused_widget() const
+{
+    auto& registry = ElementRegistry::instance();
+    if (registry.is_alive(m_focused) == false) return nullptr;
+    return static_cast<WidgetBase*>(registry.resolve(m_focused));
+}
+
+void Window::focus(WidgetBase* widget)
+{
+    auto handle = element_handle(widget);
+    if (handle == m_focused) return;
+
+    auto previous = focused_widget();
+    m_focused = handle;
+
+    if (previous != nullptr) {
+        previous->set_focused(false);
+        previous->handle_focus_lost();
+    }
+
+    if (widget != nullptr) {
+        widget->set_focused(true);
+        widget->handle_focus_gained();
+    }
+}
+
+bool Window::move_focus(bool forward, bool wrap)
+{
+    auto focused = focused_widget();
+
+    WidgetBase* target;
+    if (focused == nullptr) {
+        target = m_focus_index.first();
+    }
+    else {
+        target = forward ? m_focus_index.next(focused, wrap) : m_focus_index.previous(focused, wrap);
+    }
+
+    if (target == nullptr) return false;
+
+    focus(target);
+    return true;
+}
+
+void Window::focus_pointer_target()
+{
+    // The innermost focusable widget on the route of the press takes focus
+    auto& registry = ElementRegistry::instance();
+    for (auto& handle : m_pointer_route.elements()) {
+        if (registry.is_alive(handle) == false) continue;
+
+        auto widget = static_cast<WidgetBase*>(registry.resolve(handle));
+        if (widget->is_focusable()) {
+            focus(widget);
+            return;
+        }
+    }
+}
+
+bool Window::dispatch_key_down(uint32_t key, uint32_t modifiers)
+{
+    auto& root = root_widget();
+    if (root == nullptr) return false;
+
+    m_focus_route.update(focused_widget(), root.get());
+
+    KeyEventArgs args(key, modifiers);
+    if (WidgetBase::KeyDownEvent->raise(m_focus_route, args)) return true;
+
+    // Unhandled navigation keys move focus, tab wraps around the focus scope, arrows stop at its ends
+    switch (key) {
+    case VK_TAB:
+        return move_focus((modifiers & ModifierShift) == 0, true);
+    case VK_RIGHT:
+    case VK_DOWN:
+        return move_focus(true, false);
+    case VK_LEFT:
+    case VK_UP:
+        return move_focus(false, false);
+    default:
+        return false;
+    }
+}
+
+bool Window::dispatch_character(wchar_t character)
+{
+    auto& root = root_widget();
+    if (root == nullptr) return false;
+
+    m_focus_route.update(focused_widget(), root.get());
+
+    CharacterEventArgs args(character);
+    return WidgetBase::CharacterEvent->raise(m_focus_route, args);
+}
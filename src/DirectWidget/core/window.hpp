@@ -3,16 +3,26 @@
 
 #pragma once
 
+#include <atomic>
+#include <chrono>
 #include <memory>
+#include <vector>
 
 #include <windows.h>
 #include <d2d1.h>
 
 #include "foundation.hpp"
 #include "element_base.hpp"
+#include "focus_index.hpp"
+#include "glyph_atlas.hpp"
 #include "property.hpp"
 #include "resource.hpp"
 #include "interop.hpp"
+#include "input_queue.hpp"
+#include "latency.hpp"
+#include "layout_scheduler.hpp"
+#include "routed_event.hpp"
+#include "spatial_index.hpp"
 #include "widget.hpp"
 
 namespace DirectWidget {
@@ -29,6 +39,12 @@ namespace DirectWidget {
         static property_ptr<UINT> StyleProperty;
         static property_ptr<widget_ptr> RootWidgetProperty;
 
+        // Snaps widget bounds to device pixels at the scale of the window
+        static property_ptr<bool> LayoutRoundingProperty;
+
+        // Time a frame may spend on layout before the rest is resumed by the next frame, zero lays out everything at once
+        static property_ptr<std::chrono::microseconds> LayoutBudgetProperty;
+
         const widget_ptr& root_widget() { return RootWidgetProperty->get_value(this); }
         void set_root_widget(const widget_ptr& widget) { 
             auto& old_widget = root_widget();
@@ -39,6 +55,15 @@ namespace DirectWidget {
             register_child(widget);
         }
 
+        bool layout_rounding() const { return LayoutRoundingProperty->get_value(this); }
+        void set_layout_rounding(bool rounding) {
+            LayoutRoundingProperty->set_value(this, rounding);
+            update_layout_rounding();
+        }
+
+        std::chrono::microseconds layout_budget() const { return LayoutBudgetProperty->get_value(this); }
+        void set_layout_budget(std::chrono::microseconds budget) { LayoutBudgetProperty->set_value(this, budget); }
+
         // resources
 
         static resource_ptr<ATOM> ClassResource;
@@ -53,12 +78,46 @@ namespace DirectWidget {
         const Interop::com_ptr<ID2D1RenderTarget>& render_target() const { return RenderTargetResource->get_resource(this); }
 
         Window();
-        ~Window() { discard_device_resources(); }
+        ~Window();
 
         void show(int nCmdShow) { ShowWindow(WindowResource->get_or_initialize_resource(this), nCmdShow); }
         void show() { show(SWP_SHOWWINDOW); }
         void close() { WindowResource->invalidate_for(this); }
 
+        // interaction
+
+        // Returns the topmost widget at point, in device independent pixels
+        WidgetBase* hit_test(D2D1_POINT_2F point);
+
+        // Queues an input record for the next frame, platform input of the window is recorded through here as well
+        // The queue has a single producer: synthetic input must come from the window thread or replace platform input.
+        void inject_input(const INPUT_EVENT& event);
+
+        // Dispatches the queued input, every frame starts with it
+        // Windows without a handle get no frames, headless hosts and benches call it after injecting input.
+        void process_input();
+
+        // focus
+
+        // Widget receiving keyboard input, nullptr when nothing is focused
+        WidgetBase* focused_widget() const;
+        void focus(WidgetBase* widget);
+
+        // Moves focus to the next or previous focusable widget of the focus scope, returns false if focus did not move
+        bool move_focus(bool forward, bool wrap);
+
+        // Latency of input handled by this window, per input type and stage
+        LatencyTracker& latency_tracker() { return m_latency_tracker; }
+        const LatencyTracker& latency_tracker() const { return m_latency_tracker; }
+
+        // Budget adherence and completion latency of time sliced layout
+        LayoutScheduler& layout_scheduler() { return m_layout_scheduler; }
+        const LayoutScheduler& layout_scheduler() const { return m_layout_scheduler; }
+
+        // Glyphs of the text drawn into this window
+        GlyphAtlas& glyph_atlas() { return m_glyph_atlas; }
+        const GlyphAtlas& glyph_atlas() const { return m_glyph_atlas; }
+
     protected:
         virtual bool on_destroy() { return false; }
 
@@ -68,12 +127,58 @@ namespace DirectWidget {
         static const LogContext Logger;
 
         class WidgetRenderContentListener;
+        class WidgetRenderBoundsListener;
+        class WidgetFocusListener;
 
         static std::shared_ptr<WidgetRenderContentListener> RenderContentListener;
+        static std::shared_ptr<WidgetRenderBoundsListener> RenderBoundsListener;
+        static std::shared_ptr<WidgetFocusListener> FocusListener;
 
         bool create_device_resources();
         void discard_device_resources();
 
+        // Applies the rounding mode and scale to the root widget
+        void update_layout_rounding();
+
+        // Moves the render target to the new scale, measures in device independent pixels stay valid
+        void handle_scale_change(UINT dpi);
+
+        bool dispatch_pointer_event(int x, int y, const routed_event_ptr<PointerEventArgs>& event);
+        bool dispatch_pointer_wheel(int x, int y, int delta);
+
+        bool dispatch_key_down(uint32_t key, uint32_t modifiers);
+        bool dispatch_character(wchar_t character);
+        void focus_pointer_target();
+
+        // Pointer moves are coalesced, only the latest position is dispatched once per frame
+        void flush_pointer_move();
+
         bool m_resource_created = false;
+
+        SpatialIndex m_spatial_index;
+
+        InputQueue m_input_queue;
+        std::atomic<bool> m_input_frame_requested = false;
+
+        LatencyTracker m_latency_tracker;
+        LayoutScheduler m_layout_scheduler;
+        GlyphAtlas m_glyph_atlas;
+
+        POINT m_pointer_position{ 0, 0 };
+        bool m_pointer_inside = false;
+        bool m_pointer_move_pending = false;
+        bool m_pointer_leave_tracked = false;
+        INPUT_EVENT m_pointer_move_event{};
+
+        // Route to the widget under the pointer, reused while the pointer stays over it
+        EventRoute m_pointer_route;
+
+        FocusIndex m_focus_index;
+        ElementHandle m_focused = NullElementHandle;
+        EventRoute m_focus_route;
+
+        // Hit path of the hovered widget, topmost widget first
+        std::vector<ElementHandle> m_hover_path;
+        std::vector<ElementHandle> m_next_hover_path;
     };
 }
\ No newline at end of file
@@ -0,0 +1,513 @@
+// canvas_layout.cpp: CanvasLayout implementation
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include <Windows.h>
+#include <d2d1.h>
+#include <d2d1helper.h>
+
+#include "../core/foundation.hpp"
+#include "../core/interop.hpp"
+#include "../core/property.hpp"
+#include "../core/widget.hpp"
+#include "canvas_layout.hpp"
+
+using namespace DirectWidget;
+using namespace Layouts;
+
+property_ptr<D2D1_COLOR_F> CanvasLayout::BackgroundColorProperty = make_property<D2D1_COLOR_F>(D2D1::ColorF(D2D1::ColorF::White));
+property_ptr<D2D1_POINT_2F> CanvasLayout::PositionProperty = make_property<D2D1_POINT_2F>({ 0.0f, 0.0f });
+
+Interop::com_resource_ptr<ID2D1SolidColorBrush> CanvasLayout::BackgroundFillResource = std::make_shared<Interop::SolidColorBrushResource>(BackgroundColorProperty);
+
+static bool intersects(const BOUNDS_F& a, const BOUNDS_F& b)
+{
+    return a.left < b.right && b.left < a.right && a.top < b.bottom && b.top < a.bottom;
+}
+
+// Splits the part of a outside of b into at most four rectangles, returns their count
+static size_t subtract(const BOUNDS_F& a, const BOUNDS_F& b, BOUNDS_F(&parts)[4])
+{
+    if (intersects(a, b) == false) {
+        parts[0] = a;
+        return 1;
+    }
+
+    size_t count = 0;
+    if (b.top > a.top) {
+        parts[count++] = BOUNDS_F{ a.left, a.top, a.right, b.top };
+    }
+    if (b.bottom < a.bottom) {
+        parts[count++] = BOUNDS_F{ a.left, b.bottom, a.right, a.bottom };
+    }
+
+    auto top = (std::max)(a.top, b.top);
+    auto bottom = (std::min)(a.bottom, b.bottom);
+    if (b.left > a.left) {
+        parts[count++] = BOUNDS_F{ a.left, top, b.left, bottom };
+    }
+    if (b.right < a.right) {
+        parts[count++] = BOUNDS_F{ b.right, top, a.right, bottom };
+    }
+    return count;
+}
+
+CanvasLayout::CanvasLayout()
+{
+    register_dependency(BackgroundColorProperty);
+    register_dependency(BackgroundFillResource);
+}
+
+//
+// Items
+//
+
+void CanvasLayout::add_item(const widget_ptr& widget, D2D1_POINT_2F position)
+{
+    if (find_item(widget) != NoItem) return;
+
+    uint32_t index;
+    if (m_free_items.empty()) {
+        index = static_cast<uint32_t>(m_items.size());
+        m_items.emplace_back();
+    }
+    else {
+        index = m_free_items.back();
+        m_free_items.pop_back();
+    }
+
+    auto& item = m_items[index];
+    item = CANVAS_ITEM{};
+    item.widget = widget;
+    item.order = m_next_order++;
+    m_item_indices.insert_or_assign(widget.get(), index);
+
+    PositionProperty->set_value(widget.get(), position);
+
+    auto size = measure_item(widget);
+    place_item(index, BOUNDS_F{ position.x, position.y, position.x + size.width, position.y + size.height });
+}
+
+void CanvasLayout::remove_item(const widget_ptr& widget)
+{
+    auto index = find_item(widget);
+    if (index == NoItem) return;
+
+    auto& item = m_items[index];
+    if (item.realized) {
+        item.realized = false;
+        remove_child(widget);
+        m_visible_changed = true;
+        update_visible();
+        discard_layout();
+    }
+    if (item.indexed) {
+        unindex_item(index);
+    }
+
+    item.widget = nullptr;
+    m_item_indices.erase(widget.get());
+    m_free_items.push_back(index);
+}
+
+void CanvasLayout::move_item(const widget_ptr& widget, D2D1_POINT_2F position)
+{
+    auto index = find_item(widget);
+    if (index == NoItem) return;
+
+    PositionProperty->set_value(widget.get(), position);
+
+    auto& bounds = m_items[index].bounds;
+    place_item(index, BOUNDS_F{
+        position.x,
+        position.y,
+        position.x + (bounds.right - bounds.left),
+        position.y + (bounds.bottom - bounds.top) });
+}
+
+void CanvasLayout::refresh_item(const widget_ptr& widget)
+{
+    auto index = find_item(widget);
+    if (index == NoItem) return;
+
+    widget->discard_measure();
+
+    auto& position = PositionProperty->get_value(widget.get());
+    auto size = measure_item(widget);
+    place_item(index, BOUNDS_F{ position.x, position.y, position.x + size.width, position.y + size.height });
+}
+
+uint32_t CanvasLayout::find_item(const widget_ptr& widget) const
+{
+    auto it = m_item_indices.find(widget.get());
+    return it == m_item_indices.end() ? NoItem : it->second;
+}
+
+SIZE_F CanvasLayout::measure_item(const widget_ptr& widget) const
+{
+    // Items take their natural size, the canvas has no bounds to give them
+    widget->set_maximum_size(SIZE_F{ (std::numeric_limits<float>::max)(), (std::numeric_limits<float>::max)() });
+    return WidgetBase::MeasureResource->get_or_initialize_resource(widget.get());
+}
+
+void CanvasLayout::place_item(uint32_t index, const BOUNDS_F& bounds)
+{
+    auto& item = m_items[index];
+    auto was_realized = item.realized;
+
+    if (item.indexed) {
+        unindex_item(index);
+    }
+    item.bounds = bounds;
+    index_item(index);
+
+    if (update_realization(index)) {
+        update_visible();
+    }
+
+    // Items out of view before and after leave the view as it is
+    if (was_realized || item.realized) {
+        discard_layout();
+    }
+}
+
+void CanvasLayout::query(const BOUNDS_F& area, std::vector<WidgetBase*>& items) const
+{
+    std::vector<uint32_t> indices;
+    for_each_in(area, [&indices](uint32_t index) { indices.push_back(index); });
+
+    // Items spanning several buckets are found once per bucket
+    std::sort(indices.begin(), indices.end(), [this](uint32_t a, uint32_t b) { return m_items[a].order < m_items[b].order; });
+    indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+
+    for (auto index : indices) {
+        items.push_back(m_items[index].widget.get());
+    }
+}
+
+WidgetBase* CanvasLayout::item_at(D2D1_POINT_2F point) const
+{
+    const CANVAS_ITEM* result = nullptr;
+
+    auto test = [this, &point, &result](uint32_t index) {
+        auto& item = m_items[index];
+        if (point.x < item.bounds.left || point.x >= item.bounds.right ||
+            point.y < item.bounds.top || point.y >= item.bounds.bottom) return;
+
+        if (result == nullptr || item.order > result->order) {
+            result = &item;
+        }
+    };
+
+    auto x = static_cast<int>(std::floor(point.x / IndexCellSize));
+    auto y = static_cast<int>(std::floor(point.y / IndexCellSize));
+
+    auto cell = m_cells.find(cell_key(x, y));
+    if (cell != m_cells.end()) {
+        for (auto index : cell->second) {
+            test(index);
+        }
+    }
+    for (auto index : m_large_items) {
+        test(index);
+    }
+
+    return result != nullptr ? result->widget.get() : nullptr;
+}
+
+//
+// Index
+//
+
+CanvasLayout::CELL_RANGE CanvasLayout::cell_range(const BOUNDS_F& bounds) const
+{
+    return {
+        static_cast<int>(std::floor(bounds.left / IndexCellSize)),
+        static_cast<int>(std::floor(bounds.top / IndexCellSize)),
+        static_cast<int>(std::floor(bounds.right / IndexCellSize)),
+        static_cast<int>(std::floor(bounds.bottom / IndexCellSize)),
+    };
+}
+
+void CanvasLayout::index_item(uint32_t index)
+{
+    auto& item = m_items[index];
+    if (item.bounds.right <= item.bounds.left || item.bounds.bottom <= item.bounds.top) return;
+
+    item.indexed = true;
+    item.cells = cell_range(item.bounds);
+
+    auto cell_count = (item.cells.right - item.cells.left + 1) * (item.cells.bottom - item.cells.top + 1);
+    item.large = cell_count > MaxCellsPerItem;
+
+    if (item.large) {
+        m_large_items.push_back(index);
+        return;
+    }
+
+    for (auto y = item.cells.top; y <= item.cells.bottom; y++) {
+        for (auto x = item.cells.left; x <= item.cells.right; x++) {
+            m_cells[cell_key(x, y)].push_back(index);
+        }
+    }
+}
+
+void CanvasLayout::unindex_item(uint32_t index)
+{
+    auto remove_from = [index](std::vector<uint32_t>& indices) {
+        auto it = std::find(indices.begin(), indices.end(), index);
+        if (it == indices.end()) return;
+        *it = indices.back();
+        indices.pop_back();
+    };
+
+    auto& item = m_items[index];
+    if (item.large) {
+        remove_from(m_large_items);
+    }
+    else {
+        for (auto y = item.cells.top; y <= item.cells.bottom; y++) {
+            for (auto x = item.cells.left; x <= item.cells.right; x++) {
+                auto cell = m_cells.find(cell_key(x, y));
+                if (cell == m_cells.end()) continue;
+
+                remove_from(cell->second);
+                if (cell->second.empty()) {
+                    m_cells.erase(cell);
+                }
+            }
+        }
+    }
+
+    item.indexed = false;
+    item.large = false;
+}
+
+template <typename Callback>
+void CanvasLayout::for_each_in(const BOUNDS_F& area, Callback&& callback) const
+{
+    if (area.right <= area.left || area.bottom <= area.top) return;
+
+    auto cells = cell_range(area);
+    for (auto y = cells.top; y <= cells.bottom; y++) {
+        for (auto x = cells.left; x <= cells.right; x++) {
+            auto cell = m_cells.find(cell_key(x, y));
+            if (cell == m_cells.end()) continue;
+
+            for (auto index : cell->second) {
+                if (intersects(m_items[index].bounds, area)) {
+                    callback(index);
+                }
+            }
+        }
+    }
+
+    for (auto index : m_large_items) {
+        if (intersects(m_items[index].bounds, area)) {
+            callback(index);
+        }
+    }
+}
+
+//
+// Realization
+//
+
+void CanvasLayout::update_viewport(const BOUNDS_F& viewport)
+{
+    if (m_has_viewport &&
+        viewport.left == m_viewport.left && viewport.top == m_viewport.top &&
+        viewport.right == m_viewport.right && viewport.bottom == m_viewport.bottom) return;
+
+    auto previous = m_viewport;
+    auto had_viewport = m_has_viewport;
+    m_viewport = viewport;
+    m_has_viewport = true;
+
+    // Items are checked against the new viewport, so an item found in several areas is only realized once
+    auto update = [this](uint32_t index) { update_realization(index); };
+
+    if (had_viewport == false) {
+        for_each_in(viewport, update);
+    }
+    else {
+        // Only items in the area that came into view can enter, only items in the area that went out of view can leave
+        BOUNDS_F parts[4];
+        auto count = subtract(viewport, previous, parts);
+        for (size_t i = 0; i < count; i++) {
+            for_each_in(parts[i], update);
+        }
+
+        count = subtract(previous, viewport, parts);
+        for (size_t i = 0; i < count; i++) {
+            for_each_in(parts[i], update);
+        }
+    }
+
+    update_visible();
+}
+
+bool CanvasLayout::update_realization(uint32_t index)
+{
+    auto& item = m_items[index];
+    auto visible = m_has_viewport && item.widget != nullptr && intersects(item.bounds, m_viewport);
+    if (visible == item.realized) return false;
+
+    item.realized = visible;
+    item.pending_layout = visible;
+    if (visible) {
+        // Focus moves through items in the order children() lists them
+        add_child(item.widget, item.order);
+        if (render_target() != nullptr) {
+            item.widget->attach_render_target(render_target(), glyph_atlas());
+            item.widget->create_resources();
+        }
+        m_visible.push_back(index);
+    }
+    else {
+        remove_child(item.widget);
+    }
+
+    m_visible_changed = true;
+    return true;
+}
+
+void CanvasLayout::update_visible()
+{
+    if (m_visible_changed == false) return;
+    m_visible_changed = false;
+
+    // Items that left are dropped, an item that left and came back in the same update is listed twice
+    m_visible.erase(std::remove_if(m_visible.begin(), m_visible.end(), [this](uint32_t index) {
+        return m_items[index].realized == false;
+        }), m_visible.end());
+    std::sort(m_visible.begin(), m_visible.end(), [this](uint32_t a, uint32_t b) { return m_items[a].order < m_items[b].order; });
+    m_visible.erase(std::unique(m_visible.begin(), m_visible.end()), m_visible.end());
+
+    m_visible_widgets.clear();
+    for (auto index : m_visible) {
+        m_visible_widgets.push_back(m_items[index].widget);
+    }
+}
+
+//
+// View
+//
+
+void CanvasLayout::set_view_offset(D2D1_POINT_2F offset)
+{
+    if (offset.x == m_view_offset.x && offset.y == m_view_offset.y) return;
+
+    m_view_offset = offset;
+
+    // A canvas not laid out yet realizes the items around the offset in its next layout
+    if (m_has_viewport == false || LayoutResource->is_valid(this) == false) return;
+
+    update_viewport(BOUNDS_F{
+        offset.x,
+        offset.y,
+        offset.x + (m_viewport.right - m_viewport.left),
+        offset.y + (m_viewport.bottom - m_viewport.top) });
+
+    // Items in view before keep their layout and move by their render transform, items coming into view are laid out
+    // within the context of the last layout
+    auto context = LayoutResource->get_resource(this);
+    for (auto index : m_visible) {
+        if (m_items[index].pending_layout) {
+            layout_item(context, index);
+        }
+        else {
+            pan_item(index);
+        }
+    }
+
+    // Items leaving the view uncover the background
+    discard_frame();
+}
+
+void CanvasLayout::layout_item(const LayoutContext& context, uint32_t index)
+{
+    auto& item = m_items[index];
+    auto bounds = context.render_bounds();
+    auto dx = bounds.left - m_layout_offset.x;
+    auto dy = bounds.top - m_layout_offset.y;
+    context.layout_child(item.widget, BOUNDS_F{
+        item.bounds.left + dx,
+        item.bounds.top + dy,
+        item.bounds.right + dx,
+        item.bounds.bottom + dy });
+
+    item.pending_layout = false;
+    pan_item(index);
+}
+
+void CanvasLayout::pan_item(uint32_t index)
+{
+    auto dx = m_layout_offset.x - m_view_offset.x;
+    auto dy = m_layout_offset.y - m_view_offset.y;
+
+    // Setting a transform repaints the canvas, items already in place are left alone
+    auto& widget = m_items[index].widget;
+    auto& transform = widget->render_transform();
+    if (transform._31 == dx && transform._32 == dy) return;
+    widget->set_render_transform(D2D1::Matrix3x2F::Translation(dx, dy));
+}
+
+//
+// Layout
+//
+
+SIZE_F CanvasLayout::measure(const SIZE_F& available_size) const
+{
+    // Fills the available space, items are measured when they are added
+    return available_size;
+}
+
+void CanvasLayout::layout(LayoutContext& context) const
+{
+    WidgetBase::layout(context);
+
+    auto bounds = context.render_bounds();
+
+    // The viewport depends on the bounds, which are only known here
+    const_cast<CanvasLayout*>(this)->update_viewport(BOUNDS_F{
+        m_view_offset.x,
+        m_view_offset.y,
+        m_view_offset.x + (bounds.right - bounds.left),
+        m_view_offset.y + (bounds.bottom - bounds.top) });
+
+    // The layout of the canvas was discarded with those of its items, they are laid out again where they are in view
+    auto canvas = const_cast<CanvasLayout*>(this);
+    canvas->m_layout_offset = m_view_offset;
+    for (auto index : m_visible) {
+        canvas->layout_item(context, index);
+    }
+}
+
+//
+// Rendering
+//
+
+void CanvasLayout::discard_resources()
+{
+    BackgroundFillResource->invalidate_for(this);
+    LayoutWidgetBase::discard_resources();
+
+    // Items out of view keep the resources they made while they were in view
+    for (auto& item : m_items) {
+        if (item.widget != nullptr && item.realized == false) {
+            item.widget->discard_resources();
+        }
+    }
+}
+
+void CanvasLayout::render(const RenderContext& context) const
+{
+    context.render_target()->FillRectangle(
+        Interop::to_d2d(context.render_bounds()),
+        context.brush(BackgroundFillResource->get_or_initialize_resource(this)));
+}
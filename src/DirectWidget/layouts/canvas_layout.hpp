@@ -0,0 +1,164 @@
+// canvas_layout.hpp: CanvasLayout definition
+// CanvasLayout places items at explicit positions in an unbounded canvas seen through a movable view.
+// Items are kept in a bucket index and only the items intersecting the view are children of the canvas.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+#include <Windows.h>
+#include <d2d1.h>
+
+#include "../core/foundation.hpp"
+#include "../core/interop.hpp"
+#include "../core/property.hpp"
+#include "../core/widget.hpp"
+#include "layout_widget.hpp"
+
+namespace DirectWidget {
+    namespace Layouts {
+
+        class CanvasLayout : public LayoutWidgetBase
+        {
+        public:
+            // Size of the square buckets of the item index
+            static constexpr float IndexCellSize = 256.0f;
+
+            // Items covering more buckets than this are kept in a separate list scanned by every query
+            static constexpr int MaxCellsPerItem = 64;
+
+            // properties
+
+            static property_ptr<D2D1_COLOR_F> BackgroundColorProperty;
+
+            // Position of an item in canvas coordinates, set on the item through move_item
+            static property_ptr<D2D1_POINT_2F> PositionProperty;
+
+            const D2D1_COLOR_F& background_color() const { return get_property(BackgroundColorProperty); }
+            void set_background_color(const D2D1_COLOR_F& color) { set_property(BackgroundColorProperty, color); }
+
+            static const D2D1_POINT_2F& position(const WidgetBase* widget) { return PositionProperty->get_value(widget); }
+
+            CanvasLayout();
+
+            // items
+            // Items are measured once when added, refresh_item measures an item again after its content changed
+
+            void add_item(const widget_ptr& widget, D2D1_POINT_2F position);
+            void remove_item(const widget_ptr& widget);
+            void move_item(const widget_ptr& widget, D2D1_POINT_2F position);
+            void refresh_item(const widget_ptr& widget);
+
+            size_t item_count() const { return m_items.size() - m_free_items.size(); }
+
+            // Items intersecting area, and the last added item containing point, in canvas coordinates
+            void query(const BOUNDS_F& area, std::vector<WidgetBase*>& items) const;
+            WidgetBase* item_at(D2D1_POINT_2F point) const;
+
+            // view
+
+            // Canvas point shown at the top left corner of the layout
+            // Panning moves the items in view by their render transform, which the canvas owns, and lays out only
+            // the items coming into view
+            const D2D1_POINT_2F& view_offset() const { return m_view_offset; }
+            void set_view_offset(D2D1_POINT_2F offset);
+
+            // Area of the canvas in view as of the last layout
+            const BOUNDS_F& viewport() const { return m_viewport; }
+
+            // layout
+
+            void layout(LayoutContext& context) const override;
+
+            SIZE_F measure(const SIZE_F& available_size) const override;
+
+            // rendering
+
+            void discard_resources() override;
+
+            // children
+
+            // Items in view, in the order they were added so overlapping items paint the same wherever they are
+            std::span<const widget_ptr> children() const override { return m_visible_widgets; }
+
+        protected:
+            void render(const RenderContext& context) const override;
+            bool paints_under_children() const override { return true; }
+
+        private:
+            static constexpr uint32_t NoItem = static_cast<uint32_t>(-1);
+
+            static Interop::com_resource_ptr<ID2D1SolidColorBrush> BackgroundFillResource;
+
+            typedef struct {
+                int left, top, right, bottom;
+            } CELL_RANGE;
+
+            typedef struct {
+                widget_ptr widget;
+                BOUNDS_F bounds;
+                CELL_RANGE cells;
+                // Increasing with every added item, orders items for painting and hit testing
+                uint64_t order;
+                bool indexed;
+                bool large;
+                bool realized;
+                // Realized and not laid out yet
+                bool pending_layout;
+            } CANVAS_ITEM;
+
+            uint32_t find_item(const widget_ptr& widget) const;
+            SIZE_F measure_item(const widget_ptr& widget) const;
+            void place_item(uint32_t index, const BOUNDS_F& bounds);
+
+            // index
+
+            CELL_RANGE cell_range(const BOUNDS_F& bounds) const;
+            void index_item(uint32_t index);
+            void unindex_item(uint32_t index);
+
+            template <typename Callback>
+            void for_each_in(const BOUNDS_F& area, Callback&& callback) const;
+
+            static uint64_t cell_key(int x, int y) {
+                return (static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32) | static_cast<uint32_t>(y);
+            }
+
+            // realization
+
+            // Realizes the items entering viewport and releases the ones leaving it, looking only at the changed area
+            void update_viewport(const BOUNDS_F& viewport);
+            bool update_realization(uint32_t index);
+            void update_visible();
+
+            // Lays out a realized item relative to the layout offset, then moves it to the view offset
+            void layout_item(const LayoutContext& context, uint32_t index);
+            void pan_item(uint32_t index);
+
+            std::vector<CANVAS_ITEM> m_items;
+            std::vector<uint32_t> m_free_items;
+            std::unordered_map<const WidgetBase*, uint32_t> m_item_indices;
+            uint64_t m_next_order = 0;
+
+            std::unordered_map<uint64_t, std::vector<uint32_t>> m_cells;
+            std::vector<uint32_t> m_large_items;
+
+            // Realized items sorted by order, and their widgets
+            std::vector<uint32_t> m_visible;
+            std::vector<widget_ptr> m_visible_widgets;
+            bool m_visible_changed = false;
+
+            D2D1_POINT_2F m_view_offset{ 0.0f, 0.0f };
+            // View offset of the last layout, items are laid out relative to it
+            D2D1_POINT_2F m_layout_offset{ 0.0f, 0.0f };
+            BOUNDS_F m_viewport{ 0.0f, 0.0f, 0.0f, 0.0f };
+            bool m_has_viewport = false;
+        };
+
+    }
+}
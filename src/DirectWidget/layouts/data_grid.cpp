@@ -0,0 +1,587 @@
+// data_grid.cpp: DataGrid implementation
+
+#include <algorithm>
+#include <cmath>
+#include <format>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <Windows.h>
+#include <d2d1.h>
+#include <d2d1helper.h>
+#include <dwrite.h>
+
+#include "../core/arena.hpp"
+#include "../core/foundation.hpp"
+#include "../core/input_queue.hpp"
+#include "../core/interop.hpp"
+#include "../core/property.hpp"
+#include "../core/widget.hpp"
+#include "../widgets/text_widget.hpp"
+#include "data_grid.hpp"
+
+using namespace DirectWidget;
+using namespace Layouts;
+
+// Text widget keeping its own copy of the text, the text property only holds a pointer
+class DataGrid::GridCellWidget : public Widgets::TextWidget {
+public:
+    GridCellWidget() {
+        set_horizontal_alignment(WidgetAlignment::Stretch);
+        set_vertical_alignment(WidgetAlignment::Stretch);
+        set_paragraph_alignment(DWRITE_PARAGRAPH_ALIGNMENT_CENTER);
+        set_margin(BOUNDS_F{ 4.0f, 0.0f, 4.0f, 0.0f });
+        set_text(m_value.c_str());
+    }
+
+    void set_value(std::wstring value) {
+        m_value = std::move(value);
+        set_text(m_value.c_str());
+        discard_layout();
+    }
+
+private:
+    std::wstring m_value;
+};
+
+// Distance from a column edge in the header within which a press starts resizing the column
+static constexpr float ResizeHandleReach = 4.0f;
+
+// Rows scrolled by one wheel notch
+static constexpr int WheelRows = 3;
+
+// Distance scrolled horizontally by one arrow key press
+static constexpr float HorizontalStep = 48.0f;
+
+property_ptr<float> DataGrid::RowHeightProperty = make_property(24.0f);
+property_ptr<float> DataGrid::HeaderHeightProperty = make_property(28.0f);
+property_ptr<float> DataGrid::DefaultColumnWidthProperty = make_property(120.0f);
+property_ptr<float> DataGrid::MinimumColumnWidthProperty = make_property(24.0f);
+property_ptr<D2D1_COLOR_F> DataGrid::BackgroundColorProperty = make_property<D2D1_COLOR_F>(D2D1::ColorF(D2D1::ColorF::White));
+property_ptr<D2D1_COLOR_F> DataGrid::HeaderColorProperty = make_property<D2D1_COLOR_F>(D2D1::ColorF(0.93f, 0.93f, 0.93f));
+property_ptr<D2D1_COLOR_F> DataGrid::GridLineColorProperty = make_property<D2D1_COLOR_F>(D2D1::ColorF(0.85f, 0.85f, 0.85f));
+
+Interop::com_resource_ptr<ID2D1SolidColorBrush> DataGrid::BackgroundFillResource = std::make_shared<Interop::SolidColorBrushResource>(BackgroundColorProperty);
+Interop::com_resource_ptr<ID2D1SolidColorBrush> DataGrid::HeaderFillResource = std::make_shared<Interop::SolidColorBrushResource>(HeaderColorProperty);
+Interop::com_resource_ptr<ID2D1SolidColorBrush> DataGrid::GridLineFillResource = std::make_shared<Interop::SolidColorBrushResource>(GridLineColorProperty);
+
+DataGrid::DataGrid()
+{
+    register_dependency(RowHeightProperty);
+    register_dependency(HeaderHeightProperty);
+    register_dependency(DefaultColumnWidthProperty);
+    register_dependency(MinimumColumnWidthProperty);
+    register_dependency(BackgroundColorProperty);
+    register_dependency(HeaderColorProperty);
+    register_dependency(GridLineColorProperty);
+
+    register_dependency(BackgroundFillResource);
+    register_dependency(HeaderFillResource);
+    register_dependency(GridLineFillResource);
+
+    set_focusable(true);
+}
+
+//
+// Data
+//
+
+void DataGrid::set_data_source(const columnar_data_source_ptr& data_source)
+{
+    m_data_source = data_source;
+
+    auto columns = m_data_source != nullptr ? m_data_source->column_count() : 0;
+    m_column_widths.assign(columns, default_column_width());
+    m_column_lefts.assign(columns + 1, 0.0f);
+    update_column_lefts(0);
+
+    m_row_order.clear();
+    m_row_order.shrink_to_fit();
+    m_sort_column = NoColumn;
+    m_sort_direction = SortDirection::None;
+
+    m_first_row = 0;
+    m_horizontal_offset = 0.0f;
+    m_generation++;
+
+    discard_layout();
+}
+
+void DataGrid::refresh()
+{
+    // Columns are kept, their count is not expected to change without a new source
+    apply_sort();
+    m_generation++;
+
+    discard_layout();
+}
+
+//
+// Columns
+//
+
+void DataGrid::set_column_width(size_t column, float width)
+{
+    width = (std::max)(width, minimum_column_width());
+    if (m_column_widths[column] == width) return;
+
+    m_column_widths[column] = width;
+    update_column_lefts(column);
+
+    // Cells keep their binding, only their bounds change
+    discard_layout();
+}
+
+void DataGrid::update_column_lefts(size_t first_column)
+{
+    for (auto column = first_column; column < m_column_widths.size(); column++) {
+        m_column_lefts[column + 1] = m_column_lefts[column] + m_column_widths[column];
+    }
+}
+
+size_t DataGrid::column_at(float x) const
+{
+    // Lefts are ascending, the column is the last one starting at or before x
+    auto it = std::upper_bound(m_column_lefts.begin(), m_column_lefts.end(), x);
+    if (it == m_column_lefts.begin()) return 0;
+    return static_cast<size_t>(it - m_column_lefts.begin()) - 1;
+}
+
+size_t DataGrid::resize_handle_at(D2D1_POINT_2F point) const
+{
+    if (m_column_widths.empty()) return NoColumn;
+
+    auto& bounds = RenderBoundsResource->get_resource(this);
+    if (point.y < bounds.top || point.y >= bounds.top + header_height()) return NoColumn;
+
+    // The edge nearest to the pointer is the right edge of the column before it
+    auto x = point.x - bounds.left + m_horizontal_offset;
+    auto column = column_at(x + ResizeHandleReach);
+    if (column == 0) return NoColumn;
+
+    auto edge = m_column_lefts[column];
+    if (std::abs(edge - x) > ResizeHandleReach) return NoColumn;
+    return (std::min)(column, m_column_widths.size()) - 1;
+}
+
+//
+// Sorting
+//
+
+void DataGrid::sort_by(size_t column, SortDirection direction)
+{
+    m_sort_column = direction == SortDirection::None ? NoColumn : column;
+    m_sort_direction = direction;
+
+    apply_sort();
+    m_generation++;
+
+    discard_layout();
+}
+
+void DataGrid::apply_sort()
+{
+    if (m_data_source == nullptr || m_sort_direction == SortDirection::None) {
+        // The identity order is implied, its memory is given back
+        m_row_order.clear();
+        m_row_order.shrink_to_fit();
+        return;
+    }
+
+    auto rows = m_data_source->row_count();
+    if (m_row_order.size() != rows) {
+        m_row_order.resize(rows);
+        std::iota(m_row_order.begin(), m_row_order.end(), 0u);
+    }
+
+    // Only the row permutation is sorted, the columns stay in source order
+    auto sort = [this](auto values) {
+        if (m_sort_direction == SortDirection::Ascending) {
+            std::stable_sort(m_row_order.begin(), m_row_order.end(), [&values](uint32_t a, uint32_t b) { return values[a] < values[b]; });
+        }
+        else {
+            std::stable_sort(m_row_order.begin(), m_row_order.end(), [&values](uint32_t a, uint32_t b) { return values[b] < values[a]; });
+        }
+    };
+
+    switch (m_data_source->column_type(m_sort_column)) {
+    case ColumnType::Int64:
+        sort(m_data_source->int64_values(m_sort_column));
+        break;
+
+    case ColumnType::Double:
+        sort(m_data_source->double_values(m_sort_column));
+        break;
+
+    case ColumnType::Text:
+        sort(m_data_source->text_values(m_sort_column));
+        break;
+    }
+}
+
+//
+// Scrolling
+//
+
+size_t DataGrid::page_rows() const
+{
+    auto& bounds = RenderBoundsResource->get_resource(this);
+    auto height = (bounds.bottom - bounds.top) - header_height();
+    return (std::max)(static_cast<size_t>(height / row_height()), static_cast<size_t>(1));
+}
+
+void DataGrid::scroll_to_row(size_t row)
+{
+    auto rows = m_data_source != nullptr ? m_data_source->row_count() : 0;
+    auto page = page_rows();
+    auto maximum_row = rows > page ? rows - page : 0;
+
+    row = (std::min)(row, maximum_row);
+    if (row == m_first_row) return;
+
+    m_first_row = row;
+    discard_layout();
+}
+
+void DataGrid::scroll_rows(ptrdiff_t rows)
+{
+    if (rows < 0 && static_cast<size_t>(-rows) > m_first_row) {
+        scroll_to_row(0);
+    }
+    else {
+        scroll_to_row(m_first_row + rows);
+    }
+}
+
+void DataGrid::set_horizontal_offset(float offset)
+{
+    auto& bounds = RenderBoundsResource->get_resource(this);
+    auto maximum_offset = (std::max)(extent_width() - (bounds.right - bounds.left), 0.0f);
+
+    offset = (std::clamp)(offset, 0.0f, maximum_offset);
+    if (offset == m_horizontal_offset) return;
+
+    m_horizontal_offset = offset;
+    discard_layout();
+}
+
+//
+// Layout
+//
+
+SIZE_F DataGrid::measure(const SIZE_F& available_size) const
+{
+    // Fills the available space, rows and columns beyond it are scrolled into view
+    return available_size;
+}
+
+DataGrid::VISIBLE_RANGE DataGrid::visible_range(const BOUNDS_F& bounds) const
+{
+    auto rows = m_data_source != nullptr ? m_data_source->row_count() : 0;
+    auto view_width = bounds.right - bounds.left;
+    auto view_height = (std::max)((bounds.bottom - bounds.top) - header_height(), 0.0f);
+
+    VISIBLE_RANGE range{};
+    range.first_row = (std::min)(m_first_row, rows);
+    range.row_count = (std::min)(static_cast<size_t>(std::ceil(view_height / row_height())), rows - range.first_row);
+
+    if (m_column_widths.empty() == false) {
+        range.first_column = column_at(m_horizontal_offset);
+        range.last_column = range.first_column;
+        while (range.last_column < m_column_widths.size() && m_column_lefts[range.last_column] < m_horizontal_offset + view_width) {
+            range.last_column++;
+        }
+    }
+    return range;
+}
+
+void DataGrid::layout(LayoutContext& context) const
+{
+    WidgetBase::layout(context);
+
+    // Which cells are in view depends on the bounds, which are only known here
+    const_cast<DataGrid*>(this)->arrange_cells(context);
+}
+
+void DataGrid::arrange_cells(const LayoutContext& context)
+{
+    auto bounds = context.render_bounds();
+    auto row_height = this->row_height();
+    auto header_height = this->header_height();
+
+    // The viewport may have grown since the offsets were set
+    auto rows = m_data_source != nullptr ? m_data_source->row_count() : 0;
+    auto view_rows = static_cast<size_t>((std::max)((bounds.bottom - bounds.top) - header_height, 0.0f) / row_height);
+    m_first_row = (std::min)(m_first_row, rows > view_rows ? rows - view_rows : 0);
+    m_horizontal_offset = (std::clamp)(m_horizontal_offset, 0.0f, (std::max)(extent_width() - (bounds.right - bounds.left), 0.0f));
+
+    auto range = visible_range(bounds);
+    ensure_capacity(view_rows + 1, range.last_column - range.first_column);
+
+    m_frame++;
+
+    for (auto row = range.first_row; row < range.first_row + range.row_count; row++) {
+        auto top = bounds.top + header_height + (row - range.first_row) * row_height;
+
+        for (auto column = range.first_column; column < range.last_column; column++) {
+            auto& slot = m_cells[(row % m_row_capacity) * m_column_capacity + column % m_column_capacity];
+            if (slot.row != row || slot.column != column || slot.generation != m_generation) {
+                bind_cell(slot, row, column);
+            }
+
+            auto left = bounds.left + m_column_lefts[column] - m_horizontal_offset;
+            context.layout_child(slot.widget, BOUNDS_F{ left, top, left + m_column_widths[column], top + row_height });
+            slot.frame = m_frame;
+        }
+    }
+
+    for (auto column = range.first_column; column < range.last_column; column++) {
+        auto& slot = m_header_cells[column % m_column_capacity];
+        if (slot.column != column || slot.generation != m_generation) {
+            bind_header(slot, column);
+        }
+
+        auto left = bounds.left + m_column_lefts[column] - m_horizontal_offset;
+        context.layout_child(slot.widget, BOUNDS_F{ left, bounds.top, left + m_column_widths[column], bounds.top + header_height });
+        slot.frame = m_frame;
+    }
+
+    // Slots without a cell in view are collapsed, which keeps them from rendering
+    auto collapse = [this, &context](CELL_SLOT& slot) {
+        if (slot.frame != m_frame) {
+            context.layout_child(slot.widget, BOUNDS_F{ 0.0f, 0.0f, 0.0f, 0.0f });
+        }
+    };
+    std::for_each(m_cells.begin(), m_cells.end(), collapse);
+    std::for_each(m_header_cells.begin(), m_header_cells.end(), collapse);
+}
+
+void DataGrid::ensure_capacity(size_t rows, size_t columns)
+{
+    // Capacity only grows, a smaller viewport leaves the extra slots collapsed
+    rows = (std::max)(rows, m_row_capacity);
+    columns = (std::max)(columns, m_column_capacity);
+    if (rows == m_row_capacity && columns == m_column_capacity) return;
+
+    // The slot of every cell moves with the capacity, existing widgets are reused for the new slots
+    std::vector<std::shared_ptr<GridCellWidget>> widgets;
+    for (auto& slot : m_cells) {
+        widgets.push_back(std::move(slot.widget));
+    }
+
+    m_cells.resize(rows * columns);
+    for (auto& slot : m_cells) {
+        if (widgets.empty()) {
+            slot.widget = adopt_cell(make_element<GridCellWidget>());
+        }
+        else {
+            slot.widget = std::move(widgets.back());
+            widgets.pop_back();
+        }
+    }
+
+    // Header cells are moved to the end of the children so they are rendered over the rows
+    for (auto& slot : m_header_cells) {
+        remove_child(slot.widget);
+        add_child(slot.widget);
+    }
+
+    while (m_header_cells.size() < columns) {
+        auto cell = make_element<GridCellWidget>();
+        cell->set_font_weight(DWRITE_FONT_WEIGHT_SEMI_BOLD);
+        m_header_cells.push_back(CELL_SLOT{ adopt_cell(std::move(cell)) });
+    }
+
+    m_row_capacity = rows;
+    m_column_capacity = columns;
+    m_generation++;
+}
+
+std::shared_ptr<DataGrid::GridCellWidget> DataGrid::adopt_cell(std::shared_ptr<GridCellWidget> cell)
+{
+    add_child(cell);
+    if (render_target() != nullptr) {
+        cell->attach_render_target(render_target(), glyph_atlas());
+        cell->create_resources();
+    }
+    return cell;
+}
+
+void DataGrid::bind_cell(CELL_SLOT& slot, size_t row, size_t column)
+{
+    auto source_row = this->source_row(row);
+
+    std::wstring value;
+    switch (m_data_source->column_type(column)) {
+    case ColumnType::Int64:
+        value = std::to_wstring(m_data_source->int64_values(column)[source_row]);
+        break;
+
+    case ColumnType::Double:
+        value = std::format(L"{}", m_data_source->double_values(column)[source_row]);
+        break;
+
+    case ColumnType::Text:
+        value = std::wstring(m_data_source->text_values(column)[source_row]);
+        break;
+    }
+
+    slot.widget->set_value(std::move(value));
+    slot.row = row;
+    slot.column = column;
+    slot.generation = m_generation;
+}
+
+void DataGrid::bind_header(CELL_SLOT& slot, size_t column)
+{
+    std::wstring value = m_data_source->column_name(column);
+    if (column == m_sort_column) {
+        value += m_sort_direction == SortDirection::Ascending ? L" \u25B2" : L" \u25BC";
+    }
+
+    slot.widget->set_value(std::move(value));
+    slot.column = column;
+    slot.generation = m_generation;
+}
+
+//
+// Rendering
+//
+
+void DataGrid::discard_resources()
+{
+    BackgroundFillResource->invalidate_for(this);
+    HeaderFillResource->invalidate_for(this);
+    GridLineFillResource->invalidate_for(this);
+    LayoutWidgetBase::discard_resources();
+}
+
+void DataGrid::render(const RenderContext& context) const
+{
+    auto& bounds = context.render_bounds();
+    auto& render_target = context.render_target();
+    auto header_bottom = (std::min)(bounds.top + header_height(), bounds.bottom);
+
+    render_target->FillRectangle(Interop::to_d2d(bounds), context.brush(BackgroundFillResource->get_or_initialize_resource(this)));
+    render_target->FillRectangle(D2D1::RectF(bounds.left, bounds.top, bounds.right, header_bottom), context.brush(HeaderFillResource->get_or_initialize_resource(this)));
+
+    // Grid lines are drawn for the cells in view only
+    auto range = visible_range(bounds);
+    auto line_brush = context.brush(GridLineFillResource->get_or_initialize_resource(this));
+
+    auto right = (std::min)(bounds.left + extent_width() - m_horizontal_offset, bounds.right);
+    for (size_t row = 0; row <= range.row_count; row++) {
+        auto y = header_bottom + row * row_height() - 0.5f;
+        render_target->DrawLine(D2D1::Point2F(bounds.left, y), D2D1::Point2F(right, y), line_brush);
+    }
+
+    auto bottom = (std::min)(header_bottom + range.row_count * row_height(), bounds.bottom);
+    for (auto column = range.first_column; column < range.last_column; column++) {
+        auto x = bounds.left + m_column_lefts[column + 1] - m_horizontal_offset - 0.5f;
+        render_target->DrawLine(D2D1::Point2F(x, bounds.top), D2D1::Point2F(x, bottom), line_brush);
+    }
+}
+
+//
+// Interaction
+//
+
+bool DataGrid::handle_pointer_press(D2D1_POINT_2F point)
+{
+    auto resize_column = resize_handle_at(point);
+    if (resize_column != NoColumn) {
+        m_resize_column = resize_column;
+        m_resize_origin = point.x;
+        m_resize_width = m_column_widths[resize_column];
+        return true;
+    }
+
+    auto& bounds = RenderBoundsResource->get_resource(this);
+    if (m_column_widths.empty() || point.y < bounds.top || point.y >= bounds.top + header_height()) return false;
+
+    auto x = point.x - bounds.left + m_horizontal_offset;
+    if (x >= extent_width()) return false;
+
+    // Pressing a header sorts by its column, pressing it again flips the direction
+    auto column = column_at(x);
+    auto direction = column == m_sort_column && m_sort_direction == SortDirection::Ascending
+        ? SortDirection::Descending
+        : SortDirection::Ascending;
+    sort_by(column, direction);
+    return true;
+}
+
+bool DataGrid::handle_pointer_hover(D2D1_POINT_2F point)
+{
+    if (m_resize_column == NoColumn) return false;
+
+    set_column_width(m_resize_column, m_resize_width + point.x - m_resize_origin);
+    return true;
+}
+
+bool DataGrid::handle_pointer_release(D2D1_POINT_2F point)
+{
+    if (m_resize_column == NoColumn) return false;
+
+    m_resize_column = NoColumn;
+    return true;
+}
+
+void DataGrid::handle_pointer_leave()
+{
+    // The release may happen outside of the grid, where it is never told of it. The column keeps the width it was dragged to.
+    m_resize_column = NoColumn;
+}
+
+bool DataGrid::handle_pointer_wheel(D2D1_POINT_2F point, int delta)
+{
+    auto first_row = m_first_row;
+    scroll_rows(-static_cast<ptrdiff_t>(delta) * WheelRows / WHEEL_DELTA);
+    return m_first_row != first_row;
+}
+
+bool DataGrid::handle_key_down(uint32_t key, uint32_t modifiers)
+{
+    auto page = static_cast<ptrdiff_t>(page_rows());
+    auto control = (modifiers & ModifierControl) != 0;
+
+    switch (key) {
+    case VK_UP:
+        scroll_rows(-1);
+        return true;
+
+    case VK_DOWN:
+        scroll_rows(1);
+        return true;
+
+    case VK_PRIOR:
+        scroll_rows(-page);
+        return true;
+
+    case VK_NEXT:
+        scroll_rows(page);
+        return true;
+
+    case VK_HOME:
+        if (control) scroll_to_row(0);
+        else set_horizontal_offset(0.0f);
+        return true;
+
+    case VK_END:
+        if (control) scroll_to_row(m_data_source != nullptr ? m_data_source->row_count() : 0);
+        else set_horizontal_offset(extent_width());
+        return true;
+
+    case VK_LEFT:
+        set_horizontal_offset(m_horizontal_offset - HorizontalStep);
+        return true;
+
+    case VK_RIGHT:
+        set_horizontal_offset(m_horizontal_offset + HorizontalStep);
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,227 @@
+// data_grid.hpp: DataGrid definition
+// DataGrid shows a table read from a column-oriented data source. Rows and columns are virtualized,
+// only the cells in view have widgets and those are rebound as the grid scrolls.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include <Windows.h>
+#include <d2d1.h>
+
+#include "../core/foundation.hpp"
+#include "../core/interop.hpp"
+#include "../core/property.hpp"
+#include "../core/widget.hpp"
+#include "layout_widget.hpp"
+
+namespace DirectWidget {
+    namespace Layouts {
+
+        enum class ColumnType {
+            Int64,
+            Double,
+            Text,
+        };
+
+        // Table data stored by column, every column is a contiguous span of values of its type
+        class ColumnarDataSourceBase {
+        public:
+            virtual ~ColumnarDataSourceBase() = default;
+
+            virtual size_t row_count() const = 0;
+            virtual size_t column_count() const = 0;
+
+            virtual PCWSTR column_name(size_t column) const = 0;
+            virtual ColumnType column_type(size_t column) const = 0;
+
+            // Values of a column of the matching type, spans stay valid until the grid is refreshed
+            virtual std::span<const int64_t> int64_values(size_t column) const { return {}; }
+            virtual std::span<const double> double_values(size_t column) const { return {}; }
+            virtual std::span<const std::wstring_view> text_values(size_t column) const { return {}; }
+        };
+
+        using columnar_data_source_ptr = std::shared_ptr<ColumnarDataSourceBase>;
+
+        enum class SortDirection {
+            None,
+            Ascending,
+            Descending,
+        };
+
+        class DataGrid : public LayoutWidgetBase
+        {
+        public:
+            // properties
+
+            static property_ptr<float> RowHeightProperty;
+            static property_ptr<float> HeaderHeightProperty;
+            static property_ptr<float> DefaultColumnWidthProperty;
+            static property_ptr<float> MinimumColumnWidthProperty;
+            static property_ptr<D2D1_COLOR_F> BackgroundColorProperty;
+            static property_ptr<D2D1_COLOR_F> HeaderColorProperty;
+            static property_ptr<D2D1_COLOR_F> GridLineColorProperty;
+
+            float row_height() const { return get_property(RowHeightProperty); }
+            void set_row_height(float height) { set_property(RowHeightProperty, height); }
+
+            float header_height() const { return get_property(HeaderHeightProperty); }
+            void set_header_height(float height) { set_property(HeaderHeightProperty, height); }
+
+            float default_column_width() const { return get_property(DefaultColumnWidthProperty); }
+            void set_default_column_width(float width) { set_property(DefaultColumnWidthProperty, width); }
+
+            float minimum_column_width() const { return get_property(MinimumColumnWidthProperty); }
+            void set_minimum_column_width(float width) { set_property(MinimumColumnWidthProperty, width); }
+
+            const D2D1_COLOR_F& background_color() const { return get_property(BackgroundColorProperty); }
+            void set_background_color(const D2D1_COLOR_F& color) { set_property(BackgroundColorProperty, color); }
+
+            const D2D1_COLOR_F& header_color() const { return get_property(HeaderColorProperty); }
+            void set_header_color(const D2D1_COLOR_F& color) { set_property(HeaderColorProperty, color); }
+
+            const D2D1_COLOR_F& grid_line_color() const { return get_property(GridLineColorProperty); }
+            void set_grid_line_color(const D2D1_COLOR_F& color) { set_property(GridLineColorProperty, color); }
+
+            DataGrid();
+
+            // data
+
+            const columnar_data_source_ptr& data_source() const { return m_data_source; }
+            void set_data_source(const columnar_data_source_ptr& data_source);
+
+            // Rebinds the cells in view and sorts again, called after values or the row count of the source changed
+            void refresh();
+
+            // Row of the data source shown at display row
+            size_t source_row(size_t display_row) const { return m_row_order.empty() ? display_row : m_row_order[display_row]; }
+
+            // columns
+
+            float column_width(size_t column) const { return m_column_widths[column]; }
+            void set_column_width(size_t column, float width);
+
+            // sorting
+            // Sorting is stable, so sorting by another column keeps the previous order among equal values
+
+            size_t sort_column() const { return m_sort_column; }
+            SortDirection sort_direction() const { return m_sort_direction; }
+            void sort_by(size_t column, SortDirection direction);
+
+            // scrolling
+            // Rows scroll whole, columns scroll by distance
+
+            size_t first_visible_row() const { return m_first_row; }
+            void scroll_to_row(size_t row);
+            void scroll_rows(ptrdiff_t rows);
+
+            float horizontal_offset() const { return m_horizontal_offset; }
+            void set_horizontal_offset(float offset);
+
+            float extent_width() const { return m_column_lefts.back(); }
+
+            // layout
+
+            void layout(LayoutContext& context) const override;
+
+            SIZE_F measure(const SIZE_F& available_size) const override;
+
+            // rendering
+
+            void discard_resources() override;
+
+            // interaction
+
+            bool handle_pointer_press(D2D1_POINT_2F point) override;
+            bool handle_pointer_hover(D2D1_POINT_2F point) override;
+            bool handle_pointer_release(D2D1_POINT_2F point) override;
+            void handle_pointer_leave() override;
+            bool handle_pointer_wheel(D2D1_POINT_2F point, int delta) override;
+            bool handle_key_down(uint32_t key, uint32_t modifiers) override;
+
+        protected:
+            void render(const RenderContext& context) const override;
+            bool paints_under_children() const override { return true; }
+
+        private:
+            static constexpr size_t NoColumn = static_cast<size_t>(-1);
+
+            static Interop::com_resource_ptr<ID2D1SolidColorBrush> BackgroundFillResource;
+            static Interop::com_resource_ptr<ID2D1SolidColorBrush> HeaderFillResource;
+            static Interop::com_resource_ptr<ID2D1SolidColorBrush> GridLineFillResource;
+
+            class GridCellWidget;
+
+            typedef struct {
+                std::shared_ptr<GridCellWidget> widget;
+                // Display row and column the widget shows
+                size_t row;
+                size_t column;
+                // Binding generation, cells of an older generation are rebound
+                uint32_t generation;
+                // Last layout pass the cell was placed in
+                uint32_t frame;
+            } CELL_SLOT;
+
+            typedef struct {
+                size_t first_row;
+                size_t row_count;
+                size_t first_column;
+                size_t last_column;
+            } VISIBLE_RANGE;
+
+            VISIBLE_RANGE visible_range(const BOUNDS_F& bounds) const;
+            size_t page_rows() const;
+
+            // Column whose span holds x, in content coordinates
+            size_t column_at(float x) const;
+
+            // Column whose right edge in the header is within reach of point, NoColumn otherwise
+            size_t resize_handle_at(D2D1_POINT_2F point) const;
+
+            void update_column_lefts(size_t first_column);
+
+            // Places the cells in view, rebinding the ones that show another cell than before
+            void arrange_cells(const LayoutContext& context);
+            void ensure_capacity(size_t rows, size_t columns);
+            void bind_cell(CELL_SLOT& slot, size_t row, size_t column);
+            void bind_header(CELL_SLOT& slot, size_t column);
+            std::shared_ptr<GridCellWidget> adopt_cell(std::shared_ptr<GridCellWidget> cell);
+
+            void apply_sort();
+
+            columnar_data_source_ptr m_data_source;
+
+            std::vector<float> m_column_widths;
+            // Prefix sums of column widths, one more entry than columns
+            std::vector<float> m_column_lefts{ 0.0f };
+
+            // Display order of source rows, empty while unsorted
+            std::vector<uint32_t> m_row_order;
+            size_t m_sort_column = NoColumn;
+            SortDirection m_sort_direction = SortDirection::None;
+
+            size_t m_first_row = 0;
+            float m_horizontal_offset = 0.0f;
+
+            // Cells are assigned to slots by row and column modulo the capacity,
+            // so cells staying in view keep their widget while the grid scrolls
+            std::vector<CELL_SLOT> m_cells;
+            std::vector<CELL_SLOT> m_header_cells;
+            size_t m_row_capacity = 0;
+            size_t m_column_capacity = 0;
+            uint32_t m_generation = 1;
+            uint32_t m_frame = 0;
+
+            size_t m_resize_column = NoColumn;
+            float m_resize_origin = 0.0f;
+            float m_resize_width = 0.0f;
+        };
+
+    }
+}
@@ -0,0 +1,168 @@
+// flex_layout.cpp: FlexLayout implementation
+
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <utility>
+
+#include "../core/foundation.hpp"
+#include "../core/property.hpp"
+#include "../core/widget.hpp"
+#include "flex_layout.hpp"
+
+using namespace DirectWidget;
+using namespace Layouts;
+
+// Measures at or above this size leave the main axis unbounded, nothing wraps, grows or shrinks then
+static constexpr float Unbounded = (std::numeric_limits<float>::max)();
+
+property_ptr<FlexDirection> FlexLayout::DirectionProperty = make_property(FlexDirection::Row);
+property_ptr<bool> FlexLayout::WrapProperty = make_property(false);
+property_ptr<float> FlexLayout::GapProperty = make_property(0.0f);
+property_ptr<float> FlexLayout::LineGapProperty = make_property(0.0f);
+property_ptr<FLEX_ITEM> FlexLayout::ItemProperty = make_property<FLEX_ITEM>({ 0.0f, 1.0f, -1.0f });
+
+FlexLayout::FlexLayout()
+{
+    register_dependency(DirectionProperty);
+    register_dependency(WrapProperty);
+    register_dependency(GapProperty);
+    register_dependency(LineGapProperty);
+}
+
+void FlexLayout::add_child(std::shared_ptr<WidgetBase> widget, const FLEX_ITEM& item)
+{
+    set_item(widget.get(), item);
+    LayoutWidgetBase::add_child(std::move(widget));
+}
+
+static float main_size(const SIZE_F& size, bool row) { return row ? size.width : size.height; }
+static float cross_size(const SIZE_F& size, bool row) { return row ? size.height : size.width; }
+static SIZE_F make_size(float main, float cross, bool row) { return row ? SIZE_F{ main, cross } : SIZE_F{ cross, main }; }
+
+SIZE_F FlexLayout::measure(const SIZE_F& available_size) const
+{
+    auto row = direction() == FlexDirection::Row;
+    auto wrap = this->wrap();
+    auto gap = this->gap();
+
+    auto available_main = main_size(available_size, row);
+    auto available_cross = cross_size(available_size, row);
+    auto bounded = available_main < Unbounded;
+
+    m_entries.resize(m_nodes.size());
+    m_lines.clear();
+
+    // Children are measured and broken into lines in one pass
+    size_t first = 0;
+    auto used = 0.0f;
+    for (size_t i = 0; i < m_nodes.size(); i++) {
+        auto& node = m_nodes[i];
+        auto& item = ItemProperty->get_value(node->widget.get());
+
+        auto constraint = item.basis >= 0.0f ? item.basis : available_main;
+        node->widget->set_maximum_size(make_size(constraint, available_cross, row));
+        node->measure = WidgetBase::MeasureResource->get_or_initialize_resource(node->widget.get());
+
+        auto& entry = m_entries[i];
+        entry.index = i;
+        entry.grow = (std::max)(item.grow, 0.0f);
+        entry.shrink = (std::max)(item.shrink, 0.0f);
+        entry.hypothetical = item.basis >= 0.0f ? item.basis : main_size(node->measure, row);
+        entry.cross = cross_size(node->measure, row);
+
+        if (wrap && bounded && i > first && used + gap + entry.hypothetical > available_main) {
+            close_line(first, i - first, used, available_main, available_cross, bounded);
+            first = i;
+            used = 0.0f;
+        }
+        used += (i > first ? gap : 0.0f) + entry.hypothetical;
+    }
+    if (first < m_nodes.size()) {
+        close_line(first, m_nodes.size() - first, used, available_main, available_cross, bounded);
+    }
+
+    auto main = 0.0f;
+    auto cross = 0.0f;
+    for (auto& line : m_lines) {
+        main = (std::max)(main, line.main);
+        cross += line.cross;
+    }
+    if (m_lines.size() > 1) {
+        cross += line_gap() * (m_lines.size() - 1);
+    }
+
+    return make_size(main, cross, row);
+}
+
+void FlexLayout::close_line(size_t first, size_t count, float used, float available_main, float available_cross, bool bounded) const
+{
+    auto row = direction() == FlexDirection::Row;
+    auto last = first + count;
+
+    auto free = bounded ? available_main - used : 0.0f;
+    auto grow = 0.0f;
+    auto shrink = 0.0f;
+    for (auto i = first; i < last; i++) {
+        grow += m_entries[i].grow;
+        shrink += m_entries[i].shrink * m_entries[i].hypothetical;
+    }
+
+    FLEX_LINE line{ first, count, 0.0f, 0.0f };
+    for (auto i = first; i < last; i++) {
+        auto& entry = m_entries[i];
+
+        entry.main = entry.hypothetical;
+        if (free > 0.0f && grow > 0.0f) {
+            entry.main += free * entry.grow / grow;
+        }
+        else if (free < 0.0f && shrink > 0.0f) {
+            entry.main = (std::max)(entry.main + free * entry.shrink * entry.hypothetical / shrink, 0.0f);
+        }
+
+        // More room than measured leaves the content as it was, less may wrap it and change its cross size
+        auto& node = m_nodes[entry.index];
+        if (entry.main < main_size(node->measure, row) - 0.5f) {
+            node->widget->discard_measure();
+            node->widget->set_maximum_size(make_size(entry.main, available_cross, row));
+            node->measure = WidgetBase::MeasureResource->get_or_initialize_resource(node->widget.get());
+            entry.cross = cross_size(node->measure, row);
+        }
+
+        line.main += entry.main;
+        line.cross = (std::max)(line.cross, entry.cross);
+    }
+    line.main += gap() * (count - 1);
+
+    m_lines.push_back(line);
+}
+
+void FlexLayout::layout(LayoutContext& context) const
+{
+    WidgetBase::layout(context);
+
+    // Entries refer to children by index, they are only valid for the children they were measured with
+    if (m_entries.size() != m_nodes.size()) return;
+
+    auto bounds = context.render_bounds();
+    auto row = direction() == FlexDirection::Row;
+    auto gap = this->gap();
+    auto line_gap = this->line_gap();
+
+    auto cross_position = row ? bounds.top : bounds.left;
+    for (auto& line : m_lines) {
+        auto main_position = row ? bounds.left : bounds.top;
+
+        for (auto i = line.first; i < line.first + line.count; i++) {
+            auto& entry = m_entries[i];
+            auto constraints = row
+                ? BOUNDS_F{ main_position, cross_position, main_position + entry.main, cross_position + line.cross }
+                : BOUNDS_F{ cross_position, main_position, cross_position + line.cross, main_position + entry.main };
+
+            context.layout_child(m_nodes[entry.index]->widget, constraints);
+            main_position += entry.main + gap;
+        }
+
+        cross_position += line.cross + line_gap;
+    }
+}
@@ -0,0 +1,103 @@
+// flex_layout.hpp: FlexLayout definition
+// FlexLayout places its children in a row or column, optionally wrapping them into several lines.
+// Free space of a line is distributed by the grow and shrink factors of its children.
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "../core/foundation.hpp"
+#include "../core/property.hpp"
+#include "../core/widget.hpp"
+#include "layout_widget.hpp"
+
+namespace DirectWidget {
+    namespace Layouts {
+
+        enum class FlexDirection {
+            Row,
+            Column,
+        };
+
+        typedef struct {
+            // Share of the free space a child grows by
+            float grow;
+            // Share of the missing space a child shrinks by, weighted by its basis
+            float shrink;
+            // Main axis size before growing or shrinking, negative to use the measured size
+            float basis;
+        } FLEX_ITEM;
+
+        class FlexLayout : public LayoutWidgetBase
+        {
+        public:
+            // properties
+
+            static property_ptr<FlexDirection> DirectionProperty;
+            static property_ptr<bool> WrapProperty;
+
+            // Space between children of a line, and between lines
+            static property_ptr<float> GapProperty;
+            static property_ptr<float> LineGapProperty;
+
+            // Flex factors of a child, set on the child
+            static property_ptr<FLEX_ITEM> ItemProperty;
+
+            FlexDirection direction() const { return get_property(DirectionProperty); }
+            void set_direction(FlexDirection direction) { set_property(DirectionProperty, direction); }
+
+            bool wrap() const { return get_property(WrapProperty); }
+            void set_wrap(bool wrap) { set_property(WrapProperty, wrap); }
+
+            float gap() const { return get_property(GapProperty); }
+            void set_gap(float gap) { set_property(GapProperty, gap); }
+
+            float line_gap() const { return get_property(LineGapProperty); }
+            void set_line_gap(float gap) { set_property(LineGapProperty, gap); }
+
+            static const FLEX_ITEM& item(const WidgetBase* widget) { return ItemProperty->get_value(widget); }
+            static void set_item(const WidgetBase* widget, const FLEX_ITEM& item) { ItemProperty->set_value(widget, item); }
+
+            FlexLayout();
+
+            // children
+
+            using LayoutWidgetBase::add_child;
+            void add_child(std::shared_ptr<WidgetBase> widget, const FLEX_ITEM& item);
+
+            // layout
+
+            void layout(LayoutContext& context) const override;
+
+            SIZE_F measure(const SIZE_F& available_size) const override;
+
+        private:
+            typedef struct {
+                // Index of the child in m_nodes
+                size_t index;
+                float grow;
+                float shrink;
+                // Size before and after distributing the free space of the line
+                float hypothetical;
+                float main;
+                float cross;
+            } FLEX_ENTRY;
+
+            typedef struct {
+                size_t first;
+                size_t count;
+                float main;
+                float cross;
+            } FLEX_LINE;
+
+            void close_line(size_t first, size_t count, float used, float available_main, float available_cross, bool bounded) const;
+
+            // Children and lines of the last measure, in child order
+            mutable std::vector<FLEX_ENTRY> m_entries;
+            mutable std::vector<FLEX_LINE> m_lines;
+        };
+
+    }
+}
@@ -0,0 +1,406 @@
+// grid_layout.cpp: GridLayout implementation
+
+#include <algorithm>
+#include <cwchar>
+#include <limits>
+#include <memory>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../core/foundation.hpp"
+#include "../core/property.hpp"
+#include "../core/widget.hpp"
+#include "grid_layout.hpp"
+
+using namespace DirectWidget;
+using namespace Layouts;
+
+//
+// SharedSizeScope
+//
+
+float SharedSizeScope::group_size(const std::wstring& group) const
+{
+    auto it = m_groups.find(group);
+    if (it == m_groups.end()) return 0.0f;
+    return it->second.size;
+}
+
+float SharedSizeScope::publish(GridLayout* grid, PCWSTR name, float size)
+{
+    auto& group = m_groups[name];
+
+    auto contribution = std::find_if(group.contributions.begin(), group.contributions.end(),
+        [grid](const CONTRIBUTION& contribution) { return contribution.grid == grid; });
+    if (contribution == group.contributions.end()) {
+        group.contributions.push_back({ grid, size });
+    }
+    else if (contribution->size == size) {
+        return group.size;
+    }
+    else {
+        contribution->size = size;
+    }
+
+    update_group(group, grid);
+    return group.size;
+}
+
+void SharedSizeScope::withdraw(GridLayout* grid)
+{
+    for (auto& [name, group] : m_groups) {
+        auto it = std::remove_if(group.contributions.begin(), group.contributions.end(),
+            [grid](const CONTRIBUTION& contribution) { return contribution.grid == grid; });
+        if (it == group.contributions.end()) continue;
+
+        group.contributions.erase(it, group.contributions.end());
+        update_group(group, grid);
+    }
+}
+
+void SharedSizeScope::update_group(GROUP& group, const GridLayout* source)
+{
+    auto size = 0.0f;
+    for (auto& contribution : group.contributions) {
+        size = (std::max)(size, contribution.size);
+    }
+    if (size == group.size) return;
+
+    // Grids that already used the previous size take the new one when they are measured again.
+    // Their ancestors were measured around the old size, so their measures are dropped too and layout is redone
+    // from the topmost one, as the layout scheduler does for deferred measures.
+    // A remeasured grid publishes what its children need again, the group only changes again when that differs.
+    group.size = size;
+    for (auto& contribution : group.contributions) {
+        if (contribution.grid != source) {
+            contribution.grid->discard_measure();
+            contribution.grid->discard_ancestor_measures()->discard_layout();
+        }
+    }
+}
+
+//
+// GridLayout
+//
+
+// Measures at or above this size leave a direction unbounded, star tracks are then sized to their content
+static constexpr float Unbounded = (std::numeric_limits<float>::max)();
+
+static const GRID_TRACK DefaultTracks[] = { make_star_track() };
+
+property_ptr<GRID_CELL> GridLayout::CellProperty = make_property<GRID_CELL>({ 0, 0, 1, 1 });
+
+GridLayout::~GridLayout()
+{
+    if (m_shared_size_scope != nullptr) {
+        m_shared_size_scope->withdraw(this);
+    }
+}
+
+void GridLayout::add_row(const GRID_TRACK& track)
+{
+    m_rows.push_back(track);
+    if (m_shared_size_scope != nullptr) m_shared_size_scope->withdraw(this);
+    discard_measure();
+}
+
+void GridLayout::add_column(const GRID_TRACK& track)
+{
+    m_columns.push_back(track);
+    if (m_shared_size_scope != nullptr) m_shared_size_scope->withdraw(this);
+    discard_measure();
+}
+
+void GridLayout::set_row(size_t index, const GRID_TRACK& track)
+{
+    m_rows[index] = track;
+    if (m_shared_size_scope != nullptr) m_shared_size_scope->withdraw(this);
+    discard_measure();
+}
+
+void GridLayout::set_column(size_t index, const GRID_TRACK& track)
+{
+    m_columns[index] = track;
+    if (m_shared_size_scope != nullptr) m_shared_size_scope->withdraw(this);
+    discard_measure();
+}
+
+void GridLayout::add_child(std::shared_ptr<WidgetBase> widget, const GRID_CELL& cell)
+{
+    set_cell(widget.get(), cell);
+    LayoutWidgetBase::add_child(std::move(widget));
+}
+
+void GridLayout::set_shared_size_scope(const shared_size_scope_ptr& scope)
+{
+    if (m_shared_size_scope != nullptr) {
+        m_shared_size_scope->withdraw(this);
+    }
+    m_shared_size_scope = scope;
+    discard_measure();
+}
+
+std::span<const GRID_TRACK> GridLayout::effective_rows() const
+{
+    if (m_rows.empty()) return DefaultTracks;
+    return m_rows;
+}
+
+std::span<const GRID_TRACK> GridLayout::effective_columns() const
+{
+    if (m_columns.empty()) return DefaultTracks;
+    return m_columns;
+}
+
+GRID_CELL GridLayout::placement(const WidgetBase* widget, size_t rows, size_t columns)
+{
+    auto cell = CellProperty->get_value(widget);
+    cell.row = (std::min)(cell.row, rows - 1);
+    cell.column = (std::min)(cell.column, columns - 1);
+    cell.row_span = (std::clamp)(cell.row_span, static_cast<size_t>(1), rows - cell.row);
+    cell.column_span = (std::clamp)(cell.column_span, static_cast<size_t>(1), columns - cell.column);
+    return cell;
+}
+
+//
+// Track sizing
+//
+
+void GridLayout::begin_axis(std::span<const GRID_TRACK> tracks, AXIS& axis)
+{
+    auto count = tracks.size();
+    axis.sizes.assign(count, 0.0f);
+    axis.pixel_sums.resize(count + 1);
+    axis.flexible_counts.resize(count + 1);
+    axis.star_counts.resize(count + 1);
+
+    axis.pixel_sums[0] = 0.0f;
+    axis.flexible_counts[0] = 0;
+    axis.star_counts[0] = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        auto pixel = tracks[i].unit == GridUnit::Pixel;
+        if (pixel) {
+            axis.sizes[i] = tracks[i].value;
+        }
+
+        axis.pixel_sums[i + 1] = axis.pixel_sums[i] + axis.sizes[i];
+        axis.flexible_counts[i + 1] = axis.flexible_counts[i] + (pixel ? 0 : 1);
+        axis.star_counts[i + 1] = axis.star_counts[i] + (tracks[i].unit == GridUnit::Star ? 1 : 0);
+    }
+}
+
+float GridLayout::span_constraint(const AXIS& axis, size_t first, size_t count, float available)
+{
+    auto last = first + count;
+    auto pixels = axis.pixel_sums[last] - axis.pixel_sums[first];
+    if (axis.flexible_counts[last] == axis.flexible_counts[first]) return pixels;
+
+    // Other tracks of the span may take what the pixel tracks outside of it leave
+    auto outside = axis.pixel_sums.back() - pixels;
+    return (std::max)(available - outside, pixels);
+}
+
+bool GridLayout::contribute_single(std::span<const GRID_TRACK> tracks, AXIS& axis, size_t index, size_t count, float size, bool bounded)
+{
+    if (count > 1) return false;
+
+    // Star tracks only follow their content when there is no space to share
+    auto unit = tracks[index].unit;
+    if (unit == GridUnit::Auto || (unit == GridUnit::Star && bounded == false)) {
+        axis.sizes[index] = (std::max)(axis.sizes[index], size);
+    }
+    return true;
+}
+
+void GridLayout::contribute_span(std::span<const GRID_TRACK> tracks, AXIS& axis, size_t first, size_t count, float size, bool bounded)
+{
+    auto last = first + count;
+
+    // Children spanning a star track fill it instead of growing the auto tracks next to it
+    if (bounded && axis.star_counts[last] != axis.star_counts[first]) return;
+
+    auto flexible = axis.flexible_counts[last] - axis.flexible_counts[first];
+    if (flexible == 0) return;
+
+    auto spanned = 0.0f;
+    for (auto i = first; i < last; i++) {
+        spanned += axis.sizes[i];
+    }
+    if (size <= spanned) return;
+
+    // The missing space is spread evenly over the content sized tracks of the span
+    auto share = (size - spanned) / flexible;
+    for (auto i = first; i < last; i++) {
+        if (tracks[i].unit != GridUnit::Pixel) {
+            axis.sizes[i] += share;
+        }
+    }
+}
+
+void GridLayout::share_sizes(std::span<const GRID_TRACK> tracks, AXIS& axis) const
+{
+    // Groups are few, a linear search by name is cheaper than hashing
+    std::vector<std::pair<PCWSTR, float>> groups;
+    auto find_group = [&groups](PCWSTR name) {
+        return std::find_if(groups.begin(), groups.end(), [name](const std::pair<PCWSTR, float>& group) {
+            return std::wcscmp(group.first, name) == 0;
+            });
+    };
+
+    for (size_t i = 0; i < tracks.size(); i++) {
+        auto name = tracks[i].shared_size_group;
+        if (name == nullptr || tracks[i].unit == GridUnit::Star) continue;
+
+        auto group = find_group(name);
+        if (group == groups.end()) {
+            groups.emplace_back(name, axis.sizes[i]);
+        }
+        else {
+            group->second = (std::max)(group->second, axis.sizes[i]);
+        }
+    }
+    if (groups.empty()) return;
+
+    if (m_shared_size_scope != nullptr) {
+        // The scope calls back into grids to discard their measure, so it keeps them mutable
+        auto grid = const_cast<GridLayout*>(this);
+        for (auto& group : groups) {
+            group.second = m_shared_size_scope->publish(grid, group.first, group.second);
+        }
+    }
+
+    for (size_t i = 0; i < tracks.size(); i++) {
+        auto name = tracks[i].shared_size_group;
+        if (name == nullptr || tracks[i].unit == GridUnit::Star) continue;
+
+        axis.sizes[i] = find_group(name)->second;
+    }
+}
+
+void GridLayout::resolve_stars(std::span<const GRID_TRACK> tracks, AXIS& axis, float available, bool bounded)
+{
+    auto weights = 0.0f;
+    auto fixed = 0.0f;
+    for (size_t i = 0; i < tracks.size(); i++) {
+        if (tracks[i].unit == GridUnit::Star) {
+            weights += (std::max)(tracks[i].value, 0.0f);
+        }
+        else {
+            fixed += axis.sizes[i];
+        }
+    }
+    if (weights <= 0.0f) return;
+
+    if (bounded) {
+        auto remaining = (std::max)(available - fixed, 0.0f);
+        for (size_t i = 0; i < tracks.size(); i++) {
+            if (tracks[i].unit == GridUnit::Star) {
+                axis.sizes[i] = remaining * (std::max)(tracks[i].value, 0.0f) / weights;
+            }
+        }
+        return;
+    }
+
+    // Unbounded, star tracks keep their weights relative to each other at the size of the largest content per weight
+    auto unit = 0.0f;
+    for (size_t i = 0; i < tracks.size(); i++) {
+        if (tracks[i].unit == GridUnit::Star && tracks[i].value > 0.0f) {
+            unit = (std::max)(unit, axis.sizes[i] / tracks[i].value);
+        }
+    }
+    for (size_t i = 0; i < tracks.size(); i++) {
+        if (tracks[i].unit == GridUnit::Star) {
+            axis.sizes[i] = unit * (std::max)(tracks[i].value, 0.0f);
+        }
+    }
+}
+
+float GridLayout::finish_axis(AXIS& axis)
+{
+    axis.offsets.resize(axis.sizes.size() + 1);
+    axis.offsets[0] = 0.0f;
+    for (size_t i = 0; i < axis.sizes.size(); i++) {
+        axis.offsets[i + 1] = axis.offsets[i] + axis.sizes[i];
+    }
+    return axis.offsets.back();
+}
+
+//
+// Layout
+//
+
+SIZE_F GridLayout::measure(const SIZE_F& available_size) const
+{
+    auto rows = effective_rows();
+    auto columns = effective_columns();
+    auto bounded_width = available_size.width < Unbounded;
+    auto bounded_height = available_size.height < Unbounded;
+
+    begin_axis(columns, m_column_axis);
+    begin_axis(rows, m_row_axis);
+    m_spanning_columns.clear();
+    m_spanning_rows.clear();
+
+    // Every child is measured once, with the space its cell can have before content sized tracks are known
+    for (auto& node : m_nodes) {
+        auto cell = placement(node->widget.get(), rows.size(), columns.size());
+
+        node->widget->set_maximum_size(SIZE_F{
+            span_constraint(m_column_axis, cell.column, cell.column_span, available_size.width),
+            span_constraint(m_row_axis, cell.row, cell.row_span, available_size.height) });
+        node->measure = WidgetBase::MeasureResource->get_or_initialize_resource(node->widget.get());
+
+        if (contribute_single(columns, m_column_axis, cell.column, cell.column_span, node->measure.width, bounded_width) == false) {
+            m_spanning_columns.push_back(node.get());
+        }
+        if (contribute_single(rows, m_row_axis, cell.row, cell.row_span, node->measure.height, bounded_height) == false) {
+            m_spanning_rows.push_back(node.get());
+        }
+    }
+
+    // Spanning children only add what the single track children did not already provide
+    for (auto node : m_spanning_columns) {
+        auto cell = placement(node->widget.get(), rows.size(), columns.size());
+        contribute_span(columns, m_column_axis, cell.column, cell.column_span, node->measure.width, bounded_width);
+    }
+    for (auto node : m_spanning_rows) {
+        auto cell = placement(node->widget.get(), rows.size(), columns.size());
+        contribute_span(rows, m_row_axis, cell.row, cell.row_span, node->measure.height, bounded_height);
+    }
+
+    share_sizes(columns, m_column_axis);
+    share_sizes(rows, m_row_axis);
+
+    resolve_stars(columns, m_column_axis, available_size.width, bounded_width);
+    resolve_stars(rows, m_row_axis, available_size.height, bounded_height);
+
+    return SIZE_F{ finish_axis(m_column_axis), finish_axis(m_row_axis) };
+}
+
+void GridLayout::layout(LayoutContext& context) const
+{
+    WidgetBase::layout(context);
+
+    auto bounds = context.render_bounds();
+    auto rows = effective_rows();
+    auto columns = effective_columns();
+
+    // Star tracks share what the final bounds leave, other tracks keep their measured size
+    resolve_stars(columns, m_column_axis, bounds.right - bounds.left, true);
+    resolve_stars(rows, m_row_axis, bounds.bottom - bounds.top, true);
+    finish_axis(m_column_axis);
+    finish_axis(m_row_axis);
+
+    for (auto& node : m_nodes) {
+        auto cell = placement(node->widget.get(), rows.size(), columns.size());
+
+        context.layout_child(node->widget, BOUNDS_F{
+            bounds.left + m_column_axis.offsets[cell.column],
+            bounds.top + m_row_axis.offsets[cell.row],
+            bounds.left + m_column_axis.offsets[cell.column + cell.column_span],
+            bounds.top + m_row_axis.offsets[cell.row + cell.row_span] });
+    }
+}
@@ -0,0 +1,180 @@
+// grid_layout.hpp: GridLayout definition
+// GridLayout arranges its children in cells of rows and columns. Tracks are sized in pixels, to their content,
+// or as weighted shares of the remaining space. Auto tracks of different grids can share their size through a scope.
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <Windows.h>
+
+#include "../core/foundation.hpp"
+#include "../core/property.hpp"
+#include "../core/widget.hpp"
+#include "layout_widget.hpp"
+
+namespace DirectWidget {
+    namespace Layouts {
+
+        enum class GridUnit {
+            Pixel,
+            Auto,
+            Star,
+        };
+
+        typedef struct {
+            GridUnit unit;
+            // Size in pixels, or the weight of a star track
+            float value;
+            // Tracks of the same group get the same size, nullptr for none. Star tracks ignore it.
+            PCWSTR shared_size_group;
+        } GRID_TRACK;
+
+        inline GRID_TRACK make_pixel_track(float size, PCWSTR shared_size_group = nullptr) {
+            return { GridUnit::Pixel, size, shared_size_group };
+        }
+
+        inline GRID_TRACK make_auto_track(PCWSTR shared_size_group = nullptr) {
+            return { GridUnit::Auto, 0.0f, shared_size_group };
+        }
+
+        inline GRID_TRACK make_star_track(float weight = 1.0f) {
+            return { GridUnit::Star, weight, nullptr };
+        }
+
+        typedef struct {
+            size_t row;
+            size_t column;
+            size_t row_span;
+            size_t column_span;
+        } GRID_CELL;
+
+        class GridLayout;
+
+        // Shares the size of track groups between the grids it is set on,
+        // a group gets the largest size any of the grids needs for it
+        class SharedSizeScope {
+        public:
+            float group_size(const std::wstring& group) const;
+
+            // Records the size grid needs for group and returns the size of the group.
+            // Other grids of the group are measured again when the group size changed.
+            float publish(GridLayout* grid, PCWSTR group, float size);
+
+            void withdraw(GridLayout* grid);
+
+        private:
+            typedef struct {
+                GridLayout* grid;
+                float size;
+            } CONTRIBUTION;
+
+            typedef struct {
+                std::vector<CONTRIBUTION> contributions;
+                float size;
+            } GROUP;
+
+            void update_group(GROUP& group, const GridLayout* source);
+
+            std::unordered_map<std::wstring, GROUP> m_groups;
+        };
+
+        using shared_size_scope_ptr = std::shared_ptr<SharedSizeScope>;
+
+        class GridLayout : public LayoutWidgetBase
+        {
+        public:
+            // properties
+
+            // Cell of a child, set on the child. Indices past the last track are clamped to it.
+            static property_ptr<GRID_CELL> CellProperty;
+
+            static const GRID_CELL& cell(const WidgetBase* widget) { return CellProperty->get_value(widget); }
+            static void set_cell(const WidgetBase* widget, const GRID_CELL& cell) { CellProperty->set_value(widget, cell); }
+
+            GridLayout() = default;
+            ~GridLayout();
+
+            // tracks
+            // A grid without rows or columns has a single star track in that direction
+
+            std::span<const GRID_TRACK> rows() const { return m_rows; }
+            std::span<const GRID_TRACK> columns() const { return m_columns; }
+
+            void add_row(const GRID_TRACK& track);
+            void add_column(const GRID_TRACK& track);
+
+            void set_row(size_t index, const GRID_TRACK& track);
+            void set_column(size_t index, const GRID_TRACK& track);
+
+            // Sizes resolved by the last layout
+            std::span<const float> row_sizes() const { return m_row_axis.sizes; }
+            std::span<const float> column_sizes() const { return m_column_axis.sizes; }
+
+            // children
+
+            using LayoutWidgetBase::add_child;
+            void add_child(std::shared_ptr<WidgetBase> widget, const GRID_CELL& cell);
+
+            // shared size
+
+            const shared_size_scope_ptr& shared_size_scope() const { return m_shared_size_scope; }
+            void set_shared_size_scope(const shared_size_scope_ptr& scope);
+
+            // layout
+
+            void layout(LayoutContext& context) const override;
+
+            SIZE_F measure(const SIZE_F& available_size) const override;
+
+        private:
+            typedef struct {
+                std::vector<float> sizes;
+                std::vector<float> offsets;
+                // Pixel sizes and non-pixel track counts summed over the tracks before each index
+                std::vector<float> pixel_sums;
+                std::vector<size_t> flexible_counts;
+                std::vector<size_t> star_counts;
+            } AXIS;
+
+            // Sizes pixel tracks and clears the others
+            static void begin_axis(std::span<const GRID_TRACK> tracks, AXIS& axis);
+
+            // Space a child spanning the tracks is measured with, pixel tracks alone bound it exactly
+            static float span_constraint(const AXIS& axis, size_t first, size_t count, float available);
+
+            // Grows content sized tracks to a measured child, returns false when the child spans several of them
+            static bool contribute_single(std::span<const GRID_TRACK> tracks, AXIS& axis, size_t index, size_t count, float size, bool bounded);
+            static void contribute_span(std::span<const GRID_TRACK> tracks, AXIS& axis, size_t first, size_t count, float size, bool bounded);
+
+            void share_sizes(std::span<const GRID_TRACK> tracks, AXIS& axis) const;
+
+            static void resolve_stars(std::span<const GRID_TRACK> tracks, AXIS& axis, float available, bool bounded);
+            static float finish_axis(AXIS& axis);
+
+            std::span<const GRID_TRACK> effective_rows() const;
+            std::span<const GRID_TRACK> effective_columns() const;
+
+            // Cell of a child clamped to the tracks of the grid
+            static GRID_CELL placement(const WidgetBase* widget, size_t rows, size_t columns);
+
+            std::vector<GRID_TRACK> m_rows;
+            std::vector<GRID_TRACK> m_columns;
+
+            shared_size_scope_ptr m_shared_size_scope;
+
+            mutable AXIS m_row_axis;
+            mutable AXIS m_column_axis;
+
+            // Children spanning several content sized tracks, resolved after the single track children
+            mutable std::vector<LAYOUT_NODE*> m_spanning_rows;
+            mutable std::vector<LAYOUT_NODE*> m_spanning_columns;
+        };
+
+    }
+}
@@ -44,6 +44,11 @@ void LayoutWidgetBase::add_child(std::shared_ptr<WidgetBase> widget) {
     register_child(widget);
 }
 
+void LayoutWidgetBase::add_child(std::shared_ptr<WidgetBase> widget, uint64_t sibling_order) {
+    add_to_collection(ChildrenProperty, widget);
+    register_child(widget, sibling_order);
+}
+
 void LayoutWidgetBase::remove_child(std::shared_ptr<WidgetBase> widget) { 
     remove_from_collection(ChildrenProperty, widget);
     detach_child(widget);
@@ -64,48 +69,3 @@ void LayoutWidgetBase::discard_resources()
         node->widget->discard_resources();
     }
 }
-
-bool LayoutWidgetBase::handle_pointer_hover(D2D1_POINT_2F point)
-{
-    for (auto& node : m_nodes)
-    {
-        if (node->widget->hit_test(point))
-        {
-            if (node->widget->handle_pointer_hover(point)) {
-                return true;
-            }
-        }
-    }
-
-    return false;
-}
-
-bool LayoutWidgetBase::handle_pointer_press(D2D1_POINT_2F point)
-{
-    for (auto& node : m_nodes)
-    {
-        if (node->widget->hit_test(point))
-        {
-            if (node->widget->handle_pointer_press(point)) {
-                return true;
-            }
-        }
-    }
-
-    return false;
-}
-
-bool LayoutWidgetBase::handle_pointer_release(D2D1_POINT_2F point)
-{
-    for (auto& node : m_nodes)
-    {
-        if (node->widget->hit_test(point))
-        {
-            if (node->widget->handle_pointer_release(point)) {
-                return true;
-            }
-        }
-    }
-
-    return false;
-}
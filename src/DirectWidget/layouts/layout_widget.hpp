@@ -3,9 +3,10 @@
 
 #pragma once
 
+#include <cstdint>
 #include <memory>
+#include <span>
 #include <vector>
-#include <functional>
 
 #include "../core/foundation.hpp"
 #include "../core/property.hpp"
@@ -44,18 +45,17 @@ namespace DirectWidget {
             void create_resources() override;
             void discard_resources() override;
 
-            // interaction
+            // children
 
-            bool handle_pointer_hover(D2D1_POINT_2F point) override;
-            bool handle_pointer_press(D2D1_POINT_2F point) override;
-            bool handle_pointer_release(D2D1_POINT_2F point) override;
+            std::span<const widget_ptr> children() const override { return ChildrenProperty->get_values(this); }
 
         protected:
             LayoutWidgetBase() {
                 register_dependency(ChildrenProperty);
             }
 
-            void for_each_child(std::function<void(WidgetBase*)> callback) const override { for (auto& node : m_nodes) { callback(node->widget.get()); } }
+            // Adds a child listed in children() by sibling_order rather than after the children added before it
+            void add_child(std::shared_ptr<WidgetBase> widget, uint64_t sibling_order);
 
             std::vector<std::unique_ptr<LAYOUT_NODE>> m_nodes;
 
@@ -0,0 +1,147 @@
+// scroll_viewer.cpp: ScrollViewer implementation
+
+#include <algorithm>
+#include <limits>
+#include <memory>
+
+#include <Windows.h>
+#include <d2d1.h>
+#include <d2d1helper.h>
+
+#include "../core/foundation.hpp"
+#include "../core/interop.hpp"
+#include "../core/property.hpp"
+#include "../core/widget.hpp"
+#include "scroll_viewer.hpp"
+
+using namespace DirectWidget;
+using namespace Layouts;
+
+property_ptr<float> ScrollViewer::WheelStepProperty = make_property(48.0f);
+property_ptr<D2D1_COLOR_F> ScrollViewer::BackgroundColorProperty = make_property<D2D1_COLOR_F>(D2D1::ColorF(D2D1::ColorF::White));
+
+Interop::com_resource_ptr<ID2D1SolidColorBrush> ScrollViewer::BackgroundFillResource = std::make_shared<Interop::SolidColorBrushResource>(BackgroundColorProperty);
+
+ScrollViewer::ScrollViewer()
+{
+    register_dependency(WheelStepProperty);
+    register_dependency(BackgroundColorProperty);
+
+    register_dependency(BackgroundFillResource);
+}
+
+void ScrollViewer::replace_content(const widget_ptr& content, ScrollableBase* scrollable)
+{
+    auto previous = this->content();
+    if (previous != nullptr) {
+        remove_child(previous);
+    }
+
+    m_scrollable = scrollable;
+    m_offset = 0.0f;
+
+    if (content != nullptr) {
+        add_child(content);
+    }
+}
+
+float ScrollViewer::viewport_height() const
+{
+    auto& bounds = RenderBoundsResource->get_resource(this);
+    return bounds.bottom - bounds.top;
+}
+
+float ScrollViewer::extent_height() const
+{
+    if (m_scrollable != nullptr) return m_scrollable->extent_height();
+    if (m_nodes.empty()) return 0.0f;
+    return m_nodes.front()->measure.height;
+}
+
+float ScrollViewer::vertical_offset() const
+{
+    if (m_scrollable != nullptr) return m_scrollable->vertical_offset();
+    return m_offset;
+}
+
+void ScrollViewer::set_vertical_offset(float offset)
+{
+    scroll_by(offset - vertical_offset());
+}
+
+void ScrollViewer::scroll_by(float delta)
+{
+    auto offset = vertical_offset();
+
+    if (m_scrollable != nullptr) {
+        m_scrollable->scroll_by(delta);
+    }
+    else {
+        auto maximum_offset = (std::max)(extent_height() - viewport_height(), 0.0f);
+        m_offset = (std::clamp)(m_offset + delta, 0.0f, maximum_offset);
+    }
+
+    if (vertical_offset() == offset) return;
+
+    // Scrollable content lays itself out again, plain content is moved here. Measures are kept either way.
+    // Tiled content keeps its layout and moves by its render transform, only tiles coming into view are rasterized.
+    if (m_scrollable != nullptr) {
+        discard_frame();
+    }
+    else if (content()->is_tiled()) {
+        content()->set_render_transform(D2D1::Matrix3x2F::Translation(0, -m_offset));
+    }
+    else {
+        discard_layout();
+    }
+}
+
+void ScrollViewer::layout(LayoutContext& context) const
+{
+    WidgetBase::layout(context);
+    if (m_nodes.empty()) return;
+
+    auto bounds = context.render_bounds();
+    auto& node = m_nodes.front();
+
+    if (m_scrollable != nullptr) {
+        context.layout_child(node->widget, bounds);
+        return;
+    }
+
+    // Plain content is laid out at its full height and moved by the offset, the render clip of the viewer cuts it
+    auto top = node->widget->is_tiled() ? bounds.top : bounds.top - m_offset;
+    context.layout_child(node->widget, BOUNDS_F{ bounds.left, top, bounds.right, top + node->measure.height });
+}
+
+SIZE_F ScrollViewer::measure(const SIZE_F& available_size) const
+{
+    // Scrollable content measures itself against the viewport
+    if (m_nodes.empty() == false && m_scrollable == nullptr) {
+        auto& node = m_nodes.front();
+        node->widget->set_maximum_size(SIZE_F{ available_size.width, (std::numeric_limits<float>::max)() });
+        node->measure = WidgetBase::MeasureResource->get_or_initialize_resource(node->widget.get());
+    }
+
+    return available_size;
+}
+
+void ScrollViewer::discard_resources()
+{
+    BackgroundFillResource->invalidate_for(this);
+    LayoutWidgetBase::discard_resources();
+}
+
+bool ScrollViewer::handle_pointer_wheel(D2D1_POINT_2F point, int delta)
+{
+    auto offset = vertical_offset();
+    scroll_by(-static_cast<float>(delta) / WHEEL_DELTA * wheel_step());
+    return vertical_offset() != offset;
+}
+
+void ScrollViewer::render(const RenderContext& context) const
+{
+    context.render_target()->FillRectangle(
+        Interop::to_d2d(context.render_bounds()),
+        context.brush(BackgroundFillResource->get_or_initialize_resource(this)));
+}
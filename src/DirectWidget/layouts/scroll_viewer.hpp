@@ -0,0 +1,106 @@
+// scroll_viewer.hpp: ScrollViewer definition
+// ScrollViewer shows a vertically scrollable window into its content.
+
+#pragma once
+
+#include <memory>
+#include <type_traits>
+
+#include <Windows.h>
+#include <d2d1.h>
+
+#include "../core/foundation.hpp"
+#include "../core/interop.hpp"
+#include "../core/property.hpp"
+#include "../core/widget.hpp"
+#include "layout_widget.hpp"
+
+namespace DirectWidget {
+    namespace Layouts {
+
+        // Content scrolling itself instead of being moved by the viewer,
+        // virtualizing layouts implement it to realize only the items in view
+        class ScrollableBase {
+        public:
+            virtual ~ScrollableBase() = default;
+
+            virtual float extent_height() const = 0;
+            virtual float vertical_offset() const = 0;
+
+            virtual void set_vertical_offset(float offset) = 0;
+            virtual void scroll_by(float delta) = 0;
+        };
+
+        class ScrollViewer : public LayoutWidgetBase
+        {
+        public:
+            // properties
+
+            // Distance scrolled by one wheel notch
+            static property_ptr<float> WheelStepProperty;
+            static property_ptr<D2D1_COLOR_F> BackgroundColorProperty;
+
+            float wheel_step() const { return get_property(WheelStepProperty); }
+            void set_wheel_step(float step) { set_property(WheelStepProperty, step); }
+
+            const D2D1_COLOR_F& background_color() const { return get_property(BackgroundColorProperty); }
+            void set_background_color(const D2D1_COLOR_F& color) { set_property(BackgroundColorProperty, color); }
+
+            ScrollViewer();
+
+            // content
+
+            template <typename T>
+            void set_content(const std::shared_ptr<T>& content) {
+                if constexpr (std::is_base_of_v<ScrollableBase, T>) {
+                    replace_content(content, content.get());
+                }
+                else {
+                    replace_content(content, nullptr);
+                }
+            }
+
+            widget_ptr content() const { return m_nodes.empty() ? nullptr : m_nodes.front()->widget; }
+
+            // scrolling
+
+            float extent_height() const;
+            float vertical_offset() const;
+
+            void set_vertical_offset(float offset);
+            void scroll_by(float delta);
+
+            // layout
+
+            void layout(LayoutContext& context) const override;
+
+            SIZE_F measure(const SIZE_F& available_size) const override;
+
+            // rendering
+
+            void discard_resources() override;
+
+            // interaction
+
+            bool handle_pointer_wheel(D2D1_POINT_2F point, int delta) override;
+
+        protected:
+            void render(const RenderContext& context) const override;
+            bool paints_under_children() const override { return true; }
+
+        private:
+            static Interop::com_resource_ptr<ID2D1SolidColorBrush> BackgroundFillResource;
+
+            void replace_content(const widget_ptr& content, ScrollableBase* scrollable);
+
+            float viewport_height() const;
+
+            // Content scrolling itself, nullptr when the viewer moves the content
+            ScrollableBase* m_scrollable = nullptr;
+
+            // Offset of content moved by the viewer
+            float m_offset = 0.0f;
+        };
+
+    }
+}
@@ -0,0 +1,313 @@
+// virtualizing_stack_layout.cpp: VirtualizingStackLayout implementation
+
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "../core/foundation.hpp"
+#include "../core/property.hpp"
+#include "../core/widget.hpp"
+#include "virtualizing_stack_layout.hpp"
+
+using namespace DirectWidget;
+using namespace Layouts;
+
+property_ptr<float> VirtualizingStackLayout::OverscanProperty = make_property(200.0f);
+property_ptr<float> VirtualizingStackLayout::EstimatedItemHeightProperty = make_property(24.0f);
+
+VirtualizingStackLayout::VirtualizingStackLayout()
+{
+    register_dependency(OverscanProperty);
+    register_dependency(EstimatedItemHeightProperty);
+}
+
+//
+// Items
+//
+
+void VirtualizingStackLayout::set_items_source(const items_source_ptr& items_source)
+{
+    recycle_all();
+
+    // Containers of another source cannot show the new items
+    m_pool.clear();
+
+    m_items_source = items_source;
+    m_anchor_index = 0;
+    m_anchor_offset = 0.0f;
+    m_measured_height = 0.0;
+    m_measured_count = 0;
+
+    discard_layout();
+}
+
+void VirtualizingStackLayout::refresh_items()
+{
+    recycle_all();
+    discard_layout();
+}
+
+//
+// Scrolling
+//
+
+float VirtualizingStackLayout::average_item_height() const
+{
+    if (m_measured_count == 0) return estimated_item_height();
+    return static_cast<float>(m_measured_height / m_measured_count);
+}
+
+float VirtualizingStackLayout::item_height(size_t index) const
+{
+    if (m_realized.empty() == false) {
+        auto first = m_realized.front().index;
+        if (index >= first && index - first < m_realized.size()) {
+            return m_realized[index - first].height;
+        }
+    }
+    return average_item_height();
+}
+
+float VirtualizingStackLayout::extent_height() const
+{
+    if (m_items_source == nullptr) return 0.0f;
+    return m_items_source->item_count() * average_item_height();
+}
+
+float VirtualizingStackLayout::vertical_offset() const
+{
+    return m_anchor_index * average_item_height() + m_anchor_offset;
+}
+
+void VirtualizingStackLayout::set_vertical_offset(float offset)
+{
+    if (m_items_source == nullptr || m_items_source->item_count() == 0) return;
+
+    // Jumps are mapped through the estimate, the anchor is placed where the estimated offset falls
+    auto average = average_item_height();
+    offset = (std::clamp)(offset, 0.0f, (std::max)(extent_height() - m_viewport_height, 0.0f));
+
+    m_anchor_index = (std::min)(static_cast<size_t>(offset / average), m_items_source->item_count() - 1);
+    m_anchor_offset = offset - m_anchor_index * average;
+    normalize_anchor();
+
+    discard_layout();
+}
+
+void VirtualizingStackLayout::scroll_by(float delta)
+{
+    if (m_items_source == nullptr || m_items_source->item_count() == 0) return;
+
+    m_anchor_offset += delta;
+    normalize_anchor();
+
+    discard_layout();
+}
+
+void VirtualizingStackLayout::normalize_anchor()
+{
+    auto count = m_items_source->item_count();
+
+    while (m_anchor_offset < 0.0f && m_anchor_index > 0) {
+        m_anchor_index--;
+        m_anchor_offset += item_height(m_anchor_index);
+    }
+    m_anchor_offset = (std::max)(m_anchor_offset, 0.0f);
+
+    while (m_anchor_index + 1 < count && m_anchor_offset >= item_height(m_anchor_index)) {
+        m_anchor_offset -= item_height(m_anchor_index);
+        m_anchor_index++;
+    }
+}
+
+//
+// Layout
+//
+
+SIZE_F VirtualizingStackLayout::measure(const SIZE_F& available_size) const
+{
+    // Fills the viewport, the extent is reported through ScrollableBase
+    return available_size;
+}
+
+void VirtualizingStackLayout::layout(LayoutContext& context) const
+{
+    WidgetBase::layout(context);
+
+    auto bounds = context.render_bounds();
+
+    // Realization depends on the viewport, which is only known here
+    const_cast<VirtualizingStackLayout*>(this)->realize(bounds.right - bounds.left, bounds.bottom - bounds.top);
+
+    // Items above the anchor are stacked upwards from it
+    auto top = bounds.top - m_anchor_offset;
+    for (auto& item : m_realized) {
+        if (item.index >= m_anchor_index) break;
+        top -= item.height;
+    }
+
+    for (auto& item : m_realized) {
+        context.layout_child(item.container, BOUNDS_F{ bounds.left, top, bounds.right, top + item.height });
+        top += item.height;
+    }
+}
+
+void VirtualizingStackLayout::realize(float width, float height)
+{
+    m_viewport_height = height;
+
+    auto count = m_items_source != nullptr ? m_items_source->item_count() : 0;
+    if (count == 0) {
+        recycle_all();
+        m_anchor_index = 0;
+        m_anchor_offset = 0.0f;
+        return;
+    }
+
+    if (width != m_viewport_width) {
+        // Items may wrap differently, realized items are measured again
+        m_viewport_width = width;
+        for (auto& item : m_realized) {
+            item.container->discard_measure();
+            item.height = measure_container(item.container, width);
+        }
+    }
+
+    if (m_anchor_index >= count) {
+        m_anchor_index = count - 1;
+        m_anchor_offset = 0.0f;
+    }
+
+    // After a jump nothing realized stays in view, so every container goes back to the pool before new ones are made
+    if (m_realized.empty() == false &&
+        (m_anchor_index + 1 < m_realized.front().index || m_anchor_index > m_realized.back().index + 1)) {
+        recycle_all();
+    }
+
+    // A second pass is only needed when the end of the items came into view and the anchor moved back
+    if (realize_range(width, height)) {
+        realize_range(width, height);
+    }
+}
+
+bool VirtualizingStackLayout::realize_range(float width, float height)
+{
+    auto count = m_items_source->item_count();
+    auto overscan = this->overscan();
+
+    m_next_realized.clear();
+    m_above.clear();
+
+    // From the anchor down to the end of the overscan band below the viewport
+    auto covered = -m_anchor_offset;
+    auto index = m_anchor_index;
+    while (index < count && covered < height + overscan) {
+        m_next_realized.push_back(acquire_item(index, width));
+        covered += m_next_realized.back().height;
+        index++;
+    }
+    auto reached_end = index == count;
+
+    // Up from the anchor through the overscan band above the viewport
+    auto covered_above = 0.0f;
+    index = m_anchor_index;
+    while (index > 0 && covered_above < overscan) {
+        index--;
+        m_above.push_back(acquire_item(index, width));
+        covered_above += m_above.back().height;
+    }
+
+    // Items still in m_realized were not taken, they scrolled out
+    for (auto& item : m_realized) {
+        if (item.container != nullptr) {
+            recycle(item.container);
+        }
+    }
+
+    m_realized.clear();
+    m_realized.insert(m_realized.end(), m_above.rbegin(), m_above.rend());
+    m_realized.insert(m_realized.end(), m_next_realized.begin(), m_next_realized.end());
+
+    // Keep the last item at the bottom of the viewport instead of scrolling past it
+    if (reached_end && covered < height && (m_anchor_index > 0 || m_anchor_offset > 0.0f)) {
+        m_anchor_offset -= height - covered;
+        normalize_anchor();
+        return true;
+    }
+    return false;
+}
+
+VirtualizingStackLayout::REALIZED_ITEM VirtualizingStackLayout::acquire_item(size_t index, float width)
+{
+    // Items realized in the previous pass keep their container and measure
+    if (m_realized.empty() == false) {
+        auto first = m_realized.front().index;
+        if (index >= first && index - first < m_realized.size()) {
+            auto& item = m_realized[index - first];
+            if (item.container != nullptr) {
+                return { index, std::move(item.container), item.height };
+            }
+        }
+    }
+
+    widget_ptr container;
+    if (m_pool.empty()) {
+        container = m_items_source->create_container();
+    }
+    else {
+        container = std::move(m_pool.back());
+        m_pool.pop_back();
+    }
+
+    add_child(container);
+    if (render_target() != nullptr) {
+        container->attach_render_target(render_target(), glyph_atlas());
+        container->create_resources();
+    }
+
+    m_items_source->bind_container(container.get(), index);
+    container->discard_measure();
+
+    auto height = measure_container(container, width);
+    m_measured_height += height;
+    m_measured_count++;
+
+    return { index, container, height };
+}
+
+float VirtualizingStackLayout::measure_container(const widget_ptr& container, float width)
+{
+    container->set_maximum_size(SIZE_F{ width, (std::numeric_limits<float>::max)() });
+    return WidgetBase::MeasureResource->get_or_initialize_resource(container.get()).height;
+}
+
+void VirtualizingStackLayout::recycle(const widget_ptr& container)
+{
+    m_pool.push_back(container);
+    remove_child(container);
+}
+
+void VirtualizingStackLayout::recycle_all()
+{
+    for (auto& item : m_realized) {
+        if (item.container != nullptr) {
+            recycle(item.container);
+        }
+    }
+    m_realized.clear();
+}
+
+//
+// Rendering
+//
+
+void VirtualizingStackLayout::discard_resources()
+{
+    LayoutWidgetBase::discard_resources();
+
+    for (auto& container : m_pool) {
+        container->discard_resources();
+    }
+}
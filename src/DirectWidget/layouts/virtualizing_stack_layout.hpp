@@ -0,0 +1,129 @@
+// virtualizing_stack_layout.hpp: VirtualizingStackLayout definition
+// VirtualizingStackLayout stacks the items of an items source vertically, realizing widgets only for the items
+// in view plus an overscan band. Containers of items scrolled out are recycled for the items scrolled in.
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "../core/foundation.hpp"
+#include "../core/property.hpp"
+#include "../core/widget.hpp"
+#include "layout_widget.hpp"
+#include "scroll_viewer.hpp"
+
+namespace DirectWidget {
+    namespace Layouts {
+
+        // Provides the items of a virtualizing layout, items are identified by index
+        class ItemsSourceBase {
+        public:
+            virtual ~ItemsSourceBase() = default;
+
+            virtual size_t item_count() const = 0;
+
+            // Creates a container able to show any item
+            virtual widget_ptr create_container() = 0;
+
+            // Updates container to show the item at index, containers are rebound to other items after they scroll out
+            virtual void bind_container(WidgetBase* container, size_t index) = 0;
+        };
+
+        using items_source_ptr = std::shared_ptr<ItemsSourceBase>;
+
+        class VirtualizingStackLayout : public LayoutWidgetBase, public ScrollableBase
+        {
+        public:
+            // properties
+
+            // Distance realized above and below the viewport
+            static property_ptr<float> OverscanProperty;
+
+            // Height assumed for items before any item was measured
+            static property_ptr<float> EstimatedItemHeightProperty;
+
+            float overscan() const { return get_property(OverscanProperty); }
+            void set_overscan(float overscan) { set_property(OverscanProperty, overscan); }
+
+            float estimated_item_height() const { return get_property(EstimatedItemHeightProperty); }
+            void set_estimated_item_height(float height) { set_property(EstimatedItemHeightProperty, height); }
+
+            VirtualizingStackLayout();
+
+            // items
+
+            const items_source_ptr& items_source() const { return m_items_source; }
+            void set_items_source(const items_source_ptr& items_source);
+
+            // Rebinds every realized item, called after items of the source changed
+            void refresh_items();
+
+            // scrolling
+            // Offsets and extents are estimated from the average height of the items measured so far,
+            // scrolling moves an anchor item so small scrolls stay exact regardless of the estimate.
+
+            float extent_height() const override;
+            float vertical_offset() const override;
+
+            void set_vertical_offset(float offset) override;
+            void scroll_by(float delta) override;
+
+            // layout
+
+            void layout(LayoutContext& context) const override;
+
+            SIZE_F measure(const SIZE_F& available_size) const override;
+
+            // rendering
+
+            void discard_resources() override;
+
+        private:
+            typedef struct {
+                size_t index;
+                widget_ptr container;
+                float height;
+            } REALIZED_ITEM;
+
+            float average_item_height() const;
+
+            // Measured height of realized items, the estimate for the others
+            float item_height(size_t index) const;
+
+            // Moves the anchor to the item at the top of the viewport after the anchor offset changed
+            void normalize_anchor();
+
+            // Updates the realized items to cover the viewport and the overscan band around it
+            void realize(float width, float height);
+            bool realize_range(float width, float height);
+
+            REALIZED_ITEM acquire_item(size_t index, float width);
+            float measure_container(const widget_ptr& container, float width);
+            void recycle(const widget_ptr& container);
+            void recycle_all();
+
+            items_source_ptr m_items_source;
+
+            // Realized items in index order, the anchor item is the one at the top of the viewport
+            std::vector<REALIZED_ITEM> m_realized;
+            std::vector<REALIZED_ITEM> m_next_realized;
+            std::vector<REALIZED_ITEM> m_above;
+
+            // Containers detached from the tree, waiting to be bound to another item
+            std::vector<widget_ptr> m_pool;
+
+            size_t m_anchor_index = 0;
+            // Part of the anchor item scrolled above the viewport
+            float m_anchor_offset = 0.0f;
+
+            float m_viewport_width = -1.0f;
+            float m_viewport_height = 0.0f;
+
+            double m_measured_height = 0.0;
+            size_t m_measured_count = 0;
+        };
+
+    }
+}
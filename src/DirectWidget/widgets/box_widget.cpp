@@ -52,11 +52,11 @@ void BoxWidget::render(const RenderContext& context) const
         context.render_bounds().bottom
     );
     auto& fill_brush = FillBrushResource->get_or_initialize_resource(this);
-    context.render_target()->FillRectangle(box, fill_brush);
+    context.render_target()->FillRectangle(box, context.brush(fill_brush));
 
     auto width = stroke_width();
     auto& stroke_brush = StrokeBrushResource->get_or_initialize_resource(this);
     if (width > 0.0f) {
-        context.render_target()->DrawRectangle(box, stroke_brush, width);
+        context.render_target()->DrawRectangle(box, context.brush(stroke_brush), width);
     }
 }
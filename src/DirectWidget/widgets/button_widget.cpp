@@ -1,5 +1,6 @@
 // button_widget.cpp: ButtonWidget implementation
 
+#include <chrono>
 #include <memory>
 
 #include <Windows.h>
@@ -8,6 +9,8 @@
 #include <dwrite.h>
 
 #include "../core/foundation.hpp"
+#include "../core/animation.hpp"
+#include "../core/arena.hpp"
 #include "../core/property.hpp"
 #include "../core/widget.hpp"
 #include "button_widget.hpp"
@@ -24,6 +27,7 @@ property_ptr<D2D1_COLOR_F> ButtonWidget::StrokeColorProperty = make_property<D2D
 property_ptr<D2D1_COLOR_F> ButtonWidget::BackgroundColorProperty = make_property<D2D1_COLOR_F>(D2D1::ColorF(D2D1::ColorF::LightGray));
 property_ptr<D2D1_COLOR_F> ButtonWidget::HoverColorProperty = make_property<D2D1_COLOR_F>(D2D1::ColorF(D2D1::ColorF::DimGray));
 property_ptr<D2D1_COLOR_F> ButtonWidget::PressedColorProperty = make_property<D2D1_COLOR_F>(D2D1::ColorF(D2D1::ColorF::DarkGray));
+property_ptr<std::chrono::microseconds> ButtonWidget::TransitionDurationProperty = make_property<std::chrono::microseconds>(std::chrono::milliseconds(120));
 
 ButtonWidget::ButtonWidget()
 {
@@ -34,13 +38,14 @@ ButtonWidget::ButtonWidget()
     register_dependency(BackgroundColorProperty);
     register_dependency(HoverColorProperty);
     register_dependency(PressedColorProperty);
+    register_dependency(TransitionDurationProperty);
 
-    m_box_widget = std::make_shared<BoxWidget>();
+    m_box_widget = make_element<BoxWidget>();
     m_box_widget->set_horizontal_alignment(WidgetAlignment::Stretch);
     m_box_widget->set_vertical_alignment(WidgetAlignment::Stretch);
     add_child(m_box_widget);
 
-    m_text_widget = std::make_shared<TextWidget>();
+    m_text_widget = make_element<TextWidget>();
     m_text_widget->set_text_alignment(DWRITE_TEXT_ALIGNMENT_CENTER);
     m_text_widget->set_font_size(14.0f);
     add_child(m_text_widget);
@@ -80,17 +85,22 @@ void ButtonWidget::create_resources() {
 //    };
 //}
 
-bool ButtonWidget::handle_pointer_hover(D2D1_POINT_2F point) {
-    // TODO
-    return false;
+void ButtonWidget::handle_pointer_enter() {
+    update_background(hover_color());
+}
+
+void ButtonWidget::handle_pointer_leave() {
+    update_background(background_color());
 }
 
 bool ButtonWidget::handle_pointer_press(D2D1_POINT_2F point) {
-    // TODO
-    return false;
+    update_background(pressed_color());
+    return true;
 }
 
 bool ButtonWidget::handle_pointer_release(D2D1_POINT_2F point) {
+    update_background(is_hovered() ? hover_color() : background_color());
+
     if (m_click_handler != nullptr) {
         m_click_handler();
         return true;
@@ -98,3 +108,9 @@ bool ButtonWidget::handle_pointer_release(D2D1_POINT_2F point) {
 
     return false;
 }
+
+void ButtonWidget::update_background(D2D1_COLOR_F color) {
+    // Only the box color changes, the text drawn over it repaints with the button frame
+    Animator::instance().animate(m_box_widget.get(), BoxWidget::BackgroundColorProperty, color,
+        make_timeline(transition_duration(), Easing::EaseOut), AnimationEffect::Paint, this);
+}
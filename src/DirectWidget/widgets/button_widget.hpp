@@ -2,6 +2,7 @@
 
 #pragma once
 
+#include <chrono>
 #include <functional>
 #include <memory>
 
@@ -33,6 +34,9 @@ namespace DirectWidget {
             static property_ptr<D2D1_COLOR_F> HoverColorProperty;
             static property_ptr<D2D1_COLOR_F> PressedColorProperty;
 
+            // Duration of the transition between background, hover and pressed colors, zero switches at once
+            static property_ptr<std::chrono::microseconds> TransitionDurationProperty;
+
             const PCWSTR& text() const { return get_property(TextProperty); }
             void set_text(const PCWSTR& text) { set_property(TextProperty, text); }
 
@@ -54,6 +58,9 @@ namespace DirectWidget {
             D2D1_COLOR_F pressed_color() const { return get_property(PressedColorProperty); }
             void set_pressed_color(D2D1_COLOR_F color) { set_property(PressedColorProperty, color); }
 
+            std::chrono::microseconds transition_duration() const { return get_property(TransitionDurationProperty); }
+            void set_transition_duration(std::chrono::microseconds duration) { set_property(TransitionDurationProperty, duration); }
+
             void set_click_handler(std::function<void()> handler) { m_click_handler = handler; }
 
             // layout
@@ -66,11 +73,14 @@ namespace DirectWidget {
 
             // interaction
 
-            bool handle_pointer_hover(D2D1_POINT_2F point) override;
+            void handle_pointer_enter() override;
+            void handle_pointer_leave() override;
             bool handle_pointer_press(D2D1_POINT_2F point) override;
             bool handle_pointer_release(D2D1_POINT_2F point) override;
 
         private:
+            void update_background(D2D1_COLOR_F color);
+
             std::shared_ptr<TextWidget> m_text_widget;
             std::shared_ptr<BoxWidget> m_box_widget;
 
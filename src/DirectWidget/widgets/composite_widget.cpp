@@ -43,57 +43,9 @@ void CompositeWidget::layout(LayoutContext& context) const {
     WidgetBase::layout(context);
 
     auto& children = ChildrenProperty->get_values(this);
-    widget_ptr previous_child;
+    auto previous_child = NullElementHandle;
     for (auto& child : children) {
         context.layout_child(child, context.render_bounds(), previous_child);
-        previous_child = child;
+        previous_child = child->handle();
     }
 }
-
-bool CompositeWidget::handle_pointer_hover(D2D1_POINT_2F point)
-{
-    auto& children = ChildrenProperty->get_values(this);
-    for (auto& child : children)
-    {
-        if (child->hit_test(point))
-        {
-            if (child->handle_pointer_hover(point)) {
-                return true;
-            }
-        }
-    }
-
-    return false;
-}
-
-bool CompositeWidget::handle_pointer_press(D2D1_POINT_2F point)
-{
-    auto& children = ChildrenProperty->get_values(this);
-    for (auto& child : children)
-    {
-        if (child->hit_test(point))
-        {
-            if (child->handle_pointer_press(point)) {
-                return true;
-            }
-        }
-    }
-
-    return false;
-}
-
-bool CompositeWidget::handle_pointer_release(D2D1_POINT_2F point)
-{
-    auto& children = ChildrenProperty->get_values(this);
-    for (auto& child : children)
-    {
-        if (child->hit_test(point))
-        {
-            if (child->handle_pointer_release(point)) {
-                return true;
-            }
-        }
-    }
-
-    return false;
-}
@@ -3,8 +3,8 @@
 #pragma once
 
 #include <memory>
+#include <span>
 #include <vector>
-#include <functional>
 
 #include "../core/foundation.hpp"
 #include "../core/property.hpp"
@@ -36,19 +36,9 @@ namespace DirectWidget {
 
             // render
 
-            // interaction
+            // children
 
-            bool handle_pointer_hover(D2D1_POINT_2F point) override;
-            bool handle_pointer_press(D2D1_POINT_2F point) override;
-            bool handle_pointer_release(D2D1_POINT_2F point) override;
-
-        protected:
-            void for_each_child(std::function<void(WidgetBase*)> callback) const override {
-                auto& children = ChildrenProperty->get_values(this);
-                for (auto& child : children) {
-                    callback(child.get());
-                }
-            }
+            std::span<const widget_ptr> children() const override { return ChildrenProperty->get_values(this); }
         };
 
     }
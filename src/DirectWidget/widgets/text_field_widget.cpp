@@ -0,0 +1,601 @@
+// text_field_widget.cpp: TextFieldWidget implementation
+
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <Windows.h>
+#include <comdef.h>
+#include <d2d1.h>
+#include <d2d1helper.h>
+#include <dwrite.h>
+
+#include "../core/foundation.hpp"
+#include "../core/element_base.hpp"
+#include "../core/dependency.hpp"
+#include "../core/handle.hpp"
+#include "../core/property.hpp"
+#include "../core/interop.hpp"
+#include "../core/input_queue.hpp"
+#include "../core/piece_table.hpp"
+#include "../core/app.hpp"
+#include "../core/widget.hpp"
+#include "text_field_widget.hpp"
+
+using namespace DirectWidget;
+using namespace Widgets;
+
+const LogContext TextFieldWidget::Logger{ NAMEOF(TextFieldWidget) };
+
+class TextFieldWidget::DWriteTextFormatResource : public Interop::ComResource<IDWriteTextFormat> {
+protected:
+    HRESULT initialize(const ElementBase* owner, Interop::com_ptr<IDWriteTextFormat>& resource) override {
+        auto& dwrite = Application::instance()->dwrite();
+
+        auto& font_family = TextFieldWidget::FontFamilyProperty->get_value(owner);
+        auto& font_size = TextFieldWidget::FontSizeProperty->get_value(owner);
+
+        return dwrite->CreateTextFormat(
+            font_family,
+            NULL,
+            DWRITE_FONT_WEIGHT_NORMAL,
+            DWRITE_FONT_STYLE_NORMAL,
+            DWRITE_FONT_STRETCH_NORMAL,
+            font_size,
+            L"en-us",
+            &resource);
+    }
+};
+
+// Tells partial repaints requested by a text field apart from any other invalidation of its frame
+class TextFieldWidget::TextFieldRepaintListener : public DependencyListenerBase {
+public:
+    void register_field(TextFieldWidget* field) {
+        m_fields.insert_or_assign(field->handle(), field);
+    }
+
+    void remove_field(TextFieldWidget* field) {
+        m_fields.erase(field->handle());
+    }
+
+    void on_dependency_updated(const ElementBase* owner, const NotificationArgument& arg) override {
+        if (arg.notification_type() != NotificationType::Invalidated) return;
+
+        auto field = m_fields.find(element_handle(owner));
+        if (field == nullptr) return;
+
+        // Layout changes, device loss and background repaints invalidate the whole field
+        if ((*field)->m_requesting_repaint == false) {
+            (*field)->m_full_repaint = true;
+        }
+    }
+
+private:
+    ElementStorage<TextFieldWidget*> m_fields;
+};
+
+//
+// Properties
+//
+
+property_ptr<PCWSTR> TextFieldWidget::FontFamilyProperty = make_property<PCWSTR>(L"Consolas");
+property_ptr<float> TextFieldWidget::FontSizeProperty = make_property(12.0f);
+property_ptr<D2D1_COLOR_F> TextFieldWidget::ColorProperty = make_property<D2D1_COLOR_F>(D2D1::ColorF(D2D1::ColorF::Black));
+property_ptr<D2D1_COLOR_F> TextFieldWidget::BackgroundColorProperty = make_property<D2D1_COLOR_F>(D2D1::ColorF(D2D1::ColorF::White));
+property_ptr<D2D1_COLOR_F> TextFieldWidget::SelectionColorProperty = make_property<D2D1_COLOR_F>(D2D1::ColorF(D2D1::ColorF::LightSkyBlue));
+
+//
+// Resources
+//
+
+Interop::com_resource_ptr<ID2D1SolidColorBrush> TextFieldWidget::TextFillResource = std::make_shared<Interop::SolidColorBrushResource>(ColorProperty);
+Interop::com_resource_ptr<ID2D1SolidColorBrush> TextFieldWidget::BackgroundFillResource = std::make_shared<Interop::SolidColorBrushResource>(BackgroundColorProperty);
+Interop::com_resource_ptr<ID2D1SolidColorBrush> TextFieldWidget::SelectionFillResource = std::make_shared<Interop::SolidColorBrushResource>(SelectionColorProperty);
+Interop::com_resource_ptr<IDWriteTextFormat> TextFieldWidget::TextFormatResource = std::make_shared<DWriteTextFormatResource>();
+
+std::shared_ptr<TextFieldWidget::TextFieldRepaintListener> TextFieldWidget::RepaintListener = []() {
+    auto listener = std::make_shared<TextFieldRepaintListener>();
+    WidgetBase::RenderContentResource->add_listener(listener);
+    return listener;
+    }();
+
+TextFieldWidget::TextFieldWidget()
+{
+    register_dependency(FontFamilyProperty);
+    register_dependency(FontSizeProperty);
+    register_dependency(ColorProperty);
+    register_dependency(BackgroundColorProperty);
+    register_dependency(SelectionColorProperty);
+
+    register_dependency(TextFillResource);
+    register_dependency(BackgroundFillResource);
+    register_dependency(SelectionFillResource);
+    register_dependency(TextFormatResource);
+
+    RepaintListener->register_field(this);
+
+    set_focusable(true);
+}
+
+TextFieldWidget::~TextFieldWidget()
+{
+    RepaintListener->remove_field(this);
+}
+
+//
+// Text
+//
+
+void TextFieldWidget::set_text(std::wstring_view text)
+{
+    m_buffer = PieceTable(text);
+    m_caret = 0;
+    m_anchor = 0;
+    m_scroll_offset = 0.0f;
+
+    if (m_layout_width >= 0.0f) {
+        reset_paragraphs();
+    }
+    request_repaint(0, AllLines);
+}
+
+void TextFieldWidget::replace_selection(std::wstring_view text)
+{
+    auto start = selection_start();
+    auto end = selection_end();
+
+    auto first_line = m_buffer.line_of(start);
+    auto last_line = m_buffer.line_of(end);
+
+    m_buffer.erase(start, end - start);
+    m_buffer.insert(start, text);
+
+    auto inserted_lines = static_cast<size_t>(std::count(text.begin(), text.end(), L'\n'));
+
+    // Only the edited paragraph is reshaped, it keeps its height until then so unchanged heights repaint one line
+    if (m_paragraphs.empty() == false) {
+        auto first = m_paragraphs.begin() + first_line;
+        auto last = first + (last_line + 1 - first_line);
+        for (auto paragraph = first + 1; paragraph != last; paragraph++) {
+            m_content_height -= paragraph->height;
+        }
+        m_paragraphs.erase(first + 1, last);
+        m_paragraphs[first_line].layout = nullptr;
+        m_paragraphs.insert(m_paragraphs.begin() + first_line + 1, inserted_lines, PARAGRAPH{ nullptr, estimated_line_height() });
+        m_content_height += inserted_lines * estimated_line_height();
+        m_valid_tops = (std::min)(m_valid_tops, first_line + 1);
+    }
+
+    m_caret = start + text.size();
+    m_anchor = m_caret;
+
+    auto structure_changed = last_line != first_line || inserted_lines > 0;
+    request_repaint(first_line, structure_changed ? AllLines : first_line);
+}
+
+void TextFieldWidget::set_selection(size_t anchor, size_t caret)
+{
+    anchor = (std::min)(anchor, m_buffer.length());
+    caret = (std::min)(caret, m_buffer.length());
+    if (anchor == m_anchor && caret == m_caret) return;
+
+    // Repaint the lines of the old and the new selection, the caret is at one of their ends
+    auto first_line = m_buffer.line_of((std::min)(selection_start(), (std::min)(anchor, caret)));
+    auto last_line = m_buffer.line_of((std::max)(selection_end(), (std::max)(anchor, caret)));
+
+    m_anchor = anchor;
+    m_caret = caret;
+    request_repaint(first_line, last_line);
+}
+
+//
+// Layout
+//
+
+SIZE_F TextFieldWidget::measure(const SIZE_F& available_size) const
+{
+    return { available_size.width, (std::min)(available_size.height, content_height()) };
+}
+
+//
+// Paragraphs
+//
+
+void TextFieldWidget::reset_paragraphs() const
+{
+    m_paragraphs.assign(m_buffer.line_count(), PARAGRAPH{ nullptr, estimated_line_height() });
+    m_content_height = m_paragraphs.size() * estimated_line_height();
+    m_paragraph_tops.assign(1, 0.0f);
+    m_valid_tops = 1;
+}
+
+void TextFieldWidget::shape_paragraph(size_t paragraph) const
+{
+    if (paragraph >= m_paragraphs.size()) return;
+
+    auto& entry = m_paragraphs[paragraph];
+    if (entry.layout != nullptr) return;
+
+    auto start = m_buffer.line_start(paragraph);
+    m_scratch.clear();
+    m_buffer.copy(start, m_buffer.line_end(paragraph) - start, m_scratch);
+
+    auto& dwrite = Application::instance()->dwrite();
+    auto hr = dwrite->CreateTextLayout(
+        m_scratch.c_str(),
+        static_cast<UINT32>(m_scratch.size()),
+        TextFormatResource->get_or_initialize_resource(this),
+        m_layout_width,
+        (std::numeric_limits<float>::max)(),
+        &entry.layout);
+    if (FAILED(hr)) {
+        Logger.at(NAMEOF(shape_paragraph)).at(NAMEOF(IDWriteFactory::CreateTextLayout)).log_error(hr);
+        return;
+    }
+
+    DWRITE_TEXT_METRICS metrics;
+    hr = entry.layout->GetMetrics(&metrics);
+    if (FAILED(hr)) {
+        Logger.at(NAMEOF(shape_paragraph)).at(NAMEOF(IDWriteTextLayout::GetMetrics)).log_error(hr);
+        return;
+    }
+
+    if (metrics.height != entry.height) {
+        m_content_height += metrics.height - entry.height;
+        entry.height = metrics.height;
+        m_valid_tops = (std::min)(m_valid_tops, paragraph + 1);
+        m_dirty_first = (std::min)(m_dirty_first, paragraph);
+        m_dirty_last = AllLines;
+    }
+}
+
+float TextFieldWidget::paragraph_top(size_t paragraph) const
+{
+    if (m_paragraph_tops.size() != m_paragraphs.size() + 1) {
+        m_paragraph_tops.resize(m_paragraphs.size() + 1);
+    }
+    paragraph = (std::min)(paragraph, m_paragraphs.size());
+
+    // Tops are extended lazily, an edit only costs the paragraphs between it and the ones displayed
+    for (; m_valid_tops <= paragraph; m_valid_tops++) {
+        m_paragraph_tops[m_valid_tops] = m_paragraph_tops[m_valid_tops - 1] + m_paragraphs[m_valid_tops - 1].height;
+    }
+    return m_paragraph_tops[paragraph];
+}
+
+size_t TextFieldWidget::paragraph_at(float y) const
+{
+    if (m_paragraphs.empty() || y <= 0.0f) return 0;
+
+    paragraph_top(0);
+    while (m_valid_tops <= m_paragraphs.size() && m_paragraph_tops[m_valid_tops - 1] <= y) {
+        paragraph_top(m_valid_tops);
+    }
+
+    auto tops_end = m_paragraph_tops.begin() + m_valid_tops;
+    auto position = std::upper_bound(m_paragraph_tops.begin(), tops_end, y);
+    auto paragraph = static_cast<size_t>(position - m_paragraph_tops.begin()) - 1;
+    return (std::min)(paragraph, m_paragraphs.size() - 1);
+}
+
+float TextFieldWidget::content_height() const
+{
+    if (m_paragraphs.empty()) {
+        return m_buffer.line_count() * estimated_line_height();
+    }
+    return m_content_height;
+}
+
+float TextFieldWidget::estimated_line_height() const
+{
+    // Close to the default line spacing of common fonts, unshaped paragraphs are assumed to hold a single line
+    return font_size() * 1.33f;
+}
+
+size_t TextFieldWidget::position_at(D2D1_POINT_2F point) const
+{
+    if (m_paragraphs.empty()) return m_caret;
+
+    auto& bounds = RenderBoundsResource->get_resource(this);
+    auto y = point.y - bounds.top + m_scroll_offset;
+
+    auto paragraph = paragraph_at(y);
+    shape_paragraph(paragraph);
+
+    auto& layout = m_paragraphs[paragraph].layout;
+    if (layout == nullptr) return m_caret;
+
+    BOOL is_trailing_hit;
+    BOOL is_inside;
+    DWRITE_HIT_TEST_METRICS metrics;
+    auto hr = layout->HitTestPoint(point.x - bounds.left, y - paragraph_top(paragraph), &is_trailing_hit, &is_inside, &metrics);
+    if (FAILED(hr)) {
+        Logger.at(NAMEOF(position_at)).at(NAMEOF(IDWriteTextLayout::HitTestPoint)).log_error(hr);
+        return m_caret;
+    }
+
+    auto position = m_buffer.line_start(paragraph) + metrics.textPosition + (is_trailing_hit ? metrics.length : 0);
+    return (std::min)(position, m_buffer.line_end(paragraph));
+}
+
+//
+// Repaint
+//
+
+void TextFieldWidget::request_repaint(size_t first, size_t last)
+{
+    m_dirty_first = (std::min)(m_dirty_first, first);
+    m_dirty_last = (std::max)(m_dirty_last, last);
+
+    m_requesting_repaint = true;
+    RenderContentResource->invalidate_for(this);
+    m_requesting_repaint = false;
+}
+
+void TextFieldWidget::ensure_caret_visible(float view_height) const
+{
+    auto line = m_buffer.line_of(m_caret);
+    if (line >= m_paragraphs.size()) return;
+    shape_paragraph(line);
+
+    auto& layout = m_paragraphs[line].layout;
+    if (layout == nullptr) return;
+
+    FLOAT x, y;
+    DWRITE_HIT_TEST_METRICS metrics;
+    auto hr = layout->HitTestTextPosition(static_cast<UINT32>(m_caret - m_buffer.line_start(line)), FALSE, &x, &y, &metrics);
+    if (FAILED(hr)) {
+        Logger.at(NAMEOF(ensure_caret_visible)).at(NAMEOF(IDWriteTextLayout::HitTestTextPosition)).log_error(hr);
+        return;
+    }
+
+    auto caret_top = paragraph_top(line) + y;
+    auto caret_bottom = caret_top + metrics.height;
+
+    if (caret_top < m_scroll_offset) {
+        m_scroll_offset = caret_top;
+    }
+    else if (caret_bottom > m_scroll_offset + view_height) {
+        m_scroll_offset = (std::max)(caret_bottom - view_height, 0.0f);
+    }
+}
+
+//
+// Rendering
+//
+
+void TextFieldWidget::discard_resources()
+{
+    TextFillResource->invalidate_for(this);
+    BackgroundFillResource->invalidate_for(this);
+    SelectionFillResource->invalidate_for(this);
+    m_full_repaint = true;
+
+    WidgetBase::discard_resources();
+}
+
+void TextFieldWidget::render(const RenderContext& context) const
+{
+    auto& bounds = context.render_bounds();
+    auto& render_target = context.render_target();
+    auto view_height = bounds.bottom - bounds.top;
+
+    if (bounds.right - bounds.left != m_layout_width) {
+        // Wrapping depends on the width, so every paragraph is reshaped on demand
+        m_layout_width = bounds.right - bounds.left;
+        reset_paragraphs();
+        m_full_repaint = true;
+    }
+
+    auto scroll_offset = m_scroll_offset;
+    ensure_caret_visible(view_height);
+    if (m_scroll_offset != scroll_offset) {
+        m_full_repaint = true;
+    }
+
+    for (auto i = paragraph_at(m_scroll_offset); i < m_paragraphs.size() && paragraph_top(i) < m_scroll_offset + view_height; i++) {
+        shape_paragraph(i);
+    }
+
+    // Clipping to the dirty lines keeps the other lines only where the last frame is still there,
+    // the window and tiles are painted over by the parents of the field every frame
+    auto clip = D2D1::RectF(bounds.left, bounds.top, bounds.right, bounds.bottom);
+    if (context.retains_frame() && m_full_repaint == false) {
+        if (m_dirty_first != AllLines) {
+            clip.top = (std::max)(clip.top, bounds.top + paragraph_top(m_dirty_first) - m_scroll_offset);
+        }
+        else {
+            clip.top = clip.bottom;
+        }
+
+        if (m_dirty_last != AllLines) {
+            clip.bottom = (std::min)(clip.bottom, bounds.top + paragraph_top(m_dirty_last + 1) - m_scroll_offset);
+        }
+    }
+
+    if (clip.top < clip.bottom) {
+        render_target->PushAxisAlignedClip(clip, D2D1_ANTIALIAS_MODE_ALIASED);
+        render_target->FillRectangle(clip, context.brush(BackgroundFillResource->get_or_initialize_resource(this)));
+
+        for (auto i = paragraph_at(clip.top - bounds.top + m_scroll_offset); i < m_paragraphs.size(); i++) {
+            auto top = bounds.top + paragraph_top(i) - m_scroll_offset;
+            if (top >= clip.bottom) break;
+
+            render_paragraph(context, i, top);
+        }
+
+        render_target->PopAxisAlignedClip();
+    }
+
+    m_dirty_first = AllLines;
+    m_dirty_last = 0;
+    m_full_repaint = false;
+}
+
+void TextFieldWidget::render_paragraph(const RenderContext& context, size_t paragraph, float top) const
+{
+    auto& layout = m_paragraphs[paragraph].layout;
+    if (layout == nullptr) return;
+
+    auto& render_target = context.render_target();
+    auto left = context.render_bounds().left;
+
+    auto start = m_buffer.line_start(paragraph);
+    auto end = m_buffer.line_end(paragraph);
+
+    auto selection_first = (std::max)(selection_start(), start);
+    auto selection_last = (std::min)(selection_end(), end);
+    if (selection_first < selection_last) {
+        auto text_position = static_cast<UINT32>(selection_first - start);
+        auto text_length = static_cast<UINT32>(selection_last - selection_first);
+
+        UINT32 count = 0;
+        layout->HitTestTextRange(text_position, text_length, left, top, nullptr, 0, &count);
+
+        std::vector<DWRITE_HIT_TEST_METRICS> ranges(count);
+        auto hr = layout->HitTestTextRange(text_position, text_length, left, top, ranges.data(), count, &count);
+        Logger.at(NAMEOF(render_paragraph)).at(NAMEOF(IDWriteTextLayout::HitTestTextRange)).log_error(hr);
+
+        if (SUCCEEDED(hr)) {
+            auto selection_fill = context.brush(SelectionFillResource->get_or_initialize_resource(this));
+            for (auto& range : ranges) {
+                render_target->FillRectangle(D2D1::RectF(range.left, range.top, range.left + range.width, range.top + range.height), selection_fill);
+            }
+        }
+    }
+
+    auto text_fill = context.brush(TextFillResource->get_or_initialize_resource(this));
+    render_target->DrawTextLayout(D2D1::Point2F(left, top), layout, text_fill, D2D1_DRAW_TEXT_OPTIONS_ENABLE_COLOR_FONT);
+
+    if (is_focused() && m_caret >= start && m_caret <= end) {
+        FLOAT x, y;
+        DWRITE_HIT_TEST_METRICS metrics;
+        auto hr = layout->HitTestTextPosition(static_cast<UINT32>(m_caret - start), FALSE, &x, &y, &metrics);
+        Logger.at(NAMEOF(render_paragraph)).at(NAMEOF(IDWriteTextLayout::HitTestTextPosition)).log_error(hr);
+
+        if (SUCCEEDED(hr)) {
+            render_target->FillRectangle(D2D1::RectF(left + x, top + y, left + x + 1.0f, top + y + metrics.height), text_fill);
+        }
+    }
+}
+
+//
+// Interaction
+//
+
+bool TextFieldWidget::handle_pointer_press(D2D1_POINT_2F point)
+{
+    set_caret(position_at(point));
+    return true;
+}
+
+bool TextFieldWidget::handle_key_down(uint32_t key, uint32_t modifiers)
+{
+    auto extend = (modifiers & ModifierShift) != 0;
+    auto control = (modifiers & ModifierControl) != 0;
+
+    auto move_caret = [this, extend](size_t position) {
+        set_selection(extend ? m_anchor : position, position);
+    };
+
+    auto line = m_buffer.line_of(m_caret);
+
+    switch (key) {
+    case VK_LEFT:
+        if (extend == false && m_caret != m_anchor) {
+            move_caret(selection_start());
+        }
+        else {
+            move_caret(m_caret > 0 ? m_caret - 1 : 0);
+        }
+        return true;
+
+    case VK_RIGHT:
+        if (extend == false && m_caret != m_anchor) {
+            move_caret(selection_end());
+        }
+        else {
+            move_caret((std::min)(m_caret + 1, m_buffer.length()));
+        }
+        return true;
+
+    case VK_UP:
+        if (line == 0) {
+            move_caret(0);
+        }
+        else {
+            move_caret((std::min)(m_buffer.line_start(line - 1) + line_column(m_caret), m_buffer.line_end(line - 1)));
+        }
+        return true;
+
+    case VK_DOWN:
+        if (line + 1 >= m_buffer.line_count()) {
+            move_caret(m_buffer.length());
+        }
+        else {
+            move_caret((std::min)(m_buffer.line_start(line + 1) + line_column(m_caret), m_buffer.line_end(line + 1)));
+        }
+        return true;
+
+    case VK_HOME:
+        move_caret(control ? 0 : m_buffer.line_start(line));
+        return true;
+
+    case VK_END:
+        move_caret(control ? m_buffer.length() : m_buffer.line_end(line));
+        return true;
+
+    case VK_BACK:
+        if (m_caret == m_anchor) {
+            if (m_caret == 0) return true;
+            m_anchor = m_caret - 1;
+        }
+        replace_selection({});
+        return true;
+
+    case VK_DELETE:
+        if (m_caret == m_anchor) {
+            if (m_caret == m_buffer.length()) return true;
+            m_anchor = m_caret + 1;
+        }
+        replace_selection({});
+        return true;
+
+    case 'A':
+        if (control == false) break;
+        select_all();
+        return true;
+    }
+
+    // Tab and Enter are left to focus navigation and the character event
+    return false;
+}
+
+bool TextFieldWidget::handle_character(wchar_t character)
+{
+    if (character == L'\r') {
+        replace_selection(L"\n");
+        return true;
+    }
+
+    // Control characters, including the ones sent for Tab and Ctrl shortcuts
+    if (character < 0x20 || character == 0x7f) return false;
+
+    replace_selection(std::wstring_view(&character, 1));
+    return true;
+}
+
+void TextFieldWidget::handle_focus_gained()
+{
+    auto line = m_buffer.line_of(m_caret);
+    request_repaint(line, line);
+}
+
+void TextFieldWidget::handle_focus_lost()
+{
+    auto line = m_buffer.line_of(m_caret);
+    request_repaint(line, line);
+}
@@ -0,0 +1,168 @@
+// text_field_widget.hpp: Text field widget definition
+
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <Windows.h>
+
+#include <d2d1.h>
+#include <d2d1helper.h>
+#include <dwrite.h>
+
+#include "../core/foundation.hpp"
+#include "../core/interop.hpp"
+#include "../core/piece_table.hpp"
+#include "../core/widget.hpp"
+
+namespace DirectWidget {
+    namespace Widgets {
+
+        // Multi-line editable text
+        // Every paragraph (line of the buffer) is shaped into its own text layout on first display, edits reshape only
+        // the paragraphs they touch. Inside a composited surface, edits repaint only the lines that changed plus the old
+        // and new caret lines, frames painted into the window are painted in full.
+
+        class TextFieldWidget : public WidgetBase
+        {
+        public:
+            // properties
+
+            static property_ptr<PCWSTR> FontFamilyProperty;
+            static property_ptr<float> FontSizeProperty;
+            static property_ptr<D2D1_COLOR_F> ColorProperty;
+            static property_ptr<D2D1_COLOR_F> BackgroundColorProperty;
+            static property_ptr<D2D1_COLOR_F> SelectionColorProperty;
+
+            const PCWSTR& font_family() const { return get_property(FontFamilyProperty); }
+            void set_font_family(const PCWSTR& font_family) { set_property(FontFamilyProperty, font_family); }
+
+            float font_size() const { return get_property(FontSizeProperty); }
+            void set_font_size(float size) { set_property(FontSizeProperty, size); }
+
+            const D2D1_COLOR_F& color() const { return get_property(ColorProperty); }
+            void set_color(const D2D1_COLOR_F& color) { set_property(ColorProperty, color); }
+
+            const D2D1_COLOR_F& background_color() const { return get_property(BackgroundColorProperty); }
+            void set_background_color(const D2D1_COLOR_F& color) { set_property(BackgroundColorProperty, color); }
+
+            const D2D1_COLOR_F& selection_color() const { return get_property(SelectionColorProperty); }
+            void set_selection_color(const D2D1_COLOR_F& color) { set_property(SelectionColorProperty, color); }
+
+            TextFieldWidget();
+            ~TextFieldWidget();
+
+            // text
+
+            const PieceTable& buffer() const { return m_buffer; }
+            std::wstring text() const { return m_buffer.text(); }
+            void set_text(std::wstring_view text);
+
+            // Replaces the selection, or inserts at the caret when nothing is selected
+            void replace_selection(std::wstring_view text);
+
+            // Caret and selection, the selection spans from the anchor to the caret
+
+            size_t caret() const { return m_caret; }
+            size_t anchor() const { return m_anchor; }
+            size_t selection_start() const { return (std::min)(m_caret, m_anchor); }
+            size_t selection_end() const { return (std::max)(m_caret, m_anchor); }
+
+            void set_selection(size_t anchor, size_t caret);
+            void set_caret(size_t caret) { set_selection(caret, caret); }
+            void select_all() { set_selection(0, m_buffer.length()); }
+
+            // layout
+
+            SIZE_F measure(const SIZE_F& available_size) const override;
+
+            // rendering
+
+            void discard_resources() override;
+
+            // interaction
+
+            bool handle_pointer_press(D2D1_POINT_2F point) override;
+            bool handle_key_down(uint32_t key, uint32_t modifiers) override;
+            bool handle_character(wchar_t character) override;
+
+            void handle_focus_gained() override;
+            void handle_focus_lost() override;
+
+        protected:
+            void render(const RenderContext& context) const override;
+
+        private:
+            static const LogContext Logger;
+
+            static constexpr size_t AllLines = (std::numeric_limits<size_t>::max)();
+
+            static Interop::com_resource_ptr<ID2D1SolidColorBrush> TextFillResource;
+            static Interop::com_resource_ptr<ID2D1SolidColorBrush> BackgroundFillResource;
+            static Interop::com_resource_ptr<ID2D1SolidColorBrush> SelectionFillResource;
+            static Interop::com_resource_ptr<IDWriteTextFormat> TextFormatResource;
+
+            class DWriteTextFormatResource;
+            class TextFieldRepaintListener;
+
+            static std::shared_ptr<TextFieldRepaintListener> RepaintListener;
+
+            struct PARAGRAPH {
+                // nullptr until the paragraph is shaped
+                Interop::com_ptr<IDWriteTextLayout> layout;
+                float height = 0.0f;
+            };
+
+            // paragraphs
+
+            void reset_paragraphs() const;
+            // Shapes the paragraph if it has no layout yet, a changed height marks everything below it dirty
+            void shape_paragraph(size_t paragraph) const;
+            float paragraph_top(size_t paragraph) const;
+            size_t paragraph_at(float y) const;
+            float content_height() const;
+            float estimated_line_height() const;
+
+            size_t position_at(D2D1_POINT_2F point) const;
+
+            // repaint
+
+            // Requests repainting lines first to last, last may be AllLines
+            void request_repaint(size_t first, size_t last);
+
+            void ensure_caret_visible(float view_height) const;
+
+            void render_paragraph(const RenderContext& context, size_t paragraph, float top) const;
+
+            size_t line_column(size_t position) const { return position - m_buffer.line_start(m_buffer.line_of(position)); }
+
+            PieceTable m_buffer;
+
+            size_t m_caret = 0;
+            size_t m_anchor = 0;
+
+            // Paragraph cache, tops are prefix sums of heights valid below m_valid_tops
+            mutable std::vector<PARAGRAPH> m_paragraphs;
+            mutable std::vector<float> m_paragraph_tops;
+            mutable size_t m_valid_tops = 1;
+            // Sum of the paragraph heights, kept up to date by every change of the cache
+            mutable float m_content_height = 0.0f;
+            mutable float m_layout_width = -1.0f;
+            mutable float m_scroll_offset = 0.0f;
+            mutable std::wstring m_scratch;
+
+            // Dirty line range of the next partial repaint, the whole widget repaints after any other invalidation
+            // and whenever the render pass does not retain its last frame
+            mutable size_t m_dirty_first = AllLines;
+            mutable size_t m_dirty_last = 0;
+            mutable bool m_full_repaint = true;
+            bool m_requesting_repaint = false;
+        };
+
+    }
+}
@@ -11,6 +11,7 @@
 
 #include "../core/foundation.hpp"
 #include "../core/element_base.hpp"
+#include "../core/glyph_atlas.hpp"
 #include "../core/property.hpp"
 #include "../core/interop.hpp"
 #include "../core/app.hpp"
@@ -75,6 +76,22 @@ protected:
     };
 };
 
+// Glyph runs of the text layout, drawn from the glyph atlas
+class TextWidget::ShapedTextLayoutResource : public SharedResource<SHAPED_TEXT> {
+protected:
+    bool initialize(const ElementBase* owner, std::shared_ptr<SHAPED_TEXT>& resource) override {
+        // Shaped for the atlas of the render target, text is only drawn from an atlas while attached to one
+        auto glyph_atlas = static_cast<const TextWidget*>(owner)->glyph_atlas();
+        if (glyph_atlas == nullptr) return false;
+
+        auto& text_layout = TextWidget::TextLayoutResource->get_or_initialize_resource(owner);
+        if (text_layout == nullptr) return false;
+
+        resource = std::make_shared<SHAPED_TEXT>();
+        return SUCCEEDED(glyph_atlas->shape(text_layout, *resource));
+    }
+};
+
 // properties
 
 property_ptr<PCWSTR> TextWidget::TextProperty = make_property<PCWSTR>(L"Text");
@@ -84,12 +101,14 @@ property_ptr<D2D1_COLOR_F> TextWidget::ColorProperty = make_property<D2D1_COLOR_
 property_ptr<DWRITE_FONT_WEIGHT> TextWidget::FontWeightProperty = make_property(DWRITE_FONT_WEIGHT_NORMAL);
 property_ptr<DWRITE_TEXT_ALIGNMENT> TextWidget::TextAlignmentProperty = make_property(DWRITE_TEXT_ALIGNMENT_LEADING);
 property_ptr<DWRITE_PARAGRAPH_ALIGNMENT> TextWidget::ParagraphAlignmentProperty = make_property(DWRITE_PARAGRAPH_ALIGNMENT_NEAR);
+property_ptr<bool> TextWidget::GlyphAtlasProperty = make_property(true);
 
 // resources
 
 Interop::com_resource_ptr<ID2D1SolidColorBrush> TextWidget::TextFillResource = std::make_shared<Interop::SolidColorBrushResource>(ColorProperty);
 Interop::com_resource_ptr<IDWriteTextFormat> TextWidget::TextFormatResource = std::make_shared<DWriteTextFormatResource>();
 Interop::com_resource_ptr<IDWriteTextLayout> TextWidget::TextLayoutResource = std::make_shared<DWriteTextLayoutResource>();
+resource_ptr<std::shared_ptr<SHAPED_TEXT>> TextWidget::ShapedTextResource = std::make_shared<ShapedTextLayoutResource>();
 
 TextWidget::TextWidget() {
     register_dependency(TextProperty);
@@ -99,10 +118,12 @@ TextWidget::TextWidget() {
     register_dependency(FontWeightProperty);
     register_dependency(TextAlignmentProperty);
     register_dependency(ParagraphAlignmentProperty);
+    register_dependency(GlyphAtlasProperty);
 
     register_dependency(TextFillResource);
     register_dependency(TextFormatResource);
     register_dependency(TextLayoutResource);
+    register_dependency(ShapedTextResource);
 }
 
 SIZE_F TextWidget::measure(const SIZE_F& available_size) const
@@ -134,11 +155,33 @@ SIZE_F TextWidget::measure(const SIZE_F& available_size) const
     return { text_metrics.widthIncludingTrailingWhitespace + 1.0f, text_metrics.height + 1.0f };
 }
 
+void TextWidget::discard_layout()
+{
+    TextLayoutResource->invalidate_for(this);
+    ShapedTextResource->invalidate_for(this);
+    WidgetBase::discard_layout();
+}
+
 void TextWidget::render(const RenderContext& context) const
 {
+    auto origin = D2D1::Point2F(context.render_bounds().left, context.render_bounds().top);
+    auto brush = context.brush(TextFillResource->get_or_initialize_resource(this));
+
+    // Glyphs are blitted on the pixel grid, text rotated or scaled by a render transform is drawn by Direct2D
+    auto& transform = context.transform();
+    auto translation = transform._11 == 1.0f && transform._12 == 0.0f && transform._21 == 0.0f && transform._22 == 1.0f;
+    if (uses_glyph_atlas() && translation && glyph_atlas() != nullptr) {
+        auto& shaped_text = ShapedTextResource->get_or_initialize_resource(this);
+        if (shaped_text != nullptr && shaped_text->cacheable) {
+            auto hr = glyph_atlas()->draw(context, render_target(), *shaped_text, origin, brush);
+            Logger.at(NAMEOF(render)).at(NAMEOF(GlyphAtlas::draw)).log_error(hr);
+            if (SUCCEEDED(hr)) return;
+        }
+    }
+
     context.render_target()->DrawTextLayout(
-        D2D1::Point2F(context.render_bounds().left, context.render_bounds().top),
+        origin,
         TextLayoutResource->get_or_initialize_resource(this),
-        TextFillResource->get_or_initialize_resource(this),
+        brush,
         D2D1_DRAW_TEXT_OPTIONS_ENABLE_COLOR_FONT);
 }
@@ -9,6 +9,7 @@
 #include <dwrite.h>
 
 #include "../core/foundation.hpp"
+#include "../core/glyph_atlas.hpp"
 #include "../core/interop.hpp"
 #include "../core/widget.hpp"
 
@@ -28,6 +29,9 @@ namespace DirectWidget {
             static property_ptr<DWRITE_TEXT_ALIGNMENT> TextAlignmentProperty;
             static property_ptr<DWRITE_PARAGRAPH_ALIGNMENT> ParagraphAlignmentProperty;
 
+            // Text drawn from the GlyphAtlas is shaped once per layout and blitted glyph by glyph, with grayscale antialiasing
+            static property_ptr<bool> GlyphAtlasProperty;
+
             const PCWSTR& text() const { return get_property(TextProperty); }
             void set_text(const PCWSTR& text) { set_property(TextProperty, text); }
             
@@ -49,12 +53,18 @@ namespace DirectWidget {
             DWRITE_PARAGRAPH_ALIGNMENT paragraph_alignment() const { return get_property(ParagraphAlignmentProperty); }
             void set_paragraph_alignment(const DWRITE_PARAGRAPH_ALIGNMENT& alignment) { set_property(ParagraphAlignmentProperty, alignment); }
 
+            bool uses_glyph_atlas() const { return get_property(GlyphAtlasProperty); }
+            void set_uses_glyph_atlas(bool uses_glyph_atlas) { set_property(GlyphAtlasProperty, uses_glyph_atlas); }
+
             TextWidget();
 
             // layout
 
             SIZE_F measure(const SIZE_F& available_size) const override;
 
+            // The text layout is sized to the render bounds
+            void discard_layout() override;
+
         protected:
             void render(const RenderContext& context) const override;
 
@@ -64,9 +74,11 @@ namespace DirectWidget {
             static Interop::com_resource_ptr<ID2D1SolidColorBrush> TextFillResource;
             static Interop::com_resource_ptr<IDWriteTextFormat> TextFormatResource;
             static Interop::com_resource_ptr<IDWriteTextLayout> TextLayoutResource;
+            static resource_ptr<std::shared_ptr<SHAPED_TEXT>> ShapedTextResource;
 
             class DWriteTextFormatResource;
             class DWriteTextLayoutResource;
+            class ShapedTextLayoutResource;
         };
 
     }
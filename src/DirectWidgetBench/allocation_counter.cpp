@@ -0,0 +1,55 @@
+// allocation_counter.cpp: Global operator new of the bench console
+// Counts every allocation of the process, the library included, so benches can check walks never touch the heap.
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <malloc.h>
+#include <new>
+
+#include "bench.hpp"
+
+namespace {
+    std::atomic<uint64_t> AllocationCount{ 0 };
+}
+
+uint64_t DirectWidgetBench::allocation_count()
+{
+    return AllocationCount.load(std::memory_order_relaxed);
+}
+
+void* operator new(size_t size)
+{
+    AllocationCount.fetch_add(1, std::memory_order_relaxed);
+    auto pointer = std::malloc(size == 0 ? 1 : size);
+    if (pointer == nullptr) throw std::bad_alloc();
+    return pointer;
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+    AllocationCount.fetch_add(1, std::memory_order_relaxed);
+    auto pointer = _aligned_malloc(size == 0 ? 1 : size, static_cast<size_t>(alignment));
+    if (pointer == nullptr) throw std::bad_alloc();
+    return pointer;
+}
+
+void operator delete(void* pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t) noexcept
+{
+    _aligned_free(pointer);
+}
+
+void operator delete(void* pointer, size_t, std::align_val_t) noexcept
+{
+    _aligned_free(pointer);
+}
@@ -0,0 +1,147 @@
+// animation_bench.cpp: Animator bench
+// Ticks timelines at fixed times of a virtual clock and checks the values they apply: easing, delay, repeat and auto reverse.
+// Then ticks thousands of concurrent animations and reports the time a tick takes.
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <format>
+#include <initializer_list>
+#include <memory>
+#include <vector>
+
+#include "../DirectWidget/core/animation.hpp"
+#include "../DirectWidget/core/widget.hpp"
+#include "../DirectWidget/widgets/box_widget.hpp"
+
+#include "bench.hpp"
+
+using namespace DirectWidget;
+using namespace DirectWidgetBench;
+using namespace DirectWidget::Widgets;
+
+namespace {
+
+    constexpr std::chrono::microseconds Duration{ 1000 };
+
+    constexpr size_t ConcurrentCount = 10000;
+    constexpr uint32_t TickCount = 100;
+
+    bool nearly_equal(float a, float b) { return std::fabs(a - b) < 1e-4f; }
+
+    TIMELINE make_bench_timeline(Easing easing, uint32_t repeat_count = 1, bool auto_reverse = false,
+        std::chrono::microseconds delay = std::chrono::microseconds(0)) {
+        return { Duration, delay, easing, repeat_count, auto_reverse };
+    }
+
+    typedef struct {
+        // Time of the tick from the start of the animation
+        int64_t time;
+        float opacity;
+        // Whether the animation runs after the tick
+        bool running;
+    } SAMPLE;
+
+    // Animates opacity from 0 to 1 along timeline and checks its value and state after every tick of samples
+    void check_timeline(BenchContext& context, PCWSTR name, const TIMELINE& timeline, std::initializer_list<SAMPLE> samples)
+    {
+        Animator animator(VirtualClock::now);
+        auto widget = std::make_shared<BoxWidget>();
+        widget->set_opacity(0.5f);
+
+        auto start = VirtualClock::now();
+        animator.animate(widget.get(), WidgetBase::OpacityProperty, 0.0f, 1.0f, timeline);
+
+        for (auto& sample : samples) {
+            animator.tick(start + std::chrono::microseconds(sample.time));
+
+            auto matches = nearly_equal(widget->opacity(), sample.opacity) && animator.is_running() == sample.running;
+            if (matches == false) {
+                auto what = std::format(L"{} at {}us: opacity={} running={}, expected opacity={} running={}",
+                    name, sample.time, widget->opacity(), animator.is_running(), sample.opacity, sample.running);
+                context.check(false, what.c_str());
+            }
+        }
+    }
+}
+
+void DirectWidgetBench::run_animation_bench(BenchContext& context)
+{
+    // easing, half way and at the end of the run
+
+    check_timeline(context, L"linear", make_bench_timeline(Easing::Linear), {
+        { 0, 0.0f, true }, { 250, 0.25f, true }, { 500, 0.5f, true }, { 1000, 1.0f, false } });
+    check_timeline(context, L"ease in", make_bench_timeline(Easing::EaseIn), {
+        { 500, 0.125f, true }, { 1000, 1.0f, false } });
+    check_timeline(context, L"ease out", make_bench_timeline(Easing::EaseOut), {
+        { 500, 0.875f, true }, { 1000, 1.0f, false } });
+    check_timeline(context, L"ease in out", make_bench_timeline(Easing::EaseInOut), {
+        { 250, 0.0625f, true }, { 500, 0.5f, true }, { 750, 0.9375f, true }, { 1000, 1.0f, false } });
+    check_timeline(context, L"step", make_bench_timeline(Easing::Step), {
+        { 999, 0.0f, true }, { 1000, 1.0f, false } });
+
+    // The property keeps its value until the delay elapsed
+
+    check_timeline(context, L"delay", make_bench_timeline(Easing::Linear, 1, false, std::chrono::microseconds(500)), {
+        { 400, 0.5f, true }, { 750, 0.25f, true }, { 1500, 1.0f, false } });
+
+    // Runs restart from the start value, reversed runs go back to it, the last run ends the animation
+
+    check_timeline(context, L"repeat", make_bench_timeline(Easing::Linear, 3), {
+        { 1250, 0.25f, true }, { 2500, 0.5f, true }, { 2999, 0.999f, true }, { 3000, 1.0f, false } });
+    check_timeline(context, L"auto reverse", make_bench_timeline(Easing::Linear, 2, true), {
+        { 250, 0.25f, true }, { 1250, 0.75f, true }, { 2000, 0.0f, false } });
+    check_timeline(context, L"forever", make_bench_timeline(Easing::Linear, 0, true), {
+        { 100250, 0.25f, true }, { 101250, 0.75f, true } });
+
+    // Animating a running property again replaces its animation, which continues from the value it reached
+
+    {
+        Animator animator(VirtualClock::now);
+        auto widget = std::make_shared<BoxWidget>();
+
+        auto start = VirtualClock::now();
+        animator.animate(widget.get(), WidgetBase::OpacityProperty, 0.0f, 1.0f, make_bench_timeline(Easing::Linear));
+        animator.tick(start + std::chrono::microseconds(500));
+
+        VirtualClock::advance(std::chrono::microseconds(500));
+        auto replaced_at = VirtualClock::now();
+        auto id = animator.animate(widget.get(), WidgetBase::OpacityProperty, 0.0f, make_bench_timeline(Easing::Linear));
+        context.check(animator.count() == 1, L"replaced animation kept running");
+
+        animator.tick(replaced_at + std::chrono::microseconds(500));
+        context.check(nearly_equal(widget->opacity(), 0.25f), L"replacing animation did not continue from the running value");
+
+        animator.cancel(id);
+        context.check(animator.is_running() == false, L"cancelled animation kept running");
+    }
+
+    // Concurrent animations are ticked from one array, paint animations only discard frames
+
+    {
+        Animator animator(VirtualClock::now);
+        std::vector<std::shared_ptr<BoxWidget>> widgets;
+        widgets.reserve(ConcurrentCount);
+
+        auto start = VirtualClock::now();
+        for (size_t i = 0; i < ConcurrentCount; i++) {
+            auto widget = std::make_shared<BoxWidget>();
+            animator.animate(widget.get(), WidgetBase::OpacityProperty, 0.0f, 1.0f, make_bench_timeline(Easing::EaseInOut, 0, true));
+            widgets.push_back(widget);
+        }
+
+        std::vector<std::chrono::microseconds> ticks;
+        for (uint32_t tick = 1; tick <= TickCount; tick++) {
+            Stopwatch stopwatch;
+            animator.tick(start + std::chrono::microseconds(tick * 16667));
+            ticks.push_back(stopwatch.elapsed());
+        }
+
+        context.check(animator.count() == ConcurrentCount, L"concurrent animations stopped");
+
+        auto tick_time = median(ticks);
+        auto per_animation = static_cast<double>(tick_time.count()) * 1000.0 / ConcurrentCount;
+        context.report(std::format(L"{} concurrent animations: tick={}us ({:.1f}ns per animation)",
+            ConcurrentCount, tick_time.count(), per_animation));
+    }
+}
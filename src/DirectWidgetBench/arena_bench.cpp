@@ -0,0 +1,103 @@
+// arena_bench.cpp: ElementArena bench
+// Builds and drops a screen of about 20k widgets with make_shared and from an arena, and compares the times.
+
+#include <chrono>
+#include <format>
+#include <memory>
+#include <vector>
+
+#include "../DirectWidget/core/arena.hpp"
+#include "../DirectWidget/core/widget.hpp"
+#include "../DirectWidget/layouts/stack_layout.hpp"
+#include "../DirectWidget/widgets/button_widget.hpp"
+
+#include "bench.hpp"
+
+using namespace DirectWidget;
+using namespace DirectWidget::Layouts;
+using namespace DirectWidget::Widgets;
+
+namespace {
+
+    constexpr size_t RowCount = 1000;
+    constexpr size_t ButtonsPerRow = 6;
+
+    // Buttons are a composite, a box and a text each
+    constexpr size_t WidgetCount = 1 + RowCount * (1 + ButtonsPerRow * 3);
+
+    std::shared_ptr<StackLayout> build_screen()
+    {
+        auto root = make_element<StackLayout>();
+        root->set_orientation(STACK_LAYOUT_VERTICAL);
+
+        for (size_t i = 0; i < RowCount; i++) {
+            auto row = make_element<StackLayout>();
+            row->set_orientation(STACK_LAYOUT_HORIZONTAL);
+
+            for (size_t j = 0; j < ButtonsPerRow; j++) {
+                auto button = make_element<ButtonWidget>();
+                button->set_text(L"Button");
+                row->add_child(button);
+            }
+            root->add_child(row);
+        }
+        return root;
+    }
+}
+
+void DirectWidgetBench::run_arena_bench(BenchContext& context)
+{
+    std::vector<std::chrono::microseconds> heap_build, heap_teardown;
+    std::vector<std::chrono::microseconds> arena_build, arena_teardown;
+
+    // The first run warms up the registry and dependency storage, it is not recorded
+    for (int run = 0; run <= BenchContext::DefaultRuns; run++) {
+        {
+            Stopwatch build;
+            auto root = build_screen();
+            auto build_time = build.elapsed();
+
+            Stopwatch teardown;
+            root.reset();
+            auto teardown_time = teardown.elapsed();
+
+            if (run > 0) {
+                heap_build.push_back(build_time);
+                heap_teardown.push_back(teardown_time);
+            }
+        }
+
+        {
+            ElementArena arena;
+
+            Stopwatch build;
+            std::shared_ptr<StackLayout> root;
+            {
+                ElementArena::Scope scope(arena);
+                root = build_screen();
+            }
+            auto build_time = build.elapsed();
+
+            Stopwatch teardown;
+            auto released = arena.release(root);
+            auto teardown_time = teardown.elapsed();
+
+            context.check(released, L"arena released with elements alive");
+            context.check(arena.live_allocations() == 0, L"arena allocations left after release");
+
+            if (run > 0) {
+                arena_build.push_back(build_time);
+                arena_teardown.push_back(teardown_time);
+            }
+        }
+    }
+
+    auto report = [&](PCWSTR phase, std::chrono::microseconds heap, std::chrono::microseconds arena) {
+        auto speedup = arena.count() > 0 ? static_cast<double>(heap.count()) / arena.count() : 0.0;
+        context.report(std::format(L"{} widgets {}: heap={}us arena={}us speedup={:.2f}x",
+            WidgetCount, phase, heap.count(), arena.count(), speedup));
+    };
+
+    report(L"construction", median(heap_build), median(arena_build));
+    report(L"teardown", median(heap_teardown), median(arena_teardown));
+}
@@ -0,0 +1,85 @@
+// attach_bench.cpp: Child attach bench
+// Attaches 100k widgets to parents through register_child, then re-parents every one of them through detach_child
+// and register_child. Reports the cost of an attach and of a re-parent, and checks every widget ends up under its new parent.
+
+#include <chrono>
+#include <format>
+#include <memory>
+#include <vector>
+
+#include "../DirectWidget/core/widget.hpp"
+#include "../DirectWidget/widgets/box_widget.hpp"
+
+#include "bench.hpp"
+
+using namespace DirectWidget;
+using namespace DirectWidget::Widgets;
+
+namespace {
+
+    constexpr size_t ParentCount = 1000;
+    constexpr size_t ChildrenPerParent = 100;
+    constexpr size_t ChildCount = ParentCount * ChildrenPerParent;
+
+    // Exposes register_child and detach_child without a children collection, so only the element tree is timed
+    class ParentWidget : public WidgetBase {
+    public:
+        void attach(const widget_ptr& child) { register_child(child); }
+        void detach(const widget_ptr& child) { detach_child(child); }
+    };
+
+    std::vector<std::shared_ptr<ParentWidget>> make_parents()
+    {
+        std::vector<std::shared_ptr<ParentWidget>> parents;
+        for (size_t i = 0; i < ParentCount; i++) {
+            parents.push_back(std::make_shared<ParentWidget>());
+        }
+        return parents;
+    }
+}
+
+void DirectWidgetBench::run_attach_bench(BenchContext& context)
+{
+    std::vector<widget_ptr> children;
+    for (size_t i = 0; i < ChildCount; i++) {
+        children.push_back(std::make_shared<BoxWidget>());
+    }
+
+    std::vector<std::chrono::microseconds> attaches, reparents;
+    auto misplaced = false;
+
+    for (int run = 0; run < BenchContext::DefaultRuns; run++) {
+        auto parents = make_parents();
+
+        Stopwatch attach;
+        for (size_t i = 0; i < ChildCount; i++) {
+            parents[i % ParentCount]->attach(children[i]);
+        }
+        attaches.push_back(attach.elapsed());
+
+        // Every child moves to the next parent, parents keep a hundred children throughout
+        Stopwatch reparent;
+        for (size_t i = 0; i < ChildCount; i++) {
+            parents[i % ParentCount]->detach(children[i]);
+            parents[(i + 1) % ParentCount]->attach(children[i]);
+        }
+        reparents.push_back(reparent.elapsed());
+
+        for (size_t i = 0; i < ChildCount; i++) {
+            misplaced |= children[i]->parent() != parents[(i + 1) % ParentCount].get();
+        }
+
+        for (size_t i = 0; i < ChildCount; i++) {
+            parents[(i + 1) % ParentCount]->detach(children[i]);
+        }
+    }
+
+    context.check(misplaced == false, L"re-parented widgets are not under their new parent");
+
+    auto attach_time = median(attaches);
+    auto reparent_time = median(reparents);
+    context.report(std::format(L"{} widgets under {} parents: attach={}us ({:.0f}ns each) re-parent={}us ({:.0f}ns each)",
+        ChildCount, ParentCount,
+        attach_time.count(), attach_time.count() * 1000.0 / ChildCount,
+        reparent_time.count(), reparent_time.count() * 1000.0 / ChildCount));
+}
@@ -0,0 +1,92 @@
+// bench.hpp: BenchContext definition
+// Benches of the DirectWidgetBench console time their bodies over a few runs and report the median.
+// Checks print what failed, the console exits with a failure when any of them did.
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <format>
+#include <string>
+#include <vector>
+
+#include <Windows.h>
+
+namespace DirectWidgetBench {
+
+    // Clock of the stopwatches, the same clock the library reads input and frame times from
+    using bench_clock = std::chrono::steady_clock;
+
+    class BenchContext {
+    public:
+        // Runs of every timed body, the median of them is reported
+        static constexpr int DefaultRuns = 5;
+
+        void begin(PCWSTR name) { m_name = name; }
+
+        void check(bool condition, PCWSTR what) {
+            if (condition) return;
+            m_failures++;
+            auto line = std::format(L"{}: FAILED: {}\n", m_name, what);
+            std::fputws(line.c_str(), stdout);
+        }
+
+        void report(const std::wstring& message) const {
+            auto line = std::format(L"{}: {}\n", m_name, message);
+            std::fputws(line.c_str(), stdout);
+        }
+
+        uint32_t failure_count() const { return m_failures; }
+
+    private:
+        PCWSTR m_name = L"";
+        uint32_t m_failures = 0;
+    };
+
+    class Stopwatch {
+    public:
+        Stopwatch() : m_start(bench_clock::now()) {}
+
+        std::chrono::microseconds elapsed() const {
+            return std::chrono::duration_cast<std::chrono::microseconds>(bench_clock::now() - m_start);
+        }
+
+    private:
+        bench_clock::time_point m_start;
+    };
+
+    // Time of the virtual clocks passed to the library, it only moves when a bench advances it
+    class VirtualClock {
+    public:
+        static bench_clock::time_point now() { return s_time; }
+        static void advance(std::chrono::microseconds duration) { s_time += duration; }
+
+    private:
+        static inline bench_clock::time_point s_time{};
+    };
+
+    // Allocations made through operator new by the process so far, the library included
+    uint64_t allocation_count();
+
+    inline std::chrono::microseconds median(std::vector<std::chrono::microseconds> samples) {
+        if (samples.empty()) return std::chrono::microseconds(0);
+        auto middle = samples.begin() + samples.size() / 2;
+        std::nth_element(samples.begin(), middle, samples.end());
+        return *middle;
+    }
+
+    // benches
+
+    void run_animation_bench(BenchContext& context);
+    void run_arena_bench(BenchContext& context);
+    void run_attach_bench(BenchContext& context);
+    void run_children_bench(BenchContext& context);
+    void run_grid_bench(BenchContext& context);
+    void run_input_bench(BenchContext& context);
+    void run_latency_bench(BenchContext& context);
+    void run_raster_bench(BenchContext& context);
+    void run_scheduler_bench(BenchContext& context);
+    void run_tile_bench(BenchContext& context);
+}
@@ -0,0 +1,103 @@
+// children_bench.cpp: Child enumeration bench
+// Walks a tree of about 10k widgets through children() and for_each_child, and checks the walks never allocate.
+
+#include <chrono>
+#include <format>
+#include <memory>
+#include <vector>
+
+#include "../DirectWidget/core/widget.hpp"
+#include "../DirectWidget/layouts/stack_layout.hpp"
+#include "../DirectWidget/widgets/box_widget.hpp"
+
+#include "bench.hpp"
+
+using namespace DirectWidget;
+using namespace DirectWidget::Layouts;
+using namespace DirectWidget::Widgets;
+
+namespace {
+
+    constexpr size_t Depth = 4;
+    constexpr size_t Fanout = 10;
+
+    // Exposes for_each_child, which WidgetBase keeps for its own walks
+    class WalkedLayout : public StackLayout {
+    public:
+        size_t count_subtree() const {
+            size_t count = 1;
+            for_each_child([&count](WidgetBase* child) {
+                auto layout = dynamic_cast<WalkedLayout*>(child);
+                count += layout != nullptr ? layout->count_subtree() : 1;
+                });
+            return count;
+        }
+    };
+
+    std::shared_ptr<WalkedLayout> build_tree(size_t depth)
+    {
+        auto layout = std::make_shared<WalkedLayout>();
+        for (size_t i = 0; i < Fanout; i++) {
+            if (depth > 1) {
+                layout->add_child(build_tree(depth - 1));
+            }
+            else {
+                layout->add_child(std::make_shared<BoxWidget>());
+            }
+        }
+        return layout;
+    }
+
+    size_t count_children(const WidgetBase* widget)
+    {
+        size_t count = 1;
+        for (auto& child : widget->children()) {
+            count += count_children(child.get());
+        }
+        return count;
+    }
+
+    void discard_frames(WidgetBase* widget)
+    {
+        widget->discard_frame();
+        for (auto& child : widget->children()) {
+            discard_frames(child.get());
+        }
+    }
+}
+
+void DirectWidgetBench::run_children_bench(BenchContext& context)
+{
+    auto root = build_tree(Depth);
+    auto expected = count_children(root.get());
+
+    // The first frame discard writes resource state of every widget, it is not counted
+    discard_frames(root.get());
+
+    std::vector<std::chrono::microseconds> span_walks, visitor_walks;
+    size_t span_count = 0;
+    size_t visitor_count = 0;
+
+    auto allocations = allocation_count();
+    for (int run = 0; run < BenchContext::DefaultRuns; run++) {
+        Stopwatch span_walk;
+        span_count = count_children(root.get());
+        span_walks.push_back(span_walk.elapsed());
+
+        Stopwatch visitor_walk;
+        visitor_count = root->count_subtree();
+        visitor_walks.push_back(visitor_walk.elapsed());
+    }
+    auto walk_allocations = allocation_count() - allocations;
+
+    allocations = allocation_count();
+    discard_frames(root.get());
+    auto discard_allocations = allocation_count() - allocations;
+
+    context.check(span_count == expected && visitor_count == expected, L"walks missed widgets");
+    context.check(walk_allocations == 0, L"child enumeration allocated");
+    context.check(discard_allocations == 0, L"frame discard walk allocated");
+
+    context.report(std::format(L"{} widgets: children()={}us for_each_child={}us allocations={}",
+        expected, median(span_walks).count(), median(visitor_walks).count(), walk_allocations + discard_allocations));
+}
@@ -0,0 +1,172 @@
+// grid_bench.cpp: GridLayout bench
+// Lays out a table as a GridLayout and as the nested StackLayout tree it replaces, and counts the measures of the cells.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <memory>
+#include <vector>
+
+#include "../DirectWidget/core/widget.hpp"
+#include "../DirectWidget/layouts/grid_layout.hpp"
+#include "../DirectWidget/layouts/stack_layout.hpp"
+
+#include "bench.hpp"
+
+using namespace DirectWidget;
+using namespace DirectWidgetBench;
+using namespace DirectWidget::Layouts;
+
+namespace {
+
+    constexpr size_t RowCount = 500;
+    constexpr size_t ColumnCount = 10;
+
+    constexpr SIZE_F ViewportSize{ 4096.0f, 16384.0f };
+
+    // Cell content of a fixed size, counting how often it is measured
+    class CellWidget : public WidgetBase {
+    public:
+        CellWidget(const SIZE_F& content_size) : m_content_size(content_size) {}
+
+        uint32_t measure_count() const { return m_measure_count; }
+        void reset_measure_count() { m_measure_count = 0; }
+
+        SIZE_F measure(const SIZE_F& maximum_size) const override {
+            m_measure_count++;
+            return {
+                (std::min)(m_content_size.width, maximum_size.width),
+                (std::min)(m_content_size.height, maximum_size.height)
+            };
+        }
+
+    private:
+        SIZE_F m_content_size;
+        mutable uint32_t m_measure_count = 0;
+    };
+
+    SIZE_F cell_size(size_t row, size_t column)
+    {
+        return {
+            20.0f + static_cast<float>((row * 7 + column * 13) % 60),
+            16.0f + static_cast<float>((row + column) % 8)
+        };
+    }
+
+    std::shared_ptr<GridLayout> build_grid(std::vector<std::shared_ptr<CellWidget>>& cells)
+    {
+        auto grid = std::make_shared<GridLayout>();
+        for (size_t row = 0; row < RowCount; row++) {
+            grid->add_row(make_auto_track());
+        }
+        for (size_t column = 0; column < ColumnCount; column++) {
+            grid->add_column(make_auto_track());
+        }
+
+        for (size_t row = 0; row < RowCount; row++) {
+            for (size_t column = 0; column < ColumnCount; column++) {
+                auto cell = std::make_shared<CellWidget>(cell_size(row, column));
+                grid->add_child(cell, GRID_CELL{ row, column, 1, 1 });
+                cells.push_back(cell);
+            }
+        }
+        return grid;
+    }
+
+    std::shared_ptr<StackLayout> build_stacks(std::vector<std::shared_ptr<CellWidget>>& cells)
+    {
+        auto table = std::make_shared<StackLayout>();
+        table->set_orientation(STACK_LAYOUT_VERTICAL);
+
+        for (size_t row = 0; row < RowCount; row++) {
+            auto stack = std::make_shared<StackLayout>();
+            stack->set_orientation(STACK_LAYOUT_HORIZONTAL);
+
+            for (size_t column = 0; column < ColumnCount; column++) {
+                auto cell = std::make_shared<CellWidget>(cell_size(row, column));
+                stack->add_child(cell);
+                cells.push_back(cell);
+            }
+            table->add_child(stack);
+        }
+        return table;
+    }
+
+    // Measures and lays out the whole tree from scratch, as the first frame of a window does
+    std::chrono::microseconds layout_pass(const widget_ptr& root)
+    {
+        Stopwatch stopwatch;
+        root->set_maximum_size(ViewportSize);
+        root->set_constraints(BOUNDS_F{ 0, 0, ViewportSize.width, ViewportSize.height });
+        root->discard_measure();
+        WidgetBase::RenderBoundsResource->get_or_initialize_resource(root.get());
+        return stopwatch.elapsed();
+    }
+
+    typedef struct {
+        std::chrono::microseconds layout;
+        // Measures of the cells in one pass, over every cell and for the cell measured most often
+        uint64_t measures;
+        uint32_t maximum_measures;
+    } LAYOUT_RESULT;
+
+    LAYOUT_RESULT measure_layout(const widget_ptr& root, const std::vector<std::shared_ptr<CellWidget>>& cells)
+    {
+        std::vector<std::chrono::microseconds> passes;
+        LAYOUT_RESULT result{};
+
+        // The first pass creates layout nodes and resource state, it is not recorded
+        for (int run = 0; run <= BenchContext::DefaultRuns; run++) {
+            for (auto& cell : cells) {
+                cell->reset_measure_count();
+            }
+
+            auto duration = layout_pass(root);
+            if (run == 0) continue;
+            passes.push_back(duration);
+
+            result.measures = 0;
+            result.maximum_measures = 0;
+            for (auto& cell : cells) {
+                result.measures += cell->measure_count();
+                result.maximum_measures = (std::max)(result.maximum_measures, cell->measure_count());
+            }
+        }
+
+        result.layout = median(passes);
+        return result;
+    }
+}
+
+void DirectWidgetBench::run_grid_bench(BenchContext& context)
+{
+    std::vector<std::shared_ptr<CellWidget>> grid_cells;
+    auto grid = build_grid(grid_cells);
+    auto grid_result = measure_layout(grid, grid_cells);
+
+    std::vector<std::shared_ptr<CellWidget>> stack_cells;
+    auto stacks = build_stacks(stack_cells);
+    auto stack_result = measure_layout(stacks, stack_cells);
+
+    context.check(grid_result.maximum_measures == 1, L"grid measured a cell more than once in a pass");
+    context.check(grid->column_sizes().size() == ColumnCount && grid->row_sizes().size() == RowCount, L"grid resolved a wrong track count");
+
+    // Auto columns are as wide as their widest cell
+    auto widths_match = true;
+    for (size_t column = 0; column < ColumnCount; column++) {
+        auto widest = 0.0f;
+        for (size_t row = 0; row < RowCount; row++) {
+            widest = (std::max)(widest, cell_size(row, column).width);
+        }
+        widths_match = widths_match && grid->column_sizes()[column] == widest;
+    }
+    context.check(widths_match, L"auto columns do not fit their widest cell");
+
+    auto speedup = grid_result.layout.count() > 0 ? static_cast<double>(stack_result.layout.count()) / grid_result.layout.count() : 0.0;
+    context.report(std::format(L"{}x{} cells: grid={}us measures={} (max {} per cell), stacks={}us measures={} (max {} per cell), speedup={:.2f}x",
+        RowCount, ColumnCount,
+        grid_result.layout.count(), grid_result.measures, grid_result.maximum_measures,
+        stack_result.layout.count(), stack_result.measures, stack_result.maximum_measures,
+        speedup));
+}
@@ -0,0 +1,154 @@
+// input_bench.cpp: Input injection bench
+// Injects pointer input into a window without a handle and drains it through process_input, as a frame would.
+// Reports input records dispatched per second and dispatch latency, and checks every press reached the widget under it.
+
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <memory>
+#include <vector>
+
+#include "../DirectWidget/core/input_queue.hpp"
+#include "../DirectWidget/core/latency.hpp"
+#include "../DirectWidget/core/widget.hpp"
+#include "../DirectWidget/core/window.hpp"
+#include "../DirectWidget/layouts/stack_layout.hpp"
+
+#include "bench.hpp"
+
+using namespace DirectWidget;
+using namespace DirectWidget::Layouts;
+
+namespace {
+
+    constexpr size_t RowCount = 40;
+    constexpr size_t ColumnCount = 25;
+    constexpr size_t CellCount = RowCount * ColumnCount;
+
+    constexpr SIZE_F CellSize{ 40.0f, 20.0f };
+    constexpr SIZE_F ViewportSize{ CellSize.width * ColumnCount, CellSize.height * RowCount };
+
+    // Clicks per timed run, each one is a move, a press and a release
+    constexpr size_t ClickCount = 20000;
+
+    // Clicks injected before the queue is drained, the queue holds all of their records
+    constexpr size_t ClicksPerFrame = 256;
+    static_assert(ClicksPerFrame * 3 <= InputQueue::Capacity, "a frame of clicks overflows the input queue");
+
+    class TargetWidget : public WidgetBase {
+    public:
+        SIZE_F measure(const SIZE_F& maximum_size) const override { return CellSize; }
+
+        bool handle_pointer_press(D2D1_POINT_2F point) override {
+            m_presses++;
+            return true;
+        }
+
+        bool handle_pointer_release(D2D1_POINT_2F point) override {
+            m_releases++;
+            return true;
+        }
+
+        uint64_t presses() const { return m_presses; }
+        uint64_t releases() const { return m_releases; }
+
+    private:
+        uint64_t m_presses = 0;
+        uint64_t m_releases = 0;
+    };
+
+    // Cells are clicked in a scattered order, so every click moves the pointer to another widget
+    size_t clicked_cell(size_t click)
+    {
+        return (click * 7919) % CellCount;
+    }
+
+    POINT cell_center(size_t cell)
+    {
+        auto row = cell / ColumnCount, column = cell % ColumnCount;
+        return {
+            static_cast<LONG>((column + 0.5f) * CellSize.width),
+            static_cast<LONG>((row + 0.5f) * CellSize.height),
+        };
+    }
+
+    std::shared_ptr<StackLayout> build_screen(std::vector<std::shared_ptr<TargetWidget>>& targets)
+    {
+        auto screen = std::make_shared<StackLayout>();
+        screen->set_orientation(STACK_LAYOUT_VERTICAL);
+
+        for (size_t row = 0; row < RowCount; row++) {
+            auto stack = std::make_shared<StackLayout>();
+            stack->set_orientation(STACK_LAYOUT_HORIZONTAL);
+            for (size_t column = 0; column < ColumnCount; column++) {
+                auto target = std::make_shared<TargetWidget>();
+                stack->add_child(target);
+                targets.push_back(target);
+            }
+            screen->add_child(stack);
+        }
+        return screen;
+    }
+}
+
+void DirectWidgetBench::run_input_bench(BenchContext& context)
+{
+    std::vector<std::shared_ptr<TargetWidget>> targets;
+    auto root = build_screen(targets);
+
+    // No handle is ever created, the window maps pixels at the default scale
+    Window window;
+    window.set_root_widget(root);
+
+    root->set_maximum_size(ViewportSize);
+    root->set_constraints(BOUNDS_F{ 0, 0, ViewportSize.width, ViewportSize.height });
+    root->discard_measure();
+    WidgetBase::RenderBoundsResource->get_or_initialize_resource(root.get());
+
+    auto center = cell_center(CellCount - 1);
+    context.check(window.hit_test(D2D1::Point2F(static_cast<float>(center.x), static_cast<float>(center.y))) == targets.back().get(),
+        L"hit test missed the widget under the pointer");
+
+    std::vector<std::chrono::microseconds> samples;
+    for (int run = 0; run < BenchContext::DefaultRuns; run++) {
+        Stopwatch stopwatch;
+        for (size_t click = 0; click < ClickCount; click++) {
+            auto point = cell_center(clicked_cell(click));
+            window.inject_input(make_input_event(InputType::PointerMove, point.x, point.y));
+            window.inject_input(make_input_event(InputType::PointerPress, point.x, point.y));
+            window.inject_input(make_input_event(InputType::PointerRelease, point.x, point.y));
+
+            if ((click + 1) % ClicksPerFrame == 0) {
+                window.process_input();
+            }
+        }
+        window.process_input();
+        samples.push_back(stopwatch.elapsed());
+    }
+
+    // Every run clicks the same cells
+    std::vector<uint64_t> expected(CellCount);
+    for (size_t click = 0; click < ClickCount; click++) {
+        expected[clicked_cell(click)] += BenchContext::DefaultRuns;
+    }
+
+    auto missed = false;
+    for (size_t cell = 0; cell < CellCount; cell++) {
+        missed |= targets[cell]->presses() != expected[cell] || targets[cell]->releases() != expected[cell];
+    }
+    context.check(missed == false, L"clicks reached other widgets than the ones under the pointer");
+
+    auto time = median(samples);
+    auto records = ClickCount * 3;
+    auto records_per_second = time.count() > 0 ? records * 1e6 / time.count() : 0.0;
+
+    auto& tracker = window.latency_tracker();
+    auto& presses = tracker.histogram(InputType::PointerPress, LatencyStage::Dispatch);
+    auto& moves = tracker.histogram(InputType::PointerMove, LatencyStage::Dispatch);
+
+    context.report(std::format(L"{} widgets, {} records in {}us: {:.0f} records/s, "
+        L"press dispatch p50={}us p99={}us, move dispatch p50={}us p99={}us",
+        CellCount, records, time.count(), records_per_second,
+        presses.percentile(50).count(), presses.percentile(99).count(),
+        moves.percentile(50).count(), moves.percentile(99).count()));
+}
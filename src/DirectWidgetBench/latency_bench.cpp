@@ -0,0 +1,105 @@
+// latency_bench.cpp: LatencyTracker bench
+// Feeds the tracker input of known latencies under a virtual clock and checks the percentiles it reports,
+// including samples beyond the range of the histogram. Reports the cost of recording a sample.
+
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <vector>
+
+#include "../DirectWidget/core/input_queue.hpp"
+#include "../DirectWidget/core/latency.hpp"
+
+#include "bench.hpp"
+
+using namespace DirectWidget;
+using namespace DirectWidgetBench;
+
+namespace {
+
+    // Input records, the n-th one is dispatched n microseconds after it was received
+    constexpr uint64_t EventCount = 1000;
+
+    // Time from the end of the last dispatch to the frame presenting every record
+    constexpr std::chrono::microseconds PresentDelay{ 5000 };
+
+    // Samples per timed run of record()
+    constexpr size_t RecordCount = 1000000;
+
+    // A percentile is the upper bound of its bucket, at most 1/SubBucketCount above the exact value
+    bool within_bucket(std::chrono::microseconds reported, uint64_t exact)
+    {
+        auto value = static_cast<uint64_t>(reported.count());
+        return value >= exact && value <= exact + exact / LatencyHistogram::SubBucketCount;
+    }
+
+    void check_percentiles(BenchContext& context, const LatencyHistogram& histogram, uint64_t offset, PCWSTR what)
+    {
+        // Samples are offset + 1 .. offset + EventCount, percentile p is the sample ranked p * EventCount / 100
+        const double percentiles[] = { 50, 95, 99 };
+        auto passed = histogram.count() == EventCount;
+        for (auto percentile : percentiles) {
+            auto exact = offset + static_cast<uint64_t>(percentile * EventCount / 100);
+            passed = passed && within_bucket(histogram.percentile(percentile), exact);
+        }
+        context.check(passed, what);
+    }
+}
+
+void DirectWidgetBench::run_latency_bench(BenchContext& context)
+{
+    LatencyTracker tracker(VirtualClock::now);
+
+    std::vector<INPUT_EVENT> events;
+    for (uint64_t i = 1; i <= EventCount; i++) {
+        auto event = make_key_input_event(InputType::KeyDown, 'A', 0);
+        event.timestamp = VirtualClock::now();
+
+        VirtualClock::advance(std::chrono::microseconds(i));
+        tracker.begin_dispatch(event);
+        tracker.note_invalidation();
+        tracker.end_dispatch();
+
+        // The clock is put back, so the next record is received when this one was
+        VirtualClock::advance(-std::chrono::microseconds(i));
+    }
+
+    // Every record waits for the frame presented PresentDelay after the slowest dispatch
+    VirtualClock::advance(std::chrono::microseconds(EventCount) + PresentDelay);
+    tracker.frame_presented();
+
+    auto& dispatch = tracker.histogram(InputType::KeyDown, LatencyStage::Dispatch);
+    auto& present = tracker.histogram(InputType::KeyDown, LatencyStage::Present);
+
+    check_percentiles(context, dispatch, 0, L"dispatch percentiles differ from the recorded latencies");
+    // Every record was received at the same virtual time
+    auto presented = EventCount + static_cast<uint64_t>(PresentDelay.count());
+    context.check(present.count() == EventCount && within_bucket(present.percentile(50), presented) &&
+        static_cast<uint64_t>(present.maximum().count()) == presented,
+        L"present latency differs from the time the frame was presented");
+
+    // Samples beyond 2^40 microseconds land in the last bucket, percentiles saturate at its upper bound
+    LatencyHistogram saturated;
+    saturated.record(std::chrono::microseconds(int64_t{ 1 } << 45));
+    saturated.record(std::chrono::microseconds((int64_t{ 1 } << 41) + 12345));
+    context.check(saturated.percentile(50).count() == (int64_t{ 1 } << 40) - 1 && saturated.percentile(100).count() == (int64_t{ 1 } << 40) - 1,
+        L"samples beyond the histogram range did not land in its last bucket");
+
+    LatencyHistogram histogram;
+    std::vector<std::chrono::microseconds> samples;
+    for (int run = 0; run < BenchContext::DefaultRuns; run++) {
+        histogram.reset();
+
+        Stopwatch stopwatch;
+        for (size_t i = 0; i < RecordCount; i++) {
+            histogram.record(std::chrono::microseconds(i % 100000));
+        }
+        samples.push_back(stopwatch.elapsed());
+    }
+    auto time = median(samples);
+
+    context.report(std::format(L"{} records: dispatch p50={}us p95={}us p99={}us, present p50={}us p99={}us, record={:.1f}ns",
+        EventCount, dispatch.percentile(50).count(), dispatch.percentile(95).count(), dispatch.percentile(99).count(),
+        present.percentile(50).count(), present.percentile(99).count(),
+        time.count() * 1000.0 / RecordCount));
+}
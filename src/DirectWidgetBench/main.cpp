@@ -0,0 +1,44 @@
+// main.cpp: Entry point of the DirectWidgetBench console
+// Runs every bench, or the benches named on the command line, and fails when any check failed.
+
+#include <algorithm>
+#include <cwchar>
+
+#include <Windows.h>
+
+#include "bench.hpp"
+
+using namespace DirectWidgetBench;
+
+typedef struct {
+    PCWSTR name;
+    void (*run)(BenchContext& context);
+} BENCH;
+
+static const BENCH Benches[] = {
+    { L"arena", run_arena_bench },
+    { L"children", run_children_bench },
+    { L"grid", run_grid_bench },
+    { L"scheduler", run_scheduler_bench },
+    { L"animation", run_animation_bench },
+    { L"raster", run_raster_bench },
+    { L"input", run_input_bench },
+    { L"latency", run_latency_bench },
+    { L"attach", run_attach_bench },
+    { L"tiles", run_tile_bench },
+};
+
+int wmain(int argc, wchar_t* argv[])
+{
+    BenchContext context;
+
+    for (auto& bench : Benches) {
+        auto selected = argc <= 1 || std::any_of(argv + 1, argv + argc, [&](const wchar_t* name) { return std::wcscmp(name, bench.name) == 0; });
+        if (selected == false) continue;
+
+        context.begin(bench.name);
+        bench.run(context);
+    }
+
+    return context.failure_count() == 0 ? 0 : 1;
+}
@@ -0,0 +1,175 @@
+// raster_bench.cpp: Rasterizer bench
+// Runs every raster kernel with every instruction set the processor supports and reports megapixels per second.
+// Checks the vector kernels draw the same pixels as the scalar ones.
+
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <Windows.h>
+
+#include "../DirectWidget/core/foundation.hpp"
+#include "../DirectWidget/core/rasterizer.hpp"
+
+#include "bench.hpp"
+
+using namespace DirectWidget;
+
+namespace {
+
+    constexpr UINT SurfaceWidth = 1920;
+    constexpr UINT SurfaceHeight = 1080;
+
+    // Operations per timed run
+    constexpr int Repeats = 10;
+
+    constexpr size_t RectCount = 4000;
+
+    PCWSTR instruction_set_name(RasterInstructionSet instruction_set)
+    {
+        switch (instruction_set) {
+        case RasterInstructionSet::Avx2: return L"avx2";
+        case RasterInstructionSet::Sse2: return L"sse2";
+        case RasterInstructionSet::Scalar:
+        default: return L"scalar";
+        }
+    }
+
+    // Premultiplied pixels of varying alpha, a quarter of them opaque and a fifth transparent
+    void fill_pattern(std::vector<uint32_t>& pixels, uint32_t seed)
+    {
+        auto state = seed;
+        auto next = [&state]() {
+            state = state * 1664525u + 1013904223u;
+            return state >> 8;
+        };
+
+        for (auto& pixel : pixels) {
+            auto alpha = next() & 0xFF;
+            if (next() % 4 == 0) alpha = 255;
+            if (next() % 5 == 0) alpha = 0;
+
+            pixel = alpha << 24;
+            for (uint32_t shift = 0; shift < 24; shift += 8) {
+                pixel |= (next() % (alpha + 1)) << shift;
+            }
+        }
+    }
+
+    // Rects at fractional positions, so most of their edges are anti-aliased
+    BOUNDS_F bench_rect(size_t index)
+    {
+        auto x = static_cast<float>((index * 37) % (SurfaceWidth - 64)) + 0.3f;
+        auto y = static_cast<float>((index * 53) % (SurfaceHeight - 48)) + 0.6f;
+        return { x, y, x + 60.4f, y + 40.7f };
+    }
+
+    typedef struct {
+        PCWSTR name;
+        // Pixels one operation draws
+        double pixels;
+        std::function<void(const Rasterizer&, const RASTER_SURFACE&, const RASTER_SURFACE&)> draw;
+    } KERNEL_BENCH;
+
+    // Draws every primitive with rasterizer on a small surface of odd size, so vector kernels run their remainders as well
+    std::vector<uint32_t> draw_reference(const Rasterizer& rasterizer)
+    {
+        std::vector<uint32_t> target(97 * 61);
+        std::vector<uint32_t> source(53 * 41);
+        fill_pattern(target, 7);
+        fill_pattern(source, 11);
+
+        RASTER_SURFACE target_surface{ target.data(), 97, 61, 97 };
+        RASTER_SURFACE source_surface{ source.data(), 53, 41, 53 };
+
+        rasterizer.fill_rect(target_surface, BOUNDS_F{ 3.3f, 2.7f, 90.1f, 50.5f }, D2D1_COLOR_F{ 1.0f, 0.0f, 0.0f, 1.0f });
+        rasterizer.fill_rect(target_surface, BOUNDS_F{ 10.5f, 5.25f, 60.75f, 58.9f }, D2D1_COLOR_F{ 0.0f, 0.5f, 1.0f, 0.4f });
+        rasterizer.fill_rect(target_surface, BOUNDS_F{ -5.0f, -5.0f, 200.0f, 200.0f }, D2D1_COLOR_F{ 0.2f, 0.3f, 0.4f, 0.1f });
+        rasterizer.stroke_rect(target_surface, BOUNDS_F{ 20.2f, 10.7f, 80.3f, 40.1f }, 1.5f, D2D1_COLOR_F{ 0.0f, 0.0f, 0.0f, 0.8f });
+        rasterizer.blit(target_surface, source_surface, POINT{ -7, 5 }, RECT{ 0, 0, 97, 61 });
+        rasterizer.blend(target_surface, source_surface, POINT{ 40, 30 }, RECT{ 0, 0, 80, 55 });
+        rasterizer.blend(target_surface, source_surface, POINT{ 1, 1 }, RECT{ 0, 0, 97, 61 });
+        return target;
+    }
+}
+
+void DirectWidgetBench::run_raster_bench(BenchContext& context)
+{
+    std::vector<uint32_t> target(static_cast<size_t>(SurfaceWidth) * SurfaceHeight);
+    std::vector<uint32_t> source(target.size());
+    fill_pattern(source, 3);
+
+    RASTER_SURFACE target_surface{ target.data(), SurfaceWidth, SurfaceHeight, SurfaceWidth };
+    RASTER_SURFACE source_surface{ source.data(), SurfaceWidth, SurfaceHeight, SurfaceWidth };
+
+    const BOUNDS_F full{ 0.0f, 0.0f, static_cast<float>(SurfaceWidth), static_cast<float>(SurfaceHeight) };
+    const RECT clip{ 0, 0, static_cast<LONG>(SurfaceWidth), static_cast<LONG>(SurfaceHeight) };
+    const POINT offset{ -3, 2 };
+    const double frame_pixels = static_cast<double>(SurfaceWidth) * SurfaceHeight;
+    const double offset_pixels = static_cast<double>(SurfaceWidth - 3) * (SurfaceHeight - 2);
+
+    // Area of the rects, and of the 1.5 pixel strokes around them
+    const double rect_pixels = RectCount * 60.4 * 40.7;
+    const double stroke_pixels = RectCount * (61.9 * 42.2 - 58.9 * 39.2);
+
+    const KERNEL_BENCH kernels[] = {
+        { L"fill", frame_pixels, [&](const Rasterizer& rasterizer, const RASTER_SURFACE& target, const RASTER_SURFACE&) {
+            rasterizer.fill_rect(target, full, D2D1_COLOR_F{ 0.2f, 0.4f, 0.6f, 1.0f });
+        } },
+        { L"fill translucent", frame_pixels, [&](const Rasterizer& rasterizer, const RASTER_SURFACE& target, const RASTER_SURFACE&) {
+            rasterizer.fill_rect(target, full, D2D1_COLOR_F{ 0.2f, 0.4f, 0.6f, 0.5f });
+        } },
+        { L"fill anti-aliased", rect_pixels, [&](const Rasterizer& rasterizer, const RASTER_SURFACE& target, const RASTER_SURFACE&) {
+            for (size_t i = 0; i < RectCount; i++) {
+                rasterizer.fill_rect(target, bench_rect(i), D2D1_COLOR_F{ 0.8f, 0.1f, 0.1f, 1.0f });
+            }
+        } },
+        { L"stroke", stroke_pixels, [&](const Rasterizer& rasterizer, const RASTER_SURFACE& target, const RASTER_SURFACE&) {
+            for (size_t i = 0; i < RectCount; i++) {
+                rasterizer.stroke_rect(target, bench_rect(i), 1.5f, D2D1_COLOR_F{ 0.0f, 0.0f, 0.0f, 1.0f });
+            }
+        } },
+        { L"blit", offset_pixels, [&](const Rasterizer& rasterizer, const RASTER_SURFACE& target, const RASTER_SURFACE& source) {
+            rasterizer.blit(target, source, offset, clip);
+        } },
+        { L"blend", offset_pixels, [&](const Rasterizer& rasterizer, const RASTER_SURFACE& target, const RASTER_SURFACE& source) {
+            rasterizer.blend(target, source, offset, clip);
+        } },
+    };
+
+    auto supported = Rasterizer::supported_instruction_set();
+    auto reference = draw_reference(Rasterizer(RasterInstructionSet::Scalar));
+
+    for (auto& kernel : kernels) {
+        std::wstring line = std::format(L"{}:", kernel.name);
+
+        for (auto instruction_set = RasterInstructionSet::Scalar; instruction_set <= supported;
+            instruction_set = static_cast<RasterInstructionSet>(static_cast<int>(instruction_set) + 1)) {
+            Rasterizer rasterizer(instruction_set);
+
+            std::vector<std::chrono::microseconds> samples;
+            for (int run = 0; run < BenchContext::DefaultRuns; run++) {
+                Stopwatch stopwatch;
+                for (int repeat = 0; repeat < Repeats; repeat++) {
+                    kernel.draw(rasterizer, target_surface, source_surface);
+                }
+                samples.push_back(stopwatch.elapsed());
+            }
+
+            auto time = median(samples);
+            auto megapixels_per_second = time.count() > 0 ? kernel.pixels * Repeats / time.count() : 0.0;
+            line += std::format(L" {}={:.0f}MP/s", instruction_set_name(instruction_set), megapixels_per_second);
+        }
+        context.report(line);
+    }
+
+    for (auto instruction_set = RasterInstructionSet::Sse2; instruction_set <= supported;
+        instruction_set = static_cast<RasterInstructionSet>(static_cast<int>(instruction_set) + 1)) {
+        auto pixels = draw_reference(Rasterizer(instruction_set));
+        auto what = std::format(L"{} kernels drew other pixels than the scalar ones", instruction_set_name(instruction_set));
+        context.check(pixels == reference, what.c_str());
+    }
+}
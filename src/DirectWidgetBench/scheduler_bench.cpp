@@ -0,0 +1,121 @@
+// scheduler_bench.cpp: LayoutScheduler bench
+// Runs a cold layout of a large screen in budgeted frames under a virtual clock, where every measure costs a fixed time.
+// Reports budget adherence and completion latency, and checks slices overrun by at most one measure.
+
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <memory>
+
+#include "../DirectWidget/core/layout_scheduler.hpp"
+#include "../DirectWidget/core/widget.hpp"
+#include "../DirectWidget/layouts/stack_layout.hpp"
+
+#include "bench.hpp"
+
+using namespace DirectWidget;
+using namespace DirectWidgetBench;
+using namespace DirectWidget::Layouts;
+
+namespace {
+
+    constexpr size_t RowCount = 200;
+    constexpr size_t ColumnCount = 10;
+
+    constexpr SIZE_F ViewportSize{ 4096.0f, 16384.0f };
+
+    constexpr std::chrono::microseconds FrameInterval{ 16667 };
+    constexpr std::chrono::microseconds Budget{ 2000 };
+
+    // Frames a layout may take before the bench gives up on it
+    constexpr uint32_t MaximumFrames = 10000;
+
+    // Content whose measure takes cost on the virtual clock
+    class CostlyWidget : public WidgetBase {
+    public:
+        CostlyWidget(std::chrono::microseconds cost) : m_cost(cost) {}
+
+        SIZE_F measure(const SIZE_F& maximum_size) const override {
+            VirtualClock::advance(m_cost);
+            return { 40.0f, 20.0f };
+        }
+
+    private:
+        std::chrono::microseconds m_cost;
+    };
+
+    std::shared_ptr<StackLayout> build_screen(std::chrono::microseconds cost)
+    {
+        auto screen = std::make_shared<StackLayout>();
+        screen->set_orientation(STACK_LAYOUT_VERTICAL);
+
+        for (size_t row = 0; row < RowCount; row++) {
+            auto stack = std::make_shared<StackLayout>();
+            stack->set_orientation(STACK_LAYOUT_HORIZONTAL);
+            for (size_t column = 0; column < ColumnCount; column++) {
+                stack->add_child(std::make_shared<CostlyWidget>(cost));
+            }
+            screen->add_child(stack);
+        }
+        return screen;
+    }
+
+    // Lays root out in frames as the window does, returns the number of frames it took
+    uint32_t run_frames(LayoutScheduler& scheduler, const widget_ptr& root, std::chrono::microseconds budget)
+    {
+        root->set_maximum_size(ViewportSize);
+        root->set_constraints(BOUNDS_F{ 0, 0, ViewportSize.width, ViewportSize.height });
+        root->discard_measure();
+
+        uint32_t frames = 0;
+        do {
+            {
+                LayoutScheduler::Slice slice(scheduler, budget);
+                scheduler.resume();
+                WidgetBase::RenderBoundsResource->get_or_initialize_resource(root.get());
+            }
+            frames++;
+            VirtualClock::advance(FrameInterval);
+        } while (scheduler.has_pending() && frames < MaximumFrames);
+
+        return frames;
+    }
+}
+
+void DirectWidgetBench::run_scheduler_bench(BenchContext& context)
+{
+    // Measures shorter than the budget, and measures of which only a few fit into it
+    const std::chrono::microseconds costs[] = { std::chrono::microseconds(50), std::chrono::microseconds(700) };
+
+    for (auto cost : costs) {
+        LayoutScheduler scheduler(VirtualClock::now);
+
+        auto unbudgeted_root = build_screen(cost);
+        auto unbudgeted_frames = run_frames(scheduler, unbudgeted_root, std::chrono::microseconds(0));
+        auto expected = WidgetBase::MeasureResource->get_or_initialize_resource(unbudgeted_root.get());
+        context.check(unbudgeted_frames == 1, L"layout without a budget took more than one frame");
+
+        scheduler.reset_statistics();
+
+        auto root = build_screen(cost);
+        auto frames = run_frames(scheduler, root, Budget);
+
+        auto& slices = scheduler.slice_histogram();
+        auto& completions = scheduler.completion_histogram();
+
+        context.check(scheduler.has_pending() == false, L"budgeted layout did not complete");
+        context.check(frames > 1, L"budgeted layout was not sliced");
+        context.check(slices.maximum() <= Budget + cost, L"slice overran its budget by more than one measure");
+
+        // Once complete, the screen has the measure it gets without a budget
+        auto& measure = WidgetBase::MeasureResource->get_or_initialize_resource(root.get());
+        context.check(measure.width == expected.width && measure.height == expected.height, L"budgeted layout measured a different size");
+
+        context.report(std::format(L"{} widgets, {}us per measure, budget {}us: frames={} slices={} overruns={} deferred={} "
+            L"slice p50={}us p99={}us max={}us, completion={}us",
+            RowCount * ColumnCount, cost.count(), Budget.count(), frames,
+            slices.count(), scheduler.overrun_count(), scheduler.deferred_count(),
+            slices.percentile(50).count(), slices.percentile(99).count(), slices.maximum().count(),
+            completions.maximum().count()));
+    }
+}
@@ -0,0 +1,129 @@
+// tile_bench.cpp: Tiled scrolling bench
+// Scrolls tiled content of a ScrollViewer through a Snapshot, once with an empty TileCache and once over the tiles
+// the first pass left. Reports tile hits, misses and prefetches with the render times of both passes, and checks
+// the second pass rasterized nothing.
+
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <memory>
+#include <string>
+
+#include <Windows.h>
+#include <d2d1helper.h>
+
+#include "../DirectWidget/core/app.hpp"
+#include "../DirectWidget/core/snapshot.hpp"
+#include "../DirectWidget/core/tile_cache.hpp"
+#include "../DirectWidget/layouts/scroll_viewer.hpp"
+#include "../DirectWidget/layouts/stack_layout.hpp"
+#include "../DirectWidget/widgets/box_widget.hpp"
+
+#include "bench.hpp"
+
+using namespace DirectWidget;
+using namespace DirectWidget::Layouts;
+using namespace DirectWidget::Widgets;
+using namespace DirectWidgetBench;
+
+namespace {
+
+    constexpr SIZE_F ViewportSize{ 800.0f, 600.0f };
+
+    // Rows of the content, 8192 pixels high in all
+    constexpr size_t RowCount = 128;
+    constexpr float RowHeight = 64.0f;
+
+    // Distance scrolled between two renders
+    constexpr float ScrollStep = 48.0f;
+
+    typedef struct {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t prefetched;
+        size_t frames;
+        std::chrono::microseconds p50;
+        std::chrono::microseconds p95;
+        std::chrono::microseconds total;
+    } PASS;
+
+    std::shared_ptr<ScrollViewer> build_viewer()
+    {
+        auto content = std::make_shared<StackLayout>();
+        content->set_orientation(STACK_LAYOUT_VERTICAL);
+        content->set_tiled(true);
+
+        for (size_t row = 0; row < RowCount; row++) {
+            auto box = std::make_shared<BoxWidget>();
+            box->set_size(SIZE_F{ ViewportSize.width, RowHeight });
+            box->set_background_color(row % 2 == 0 ? D2D1::ColorF(0.9f, 0.9f, 0.95f) : D2D1::ColorF(0.6f, 0.7f, 0.9f));
+            box->set_stroke_color(D2D1::ColorF(D2D1::ColorF::Black));
+            box->set_stroke_width(1.0f);
+            content->add_child(box);
+        }
+
+        auto viewer = std::make_shared<ScrollViewer>();
+        viewer->set_content(content);
+        return viewer;
+    }
+
+    // Scrolls from the top to the bottom of the content, one render per step
+    PASS scroll_pass(Snapshot& snapshot, const std::shared_ptr<ScrollViewer>& viewer, bool& failed)
+    {
+        viewer->set_vertical_offset(0);
+        failed |= FAILED(snapshot.render(viewer));
+
+        auto& cache = TileCache::instance();
+        cache.reset_statistics();
+        snapshot.reset_statistics();
+
+        size_t frames = 0;
+        Stopwatch stopwatch;
+        for (auto offset = ScrollStep; offset < RowCount * RowHeight; offset += ScrollStep) {
+            viewer->set_vertical_offset(offset);
+            failed |= FAILED(snapshot.render(viewer));
+            frames++;
+        }
+        auto total = stopwatch.elapsed();
+
+        auto& histogram = snapshot.render_histogram();
+        return {
+            cache.hit_count(), cache.miss_count(), cache.prefetch_count(), frames,
+            histogram.percentile(50), histogram.percentile(95), total,
+        };
+    }
+
+    std::wstring format_pass(PCWSTR name, const PASS& pass)
+    {
+        return std::format(L"{}: hits={} misses={} prefetched={} render p50={}us p95={}us total={}us",
+            name, pass.hits, pass.misses, pass.prefetched, pass.p50.count(), pass.p95.count(), pass.total.count());
+    }
+}
+
+void DirectWidgetBench::run_tile_bench(BenchContext& context)
+{
+    auto& app = Application::instance();
+    if (app->d2d() == nullptr) {
+        auto hr = app->initialize();
+        context.check(SUCCEEDED(hr), L"Direct2D could not be initialized");
+        if (FAILED(hr)) return;
+    }
+
+    auto viewer = build_viewer();
+    auto failed = false;
+
+    TileCache::instance().clear();
+    Snapshot snapshot(ViewportSize);
+
+    auto cold = scroll_pass(snapshot, viewer, failed);
+    auto warm = scroll_pass(snapshot, viewer, failed);
+    snapshot.detach();
+
+    context.check(failed == false, L"snapshot failed to render");
+    context.check(cold.misses > 0, L"scrolling an empty cache rasterized no tile");
+    context.check(warm.misses == 0 && warm.prefetched == 0 && warm.hits > 0, L"scrolling over cached tiles rasterized tiles again");
+    context.check(TileCache::instance().has_tiles(viewer->content()->handle()) == false, L"tiles outlived the snapshot of their widget");
+
+    context.report(std::format(L"{} frames of {}x{}: {}, {}", cold.frames,
+        ViewportSize.width, ViewportSize.height, format_pass(L"cold", cold), format_pass(L"warm", warm)));
+}